@@ -257,6 +257,37 @@ namespace lintel {
 	    LINTEL_ATOMIC_STORE(&counter, t);
         }
 
+        /// load() is always at least an acquire; an explicit order
+        /// only matters with std::atomic.
+        T load(memory_order order) const {
+#if defined (LINTEL_USE_STD_ATOMICS)
+	    return counter.load(order);
+#else
+	    (void)order;
+	    return load();
+#endif
+        }
+
+        /// store() is sequentially consistent, which costs a locked
+        /// instruction on x86; a release or relaxed store is a plain
+        /// store there, for publishing data to another thread.
+        void store(T t, memory_order order) {
+#if defined (LINTEL_USE_STD_ATOMICS)
+	    counter.store(t, order);
+#else
+	    if (order == memory_order_seq_cst) {
+		store(t);
+		return;
+	    }
+#  if defined (LINTEL_USE_GCC_BUILTIN_SYNC_ATOMICS)
+	    ::__sync_synchronize();
+#  else
+	    asm volatile ("":::"memory"); // x86 stores are not reordered with earlier accesses
+#  endif
+	    *static_cast<volatile T *>(&counter) = t;
+#endif
+        }
+
         /// Assignement
         T operator=(T amount) { store(amount); return amount; }
 
@@ -268,6 +299,16 @@ namespace lintel {
         { return LINTEL_COMPARE_EXCHANGE(&counter, expected, desired); }
 
         T fetch_add(T amount) { return LINTEL_ATOMIC_FETCH(add, &counter, amount); }
+        /// An explicit order only matters with std::atomic, a relaxed
+        /// add is cheaper on machines other than x86.
+        T fetch_add(T amount, memory_order order) {
+#if defined (LINTEL_USE_STD_ATOMICS)
+	    return counter.fetch_add(amount, order);
+#else
+	    (void)order;
+	    return fetch_add(amount);
+#endif
+        }
         T fetch_sub(T amount) { return LINTEL_ATOMIC_FETCH(sub, &counter, amount); }
         T fetch_or (T amount) { return LINTEL_ATOMIC_FETCH(or , &counter, amount); }
         T fetch_and(T amount) { return LINTEL_ATOMIC_FETCH(and, &counter, amount); }
@@ -0,0 +1,54 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for BackgroundTasks class
+*/
+
+#ifndef LINTEL_BACKGROUND_TASKS_HPP
+#define LINTEL_BACKGROUND_TASKS_HPP
+
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+
+#include <Lintel/Deque.hpp>
+#include <Lintel/PThread.hpp>
+
+/// \brief Runs tasks in order on a single background thread
+///
+/// For work the caller should not have to wait for, such as freeing a
+/// large table; see RotatingHashMap::setBackgroundRunner.  add() can be
+/// called from any thread, but the tasks run one at a time, so a task
+/// only has to be safe against the threads other than the one
+/// running it.  Destroying a BackgroundTasks waits for all of the
+/// tasks added to it to finish.
+class BackgroundTasks : boost::noncopyable {
+public:
+    typedef boost::function<void ()> Task;
+
+    BackgroundTasks();
+    ~BackgroundTasks();
+
+    void add(const Task &task);
+
+    /// Wait until all of the tasks added so far have finished.
+    void wait();
+
+    /// Number of tasks added that have not finished
+    size_t pending() const;
+
+private:
+    void *run();
+
+    mutable PThreadMutex mutex;
+    PThreadCond work_cond, done_cond;
+    Deque<Task> tasks;
+    bool running, stopping;
+    PThreadFunction thread;
+};
+
+#endif
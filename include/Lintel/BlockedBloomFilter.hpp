@@ -0,0 +1,234 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for BlockedBloomFilter class
+*/
+
+#ifndef LINTEL_BLOCKED_BLOOM_FILTER_HPP
+#define LINTEL_BLOCKED_BLOOM_FILTER_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/CompilerMarkup.hpp>
+#include <Lintel/HashFns.hpp>
+
+/// \brief Bloom filter over 32 bit hashes that touches one cache line per key
+///
+/// The filter is split into 64 byte blocks of 8 words; a key sets one
+/// bit in each word of the block its hash picks, so a check reads a
+/// single cache line.  At 10 bits per key about 1% of the keys that
+/// were never added are reported as maybe present; keys that were
+/// added always are.  Keys can not be removed, so a filter in front
+/// of a table that has removes has to be rebuilt from time to time.
+///
+/// If it was asked to at init(), the filter also counts the checks
+/// made through check() and the false positives reported through
+/// falsePositive(), so that the owner can report how well it is
+/// doing.  The counters are atomic, so concurrent checks stay safe;
+/// without counting, check() is just mayContain().
+class BlockedBloomFilter {
+public:
+    struct FilterStats {
+	/// number of keys added since the filter was last cleared
+	size_t keys;
+	/// number of keys the filter was sized for
+	size_t capacity;
+	/// bits in the filter per key added
+	double bits_per_key;
+	/// checks made, checks that said definitely absent, and
+	/// checks that said maybe present for an absent key
+	uint64_t checks, negatives, false_positives;
+
+	/// fraction of the checks of absent keys that said maybe present
+	double falsePositiveRate() const {
+	    uint64_t absent = negatives + false_positives;
+	    return absent == 0 ? 0 : static_cast<double>(false_positives) / absent;
+	}
+    };
+
+    BlockedBloomFilter()
+	: block_mask(0), nkeys(0), max_keys(0), bits_per_key(0), count_stats(false) { }
+
+    BlockedBloomFilter(const BlockedBloomFilter &from) {
+	assign(from);
+    }
+
+    BlockedBloomFilter &operator=(const BlockedBloomFilter &from) {
+	if (this != &from) {
+	    assign(from);
+	}
+	return *this;
+    }
+
+    /// Size the filter for expected_keys at _bits_per_key, and clear
+    /// it.  The number of blocks is rounded up to a power of two.
+    /// count_stats turns on the check and false positive counters.
+    void init(size_t expected_keys, double _bits_per_key, bool _count_stats = false) {
+	INVARIANT(_bits_per_key >= 1 && _bits_per_key <= 64,
+		  boost::format("invalid bits_per_key %.6f") % _bits_per_key);
+	bits_per_key = _bits_per_key;
+	count_stats = _count_stats;
+	double want_blocks = expected_keys * bits_per_key / block_bits;
+	size_t nblocks = 1;
+	while (nblocks < want_blocks) {
+	    nblocks *= 2;
+	}
+	std::vector<uint64_t> tmp(nblocks * block_words + block_words - 1, 0);
+	storage.swap(tmp);
+	block_mask = nblocks - 1;
+	nkeys = 0;
+	max_keys = static_cast<size_t>(nblocks * block_bits / bits_per_key);
+    }
+
+    /// true once init() has been called
+    bool enabled() const {
+	return !storage.empty();
+    }
+
+    /// the bits per key init() was called with
+    double bitsPerKey() const {
+	return bits_per_key;
+    }
+
+    bool countingStats() const {
+	return count_stats;
+    }
+
+    /// Forget all of the keys; the counters are kept.
+    void clear() {
+	std::fill(storage.begin(), storage.end(), 0);
+	nkeys = 0;
+    }
+
+    void add(uint32_t hash) {
+	uint64_t h = lintel::mix64(hash);
+	uint64_t *block = blockFor(h);
+	for(unsigned i = 0; i < block_words; ++i) {
+	    block[i] |= bitFor(h, i);
+	}
+	++nkeys;
+    }
+
+    /// false if a key with this hash was definitely never added
+    bool mayContain(uint32_t hash) const {
+	uint64_t h = lintel::mix64(hash);
+	const uint64_t *block = blockFor(h);
+	for(unsigned i = 0; i < block_words; ++i) {
+	    if ((block[i] & bitFor(h, i)) == 0) {
+		return false;
+	    }
+	}
+	return true;
+    }
+
+    /// mayContain(hash), counted in the statistics if counting
+    bool check(uint32_t hash) const {
+	bool ret = mayContain(hash);
+	if (count_stats) {
+	    checks.fetch_add(1, lintel::memory_order_relaxed);
+	    if (!ret) {
+		negatives.fetch_add(1, lintel::memory_order_relaxed);
+	    }
+	}
+	return ret;
+    }
+
+    /// Record that check() said maybe present for an absent key.
+    void falsePositive() const {
+	if (count_stats) {
+	    false_positives.fetch_add(1, lintel::memory_order_relaxed);
+	}
+    }
+
+    void prefetch(uint32_t hash) const {
+	LINTEL_PREFETCH(blockFor(lintel::mix64(hash)));
+    }
+
+    /// true once more keys have been added than the filter was sized
+    /// for, at which point its false positive rate climbs quickly.
+    bool full() const {
+	return nkeys > max_keys;
+    }
+
+    FilterStats stats() const {
+	FilterStats ret;
+	ret.keys = nkeys;
+	ret.capacity = max_keys;
+	ret.bits_per_key = nkeys == 0 ? 0
+	    : static_cast<double>((block_mask + 1) * block_bits) / nkeys;
+	ret.checks = checks.load(lintel::memory_order_relaxed);
+	ret.negatives = negatives.load(lintel::memory_order_relaxed);
+	ret.false_positives = false_positives.load(lintel::memory_order_relaxed);
+	return ret;
+    }
+
+    size_t memoryUsage() const {
+	return storage.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    static const unsigned block_words = 8;
+    static const unsigned block_bits = 64 * block_words;
+
+    // the blocks start at a different offset in a copy of the storage
+    void assign(const BlockedBloomFilter &from) {
+	std::vector<uint64_t> tmp(from.storage.size(), 0);
+	storage.swap(tmp);
+	if (!storage.empty()) {
+	    std::copy(from.blocks(), from.blocks() + (from.block_mask + 1) * block_words,
+		      const_cast<uint64_t *>(blocks()));
+	}
+	block_mask = from.block_mask;
+	nkeys = from.nkeys;
+	max_keys = from.max_keys;
+	bits_per_key = from.bits_per_key;
+	count_stats = from.count_stats;
+	checks.store(from.checks.load(lintel::memory_order_relaxed),
+		     lintel::memory_order_relaxed);
+	negatives.store(from.negatives.load(lintel::memory_order_relaxed),
+			lintel::memory_order_relaxed);
+	false_positives.store(from.false_positives.load(lintel::memory_order_relaxed),
+			      lintel::memory_order_relaxed);
+    }
+
+    // the storage has room to start the blocks on a cache line boundary
+    const uint64_t *blocks() const {
+	const uint64_t *p = &storage[0];
+	size_t misalign = (reinterpret_cast<size_t>(p) / sizeof(uint64_t)) % block_words;
+	return misalign == 0 ? p : p + block_words - misalign;
+    }
+
+    const uint64_t *blockFor(uint64_t h) const {
+	return blocks() + ((h >> 32) & block_mask) * block_words;
+    }
+
+    uint64_t *blockFor(uint64_t h) {
+	return const_cast<uint64_t *>(static_cast<const BlockedBloomFilter *>(this)->blockFor(h));
+    }
+
+    // a different odd multiplier for each word picks its bit from the
+    // low half of the hash, the high half picked the block.
+    static uint64_t bitFor(uint64_t h, unsigned word) {
+	static const uint32_t salt[block_words] = {
+	    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+	};
+	return 1ULL << ((static_cast<uint32_t>(h) * salt[word]) >> 26);
+    }
+
+    std::vector<uint64_t> storage;
+    size_t block_mask, nkeys, max_keys;
+    double bits_per_key;
+    bool count_stats;
+    mutable lintel::Atomic<uint64_t> checks, negatives, false_positives;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for CalendarQueue class
+*/
+
+#ifndef LINTEL_CALENDAR_QUEUE_HPP
+#define LINTEL_CALENDAR_QUEUE_HPP
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <boost/static_assert.hpp>
+#include <boost/utility.hpp>
+
+#include <Lintel/AssertBoost.hpp>
+
+/// \brief Brown's calendar queue, over unsigned integer times
+///
+/// For event queues whose events are spread over time; top() is the
+/// value with the smallest key.  Time is cut into days of 2^shift
+/// ticks, and the day of a key picks its bucket, modulo the number of
+/// buckets, so a bucket holds the events of one day in each "year".
+/// Popping looks at the current day's bucket, moving on a day at a
+/// time, so push and pop take constant time when there are a few
+/// events per day.  The buckets are doubled or halved as the queue
+/// grows or shrinks, and the day length is then set from the spacing
+/// of the earliest events.  Unlike RadixHeap, keys may go back in
+/// time.  Values with the same key come out in no particular order.
+template<class Key, class Value>
+class CalendarQueue : boost::noncopyable {
+public:
+    BOOST_STATIC_ASSERT(std::numeric_limits<Key>::is_integer
+			&& !std::numeric_limits<Key>::is_signed);
+
+    typedef std::pair<Key, Value> value_type;
+
+    CalendarQueue() : shift(0), day(0), nvalues(0) {
+	buckets.resize(min_buckets);
+    }
+
+    void push(Key key, const Value &val) {
+	insertNoResize(value_type(key, val));
+	if (nvalues > 2 * buckets.size()) {
+	    resize(2 * buckets.size());
+	}
+    }
+
+    const value_type &top() const {
+	DEBUG_SINVARIANT(!empty());
+	return buckets[day & mask()].back();
+    }
+
+    void pop() {
+	DEBUG_SINVARIANT(!empty());
+	buckets[day & mask()].pop_back();
+	--nvalues;
+	if (nvalues > 0 && nvalues < buckets.size() / 2 && buckets.size() > min_buckets) {
+	    resize(buckets.size() / 2);
+	} else if (nvalues > 0) {
+	    findDay();
+	}
+    }
+
+    size_t size() const {
+	return nvalues;
+    }
+
+    bool empty() const {
+	return nvalues == 0;
+    }
+
+    void clear() {
+	for(size_t i = 0; i < buckets.size(); ++i) {
+	    buckets[i].clear();
+	}
+	nvalues = 0;
+    }
+
+    /// Number of buckets, and the number of ticks in a day
+    size_t nbuckets() const {
+	return buckets.size();
+    }
+    Key dayLength() const {
+	return static_cast<Key>(1) << shift;
+    }
+
+private:
+    static const size_t min_buckets = 16;
+    // how many of the earliest events to look at for the day length
+    static const size_t nsample = 64;
+
+    struct KeyGreater {
+	bool operator()(const value_type &a, const value_type &b) const {
+	    return a.first > b.first;
+	}
+    };
+
+    size_t mask() const {
+	return buckets.size() - 1;
+    }
+
+    // Move day forward to the day of the next value.  If a year goes
+    // by without one, the values are far apart, so look at the next
+    // value of every bucket instead.
+    void findDay() {
+	for(size_t i = 0; i < buckets.size(); ++i, ++day) {
+	    const std::vector<value_type> &bucket(buckets[day & mask()]);
+	    if (!bucket.empty() && (bucket.back().first >> shift) == day) {
+		return;
+	    }
+	}
+	Key min_key = std::numeric_limits<Key>::max();
+	for(size_t i = 0; i < buckets.size(); ++i) {
+	    if (!buckets[i].empty() && buckets[i].back().first < min_key) {
+		min_key = buckets[i].back().first;
+	    }
+	}
+	day = min_key >> shift;
+    }
+
+    // Brown's rule: a day is about three times the average gap between
+    // the earliest events.
+    unsigned chooseShift(std::vector<Key> &keys) {
+	size_t n = keys.size() < nsample ? keys.size() : nsample;
+	if (n < 2) {
+	    return shift;
+	}
+	std::nth_element(keys.begin(), keys.begin() + (n - 1), keys.end());
+	std::sort(keys.begin(), keys.begin() + n);
+	Key gap = (keys[n - 1] - keys[0]) / (n - 1);
+	Key width = gap > std::numeric_limits<Key>::max() / 3
+	    ? std::numeric_limits<Key>::max() : 3 * gap;
+	unsigned ret = 0;
+	while (ret + 1 < static_cast<unsigned>(std::numeric_limits<Key>::digits)
+	       && (static_cast<Key>(1) << ret) < width) {
+	    ++ret;
+	}
+	return ret;
+    }
+
+    void resize(size_t new_buckets) {
+	std::vector<std::vector<value_type> > old(new_buckets);
+	old.swap(buckets);
+	std::vector<Key> keys;
+	keys.reserve(nvalues);
+	for(size_t i = 0; i < old.size(); ++i) {
+	    for(size_t j = 0; j < old[i].size(); ++j) {
+		keys.push_back(old[i][j].first);
+	    }
+	}
+	shift = chooseShift(keys);
+	size_t n = nvalues;
+	nvalues = 0;
+	for(size_t i = 0; i < old.size(); ++i) {
+	    for(size_t j = 0; j < old[i].size(); ++j) {
+		insertNoResize(old[i][j]);
+	    }
+	}
+	SINVARIANT(nvalues == n);
+	findDay();
+    }
+
+    void insertNoResize(const value_type &v) {
+	std::vector<value_type> &bucket(buckets[(v.first >> shift) & mask()]);
+	// each bucket is sorted by decreasing key, the next value is at the back
+	bucket.insert(std::upper_bound(bucket.begin(), bucket.end(), v, KeyGreater()), v);
+	if (nvalues == 0 || (v.first >> shift) < day) {
+	    day = v.first >> shift;
+	}
+	++nvalues;
+    }
+
+    std::vector<std::vector<value_type> > buckets;
+    unsigned shift;
+    // the day of the next value
+    Key day;
+    size_t nvalues;
+};
+
+#endif
@@ -26,6 +26,10 @@
         // usually false branch
     }
     \endverbatim
+
+    LINTEL_PREFETCH(addr) hints that the cache line holding addr will
+    be read soon; it does nothing on compilers without a prefetch
+    builtin.
 */
 
 #ifndef LINTEL_COMPILER_MARKUP_HPP
@@ -46,6 +50,7 @@
 #    define VAR_DEPRECATED __attribute__ ((deprecated))
 #    define LIKELY(x)      __builtin_expect ((x), 1)
 #    define UNLIKELY(x)    __builtin_expect ((x), 0)
+#    define LINTEL_PREFETCH(addr) __builtin_prefetch(addr)
 // # define __malloc       __attribute__ ((malloc))
 // # define __must_check   __attribute__ ((warn_unused_result))
 #elif defined(_MSC_VER)
@@ -56,6 +61,7 @@
 #    define VAR_DEPRECATED
 #    define LIKELY(x) (x)
 #    define UNLIKELY(x) (x)
+#    define LINTEL_PREFETCH(addr) ((void)0)
 #else
 #    define FUNC_ATTR_NORETURN_PREFIX
 #    define FUNC_ATTR_NORETURN     /* no noreturn attribute support */
@@ -64,6 +70,7 @@
 #    define VAR_DEPRECATED
 #    define LIKELY(x)      (x)
 #    define UNLIKELY(x)    (x)
+#    define LINTEL_PREFETCH(addr) ((void)0)
 #endif
 
 #endif
@@ -0,0 +1,212 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for ConcurrentHashMap class
+*/
+
+#ifndef LINTEL_CONCURRENT_HASHMAP_HPP
+#define LINTEL_CONCURRENT_HASHMAP_HPP
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+
+#include <Lintel/HashMap.hpp>
+#include <Lintel/PThread.hpp>
+
+/// \brief A HashMap that can be used from multiple threads at once
+///
+/// The map is split into a power of two number of shards, each a
+/// HashMap with its own mutex, so threads only contend when they hit
+/// the same shard.  The shard is picked from the top bits of the key's
+/// hash run through lintel::mix64, so keys spread over the shards even
+/// with the identity hash of the integers, and the hash table inside
+/// the shard still works from the unmixed hash.  Each key is hashed
+/// once, and the hash used for both the shard and the probe inside
+/// it.  Use a number of shards several
+/// times the number of threads.
+///
+/// Since another thread can remove or rehash an entry at any time,
+/// there is no operator[] or pointer returning lookup; values are
+/// copied out by lookup(), or modified in place under the shard lock
+/// by upsert().  Needs to be linked with LintelPThread.
+template <class K, class V,
+          class KHash = HashMap_hash<const K>,
+          class KEqual = std::equal_to<const K> >
+class ConcurrentHashMap : boost::noncopyable {
+public:
+    typedef HashMap<K, V, KHash, KEqual> HashMapT;
+
+    /// nshards is rounded up to a power of two.
+    explicit ConcurrentHashMap(uint32_t nshards = 64) {
+	SINVARIANT(nshards > 0 && nshards <= (1U << 31));
+	shard_bits = 0;
+	while ((1U << shard_bits) < nshards) {
+	    ++shard_bits;
+	}
+	shards = new Shard[1U << shard_bits];
+    }
+
+    ~ConcurrentHashMap() {
+	delete [] shards;
+    }
+
+    /// Calls fn(V &) on the value for key k under the shard lock,
+    /// first adding a default V if the key is not present.  fn
+    /// should be quick since it blocks all other accesses to the
+    /// shard, and must not call back into this map.  Returns true if
+    /// the key was added.
+    template<class Fn> bool upsert(const K &k, Fn fn) {
+	uint32_t hash = khash(k);
+	Shard &shard(shardFor(hash));
+	PThreadScopedLock lock(shard.mutex);
+	V *v = shard.map.lookupWithHash(k, hash);
+	bool added = false;
+	if (v == NULL) {
+	    v = shard.map.addWithHash(k, V(), hash);
+	    added = true;
+	}
+	fn(*v);
+	return added;
+    }
+
+    /// Set the value for key k, replacing any existing value.
+    void set(const K &k, const V &v) {
+	uint32_t hash = khash(k);
+	Shard &shard(shardFor(hash));
+	PThreadScopedLock lock(shard.mutex);
+	V *old = shard.map.lookupWithHash(k, hash);
+	if (old == NULL) {
+	    shard.map.addWithHash(k, v, hash);
+	} else {
+	    *old = v;
+	}
+    }
+
+    /// Copies the value for key k into out and returns true if the key
+    /// is present, otherwise returns false and leaves out alone.
+    bool lookup(const K &k, V &out) const {
+	uint32_t hash = khash(k);
+	Shard &shard(shardFor(hash));
+	PThreadScopedLock lock(shard.mutex);
+	const V *v = shard.map.lookupWithHash(k, hash);
+	if (v == NULL) {
+	    return false;
+	} else {
+	    out = *v;
+	    return true;
+	}
+    }
+
+    bool exists(const K &k) const {
+	uint32_t hash = khash(k);
+	Shard &shard(shardFor(hash));
+	PThreadScopedLock lock(shard.mutex);
+	return shard.map.lookupWithHash(k, hash) != NULL;
+    }
+
+    /** returns true if something was removed */
+    bool remove(const K &k, bool must_exist = true) {
+	uint32_t hash = khash(k);
+	Shard &shard(shardFor(hash));
+	PThreadScopedLock lock(shard.mutex);
+	return shard.map.removeWithHash(k, hash, must_exist);
+    }
+
+    /// Number of entries; only exact if no other thread is changing
+    /// the map.
+    size_t size() const {
+	size_t ret = 0;
+	for(uint32_t i = 0; i < nShards(); ++i) {
+	    PThreadScopedLock lock(shards[i].mutex);
+	    ret += shards[i].map.size();
+	}
+	return ret;
+    }
+
+    void clear() {
+	for(uint32_t i = 0; i < nShards(); ++i) {
+	    PThreadScopedLock lock(shards[i].mutex);
+	    shards[i].map.clear();
+	}
+    }
+
+    uint32_t nShards() const {
+	return 1U << shard_bits;
+    }
+
+    /// Number of entries in one shard, for checking how evenly the
+    /// keys spread; only exact if no other thread is changing it.
+    size_t shardSize(uint32_t shard) const {
+	SINVARIANT(shard < nShards());
+	PThreadScopedLock lock(shards[shard].mutex);
+	return shards[shard].map.size();
+    }
+
+    /// Calls fn(const K &, V &) on every entry.  The shards are split
+    /// across nthreads threads (default one per cpu), so fn is called
+    /// concurrently and must be thread-safe; each shard is locked
+    /// while it is walked.  fn must not call back into this map.
+    /// Entries added or removed by other threads during the walk may
+    /// or may not be seen.
+    template<class Fn> void forEach(Fn fn, int nthreads = -1) {
+	if (nthreads < 0) {
+	    nthreads = PThreadMisc::getNCpus();
+	}
+	if (static_cast<uint32_t>(nthreads) > nShards()) {
+	    nthreads = nShards();
+	}
+	if (nthreads <= 1) {
+	    forEachWorker(&fn, 0, 1);
+	    return;
+	}
+	std::vector<PThreadFunction *> workers;
+	for(int i = 0; i < nthreads; ++i) {
+	    workers.push_back(new PThreadFunction
+			      (boost::bind(&ConcurrentHashMap::forEachWorker<Fn>,
+					   this, &fn, i, nthreads)));
+	    workers.back()->start();
+	}
+	for(int i = 0; i < nthreads; ++i) {
+	    workers[i]->join();
+	    delete workers[i];
+	}
+    }
+
+private:
+    // The padding keeps the map of one shard and the mutex of the next
+    // out of the same cache line, so threads working on neighboring
+    // shards don't slow each other down.
+    struct Shard {
+	PThreadMutex mutex;
+	HashMapT map;
+	char padding[64];
+    };
+
+    Shard &shardFor(uint32_t hash) const {
+	return shards[(lintel::mix64(hash) >> 32) >> (32 - shard_bits)];
+    }
+
+    template<class Fn> void *forEachWorker(Fn *fn, uint32_t first, uint32_t step) {
+	for(uint32_t i = first; i < nShards(); i += step) {
+	    PThreadScopedLock lock(shards[i].mutex);
+	    for(typename HashMapT::iterator j = shards[i].map.begin();
+		j != shards[i].map.end(); ++j) {
+		(*fn)(j->first, j->second);
+	    }
+	}
+	return NULL;
+    }
+
+    Shard *shards;
+    uint32_t shard_bits;
+    KHash khash;
+};
+
+#endif
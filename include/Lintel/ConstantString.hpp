@@ -21,15 +21,13 @@
 #include <cstring>
 
 #include <boost/static_assert.hpp>
+#include <boost/utility.hpp>
 
 #include <Lintel/HashMap.hpp>
 
-// TODO: think about how to make this thread safe; potentially one
-// choice is to make the constructor the constantstring take a
-// stringpool argument with a choice on the pool as to whether it is
-// locked or not.
-
-// Class is here merely to force type incompatibility
+// Class is here merely to force type incompatibility.  A value is
+// the bytes of the string followed by a null, preceded by the hash of
+// the bytes (lintel::hashBytes) and then the length, each a uint32_t.
 struct ConstantStringValue;
 
 // These functions are stored out here rather than as static inline
@@ -38,15 +36,62 @@ struct ConstantStringValue;
 inline uint32_t ConstantString_length(const ConstantStringValue *ptr) { 
     return *(reinterpret_cast<const uint32_t *>(ptr) - 1); 
 }
+inline uint32_t ConstantString_hash(const ConstantStringValue *ptr) { 
+    return *(reinterpret_cast<const uint32_t *>(ptr) - 2); 
+}
 inline const char *ConstantString_c_str(const ConstantStringValue *ptr) { 
     return reinterpret_cast<const char *>(ptr); 
 }
 
+/** \brief A pool holding the bytes of a set of ConstantStrings
+ *
+ * Strings can be added to a pool from multiple threads at once.  The pool is split into
+ * shards by hash; looking up a string that is already in the pool takes no locks, adding a
+ * new one locks only its shard, and each thread copies new strings into its own buffers.
+ *
+ * The pool owns all of the memory for its strings, so destroying or resetting it frees
+ * everything at once, at the cost of one free per buffer rather than one per string.  Any
+ * ConstantString created from the pool is left dangling, other than empty strings, which are
+ * not stored in any pool.
+ */
+class ConstantStringPool : boost::noncopyable {
+public:
+    /// nshards is rounded up to a power of two; use several times the
+    /// number of threads that add strings at the same time.
+    explicit ConstantStringPool(uint32_t nshards = 64);
+    ~ConstantStringPool();
+
+    /// Free all of the strings in the pool; must not be called while
+    /// other threads are using the pool.
+    void reset();
+
+    /// Number of distinct strings in the pool
+    size_t size() const;
+    /// Bytes allocated for strings
+    size_t memoryUsage() const;
+    void dumpInfo() const;
+
+    /// The pool used by ConstantStrings created without one; it is
+    /// never freed.
+    static ConstantStringPool &global();
+
+    /// \cond SEMI_INTERNAL_CLASSES
+    class Impl;
+    /// \endcond
+private:
+    friend class ConstantString;
+    ConstantStringValue *intern(const char *s, uint32_t slen);
+
+    Impl *impl;
+};
+
 /** \brief A class representing a constant string.
  * 
  * ConstantString is much like std::string except that only a single instance of each string
- * will be stored.  Currently the implementation uses globals so there is only a single string
- * pool.  This approach means that the memory allocated for constant string will never be freed. 
+ * will be stored in a ConstantStringPool, so copying and comparing them is cheap.  Strings
+ * created without a pool go in ConstantStringPool::global(), which is never freed.  Strings
+ * from different pools compare and hash by value, so they can be mixed, but comparing them
+ * has to compare their bytes.
  */
 
 class ConstantString {
@@ -67,14 +112,28 @@ public:
     ConstantString(const void *s, uint32_t slen) {
 	init(static_cast<const char *>(s), slen);
     }
+    ConstantString(const std::string &str, ConstantStringPool &pool) { 
+	init(str.data(), str.size(), pool);
+    }
+    ConstantString(const char *s, ConstantStringPool &pool) {
+	init(s, strlen(s), pool);
+    }
+    ConstantString(const void *s, uint32_t slen, ConstantStringPool &pool) {
+	init(static_cast<const char *>(s), slen, pool);
+    }
     ConstantString() { 
-	if (empty_string_myptr != NULL) {
-	    myptr = empty_string_myptr;
+	myptr = emptyString();
+    }
+    void init(const void *s, uint32_t slen) {
+	init(s, slen, ConstantStringPool::global());
+    }
+    void init(const void *s, uint32_t slen, ConstantStringPool &pool) {
+	if (slen == 0) {
+	    myptr = emptyString();
 	} else {
-	    init("", 0); 
+	    myptr = pool.intern(static_cast<const char *>(s), slen);
 	}
     }
-    void init(const void *s, uint32_t slen);
 
     const char *c_str() const { return ConstantString_c_str(myptr); }
     const char *data() const { return ConstantString_c_str(myptr); }
@@ -83,21 +142,11 @@ public:
     bool empty() const { return size() == 0; }
     std::string str() const { return std::string(c_str(), size()); }
 
+    /// The hash of the bytes, stored with the string; the same as
+    /// the hash of the equal std::string, and the same for equal
+    /// strings from different pools.
     uint32_t hash() const {
-	BOOST_STATIC_ASSERT(sizeof(ConstantStringValue *) == 4 ||
-			    sizeof(ConstantStringValue *) == 8);
-	if (sizeof(ConstantStringValue *) == 4) {
-	    // guaranteed to be unique!
-	    // Cast through size_t because on 64bit gcc 3.4.6
-	    // complains about the cast losing precision even though
-	    // this branch of the if is dead.
-	    size_t tmp = reinterpret_cast<size_t>(myptr);
-	    return static_cast<uint32_t>(tmp);
-	} else if (sizeof(ConstantStringValue *) == 8) {
-	    // likely to be unique
-	    uint64_t v = reinterpret_cast<uint64_t>(myptr);
-	    return static_cast<uint32_t>((v & 0xFFFFFFFFULL) ^ (v >> 32));
-	} 
+	return ConstantString_hash(myptr);
     }
     int compare(const ConstantString &rhs) const {
 	int cmplen = size() < rhs.size() ? size() : rhs.size();
@@ -117,23 +166,20 @@ public:
 
     /// \cond SEMI_INTERNAL_CLASSES
 
-    struct buffer {
-	ConstantStringValue *data;
-	int size;
-	int amt_used;
-    };
     static void dumpInfo();
-    typedef std::vector<buffer> bufvect;
 
-    // Comparisons are done with char *'s here so that when doing a
-    // hash check to see if we already have a string, we don't have to
-    // create a constant-string formed string before it can do the
-    // hash lookup; note that this substantially embeds the idea that
-    // the c_str() pointer of a thing is the same as the pointer
+    // Comparisons are done with char *'s here; note that this
+    // substantially embeds the idea that the c_str() pointer of a
+    // thing is the same as the pointer.  The StringRef versions let
+    // a table check whether it already has a string without creating
+    // a constant-string formed copy of it first.
     class hteHash {
     public:
 	unsigned int operator()(const ConstantStringValue *k) const {
-	    return lintel::hashBytes(ConstantString_c_str(k),ConstantString_length(k));
+	    return ConstantString_hash(k);
+	}
+	unsigned int operator()(const lintel::StringRef &k) const {
+	    return lintel::hashBytes(k.data, k.size);
 	}
     };
     class hteEqual {
@@ -147,22 +193,31 @@ public:
 		return memcmp(ConstantString_c_str(a),ConstantString_c_str(b), len_a) == 0;
 	    }
 	}
+	bool operator()(const lintel::StringRef &a, const ConstantStringValue *b) const {
+	    return a.size == ConstantString_length(b) 
+		&& memcmp(a.data, ConstantString_c_str(b), a.size) == 0;
+	}
     };
     /// \endcond
     bool equal(const ConstantString &to) const {
-	return myptr == to.myptr ? true : false;
+	if (myptr == to.myptr) {
+	    return true;
+	} else {
+	    // may be equal if from different pools
+	    return hash() == to.hash() && size() == to.size() 
+		&& memcmp(c_str(), to.c_str(), size()) == 0;
+	}
     }
 private:
-    ConstantStringValue *myptr;
+    static ConstantStringValue *emptyString() {
+	// the empty string is its hash and a length of 0 followed by a
+	// null byte.
+	return reinterpret_cast<ConstantStringValue *>(empty_string + 2);
+    }
 
-    static int nstrings;
-    static int string_bytes;
-    static const int buffer_size = 512*1024;
-    static bufvect *buffers;
-    typedef HashTable<ConstantStringValue *, hteHash, hteEqual> CS_hashtable;
+    ConstantStringValue *myptr;
 
-    static CS_hashtable *hashtable;
-    static ConstantStringValue *empty_string_myptr;
+    static uint32_t empty_string[3];
 };
 
 inline bool
@@ -12,6 +12,9 @@
 #ifndef LINTEL_DEQUE_HPP
 #define LINTEL_DEQUE_HPP
 
+#include <algorithm>
+#include <limits>
+#include <memory>
 #include <vector>
 
 #include <boost/utility.hpp>
@@ -19,9 +22,10 @@
 #include <Lintel/AssertBoost.hpp>
 // don't use deque for runnable; it has horrid performance on
 // HP-UX (~10us / insertion to empty deque) Instead, standard
-// rules on a rotating vector, valid range is [q_front
-// .. q_back -1] (wrapping), one slot is wasted, front ==
-// back -> empty
+// rules on a rotating array.  The size is a power of two and
+// q_front and q_back count up without wrapping, so the valid range
+// is [q_front .. q_back - 1] masked by q_size - 1, the size is
+// q_back - q_front, and every slot can be used.
 
 /*!
     \class Deque
@@ -36,72 +40,155 @@
     Deque implementation that has amortized constant-time performance,
     rather than log(n); g++ deque looks better since it does the linked list
     of multiple elements; performance comparison unclear.
+
+    The capacity is always a power of two, so positions are masked
+    rather than taken modulo the size.  Growing keeps the contents, and
+    moves them under C++11.  The bulk push_back() and pop_front() copy
+    in at most two contiguous pieces, which std::copy turns into
+    memmove for plain types.
 */
 template <class T, class Alloc = std::allocator<T> >
 class Deque : boost::noncopyable {
 public:
+    /// default_size is rounded up to a power of two
     Deque(size_t default_size = 8) 
-	: q_front(0), q_back(0), q_size(default_size) {
-	INVARIANT(q_size > 1, "Must have size at least 2\n");
+	: q_front(0), q_back(0), q_size(roundSize(default_size)) {
+	INVARIANT(default_size > 1, "Must have size at least 2\n");
 	deque = allocator.allocate(q_size);
     }
 
     ~Deque() {
+	clear();
 	allocator.deallocate(deque, q_size);
     }
     typedef Deque<T> mytype;
 
     T &front() {
 	DEBUG_INVARIANT(!empty(), "front() on empty deque"); 
-	return deque[q_front];
+	return *slot(q_front);
+    }
+    const T &front() const {
+	DEBUG_INVARIANT(!empty(), "front() on empty deque"); 
+	return *slot(q_front);
     }
     T &back() {
 	DEBUG_INVARIANT(!empty(), "back() on empty dequeue");
-	return deque[(q_back + q_size - 1) % q_size];
+	return *slot(q_back - 1);
+    }
+    const T &back() const {
+	DEBUG_INVARIANT(!empty(), "back() on empty dequeue");
+	return *slot(q_back - 1);
     }
     T &at(size_t pos) {
 	DEBUG_INVARIANT(pos < size(), "invalid position for at()");
-	return deque[(q_front + pos) % q_size];
+	return *slot(q_front + pos);
+    }
+    const T &at(size_t pos) const {
+	DEBUG_INVARIANT(pos < size(), "invalid position for at()");
+	return *slot(q_front + pos);
     }
     void pop_front() {
 	DEBUG_INVARIANT(!empty(), "pop_front() on empty dequeue");
-	allocator.destroy(deque + q_front);
-	q_front = (q_front + 1) % q_size;
+	allocator.destroy(slot(q_front));
+	++q_front;
+    }
+    void pop_back() {
+	DEBUG_INVARIANT(!empty(), "pop_back() on empty dequeue");
+	--q_back;
+	allocator.destroy(slot(q_back));
     }
     void push_back(const T &val) { 
-	size_t back_next = (q_back + 1) % q_size; 
-	if (back_next != q_front) {
-	    allocator.construct(deque + q_back, val);
-	    q_back = back_next;
-	} else { 
-	    push_expand(val);
+	if (full()) {
+	    T tmp(val); // val could be in the deque
+	    grow(q_size * 2);
+	    allocator.construct(slot(q_back), tmp);
+	} else {
+	    allocator.construct(slot(q_back), val);
+	}
+	++q_back;
+    }
+    void push_front(const T &val) { 
+	if (full()) {
+	    T tmp(val);
+	    grow(q_size * 2);
+	    allocator.construct(slot(q_front - 1), tmp);
+	} else {
+	    allocator.construct(slot(q_front - 1), val);
 	}
+	--q_front;
+    }
+#if __cplusplus >= 201103L
+    void push_back(T &&val) {
+	emplace_back(std::move(val));
     }
+    void push_front(T &&val) {
+	emplace_front(std::move(val));
+    }
+    template<class... Args> void emplace_back(Args &&... args) {
+	if (full()) {
+	    T tmp(std::forward<Args>(args)...);
+	    grow(q_size * 2);
+	    allocator.construct(slot(q_back), std::move(tmp));
+	} else {
+	    allocator.construct(slot(q_back), std::forward<Args>(args)...);
+	}
+	++q_back;
+    }
+    template<class... Args> void emplace_front(Args &&... args) {
+	if (full()) {
+	    T tmp(std::forward<Args>(args)...);
+	    grow(q_size * 2);
+	    allocator.construct(slot(q_front - 1), std::move(tmp));
+	} else {
+	    allocator.construct(slot(q_front - 1), std::forward<Args>(args)...);
+	}
+	--q_front;
+    }
+#endif
     /// Add in an entire vector of values onto the back.
     void push_back(const std::vector<T> &vals) {
-	typedef typename std::vector<T>::const_iterator vector_iterator;
-	for(vector_iterator i = vals.begin(); 
-	    i != vals.end(); ++i) {
-	    push_back(*i);
+	if (!vals.empty()) {
+	    push_back(&vals[0], vals.size());
+	}
+    }
+    /// Add n values onto the back; they can not be in the deque.
+    void push_back(const T *vals, size_t n) {
+	if (size() + n > q_size) {
+	    grow(roundSize(size() + n));
 	}
+	size_t pos = q_back & (q_size - 1);
+	size_t first = std::min(n, q_size - pos);
+	std::uninitialized_copy(vals, vals + first, deque + pos);
+	q_back += first;
+	std::uninitialized_copy(vals + first, vals + n, deque);
+	q_back += n - first;
+    }
+    /// Remove the first n values, copying (under C++11 moving) them to
+    /// out; returns the end of the output.
+    template<class OutputIterator> OutputIterator pop_front(size_t n, OutputIterator out) {
+	DEBUG_INVARIANT(n <= size(), "pop_front(n) past the end of the deque");
+	size_t pos = q_front & (q_size - 1);
+	size_t first = std::min(n, q_size - pos);
+	out = moveOut(deque + pos, first, out);
+	out = moveOut(deque, n - first, out);
+	q_front += n;
+	return out;
     }
 
     bool empty() const { return q_front == q_back;} ;
-    size_t size() const { return (q_back + q_size - q_front) % q_size; }
+    size_t size() const { return q_back - q_front; }
 
-    // TODO: Implement correct resize (reserve + push_back's, or pop_back's if we handle non-empty)
+    /// Make room for at least new_size values without growing again,
+    /// keeping the contents; never shrinks the deque.
     void reserve(size_t new_size) {
-	INVARIANT(empty(),"Lame implementation only does reserve when empty");
 	INVARIANT(new_size > 0 && new_size < std::numeric_limits<size_t>::max(), 
                   "Must have size at least 1, and at most size_t::max() - 1");
-	new_size += 1; // for the empty entry that always exists
-	q_front = q_back = 0;
-	allocator.deallocate(deque, q_size);
-	q_size = new_size;
-	deque = allocator.allocate(q_size);
+	if (new_size > q_size) {
+	    grow(roundSize(new_size));
+	}
     }
 
-    size_t capacity() const { return q_size - 1; }
+    size_t capacity() const { return q_size; }
 
     /// \brief an iterator for Deque's
     class iterator {
@@ -133,8 +220,9 @@ public:
 	}
         /// dereference the iterator
 	T &operator *() {
-	    DEBUG_INVARIANT(cur_pos < mydeque->q_size, "invalid use of iterator");
-	    return mydeque->deque[cur_pos];
+	    DEBUG_INVARIANT(static_cast<size_t>(logicalOffset(*this)) < mydeque->size(),
+			    "invalid use of iterator");
+	    return *mydeque->slot(cur_pos);
 	}
         /// dereference the iterator
 	T *operator ->() {
@@ -162,13 +250,12 @@ public:
         /// adds diff and returns the iterator
         iterator operator+(ptrdiff_t diff) {
             DEBUG_SINVARIANT(inRangePlus(diff));
-            return iterator(mydeque, static_cast<size_t>(cur_pos + diff) % mydeque->q_size);
+            return iterator(mydeque, cur_pos + diff);
         }
         /// subtracts diff and returns the iterator
         iterator operator-(ptrdiff_t diff) {
             DEBUG_SINVARIANT(inRangeMinus(diff));
-            return iterator(mydeque, static_cast<size_t>(cur_pos + mydeque->q_size 
-                                                         - diff) % mydeque->q_size);
+            return iterator(mydeque, cur_pos - diff);
         }
         /// compares if lhs iterator is smaller than rhs iterator
         bool operator<(const iterator &rhs) {
@@ -193,14 +280,13 @@ public:
         /// adds diff to the iterator and returns the reference
         iterator &operator+=(ptrdiff_t diff) {
             DEBUG_SINVARIANT(inRangePlus(diff));
-            cur_pos = static_cast<size_t>(cur_pos + diff) % mydeque->q_size;
+            cur_pos += diff;
             return *this;
         }
         /// subtracts diff to the iterator and returns the reference
         iterator &operator-=(ptrdiff_t diff) {
             DEBUG_SINVARIANT(inRangeMinus(diff));
-                                  
-            cur_pos = static_cast<size_t>(cur_pos + mydeque->q_size - diff) % mydeque->q_size;
+            cur_pos -= diff;
             return *this;
         }
         /// returns difference between two iterators
@@ -220,16 +306,17 @@ public:
                 && static_cast<size_t>(logicalOffset(*this) + diff) <= mydeque->size();
         }
 	void increment() {
-	    DEBUG_INVARIANT(cur_pos < mydeque->q_size, "invalid use of iterator");
-	    cur_pos = (cur_pos + 1) % mydeque->q_size;
+	    DEBUG_INVARIANT(static_cast<size_t>(logicalOffset(*this)) < mydeque->size(),
+			    "invalid use of iterator");
+	    ++cur_pos;
 	}
         void decrement() {
             DEBUG_INVARIANT(logicalOffset(*this) > 0, "invalid use of iterator");
-            cur_pos = (cur_pos + mydeque->q_size - 1) % mydeque->q_size;
+            --cur_pos;
         }
         // The logical offset in the deque, as if the deque was a vector starting at 0.
         inline int64_t logicalOffset(const iterator &i) const {
-            return (i.cur_pos - i.mydeque->q_front + i.mydeque->q_size) % i.mydeque->q_size;
+            return static_cast<int64_t>(i.cur_pos - i.mydeque->q_front);
         }
 	Deque *mydeque;
 	size_t cur_pos;
@@ -244,58 +331,77 @@ public:
     }
 
     void clear() {
-	if (!empty()) {
-	    size_t max = q_back > q_front ? q_back : q_size;
-	    for(size_t i = q_front; i < max; ++i) {
-		allocator.destroy(deque + i);
-	    }
-	    if (q_back < q_front) {
-		for(size_t i = 0; i < q_back; ++i) {
-		    allocator.destroy(deque + i);
-		}
-	    }
+	for(size_t i = q_front; i != q_back; ++i) {
+	    allocator.destroy(slot(i));
 	}
 	q_front = q_back = 0;
 	DEBUG_SINVARIANT(empty());
     }
 
-    size_t memoryUsage() {
+    size_t memoryUsage() const {
 	return q_size * sizeof(T) + sizeof(Deque<T>);
     }
 
 private:
     friend class iterator;
-    void push_expand(const T &val) {
-	T *new_deque = allocator.allocate(q_size * 2);
-	size_t i = 0;
-	// copy back to 0 offset
-	if (q_front == 0) {
-	    // special case if it's already 0 offset
-	    for(;i<q_back;i++) {
-		allocator.construct(new_deque + i, deque[i]);
-		allocator.destroy(deque + i);
-	    }
-	} else {
-	    for(size_t j=q_front; j<q_size;++j) {
-		allocator.construct(new_deque + i, deque[j]);
-		allocator.destroy(deque + j);
-		++i;
-	    }
-	    for(size_t j=0;j<q_back;++j) {
-		allocator.construct(new_deque + i, deque[j]);
-		allocator.destroy(deque + j);
-		++i;
-	    }
+
+    static size_t roundSize(size_t size) {
+	INVARIANT(size <= std::numeric_limits<size_t>::max() / 2 + 1, "Deque too large");
+	size_t ret = 2;
+	while (ret < size) {
+	    ret *= 2;
 	}
-	INVARIANT(i == q_size-1, boost::format("internal %u %u %u %u")
-                  % i % q_size % q_front % q_back);
-	q_front = 0;
-	allocator.construct(new_deque + i, val);
-	q_back = i + 1;
+	return ret;
+    }
+
+    bool full() const {
+	return q_back - q_front == q_size;
+    }
+
+    T *slot(size_t pos) const {
+	return deque + (pos & (q_size - 1));
+    }
+
+    template<class OutputIterator>
+    OutputIterator moveOut(T *from, size_t n, OutputIterator out) {
+#if __cplusplus >= 201103L
+	out = std::move(from, from + n, out);
+#else
+	out = std::copy(from, from + n, out);
+#endif
+	for(size_t i = 0; i < n; ++i) {
+	    allocator.destroy(from + i);
+	}
+	return out;
+    }
+
+    void moveTo(T *from, size_t n, T *to) {
+	for(size_t i = 0; i < n; ++i) {
+#if __cplusplus >= 201103L
+	    allocator.construct(to + i, std::move(from[i]));
+#else
+	    allocator.construct(to + i, from[i]);
+#endif
+	    allocator.destroy(from + i);
+	}
+    }
+
+    // copy back to 0 offset
+    void grow(size_t new_size) {
+	DEBUG_SINVARIANT(new_size > q_size && (new_size & (new_size - 1)) == 0);
+	T *new_deque = allocator.allocate(new_size);
+	size_t n = size();
+	size_t pos = q_front & (q_size - 1);
+	size_t first = std::min(n, q_size - pos);
+	moveTo(deque + pos, first, new_deque);
+	moveTo(deque, n - first, new_deque + first);
 	allocator.deallocate(deque, q_size);
-	q_size = q_size * 2;
 	deque = new_deque;
+	q_size = new_size;
+	q_front = 0;
+	q_back = n;
     }
+
     Alloc allocator;
     T *deque; 
     size_t q_front; 
@@ -0,0 +1,115 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for EpochReclaimer class
+*/
+
+#ifndef LINTEL_EPOCH_RECLAIMER_HPP
+#define LINTEL_EPOCH_RECLAIMER_HPP
+
+#include <stdint.h>
+
+#include <boost/utility.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/CompilerMarkup.hpp>
+
+/// \brief Epoch based reclamation of memory that readers may still be using
+///
+/// For data that is read through a shared pointer and replaced by
+/// swapping in a new copy, such as SnapshotHashMap.  Readers wrap
+/// their use of the pointer in a ReadGuard; the writer swaps the
+/// pointer and then calls retire() on the old copy, which is deleted
+/// once every ReadGuard that could have seen it has finished.
+///
+/// A ReadGuard costs two plain stores to a slot of the thread's own
+/// and no locks or atomic read-modify-write operations.  Where Linux
+/// supports membarrier(2), the ordering that needs is forced from the
+/// retiring side; elsewhere the ReadGuard issues a memory fence.  The
+/// first ReadGuard in a thread takes a lock to claim the thread's slot,
+/// which is given back when the thread exits.
+///
+/// Retired data is deleted by later calls to retire() or by
+/// synchronize(), in whichever thread makes them, and a retire() while
+/// a reader is stuck in a ReadGuard just adds to the list.  There is a
+/// single set of epochs for the whole process, so ReadGuards nest and
+/// cover any number of structures.
+class EpochReclaimer {
+public:
+    /// \cond SEMI_INTERNAL_CLASSES
+    struct ThreadState {
+	uint32_t nesting;
+	volatile uint64_t *epoch;
+	void *slot;
+    };
+    /// \endcond
+
+    /// Marks the calling thread as reading for its lifetime; pointers
+    /// loaded while it exists stay valid until it is destroyed.
+    class ReadGuard : boost::noncopyable {
+    public:
+	ReadGuard() {
+	    state = thread_state;
+	    if (UNLIKELY(state == NULL)) {
+		state = registerThread();
+	    }
+	    if (state->nesting++ == 0) {
+		*state->epoch = global_epoch;
+		if (asymmetric_barrier) {
+		    lintel::atomic_signal_fence(lintel::memory_order_seq_cst);
+		} else {
+		    lintel::atomic_thread_fence(lintel::memory_order_seq_cst);
+		}
+	    }
+	}
+
+	~ReadGuard() {
+	    lintel::atomic_thread_fence(lintel::memory_order_release);
+	    if (--state->nesting == 0) {
+		*state->epoch = 0;
+	    }
+	}
+
+    private:
+	ThreadState *state;
+    };
+
+    /// Delete ptr once no ReadGuard that could have seen it remains.
+    /// Call after making ptr unreachable for new readers.
+    template<class T> static void retire(T *ptr) {
+	retire(&deleteAs<T>, ptr);
+    }
+
+    static void retire(void (*deleter)(void *), void *ptr);
+
+    /// Wait for all of the ReadGuards in other threads to finish and
+    /// delete everything retired so far.  Must not be called with a
+    /// ReadGuard in the calling thread.
+    static void synchronize();
+
+    /// Number of retired pointers not yet deleted
+    static size_t pending();
+
+    /// true if readers rely on membarrier(2) rather than fences
+    static bool asymmetricBarrier() {
+	return asymmetric_barrier;
+    }
+
+private:
+    template<class T> static void deleteAs(void *p) {
+	delete static_cast<T *>(p);
+    }
+
+    static ThreadState *registerThread();
+
+    static __thread ThreadState *thread_state;
+    static volatile uint64_t global_epoch;
+    static bool asymmetric_barrier;
+};
+
+#endif
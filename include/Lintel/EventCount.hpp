@@ -0,0 +1,88 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for EventCount class
+*/
+
+#ifndef LINTEL_EVENT_COUNT_HPP
+#define LINTEL_EVENT_COUNT_HPP
+
+#include <boost/utility.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/PThread.hpp>
+
+/// \brief Lets threads sleep until a lock free structure changes
+///
+/// A waiter calls prepareWait(), checks its condition again, and then
+/// either cancelWait() if it now holds or wait() with the returned
+/// key; whoever changes the structure calls notifyAll() or
+/// notifyOne() afterwards.  A notify that comes after prepareWait()
+/// wakes the waiter even if it has not reached wait() yet.  notifyAll() costs a fence and a load
+/// when nobody is waiting, the mutex is only taken to wake sleepers.
+class EventCount : boost::noncopyable {
+public:
+    EventCount() : nwaiting(0), epoch(0) { }
+
+    /// Times to retry with sched_yield() before sleeping.  Sleeping
+    /// makes every notify take the mutex until the sleeper runs again,
+    /// so it is worth letting the other side catch up first.
+    static const uint32_t yields_before_wait = 16;
+
+    uint32_t prepareWait() {
+	++nwaiting; // a full barrier, so the recheck happens after
+	return epoch.load();
+    }
+
+    void cancelWait() {
+	--nwaiting;
+    }
+
+    void wait(uint32_t key) {
+	{
+	    PThreadScopedLock lock(mutex);
+	    while (epoch.load() == key) {
+		cond.wait(mutex);
+	    }
+	}
+	--nwaiting;
+    }
+
+    void notifyAll() {
+	if (haveWaiters()) {
+	    PThreadScopedLock lock(mutex);
+	    ++epoch;
+	    cond.broadcast();
+	}
+    }
+
+    /// Wake one sleeping waiter, for a change only one waiter can use,
+    /// such as a single item added to a queue.  Waiters that have not
+    /// gone to sleep yet all see the change.
+    void notifyOne() {
+	if (haveWaiters()) {
+	    PThreadScopedLock lock(mutex);
+	    ++epoch;
+	    cond.signal();
+	}
+    }
+
+private:
+    bool haveWaiters() {
+	// order the caller's change before the check for waiters
+	lintel::atomic_thread_fence(lintel::memory_order_seq_cst);
+	return nwaiting.load() != 0;
+    }
+
+    lintel::Atomic<uint32_t> nwaiting;
+    lintel::Atomic<uint32_t> epoch;
+    PThreadMutex mutex;
+    PThreadCond cond;
+};
+
+#endif
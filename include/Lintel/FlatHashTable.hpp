@@ -0,0 +1,789 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for an open-addressing hash table with group probing
+*/
+
+#ifndef LINTEL_FLAT_HASH_TABLE_HPP
+#define LINTEL_FLAT_HASH_TABLE_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <boost/type_traits/alignment_of.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/CompilerMarkup.hpp>
+#include <Lintel/HashFns.hpp>
+#include <Lintel/HashTable.hpp>
+#include <Lintel/Stats.hpp>
+
+/// \brief FlatHashTable class -- an open addressing alternative to HashTable
+///
+/// The FlatHashTable stores one control byte per slot in front of a
+/// single array of slots, both in one allocation.  Slots are grouped
+/// 16 at a time; a lookup loads the 16 control bytes of a group and
+/// compares all of them against 7 bits of the hash in one operation
+/// (SSE2 when available, a byte loop otherwise) so that on average
+/// only the slot holding the entry is touched.  Compared to the
+/// chained HashTable there is no next index per entry and no separate
+/// entry_points vector, so a lookup that hits is usually one cache
+/// miss on the control bytes plus one on the slot.
+///
+/// The interface matches HashTable so that HashMap and HashUnique can
+/// use it as a backend, e.g.  HashMap<K, V, KHash, KEqual,
+/// FlatHashTableBackend>.  Differences from HashTable: the constructor
+/// argument is the maximum load factor (0, 1) rather than the target
+/// chain length, and chainLengthStats reports the number of groups
+/// probed to find each entry.  Pointers into the table are invalidated
+/// by any add, as with HashTable.
+///
+/// HashFn and Equal have the same requirements as for HashTable.
+/// Since the table size is a power of two, the hash value is run
+/// through a 64 bit finalizer before use so that weak hash functions
+/// (e.g. identity on integers) still spread across groups.
+template <class D, class HashFn, class Equal>
+class FlatHashTable {
+public:
+    explicit FlatHashTable(double _max_load_factor) {
+	init(_max_load_factor);
+    }
+    FlatHashTable() {
+	init(0.875);
+    }
+    ~FlatHashTable() {
+	destroyAll();
+	deallocate();
+    }
+
+    static const size_t group_width = 16;
+
+    /// Add in a new entry to the hash table; will always add in the
+    /// value even if there is an existing value v that is Equal(data,
+    /// v).
+    D *add(const D &data) {
+	return internalAdd(data, doHash(data));
+    }
+
+    /// Add in a new entry to the hash table if the key does not
+    /// exist.  If the key does exist, return the existing data, which
+    /// matches the behavior of HashTable::addOrReplace.
+    D *addOrReplace(const D &data, bool &replaced) {
+	uint64_t hashof = doHash(data);
+	size_t slot = findSlot(data, hashof);
+	if (slot != npos) {
+	    replaced = true;
+	    return slots + slot;
+	} else {
+	    replaced = false;
+	    return internalAdd(data, hashof);
+	}
+    }
+
+#if __cplusplus >= 201103L
+    /// Same as add(const D &), but moves data into the table.
+    D *add(D &&data) {
+	uint64_t hashof = doHash(data);
+	size_t slot = claimSlot(hashof);
+	new (slots + slot) D(std::move(data));
+	return fillSlot(slot, hashof);
+    }
+
+    D *addOrReplace(D &&data, bool &replaced) {
+	std::pair<D *, bool> ret = try_emplace(data, std::move(data));
+	replaced = !ret.second;
+	return ret.first;
+    }
+
+    /// Construct a D from args and add it.  Since the slot depends
+    /// on the hash, the D is built first and then moved into place.
+    template<class... Args> D *emplace(Args&&... args) {
+	D data(std::forward<Args>(args)...);
+	return add(std::move(data));
+    }
+
+    /// See HashTable::emplaceWithHash; since the hash is known, the D
+    /// is constructed in place.
+    template<class... Args> D *emplaceWithHash(uint32_t hash, Args&&... args) {
+	uint64_t hashof = lintel::mix64(hash);
+	size_t slot = claimSlot(hashof);
+	new (slots + slot) D(std::forward<Args>(args)...);
+	DEBUG_SINVARIANT(hash == hashOf(slots[slot]));
+	return fillSlot(slot, hashof);
+    }
+
+    /// See HashTable::try_emplace; the D is constructed in place.
+    template<class K, class... Args> std::pair<D *, bool> 
+    try_emplace(const K &key, Args&&... args) {
+	uint64_t hashof = doHash(key);
+	size_t slot = findSlot(key, hashof);
+	if (slot != npos) {
+	    return std::pair<D *, bool>(slots + slot, false);
+	}
+	slot = claimSlot(hashof);
+	new (slots + slot) D(std::forward<Args>(args)...);
+	return std::pair<D *, bool>(fillSlot(slot, hashof), true);
+    }
+#endif
+
+    // changing the key in the returned key/value data will of course
+    // totally screw up the hash table.
+    D *lookup(const D &data) {
+	size_t slot = findSlot(data, doHash(data));
+	return slot == npos ? NULL : slots + slot;
+    }
+
+    /// const version of lookup, hence returns constant data.
+    const D *lookup(const D &data) const {
+	size_t slot = findSlot(data, doHash(data));
+	return slot == npos ? NULL : slots + slot;
+    }
+
+    /// lookup using a key of a type other than D; same requirements
+    /// as for HashTable.
+    template<class K2> typename HashTable_otherKey<K2, D, D *>::type
+    lookup(const K2 &key) {
+	size_t slot = findSlot(key, doHash(key));
+	return slot == npos ? NULL : slots + slot;
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, const D *>::type
+    lookup(const K2 &key) const {
+	size_t slot = findSlot(key, doHash(key));
+	return slot == npos ? NULL : slots + slot;
+    }
+
+    /// See HashTable::hashOf; the hash is mixed before use, so the
+    /// *WithHash methods take the same values for both tables.
+    template<class K> uint32_t hashOf(const K &key) const {
+	return static_cast<uint32_t>(hashfn(key));
+    }
+
+    template<class K> D *lookupWithHash(const K &key, uint32_t hash) {
+	DEBUG_SINVARIANT(hash == hashOf(key));
+	size_t slot = findSlot(key, lintel::mix64(hash));
+	return slot == npos ? NULL : slots + slot;
+    }
+
+    template<class K> const D *lookupWithHash(const K &key, uint32_t hash) const {
+	DEBUG_SINVARIANT(hash == hashOf(key));
+	size_t slot = findSlot(key, lintel::mix64(hash));
+	return slot == npos ? NULL : slots + slot;
+    }
+
+    D *addWithHash(const D &data, uint32_t hash) {
+	DEBUG_SINVARIANT(hash == hashOf(data));
+	return internalAdd(data, lintel::mix64(hash));
+    }
+
+    /// Look up n keys at once, setting out[i] to the result of
+    /// lookup(keys[i]); see HashTable::lookupBatch.
+    template<class K> void lookupBatch(const K *keys, size_t n, D **out) {
+	internalLookupBatch(keys, n, out);
+    }
+
+    template<class K> void lookupBatch(const K *keys, size_t n, const D **out) const {
+	internalLookupBatch(keys, n, out);
+    }
+
+    /* return true if something was found to remove */
+    bool remove(const D &key, bool must_exist = true) {
+	return internalRemove(key, must_exist);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, bool>::type
+    remove(const K2 &key, bool must_exist = true) {
+	return internalRemove(key, must_exist);
+    }
+
+    template<class K> bool removeWithHash(const K &key, uint32_t hash, bool must_exist = true) {
+	DEBUG_SINVARIANT(hash == hashOf(key));
+	return internalRemove(key, lintel::mix64(hash), must_exist);
+    }
+
+    void clear() {
+	destroyAll();
+	if (n_slots > 0) {
+	    memset(ctrl, ctrl_empty, n_slots);
+	}
+	n_entries = 0;
+	growth_left = maxEntries(n_slots);
+    }
+
+    /// Get statistics for the number of groups probed to find each
+    /// entry; 1 means the entry is in its home group.  Useful for
+    /// detecting a bad hash function.
+    void chainLengthStats(Stats &stats) const {
+	for(size_t i = 0; i < n_slots; ++i) {
+	    if (isFull(ctrl[i])) {
+		stats.add(probeLength(slots[i], i));
+	    }
+	}
+    }
+
+private:
+    template<typename t_value_type, class t_hashtable_type>
+    class iterator_base {
+    public:
+	typedef class iterator_base<t_value_type, t_hashtable_type> SelfT;
+	typedef std::forward_iterator_tag iterator_category;
+	typedef t_value_type value_type;
+	typedef value_type* pointer;
+	typedef value_type& reference;
+	typedef std::ptrdiff_t difference_type;
+
+	bool operator==(const SelfT &y) const {
+	    return this->mytable == y.mytable && this->slot == y.slot;
+	}
+
+	bool operator!=(const SelfT &y) const {
+	    return !(*this == y);
+	}
+
+	t_value_type &operator *() {
+	    INVARIANT(slot < mytable->n_slots && isFull(mytable->ctrl[slot]),
+		      "Bad use of iterator");
+	    return mytable->slots[slot];
+	}
+
+	t_value_type *operator ->() {
+	    return &(operator *());
+	}
+
+	/// Same purpose as HashTable::iterator::partialReset; after
+	/// removing the entry the iterator points to, this moves the
+	/// iterator to the next entry.  Entries never move on removal,
+	/// so the rest of the scan is unaffected.
+	void partialReset() {
+	    findFull();
+	}
+
+	/// true if the iterator is at the first entry in its group of slots
+	bool atStartOfChain() {
+	    if (slot == mytable->n_slots) {
+		return true;
+	    }
+	    for(size_t i = slot & ~(group_width - 1); i < slot; ++i) {
+		if (isFull(mytable->ctrl[i])) {
+		    return false;
+		}
+	    }
+	    return true;
+	}
+
+	/// true if the iterator is at the last entry in its group of slots
+	bool atEndOfChain() {
+	    if (slot == mytable->n_slots) {
+		return true;
+	    }
+	    for(size_t i = slot + 1; (i & (group_width - 1)) != 0; ++i) {
+		if (isFull(mytable->ctrl[i])) {
+		    return false;
+		}
+	    }
+	    return true;
+	}
+
+	void reset() {
+	    slot = 0;
+	    findFull();
+	}
+    protected:
+	friend class FlatHashTable<D, HashFn, Equal>;
+	iterator_base(t_hashtable_type *_mytable, size_t _slot)
+	    : mytable(_mytable), slot(_slot) {
+	    findFull();
+	}
+	void findFull() {
+	    while(slot < mytable->n_slots && !isFull(mytable->ctrl[slot])) {
+		++slot;
+	    }
+	}
+	void increment() {
+	    INVARIANT(slot < mytable->n_slots,
+		      boost::format("bad use of iterator %d not in [0,%d[") % slot
+		      % mytable->n_slots);
+	    ++slot;
+	    findFull();
+	}
+	t_hashtable_type *mytable; // Must be pointer for operator =
+	size_t slot;
+    };
+public:
+    /// \brief FlatHashTable iterator
+    class iterator : public iterator_base<D, FlatHashTable> {
+    public:
+	iterator(FlatHashTable &mytable, size_t slot = 0)
+	    : iterator_base<D, FlatHashTable>(&mytable, slot) { }
+
+	iterator &operator++() { this->increment(); return *this; }
+	iterator operator++(int) {
+	    iterator tmp = *this;
+	    this->increment();
+	    return tmp;
+	}
+    };
+
+    iterator begin() {
+	return iterator(*this, 0);
+    }
+
+    iterator end() {
+	return iterator(*this, n_slots);
+    }
+
+    iterator find(const D &key) {
+	size_t slot = findSlot(key, doHash(key));
+	return slot == npos ? end() : iterator(*this, slot);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, iterator>::type
+    find(const K2 &key) {
+	size_t slot = findSlot(key, doHash(key));
+	return slot == npos ? end() : iterator(*this, slot);
+    }
+
+    void erase(iterator it) {
+	DEBUG_SINVARIANT(it.mytable == this);
+	eraseSlot(it.slot);
+    }
+
+    /// \brief FlatHashTable constant iterator
+    class const_iterator : public iterator_base<const D, const FlatHashTable> {
+    public:
+	const_iterator(const FlatHashTable &mytable, size_t slot = 0)
+	    : iterator_base<const D, const FlatHashTable>(&mytable, slot) { }
+
+	const_iterator &operator++() { this->increment(); return *this; }
+	const_iterator operator++(int) {
+	    const_iterator tmp = *this;
+	    this->increment();
+	    return tmp;
+	}
+    };
+
+    const_iterator begin() const {
+	return const_iterator(*this, 0);
+    }
+
+    const_iterator end() const {
+	return const_iterator(*this, n_slots);
+    }
+
+    const_iterator find(const D &key) const {
+	size_t slot = findSlot(key, doHash(key));
+	return slot == npos ? end() : const_iterator(*this, slot);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, const_iterator>::type
+    find(const K2 &key) const {
+	size_t slot = findSlot(key, doHash(key));
+	return slot == npos ? end() : const_iterator(*this, slot);
+    }
+
+    size_t size() const {
+	return n_entries;
+    }
+
+    bool empty() const {
+	return n_entries == 0;
+    }
+
+    FlatHashTable(const FlatHashTable &__in) {
+	init(__in.max_load_factor);
+	assign(__in);
+    }
+
+    FlatHashTable &operator=(const FlatHashTable &__in) {
+	if (this != &__in) {
+	    assign(__in);
+	}
+	return *this;
+    }
+
+    /// Make sure that expected_entries can be added without any
+    /// rehashing; unlike HashTable this can be called on a non-empty
+    /// table.
+    void reserve(size_t expected_entries) {
+	size_t want = group_width;
+	while (maxEntries(want) < expected_entries) {
+	    want *= 2;
+	}
+	if (want > n_slots) {
+	    rehash(want);
+	}
+    }
+
+    /// Rehash into the smallest table that holds the current entries,
+    /// dropping tombstones and giving back memory; see
+    /// HashTable::compact.
+    void compact() {
+	if (n_entries == 0) {
+	    deallocate();
+	    growth_left = 0;
+	    return;
+	}
+	size_t want = group_width;
+	while (maxEntries(want) < n_entries) {
+	    want *= 2;
+	}
+	rehash(want);
+    }
+
+    /// See HashTable::extractSorted.
+    template<class Cmp> std::vector<D> extractSorted(Cmp cmp) const {
+	std::vector<D> ret;
+	ret.reserve(n_entries);
+	for(size_t i = 0; i < n_slots; ++i) {
+	    if (isFull(ctrl[i])) {
+		ret.push_back(slots[i]);
+	    }
+	}
+	std::sort(ret.begin(), ret.end(), cmp);
+	return ret;
+    }
+
+    /// number of entries that can be stored before the table grows
+    size_t capacity() const {
+	return maxEntries(n_slots);
+    }
+
+    size_t memoryUsage() const {
+	return n_slots == 0 ? 0 : allocBytes(n_slots);
+    }
+
+    double maxLoadFactor() const {
+	return max_load_factor;
+    }
+
+private:
+    static const int8_t ctrl_empty = -128; // 0x80
+    static const int8_t ctrl_deleted = -2; // 0xFE
+    static const size_t npos = ~static_cast<size_t>(0);
+
+    static bool isFull(int8_t c) {
+	return c >= 0;
+    }
+
+    // all bits of the mixed hash depend on all bits of the input so
+    // we can take the tag from the bottom and the group from the bits
+    // above.
+    template<class K> uint64_t doHash(const K &key) const {
+	return lintel::mix64(hashOf(key));
+    }
+
+    static int8_t hashTag(uint64_t hashof) {
+	return static_cast<int8_t>(hashof & 0x7F);
+    }
+
+    size_t homeGroup(uint64_t hashof) const {
+	return static_cast<size_t>(hashof >> 7) & (n_slots / group_width - 1);
+    }
+
+    /// bitmask of slots in the group at g whose control byte == c
+    static uint32_t matchByte(const int8_t *g, int8_t c) {
+#if defined(__SSE2__)
+	__m128i ctrls = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g));
+	return static_cast<uint32_t>
+	    (_mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, _mm_set1_epi8(c))));
+#else
+	uint32_t ret = 0;
+	for(size_t i = 0; i < group_width; ++i) {
+	    if (g[i] == c) {
+		ret |= 1U << i;
+	    }
+	}
+	return ret;
+#endif
+    }
+
+    /// bitmask of slots in the group at g that are empty or deleted
+    static uint32_t matchFree(const int8_t *g) {
+#if defined(__SSE2__)
+	return static_cast<uint32_t>
+	    (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(g))));
+#else
+	uint32_t ret = 0;
+	for(size_t i = 0; i < group_width; ++i) {
+	    if (!isFull(g[i])) {
+		ret |= 1U << i;
+	    }
+	}
+	return ret;
+#endif
+    }
+
+    static uint32_t lowestBit(uint32_t mask) {
+	DEBUG_SINVARIANT(mask != 0);
+	return __builtin_ctz(mask);
+    }
+
+    // Groups are probed in triangular order, which visits every group
+    // once when the number of groups is a power of two.  The table is
+    // never completely full so the probe always stops.
+    template<class K> size_t findSlot(const K &key, uint64_t hashof) const {
+	if (n_entries == 0) {
+	    return npos;
+	}
+	const size_t group_mask = n_slots / group_width - 1;
+	size_t group = homeGroup(hashof);
+	int8_t tag = hashTag(hashof);
+	for(size_t step = 1; ; ++step) {
+	    const int8_t *g = ctrl + group * group_width;
+	    for(uint32_t match = matchByte(g, tag); match != 0; match &= match - 1) {
+		size_t slot = group * group_width + lowestBit(match);
+		if (LIKELY(equal(key, slots[slot]))) {
+		    return slot;
+		}
+	    }
+	    if (matchByte(g, ctrl_empty) != 0) {
+		return npos;
+	    }
+	    DEBUG_SINVARIANT(step <= group_mask + 1);
+	    group = (group + step) & group_mask;
+	}
+    }
+
+    // Hash a group of keys and prefetch the control bytes and first
+    // slots of their home groups, then probe; most lookups finish in
+    // the home group.
+    template<class K, class V> 
+    void internalLookupBatch(const K *keys, size_t n, V **out) const {
+	static const size_t batch_group_size = 16;
+	if (n_entries == 0) {
+	    std::fill(out, out + n, static_cast<V *>(NULL));
+	    return;
+	}
+	uint64_t hashes[batch_group_size];
+	for(size_t base = 0; base < n; base += batch_group_size) {
+	    size_t count = std::min(n - base, batch_group_size);
+	    for(size_t i = 0; i < count; ++i) {
+		hashes[i] = doHash(keys[base + i]);
+		size_t first = homeGroup(hashes[i]) * group_width;
+		LINTEL_PREFETCH(ctrl + first);
+		LINTEL_PREFETCH(slots + first);
+	    }
+	    for(size_t i = 0; i < count; ++i) {
+		size_t slot = findSlot(keys[base + i], hashes[i]);
+		out[base + i] = slot == npos ? NULL : slots + slot;
+	    }
+	}
+    }
+
+    size_t findFreeSlot(uint64_t hashof) const {
+	const size_t group_mask = n_slots / group_width - 1;
+	size_t group = homeGroup(hashof);
+	for(size_t step = 1; ; ++step) {
+	    uint32_t match = matchFree(ctrl + group * group_width);
+	    if (match != 0) {
+		return group * group_width + lowestBit(match);
+	    }
+	    DEBUG_SINVARIANT(step <= group_mask + 1);
+	    group = (group + step) & group_mask;
+	}
+    }
+
+    double probeLength(const D &data, size_t slot) const {
+	const size_t group_mask = n_slots / group_width - 1;
+	size_t group = homeGroup(doHash(data));
+	uint32_t ret = 1;
+	for(size_t step = 1; group != slot / group_width; ++step) {
+	    group = (group + step) & group_mask;
+	    ++ret;
+	}
+	return ret;
+    }
+
+    D *internalAdd(const D &data, uint64_t hashof) {
+	size_t slot = claimSlot(hashof);
+	new (slots + slot) D(data);
+	return fillSlot(slot, hashof);
+    }
+
+    // Returns the slot a new entry with hashof goes in, growing the
+    // table first if needed.  The caller constructs the D there and
+    // then calls fillSlot, so nothing changes if the constructor
+    // throws.
+    size_t claimSlot(uint64_t hashof) {
+	if (growth_left == 0) {
+	    // If more than half of the used slots are tombstones,
+	    // rehashing in place reclaims them; otherwise grow.
+	    if (n_slots > 0 && n_entries <= maxEntries(n_slots) / 2) {
+		rehash(n_slots);
+	    } else {
+		rehash(n_slots == 0 ? group_width : n_slots * 2);
+	    }
+	}
+	return findFreeSlot(hashof);
+    }
+
+    D *fillSlot(size_t slot, uint64_t hashof) {
+	if (ctrl[slot] == ctrl_empty) {
+	    --growth_left;
+	}
+	ctrl[slot] = hashTag(hashof);
+	++n_entries;
+	return slots + slot;
+    }
+
+    template<class K> bool internalRemove(const K &key, bool must_exist) {
+	return internalRemove(key, doHash(key), must_exist);
+    }
+
+    template<class K> bool internalRemove(const K &key, uint64_t hashof, bool must_exist) {
+	size_t slot = findSlot(key, hashof);
+	if (slot == npos) {
+	    INVARIANT(must_exist == false, "remove failed, value doesn't exist");
+	    return false;
+	}
+	eraseSlot(slot);
+	return true;
+    }
+
+    void eraseSlot(size_t slot) {
+	DEBUG_SINVARIANT(slot < n_slots && isFull(ctrl[slot]));
+	slots[slot].~D();
+	--n_entries;
+	// If the group still has an empty slot then it never filled
+	// up, so no probe sequence continued past it and the slot can
+	// go back to empty; otherwise leave a tombstone.
+	const int8_t *g = ctrl + (slot & ~(group_width - 1));
+	if (matchByte(g, ctrl_empty) != 0) {
+	    ctrl[slot] = ctrl_empty;
+	    ++growth_left;
+	} else {
+	    ctrl[slot] = ctrl_deleted;
+	}
+    }
+
+    size_t maxEntries(size_t nslots) const {
+	size_t ret = static_cast<size_t>(nslots * max_load_factor);
+	// always leave at least one empty slot so probes terminate
+	return ret >= nslots ? nslots - 1 : ret;
+    }
+
+    static size_t slotOffset(size_t nslots) {
+	size_t align = boost::alignment_of<D>::value;
+	return (nslots + align - 1) / align * align;
+    }
+
+    static size_t allocBytes(size_t nslots) {
+	return slotOffset(nslots) + nslots * sizeof(D);
+    }
+
+    void rehash(size_t new_slots) {
+	SINVARIANT(new_slots >= group_width && (new_slots & (new_slots - 1)) == 0);
+	int8_t *old_ctrl = ctrl;
+	D *old_slots = slots;
+	size_t old_n_slots = n_slots;
+
+	allocate(new_slots);
+	for(size_t i = 0; i < old_n_slots; ++i) {
+	    if (isFull(old_ctrl[i])) {
+		uint64_t hashof = doHash(old_slots[i]);
+		size_t slot = findFreeSlot(hashof);
+#if __cplusplus >= 201103L
+		new (slots + slot) D(std::move(old_slots[i]));
+#else
+		new (slots + slot) D(old_slots[i]);
+#endif
+		ctrl[slot] = hashTag(hashof);
+		old_slots[i].~D();
+	    }
+	}
+	growth_left = maxEntries(n_slots) - n_entries;
+	if (old_n_slots > 0) {
+	    ::operator delete(old_ctrl);
+	}
+    }
+
+    void allocate(size_t nslots) {
+	char *block = static_cast<char *>(::operator new(allocBytes(nslots)));
+	ctrl = reinterpret_cast<int8_t *>(block);
+	slots = reinterpret_cast<D *>(block + slotOffset(nslots));
+	memset(ctrl, ctrl_empty, nslots);
+	n_slots = nslots;
+    }
+
+    void deallocate() {
+	if (n_slots > 0) {
+	    ::operator delete(ctrl);
+	}
+	ctrl = NULL;
+	slots = NULL;
+	n_slots = 0;
+    }
+
+    void destroyAll() {
+	for(size_t i = 0; i < n_slots; ++i) {
+	    if (isFull(ctrl[i])) {
+		slots[i].~D();
+	    }
+	}
+    }
+
+    void init(double _max_load_factor) {
+	INVARIANT(_max_load_factor > 0 && _max_load_factor < 1,
+		  boost::format("invalid max_load_factor %.6f") % _max_load_factor);
+	max_load_factor = _max_load_factor;
+	ctrl = NULL;
+	slots = NULL;
+	n_slots = 0;
+	n_entries = 0;
+	growth_left = 0;
+    }
+
+    void assign(const FlatHashTable &__in) {
+	destroyAll();
+	deallocate();
+	max_load_factor = __in.max_load_factor;
+	hashfn = __in.hashfn;
+	equal = __in.equal;
+	n_entries = 0;
+	growth_left = 0;
+	if (__in.n_slots > 0) {
+	    allocate(__in.n_slots);
+	    for(size_t i = 0; i < n_slots; ++i) {
+		if (isFull(__in.ctrl[i])) {
+		    new (slots + i) D(__in.slots[i]);
+		}
+	    }
+	    memcpy(ctrl, __in.ctrl, n_slots);
+	    n_entries = __in.n_entries;
+	    growth_left = __in.growth_left;
+	}
+    }
+
+    int8_t *ctrl; // n_slots control bytes, start of the allocation
+    D *slots; // n_slots entries following the control bytes
+    size_t n_slots;
+    size_t n_entries;
+    size_t growth_left; // adds into empty slots before we have to rehash
+    double max_load_factor;
+    HashFn hashfn;
+    Equal equal;
+};
+
+/// \brief Backend selector for HashMap and HashUnique that picks FlatHashTable.
+struct FlatHashTableBackend {
+    template <class D, class HashFn, class Equal> struct table {
+	typedef FlatHashTable<D, HashFn, Equal> type;
+    };
+};
+
+#endif
@@ -0,0 +1,153 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for FrozenHashMap class
+*/
+
+#ifndef LINTEL_FROZEN_HASHMAP_HPP
+#define LINTEL_FROZEN_HASHMAP_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <Lintel/HashMap.hpp>
+
+/// \brief An immutable hash map, built once from another map
+///
+/// For tables that are built, or rebuilt now and then, and read a
+/// lot.  The entries are kept in one vector in the order of their
+/// home slot, and the index is an open addressed table of (hash,
+/// entry number) pairs at most half full, probed linearly; a lookup
+/// reads one or two index slots and then the entry.  The hash is run
+/// through lintel::mix64 first, since the identity hash of the
+/// integers would pile keys with the same low bits into one run.
+/// Since nothing
+/// can change it, any number of threads can read a FrozenHashMap at
+/// once; see SnapshotHashMap for replacing one while it is being read.
+///
+/// lookup() and exists() also accept a key of another type K2 when
+/// KHash and KEqual do, as for HashMap.
+template <class K, class V,
+	  class KHash = HashMap_hash<const K>,
+	  class KEqual = std::equal_to<const K> >
+class FrozenHashMap {
+public:
+    typedef std::pair<K, V> value_type;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    FrozenHashMap() {
+	build(std::vector<value_type>());
+    }
+
+    /// Copy the entries of from, which can be a HashMap with either
+    /// backend, a std::map, or anything else with begin(), end() and
+    /// value_type pair<K, V>; its keys have to be distinct.
+    template<class Map> explicit FrozenHashMap(const Map &from) {
+	build(std::vector<value_type>(from.begin(), from.end()));
+    }
+
+    template<class K2> const V *lookup(const K2 &k) const {
+	uint32_t hash = mixedHash(k);
+	for(uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+	    const Slot &slot(slots[i]);
+	    if (slot.entry == 0) {
+		return NULL;
+	    }
+	    if (slot.hash == hash && kequal(k, entries[slot.entry - 1].first)) {
+		return &entries[slot.entry - 1].second;
+	    }
+	}
+    }
+
+    template<class K2> bool exists(const K2 &k) const {
+	return lookup(k) != NULL;
+    }
+
+    size_t size() const {
+	return entries.size();
+    }
+
+    bool empty() const {
+	return entries.empty();
+    }
+
+    const_iterator begin() const {
+	return entries.begin();
+    }
+
+    const_iterator end() const {
+	return entries.end();
+    }
+
+    size_t memoryUsage() const {
+	return sizeof(value_type) * entries.capacity() + sizeof(Slot) * slots.capacity();
+    }
+
+private:
+    struct Slot {
+	uint32_t hash;
+	uint32_t entry; // 1 + index into entries, 0 if empty
+    };
+
+    struct HomeLess {
+	explicit HomeLess(uint32_t mask) : mask(mask) { }
+	bool operator()(const std::pair<uint32_t, size_t> &a,
+			const std::pair<uint32_t, size_t> &b) const {
+	    return (a.first & mask) < (b.first & mask);
+	}
+	uint32_t mask;
+    };
+
+    template<class K2> uint32_t mixedHash(const K2 &k) const {
+	return static_cast<uint32_t>(lintel::mix64(khash(k)));
+    }
+
+    void build(const std::vector<value_type> &from) {
+	INVARIANT(from.size() < (1U << 31), "FrozenHashMap is limited to 2^31 entries");
+	uint32_t nslots = 2;
+	while (nslots < 2 * from.size()) {
+	    nslots *= 2;
+	}
+	mask = nslots - 1;
+
+	// place the entries in the order of their home slots, so the
+	// entries of neighbouring slots are near each other.
+	std::vector<std::pair<uint32_t, size_t> > order;
+	order.reserve(from.size());
+	for(size_t i = 0; i < from.size(); ++i) {
+	    order.push_back(std::make_pair(mixedHash(from[i].first), i));
+	}
+	std::stable_sort(order.begin(), order.end(), HomeLess(mask));
+
+	entries.reserve(from.size());
+	Slot empty_slot = { 0, 0 };
+	slots.assign(nslots, empty_slot);
+	for(size_t i = 0; i < order.size(); ++i) {
+	    const value_type &v(from[order[i].second]);
+	    uint32_t hash = order[i].first;
+	    uint32_t s = hash & mask;
+	    for(; slots[s].entry != 0; s = (s + 1) & mask) {
+		INVARIANT(slots[s].hash != hash
+			  || !kequal(v.first, entries[slots[s].entry - 1].first),
+			  "FrozenHashMap built from duplicate keys");
+	    }
+	    entries.push_back(v);
+	    slots[s].hash = hash;
+	    slots[s].entry = entries.size();
+	}
+    }
+
+    std::vector<value_type> entries;
+    std::vector<Slot> slots;
+    uint32_t mask;
+    KHash khash;
+    KEqual kequal;
+};
+
+#endif
@@ -22,6 +22,10 @@
 #include <ext/hash_fun.h>
 #endif
 #include <functional>
+#if __cplusplus >= 201103L
+#include <tuple>
+#endif
+#include <utility>
 
 #include <boost/static_assert.hpp>
 
@@ -89,10 +93,18 @@ template<typename T> struct PointerHashMapEqual : lintel::PointerEqual<T> { };
 ///
 /// Then you can define your hash map:
 /// HashMap<example, int> example_to_int;
+///
+/// The Backend parameter selects the underlying table;
+/// HashTableChainedBackend uses HashTable, FlatHashTableBackend (from
+/// Lintel/FlatHashTable.hpp) uses the open addressing FlatHashTable,
+/// which is faster for lookups and has no per-entry chain overhead.
+/// For the flat backend the constructor argument is the maximum load
+/// factor rather than the target chain length.
 
 template <class K, class V, 
           class KHash = HashMap_hash<const K>, 
-          class KEqual = std::equal_to<const K> >
+          class KEqual = std::equal_to<const K>,
+          class Backend = HashTableChainedBackend>
 class HashMap {
 public:
     /// \cond SEMI_INTERNAL_CLASSES
@@ -102,12 +114,19 @@ public:
 	uint32_t operator()(const value_type &hmv) const {
 	    return khash(hmv.first);
 	}
+	// used to probe the table with just a key
+	template<class K2> uint32_t operator()(const K2 &k) const {
+	    return khash(k);
+	}
     };
     struct value_typeEqual {
 	KEqual kequal;
 	bool operator()(const value_type &a, const value_type &b) const {
 	    return kequal(a.first,b.first);
 	}
+	template<class K2> bool operator()(const K2 &a, const value_type &b) const {
+	    return kequal(a, b.first);
+	}
     };
     /// \endcond
 
@@ -119,39 +138,153 @@ public:
 	return internalLookup<const V, const value_type>(this, k);
     }
 
+    /// lookup using a key of a type other than K, for example a
+    /// lintel::StringRef with lintel::StringHash and
+    /// lintel::StringEqual as KHash and KEqual.  KHash and KEqual have
+    /// to accept K2 in place of K, and the hash of a K2 has to match
+    /// the hash of the equal K.
+    template<class K2> typename HashTable_otherKey<K2, K, V *>::type
+    lookup(const K2 &k) {
+	return internalLookup<V, value_type>(this, k);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, K, const V *>::type
+    lookup(const K2 &k) const {
+	return internalLookup<const V, const value_type>(this, k);
+    }
+
+    /// Look up n keys at once, setting out[i] to lookup(keys[i]).
+    /// Much faster than a loop over lookup() when the map is larger
+    /// than the cache; see HashTable::lookupBatch.  K2 can be K or
+    /// any other key type lookup() accepts.
+    template<class K2> void lookupBatch(const K2 *keys, size_t n, V **out) {
+	internalLookupBatch<V, value_type>(this, keys, n, out);
+    }
+
+    template<class K2> void lookupBatch(const K2 *keys, size_t n, const V **out) const {
+	internalLookupBatch<const V, const value_type>(this, keys, n, out);
+    }
+
+    /// The hash of k for the *WithHash methods, which let code that
+    /// probes several maps with the same KHash hash the key once.
+    /// K2 can be K or any other key type lookup() accepts.
+    template<class K2> uint32_t hashOf(const K2 &k) const {
+	return hashtable.hashOf(k);
+    }
+
+    /// Same as lookup(k), with hash == hashOf(k).
+    template<class K2> V *lookupWithHash(const K2 &k, uint32_t hash) {
+	value_type *v = hashtable.lookupWithHash(k, hash);
+	return v == NULL ? NULL : &v->second;
+    }
+
+    template<class K2> const V *lookupWithHash(const K2 &k, uint32_t hash) const {
+	const value_type *v = hashtable.lookupWithHash(k, hash);
+	return v == NULL ? NULL : &v->second;
+    }
+
+    /// Add k with value v, with hash == hashOf(k).  k must not already
+    /// be present; check with lookupWithHash first.
+    V *addWithHash(const K &k, const V &v, uint32_t hash) {
+	return &hashtable.addWithHash(value_type(k, v), hash)->second;
+    }
+
+#if __cplusplus >= 201103L
+    /// Same as addWithHash(k, v, hash), but moves v into the map.
+    V *addWithHash(const K &k, V &&v, uint32_t hash) {
+	return &hashtable.emplaceWithHash(hash, std::piecewise_construct,
+					  std::forward_as_tuple(k),
+					  std::forward_as_tuple(std::move(v)))->second;
+    }
+#endif
+
+    /// Same as remove(k, must_exist), with hash == hashOf(k).
+    template<class K2> bool removeWithHash(const K2 &k, uint32_t hash, bool must_exist = true) {
+	return hashtable.removeWithHash(k, hash, must_exist);
+    }
+
     /// Returns the value associated with the key, if it exists. Otherwise,
     /// creates an entry initialized with the default value.
     V &operator[] (const K &k) {
-	value_type fullval; 
-	fullval.first = k;
-	value_type *v = hashtable.lookup(fullval);
+#if __cplusplus >= 201103L
+	return *try_emplace(k).first;
+#else
+	value_type *v = hashtable.lookup(k);
 	if (v == NULL) {
+	    value_type fullval; 
+	    fullval.first = k;
 	    return hashtable.add(fullval)->second;
 	} else {
 	    return v->second;
 	}
+#endif
+    }
+
+    /// Add v unless its key is already present.  Returns the value
+    /// for the key, and true if v was added; unlike the std maps this
+    /// returns a pointer to the value rather than an iterator.
+    std::pair<V *, bool> insert(const value_type &v) {
+#if __cplusplus >= 201103L
+	return valuePair(hashtable.try_emplace(v.first, v));
+#else
+	value_type *e = hashtable.lookup(v.first);
+	if (e != NULL) {
+	    return std::pair<V *, bool>(&e->second, false);
+	} else {
+	    return std::pair<V *, bool>(&hashtable.add(v)->second, true);
+	}
+#endif
+    }
+
+#if __cplusplus >= 201103L
+    std::pair<V *, bool> insert(value_type &&v) {
+	return valuePair(hashtable.try_emplace(v.first, std::move(v)));
+    }
+
+    /// Construct a value_type from args and insert it.  Use try_emplace
+    /// to avoid constructing the value if the key is present.
+    template<class... Args> std::pair<V *, bool> emplace(Args&&... args) {
+	return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    /// If k is not present, add it with a value constructed in place
+    /// from args.  Returns the value for k, and true if it was added.
+    template<class... Args> std::pair<V *, bool> try_emplace(const K &k, Args&&... args) {
+	return valuePair(hashtable.try_emplace
+			 (k, std::piecewise_construct, std::forward_as_tuple(k),
+			  std::forward_as_tuple(std::forward<Args>(args)...)));
     }
 
+    template<class... Args> std::pair<V *, bool> try_emplace(K &&k, Args&&... args) {
+	return valuePair(hashtable.try_emplace
+			 (k, std::piecewise_construct, std::forward_as_tuple(std::move(k)),
+			  std::forward_as_tuple(std::forward<Args>(args)...)));
+    }
+#endif
+
     /// Add the key to the map if the key doesn't already exist, otherwise leave the existing
     /// key-value pair unchanged.  Returns true if new key is added, otherwise return false.
     bool addUnlessExist(const K &k) {
-	value_type fullval; 
-	fullval.first = k;
-	value_type *v = hashtable.lookup(fullval);
+#if __cplusplus >= 201103L
+	return try_emplace(k).second;
+#else
+	value_type *v = hashtable.lookup(k);
 	if (v == NULL) {
+	    value_type fullval; 
+	    fullval.first = k;
 	    hashtable.add(fullval);
 	    return true;
 	} else {
 	    return false;
 	}
+#endif
     }
 
     /// Const get; will error out if you attempt to get a value that
     /// isn't present in the hash table because creating the entry is
     /// a non-const operation.
     const V &cGet(const K &k) const {
-	value_type fullval; fullval.first = k;
-	const value_type *v = hashtable.lookup(fullval);
+	const value_type *v = hashtable.lookup(k);
 	if (v == NULL) {
 	    FATAL_ERROR(boost::format("Unable to get missing entry %1% from hash table") % k);
 	} else {
@@ -161,8 +294,7 @@ public:
 
     /// Const "default" get returning default value if entry is missing in table.
     const V &dGet(const K &k) const {
-	value_type fullval; fullval.first = k;
-	const value_type *v = hashtable.lookup(fullval);
+	const value_type *v = hashtable.lookup(k);
 	if (v == NULL) {
 	    static V default_v;
             return default_v;
@@ -177,17 +309,26 @@ public:
 	return lookup(k) != NULL;
     }
 
+    template<class K2> typename HashTable_otherKey<K2, K, bool>::type
+    exists(const K2 &k) const {
+	return lookup(k) != NULL;
+    }
+
     /** returns true if something was removed */
     bool remove(const K &k, bool must_exist = true) {
-	value_type fullval; fullval.first = k;
-	return hashtable.remove(fullval, must_exist);
+	return hashtable.remove(k, must_exist);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, K, bool>::type
+    remove(const K2 &k, bool must_exist = true) {
+	return hashtable.remove(k, must_exist);
     }
 
     void clear() {
 	hashtable.clear();
     }
 
-    uint32_t size() const {
+    size_t size() const {
 	return hashtable.size();
     }
 
@@ -199,7 +340,8 @@ public:
 	return hashtable.empty();
     }
 
-    typedef HashTable<value_type,value_typeHash,value_typeEqual> HashTableT;
+    typedef typename Backend::template table<value_type, value_typeHash, 
+                                             value_typeEqual>::type HashTableT;
     typedef typename HashTableT::iterator iterator;
     typedef typename HashTableT::const_iterator const_iterator;
 
@@ -218,13 +360,21 @@ public:
     }
 
     iterator find(const K &k) {
-	value_type fullval; fullval.first = k;
-	return hashtable.find(fullval);
+	return hashtable.find(k);
     }
     
     const_iterator find(const K &k) const {
-	value_type fullval; fullval.first = k;
-	return hashtable.find(fullval);
+	return hashtable.find(k);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, K, iterator>::type
+    find(const K2 &k) {
+	return hashtable.find(k);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, K, const_iterator>::type
+    find(const K2 &k) const {
+	return hashtable.find(k);
     }
 
     // TODO: try to find someone with enough C++ STL magic foo to explain why
@@ -249,9 +399,14 @@ public:
 	return *this;
     }
 
-    void reserve(uint32_t nentries) {
+    void reserve(size_t nentries) {
 	hashtable.reserve(nentries);
     }
+
+    /// See HashTable::reserve; only for the chained backend.
+    void reserve(size_t nentries, bool resize_buckets) {
+	hashtable.reserve(nentries, resize_buckets);
+    }
     
     uint32_t available() {
 	return hashtable.available();
@@ -270,6 +425,46 @@ public:
 	return hashtable.memoryUsage();
     }
 
+    /// Give back the memory of removed entries; see
+    /// HashTable::compact.  Invalidates iterators and pointers.
+    void compact() {
+	hashtable.compact();
+    }
+
+    /// Copy of all the entries sorted by cmp, which compares
+    /// value_types; see HashTable::extractSorted.
+    template<class Cmp> std::vector<value_type> extractSorted(Cmp cmp) const {
+	return hashtable.extractSorted(cmp);
+    }
+
+    /// Copy of all the entries sorted by key.
+    std::vector<value_type> extractSorted() const {
+	return hashtable.extractSorted(KeyLess());
+    }
+
+    /// See HashTable::setIncrementalResize; only for the chained backend.
+    void setIncrementalResize(uint32_t buckets_per_op) {
+	hashtable.setIncrementalResize(buckets_per_op);
+    }
+
+    /// See HashTable::enableFilter; only for the chained backend, the
+    /// flat one already answers most misses from one group of control
+    /// bytes.
+    void enableFilter(double bits_per_key = 10, bool count_stats = false) {
+	hashtable.enableFilter(bits_per_key, count_stats);
+    }
+
+    BlockedBloomFilter::FilterStats filterStats() const {
+	return hashtable.filterStats();
+    }
+
+    /// Write the map to path for MappedHashMap; see HashTable::save.
+    /// K and V have to be trivially copyable; only for the chained
+    /// backend.
+    void save(const std::string &path) {
+	hashtable.save(path);
+    }
+
     /// Get statistics for the chain lengths of all the chains in the
     /// underlying hash table.  Useful for detecting a bad hash
     /// function.
@@ -283,15 +478,38 @@ public:
 	return hashtable;
     }
 private:
-    template<class R, class VT, class C> static inline R *internalLookup(C *me, const K &k) {
-	value_type fullval; fullval.first = k;
-	VT *v = me->hashtable.lookup(fullval);
+    struct KeyLess {
+	bool operator()(const value_type &a, const value_type &b) const {
+	    return a.first < b.first;
+	}
+    };
+
+    static std::pair<V *, bool> valuePair(const std::pair<value_type *, bool> &p) {
+	return std::pair<V *, bool>(&p.first->second, p.second);
+    }
+
+    template<class R, class VT, class C, class K2> 
+    static inline R *internalLookup(C *me, const K2 &k) {
+	VT *v = me->hashtable.lookup(k);
 	if (v == NULL) {
 	    return NULL;
 	} else {
 	    return &v->second;
 	}
     }
+
+    template<class R, class VT, class C, class K2>
+    static void internalLookupBatch(C *me, const K2 *keys, size_t n, R **out) {
+	static const size_t chunk = 64;
+	VT *values[chunk];
+	for(size_t base = 0; base < n; base += chunk) {
+	    size_t count = std::min(n - base, chunk);
+	    me->hashtable.lookupBatch(keys + base, count, values);
+	    for(size_t i = 0; i < count; ++i) {
+		out[base + i] = values[i] == NULL ? NULL : &values[i]->second;
+	    }
+	}
+    }
     
     HashTableT hashtable;
 };
@@ -13,10 +13,22 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <iterator>
+#include <new>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/is_convertible.hpp>
+#include <boost/mpl/if.hpp>
+#include <boost/type_traits/is_const.hpp>
+#include <boost/utility/enable_if.hpp>
+
 #include <Lintel/AssertBoost.hpp>
+#include <Lintel/BlockedBloomFilter.hpp>
 #include <Lintel/CompilerMarkup.hpp>
 #include <Lintel/HashFns.hpp>
 #include <Lintel/Stats.hpp>
@@ -31,18 +43,53 @@ extern uint32_t HashTable_prime_list[];
 // allocator under the C++ STL specification is a template not a
 // class.
 /// \cond SEMI_INTERNAL_CLASSES
-template <class D> struct HashTable_hte {
+struct HashTable_emplace_tag { };
+
+template <class D, class IndexT = uint32_t> struct HashTable_hte {
     D data;
-    int32_t next;
-    HashTable_hte(const D &d, int32_t _next) : data(d), next(_next) {};
+    IndexT next;
+    HashTable_hte(const D &d, IndexT _next) : data(d), next(_next) {};
+#if __cplusplus >= 201103L
+    template<class... Args> HashTable_hte(HashTable_emplace_tag, IndexT _next, Args&&... args)
+	: data(std::forward<Args>(args)...), next(_next) { }
+#endif
 };
-/// \endcond
 
-// TODO: fix this so that instead of using -1, it uses 0xFFFFFFFF as
-// the sentinal value, then make sure the use of uint32_t is proper
-// through all of this so we can bump the maximum hash table size to
-// 2^32-1 entries.  Consider writing a test (64bit only) that can
-// verify proper operation at that size.
+// Return type R for the heterogeneous key overloads, which are only
+// enabled for keys that can not be converted to D.  Keys that can be
+// converted keep going through the D overloads so the conversion
+// happens once rather than on every hash and comparison.
+template <class K, class D, class R> struct HashTable_otherKey 
+    : boost::disable_if<boost::is_convertible<K, D>, R> { };
+
+/// Header at the start of a file written by HashTable::save; the
+/// chains and entry points arrays follow at the given offsets, each
+/// aligned to HashTableImageHeader::alignment.  The sizes let
+/// MappedHashTable catch opening a file written for a different type.
+struct HashTableImageHeader {
+    static const uint32_t current_version = 1;
+    static const uint32_t byte_order_mark = 0x01020304;
+    static const uint64_t alignment = 64;
+
+    char magic[8]; // "LintelHT"
+    uint32_t version, byte_order;
+    uint32_t data_size, index_size, entry_size, unused;
+    uint64_t nentries, nchains, nentry_points;
+    uint64_t chains_offset, entry_points_offset, file_size;
+
+    HashTableImageHeader(uint32_t data_size, uint32_t index_size,
+			 uint32_t entry_size, uint64_t nentries,
+			 uint64_t nchains, uint64_t nentry_points);
+
+    static uint64_t roundUp(uint64_t offset);
+};
+
+/// Writes header, then the chains and entry_points arrays, to path
+/// via a temporary file which is renamed into place, so readers never
+/// see a partial image.
+void HashTable_writeImage(const std::string &path, const HashTableImageHeader &header,
+			  const void *chains, const void *entry_points);
+/// \endcond
 
 /// \brief HashTable class -- a low-level chained hashing class
 ///
@@ -85,7 +132,10 @@ template <class D> struct HashTable_hte {
 /// destructor for the structure.  The problem is that during
 /// operation, the data structure may be copied, and the old version
 /// deleted.  This destroys the pointed to value but leaves around the
-/// pointer.  An stl::map behaves the same way.  
+/// pointer.  An stl::map behaves the same way.  When compiled as C++11
+/// the entries are moved rather than copied as the table grows, and
+/// add, emplace and try_emplace can move or construct the data in
+/// place, so a value that owns memory is never duplicated.
 ///
 /// The key and value are not separate because in some cases, they are
 /// the same, for example for ConstantString, which wants to do a lookup to
@@ -93,11 +143,23 @@ template <class D> struct HashTable_hte {
 ///
 /// HashFn should only hash the key part of D; similarly Equal should only
 /// compare on the key part of D.
-
-
-template <class D, class HashFn, class Equal, 
-    class AllocHTE = std::allocator<HashTable_hte<D> >,
-    class AllocInt = std::allocator<int> >
+///
+/// lookup, find and remove also accept a key of some other type K2 if
+/// HashFn has an operator()(const K2 &) and Equal has an operator()(const
+/// K2 &, const D &); the hash of a K2 has to match the hash of the D
+/// it is equal to.  This lets you probe with just the key, or with a
+/// view of it such as lintel::StringRef, without building a D.
+///
+/// IndexT is the unsigned type used to link entries; all ones is the
+/// end of chain marker, so a table can hold at most 2^32-2 entries with
+/// the default uint32_t.  Use uint64_t for bigger tables at the cost of
+/// 4 more bytes per entry and per bucket, or uint16_t for small
+/// tables.  Since the hash values are 32 bits, a table has at most
+/// ~2^32 buckets, so past that the chains just get longer.
+
+template <class D, class HashFn, class Equal, class IndexT = uint32_t,
+    class AllocHTE = std::allocator<HashTable_hte<D, IndexT> >,
+    class AllocInt = std::allocator<IndexT> >
 class HashTable {
 public:
     explicit HashTable(double _target_chain_length) {
@@ -106,9 +168,18 @@ public:
     HashTable() {
 	init(2.0);
     }
-    typedef HashTable_hte<D> hte;
+    /// For HashFn or Equal that need state, for example a pointer to
+    /// where the keys are stored when D only holds an index.
+    HashTable(const HashFn &_hashfn, const Equal &_equal, double _target_chain_length = 2.0)
+	: hashfn(_hashfn), equal(_equal) {
+	init(_target_chain_length);
+    }
+    typedef HashTable_hte<D, IndexT> hte;
     typedef std::vector<hte, AllocHTE> hte_vectorT;
-    typedef std::vector<int, AllocInt> hash_tableT;
+    typedef std::vector<IndexT, AllocInt> hash_tableT;
+
+    /// end of chain / empty bucket marker
+    static const IndexT null_index = static_cast<IndexT>(~static_cast<IndexT>(0));
 public:
     /// Add in a new entry to the hash table; will always add in the
     /// value even if there is an existing value v that is Equal(data,
@@ -132,27 +203,123 @@ public:
 	}
     }
 
-    // changing the key in the returned key/value data will of course
-    // totally screw up the hash table.
-    D *lookup(const D &data) {
+#if __cplusplus >= 201103L
+    /// Same as add(const D &), but moves data into the table.
+    D *add(D &&data) {
 	uint32_t hashof = doHash(data);
-	hte *chain = internal_lookup(data, hashof);
+	IndexT loc = emplaceEntry(std::move(data));
+	linkEntry(loc, hashof);
+	return &chains[loc].data;
+    }
+
+    /// Same as addOrReplace(const D &, bool &), but moves data into
+    /// the table if it is added.
+    D *addOrReplace(D &&data, bool &replaced) {
+	std::pair<D *, bool> ret = try_emplace(data, std::move(data));
+	replaced = !ret.second;
+	return ret.first;
+    }
+
+    /// Construct a D from args directly in the table; like add(), it
+    /// is always added.
+    template<class... Args> D *emplace(Args&&... args) {
+	IndexT loc = emplaceEntry(std::forward<Args>(args)...);
+	linkEntry(loc, doHash(chains[loc].data));
+	return &chains[loc].data;
+    }
+
+    /// Same as emplace(args...), with hash == hashOf() of the D built
+    /// from args.
+    template<class... Args> D *emplaceWithHash(uint32_t hash, Args&&... args) {
+	IndexT loc = emplaceEntry(std::forward<Args>(args)...);
+	DEBUG_SINVARIANT(hash == hashOf(chains[loc].data));
+	linkEntry(loc, hash);
+	return &chains[loc].data;
+    }
+
+    /// If there is no entry equal to key, construct one from args
+    /// directly in the table.  key can be a D or any key type lookup()
+    /// accepts, and the D built from args has to be equal to it.
+    /// Returns the entry for key and whether it was added.
+    template<class K, class... Args> std::pair<D *, bool> 
+    try_emplace(const K &key, Args&&... args) {
+	maybeMigrate();
+	uint32_t hashof = doHash(key);
+	hte *chain = staticInternalLookup<hte>(this, key, hashof);
 	if (chain != NULL) {
-	    return &(chain->data);
-	} else {
-	    return NULL;
+	    return std::pair<D *, bool>(&chain->data, false);
 	}
+	IndexT loc = emplaceEntry(std::forward<Args>(args)...);
+	linkEntry(loc, hashof);
+	return std::pair<D *, bool>(&chains[loc].data, true);
+    }
+#endif
+
+    // changing the key in the returned key/value data will of course
+    // totally screw up the hash table.
+    D *lookup(const D &data) {
+	maybeMigrate();
+	return staticLookup<D>(this, data);
     }
 
     /// const version of lookup, hence returns constant data.
     const D *lookup(const D &data) const {
-	uint32_t hashof = doHash(data);
-	const hte *chain = internal_lookup(data, hashof);
-	if (chain != NULL) {
-	    return &(chain->data);
-	} else {
-	    return NULL;
-	}
+	return staticLookup<const D>(this, data);
+    }
+
+    /// lookup using a key of a type other than D; see class comment.
+    template<class K2> typename HashTable_otherKey<K2, D, D *>::type
+    lookup(const K2 &key) {
+	maybeMigrate();
+	return staticLookup<D>(this, key);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, const D *>::type
+    lookup(const K2 &key) const {
+	return staticLookup<const D>(this, key);
+    }
+
+    /// The hash of key, as given by HashFn, for the *WithHash
+    /// methods.  Code that probes several tables with the same HashFn
+    /// for one key can hash it once and pass the hash to each.
+    template<class K> uint32_t hashOf(const K &key) const {
+	return doHash(key);
+    }
+
+    /// Same as lookup(key), with hash == hashOf(key).
+    template<class K> D *lookupWithHash(const K &key, uint32_t hash) {
+	DEBUG_SINVARIANT(hash == hashOf(key));
+	maybeMigrate();
+	hte *chain = staticInternalLookup<hte>(this, key, hash);
+	return chain == NULL ? NULL : &chain->data;
+    }
+
+    template<class K> const D *lookupWithHash(const K &key, uint32_t hash) const {
+	DEBUG_SINVARIANT(hash == hashOf(key));
+	const hte *chain = staticInternalLookup<const hte>(this, key, hash);
+	return chain == NULL ? NULL : &chain->data;
+    }
+
+    /// Same as add(data), with hash == hashOf(data).
+    D *addWithHash(const D &data, uint32_t hash) {
+	DEBUG_SINVARIANT(hash == hashOf(data));
+	return internalAdd(data, hash);
+    }
+
+    /// Look up n keys at once, setting out[i] to the result of
+    /// lookup(keys[i]).  The keys are hashed and their buckets and
+    /// first chain entries prefetched a group at a time, and the next
+    /// group is hashed while the chains of the current one are walked,
+    /// so for tables much larger than the cache the misses of
+    /// different keys overlap rather than being taken one after
+    /// another.  K can be D or any key type lookup() accepts.
+    template<class K> void lookupBatch(const K *keys, size_t n, D **out) {
+	maybeMigrate();
+	staticLookupBatch<D>(this, keys, n, out);
+    }
+
+    template<class K> void lookupBatch(const K *keys, size_t n, const D **out) const {
+	staticLookupBatch<const D>(this, keys, n, out);
     }
 
     // Not perfectly random, if there are biases in the hash(key)
@@ -169,23 +336,23 @@ public:
 	if (size() == 0) {
 	    return NULL;
 	}
-	uint32_t start_chain = randa % entry_points.size();
-	uint32_t chain = start_chain;
-	while(entry_points[chain] == -1) {
-	    chain = (chain + 1) % entry_points.size();
+	size_t start_chain = randa % bucketCount();
+	size_t chain = start_chain;
+	while(bucketHead(chain) == null_index) {
+	    chain = (chain + 1) % bucketCount();
 	    INVARIANT(chain != start_chain, 
 		      "unable to find a non-empty chain");
 	}
 
-	uint32_t chain_len = 0;
-	for(int32_t j = entry_points[chain]; j != -1; j=chains[j].next) {
+	size_t chain_len = 0;
+	for(IndexT j = bucketHead(chain); j != null_index; j=chains[j].next) {
 	    ++chain_len;
 	}
 
 	SINVARIANT(chain_len > 0);
 
-	uint32_t bucket = randb % chain_len;
-	for(int32_t j = entry_points[chain]; j != -1; j=chains[j].next) {
+	size_t bucket = randb % chain_len;
+	for(IndexT j = bucketHead(chain); j != null_index; j=chains[j].next) {
 	    if (bucket == 0) {
 		return &chains[j].data;
 	    } else {
@@ -198,65 +365,103 @@ public:
 
     /* return true if something was found to remove */
     bool remove(const D &key, bool must_exist = true) {
+	return internalRemove(key, must_exist);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, bool>::type
+    remove(const K2 &key, bool must_exist = true) {
+	return internalRemove(key, must_exist);
+    }
+
+    /// Same as remove(key, must_exist), with hash == hashOf(key).
+    template<class K> bool removeWithHash(const K &key, uint32_t hash, bool must_exist = true) {
+	DEBUG_SINVARIANT(hash == hashOf(key));
+	return internalRemove(key, hash, must_exist);
+    }
+
+private:
+    template<class K> bool internalRemove(const K &key, bool must_exist) {
+	return internalRemove(key, entry_points.size() == 0 ? 0 : doHash(key), must_exist);
+    }
+
+    template<class K> bool internalRemove(const K &key, uint32_t hashof, bool must_exist) {
 	if (entry_points.size() == 0) {
 	    INVARIANT(must_exist == false,
 		      "remove failed, hash table is empty");
 	    return false;
 	}
-	uint32_t hash = doHash(key) % entry_points.size();
-	int32_t loc = entry_points[hash];
-	if (loc == -1) {
-	    INVARIANT(must_exist == false,
-		      "remove failed, value doesn't exist");
+	maybeMigrate();
+	if (filter != NULL && !filter->mayContain(hashof)) {
+	    INVARIANT(must_exist == false, "remove failed, value doesn't exist");
+	    return false;
+	}
+	if (removeFromChain(entry_points[hashof % entry_points.size()], key)) {
+	    return true;
+	}
+	if (!old_entry_points.empty() &&
+	    removeFromChain(old_entry_points[hashof % old_entry_points.size()], key)) {
+	    return true;
+	}
+	INVARIANT(must_exist == false, "remove failed, value doesn't exist");
+	return false;
+    }
+
+    template<class K> bool removeFromChain(IndexT &head, const K &key) {
+	IndexT loc = head;
+	if (loc == null_index) {
 	    return false;
 	}
 
-	bool ret = true;
 	if (equal(key,chains[loc].data)) {
-	    chains[loc].data = D();
-	    entry_points[hash] = chains[loc].next;
+	    clearEntry(loc);
+	    head = chains[loc].next;
 	    chains[loc].next = free_list;
 	    ++free_list_size;
 	    free_list = loc;
+	    return true;
 	} else {
-	    int32_t prev = loc;
+	    IndexT prev = loc;
 	    while(true) {
 		prev = loc;
 		loc = chains[loc].next;
-		if (loc == -1) {
-		    INVARIANT(must_exist == false,
-			      "remove failed, value doesn't exist");
-		    ret = false;
-		    break;
+		if (loc == null_index) {
+		    return false;
 		}
 		if (equal(key,chains[loc].data)) {
-		    chains[loc].data = D();
+		    clearEntry(loc);
 		    chains[prev].next = chains[loc].next;
 		    chains[loc].next = free_list;
 		    ++free_list_size;
 		    free_list = loc;
-		    break;
+		    return true;
 		}
 	    }
 	}
-	return ret;
     }
 
+public:
      void clear() {
-	 free_list = -1;
+	 free_list = null_index;
 	 free_list_size = 0;
 	 chains.clear();
-	 for(uint32_t i=0;i<entry_points.size();i++) {
-	     entry_points[i] = -1;
+	 for(size_t i=0;i<entry_points.size();i++) {
+	     entry_points[i] = null_index;
+	 }
+	 hash_tableT().swap(old_entry_points);
+	 migrate_pos = 0;
+	 hash_tableT().swap(pending_entry_points);
+	 pending_buckets = 0;
+	 if (filter != NULL) {
+	     filter->clear();
 	 }
      }
 
     /// Get statistics for the chain lengths of all the chains in a
     /// hash table.  Useful for detecting a bad hash function.
     void chainLengthStats(Stats &stats) const {
-	 for(uint32_t i=0;i<entry_points.size();i++) {
-	     uint32_t len = 0;
-	     for(int32_t j = entry_points[i]; j != -1; j = chains[j].next) {
+	 for(size_t i=0;i<bucketCount();i++) {
+	     size_t len = 0;
+	     for(IndexT j = bucketHead(i); j != null_index; j = chains[j].next) {
 		 ++len;
 	     }
 	     stats.add(len);
@@ -285,8 +490,7 @@ private:
 	}
 
 	t_value_type &operator *() { 
-	    INVARIANT(this->chain_loc >= 0 && 
-		      this->chain_loc < static_cast<int32_t>(this->mytable->chains.size()),
+	    INVARIANT(this->chain_loc < this->mytable->chains.size(),
 		      "Bad use of iterator");
 	    return this->mytable->chains[this->chain_loc].data;
 	}
@@ -301,11 +505,11 @@ private:
 	/// restart the scan operation partway through after doing some
 	/// number of updates safely.
 	void partialReset() {
-	    if (cur_chain < static_cast<int32_t>(mytable->entry_points.size())) {
-		chain_loc = mytable->entry_points[cur_chain];
+	    if (cur_chain < mytable->bucketCount()) {
+		chain_loc = mytable->bucketHead(cur_chain);
 		findNonemptyChain();
 	    } else {
-		SINVARIANT(cur_chain == static_cast<int32_t>(mytable->entry_points.size()));
+		SINVARIANT(cur_chain == mytable->bucketCount());
 	    }
 	}
 	/// if you want to do incremental iteration, this will tell
@@ -315,56 +519,56 @@ private:
 	/// guaranteed to make progress.  (If you don't, and you have
 	/// a long chain, you could get stuck in the long chain).
 	bool atStartOfChain() {
-	    return this->cur_chain == static_cast<int32_t>(this->mytable->entry_points.size())
-  	        || this->mytable->entry_points[this->cur_chain] == this->chain_loc;
+	    return this->cur_chain == this->mytable->bucketCount()
+  	        || this->mytable->bucketHead(this->cur_chain) == this->chain_loc;
 	}
 
 	/// Tells you that you are at the end of a hash-table chain.
 	/// Similar use to atStartOfChain.
 	bool atEndOfChain() {
-	    return this->cur_chain == static_cast<int32_t>(this->mytable->entry_points.size())
-	        || this->mytable->chains[this->chain_loc].next == -1;
+	    return this->cur_chain == this->mytable->bucketCount()
+	        || this->mytable->chains[this->chain_loc].next == null_index;
 	}
 
 	void reset() {
 	    cur_chain = 0;
 	    findNonemptyChain();
 	}
-	int32_t getCurChain() {
+	size_t getCurChain() {
 	    return cur_chain;
 	}
     protected:
-	friend class HashTable<D, HashFn, Equal, AllocHTE, AllocInt>;
-	iterator_base(t_hashtable_type *_mytable, int32_t start_chain = 0,
-		      int32_t _chain_loc = -1) 
+	friend class HashTable<D, HashFn, Equal, IndexT, AllocHTE, AllocInt>;
+	iterator_base(t_hashtable_type *_mytable, size_t start_chain = 0,
+		      IndexT _chain_loc = null_index) 
 	    : mytable(_mytable), cur_chain(start_chain), 
 	      chain_loc(_chain_loc) {
-		  if (chain_loc == -1) {
+		  if (chain_loc == null_index) {
 		      findNonemptyChain();
 		  }
 	    }
 	void findNonemptyChain() {
-	    while(cur_chain < static_cast<int>(mytable->entry_points.size()) &&
-		  mytable->entry_points[cur_chain] == -1) {
+	    while(cur_chain < mytable->bucketCount() &&
+		  mytable->bucketHead(cur_chain) == null_index) {
 		      cur_chain += 1;
 		  }
-	    if (cur_chain < static_cast<int>(mytable->entry_points.size())) {
-		chain_loc = mytable->entry_points[cur_chain];
+	    if (cur_chain < mytable->bucketCount()) {
+		chain_loc = mytable->bucketHead(cur_chain);
 	    }
 	}
 	void increment() {
-	    INVARIANT(chain_loc >= 0 && chain_loc < static_cast<int>(mytable->chains.size()),
+	    INVARIANT(chain_loc < mytable->chains.size(),
 		      boost::format("bad use of iterator %d not in [0,%d[") % chain_loc
 		      % mytable->chains.size());
 	    chain_loc = mytable->chains[chain_loc].next;
-	    if (chain_loc == -1) {
+	    if (chain_loc == null_index) {
 		cur_chain += 1;
 		findNonemptyChain();
 	    }
 	}
 	t_hashtable_type *mytable; // Must be pointer for operator =
-	int32_t cur_chain;
-	int32_t chain_loc;
+	size_t cur_chain;
+	IndexT chain_loc;
     };
 public:
     /// \brief HashTable iterator
@@ -373,8 +577,8 @@ public:
 	iterator(const iterator &from) 
 	    : iterator_base<D, HashTable>
   	          (from.mytable, from.cur_chain, from.chain_loc) { }
-	iterator(HashTable &mytable, int32_t start_chain = 0, 
-		 int32_t chain_loc = -1)
+	iterator(HashTable &mytable, size_t start_chain = 0, 
+		 IndexT chain_loc = null_index)
 	    : iterator_base<D, HashTable>(&mytable, start_chain, chain_loc) { }
 	
 	iterator &operator++() { this->increment(); return *this; }
@@ -391,25 +595,23 @@ public:
 	}
     };
     
-    iterator begin(int32_t start_chain = 0) {
+    iterator begin(size_t start_chain = 0) {
 	return iterator(*this,start_chain);
     }
 
     iterator end() {
-	return iterator(*this,entry_points.size());
+	return iterator(*this,bucketCount());
     }
 
     iterator find(const D &key) {
-	if (entry_points.size() == 0) {
-	    return end();
-	}
-	uint32_t hash = doHash(key) % entry_points.size();
-	for(int32_t i=entry_points[hash];i != -1; i=chains[i].next) {
-	    if (equal(key,chains[i].data)) {
-		return iterator(*this, hash, i);
-	    }
-	}
-	return end();
+	maybeMigrate();
+	return staticFind<iterator>(this, key);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, iterator>::type
+    find(const K2 &key) {
+	maybeMigrate();
+	return staticFind<iterator>(this, key);
     }
 
     // TODO: think about whether there is a way to combine erase() and
@@ -418,16 +620,17 @@ public:
     // pass, and erase doesn't have to re-do the hash and compare operations.
     void erase(iterator it) {
        	DEBUG_SINVARIANT(it.mytable == this);
-	chains[it.chain_loc].data = D();
+	clearEntry(it.chain_loc);
 
-	int32_t prev = -1, cur = entry_points[it.cur_chain];
+	IndexT &head = bucketHeadRef(it.cur_chain);
+	IndexT prev = null_index, cur = head;
 	while (cur != it.chain_loc) {
 	    prev = cur;
 	    cur = chains[cur].next;
-	    DEBUG_SINVARIANT(cur != -1);
+	    DEBUG_SINVARIANT(cur != null_index);
 	}
-	if (prev == -1) {
-	    entry_points[it.cur_chain] = chains[cur].next;
+	if (prev == null_index) {
+	    head = chains[cur].next;
 	} else {
 	    chains[prev].next = chains[cur].next;
 	}
@@ -439,8 +642,8 @@ public:
     /// \brief Hash Table constant iterator
     class const_iterator : public iterator_base<const D, const HashTable> {
     public:
-	const_iterator(const HashTable &mytable, int32_t start_chain = 0,
-		       int32_t chain_loc = -1)
+	const_iterator(const HashTable &mytable, size_t start_chain = 0,
+		       IndexT chain_loc = null_index)
 	    : iterator_base<const D, const HashTable>
 	          (&mytable, start_chain, chain_loc) 
 	{ }
@@ -453,28 +656,24 @@ public:
 	}
     };
 
-    const_iterator begin(int32_t start_chain = 0) const {
+    const_iterator begin(size_t start_chain = 0) const {
 	return const_iterator(*this, start_chain);
     }
 
     const_iterator end() const {
-	return const_iterator(*this, entry_points.size());
+	return const_iterator(*this, bucketCount());
     }
 
     const_iterator find(const D &key) const {
-	if (entry_points.size() == 0) {
-	    return end();
-	}
-	uint32_t hash = doHash(key) % entry_points.size();
-	for(int32_t i=entry_points[hash];i != -1; i=chains[i].next) {
-	    if (equal(key, chains[i].data)) {
-		return const_iterator(*this, hash, i);
-	    }
-	}
-	return end();
+	return staticFind<const_iterator>(this, key);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, D, const_iterator>::type
+    find(const K2 &key) const {
+	return staticFind<const_iterator>(this, key);
     }
 
-    uint32_t size() const {
+    size_t size() const {
 	DEBUG_SINVARIANT(verifyFreeListSize());
 	DEBUG_SINVARIANT(chains.size() >= free_list_size);
 	return chains.size() - free_list_size;
@@ -484,29 +683,38 @@ public:
 	return size() == 0;
     }
 
-    explicit HashTable(const HashTable &__in) {
+    explicit HashTable(const HashTable &__in) : filter(NULL) {
 	assign(__in);
     }
 
+    ~HashTable() {
+	delete filter;
+    }
+
     HashTable &
     operator=(const HashTable &__in) {
 	return assign(__in);
     }
     
-    void reserve(unsigned expected_entries) {
-	// assertion lets us resize the entry points without thinking about
-	// handling existing bits.
-	INVARIANT(chains.size() == 0,
-		  "have to reserve() before putting anything in hash table");
+    /// Make room for expected_entries: the chains vector is grown
+    /// now rather than by copying during some later add, and the entry
+    /// points are grown if they are too small.  On a non-empty table
+    /// growing the entry points is a resize, done incrementally if
+    /// setIncrementalResize() is on.  With resize_buckets false only
+    /// the chains vector is grown, so the entry points still grow as
+    /// the table fills; together with incremental resizing that keeps
+    /// every add short.
+    void reserve(size_t expected_entries, bool resize_buckets = true) {
 	chains.reserve(expected_entries);
-	unsigned new_entry_size = (unsigned)(expected_entries / target_chain_length);
-	unsigned i;
-	for(i=0; HashTable_prime_list[i] < new_entry_size; ++i) {
-	    SINVARIANT(HashTable_prime_list[i] != 0);
+	if (!resize_buckets) {
+	    return;
 	}
-	unsigned new_size = HashTable_prime_list[i];
-
-	entry_points.resize(new_size, -1);
+	size_t new_size = bucketsFor(expected_entries);
+	if (new_size <= std::max(entry_points.size(), pending_buckets)) {
+	    return;
+	}
+	finishMigration();
+	resizeEntryPoints(new_size);
     }
 
     uint32_t available() {
@@ -518,7 +726,10 @@ public:
     }
 
     size_t memoryUsage() const {
-	return sizeof(hte) * chains.capacity() + sizeof(int) * entry_points.capacity();
+	return sizeof(hte) * chains.capacity() 
+	    + sizeof(IndexT) * (entry_points.capacity() + old_entry_points.capacity()
+				+ pending_entry_points.capacity())
+	    + (filter == NULL ? 0 : sizeof(BlockedBloomFilter) + filter->memoryUsage());
     }
 
     // this is useful if you want to build up a big table of data, but
@@ -527,15 +738,168 @@ public:
     // other choice is to hash pointers to the data, which loses more
     // memory space.  The vector needs to be dense for this to be
     // safe.  In other words, one must have either (a) only added
-    // items to the hash, or (b) re-added as many items as were
-    // removed.
-
-    // TODO: add a "densify" function that will go through and remove things
-    // from the end of the hash table and put them in free entries until
-    // the table is dense.
+    // items to the hash, (b) re-added as many items as were
+    // removed, or (c) called compact().  See also extractSorted().
 
     bool dense() {
-	return free_list == -1;
+	return free_list == null_index;
+    }
+
+    /// Make the table dense and give back the memory of removed
+    /// entries: entries from the end of the chains vector are moved
+    /// into the holes left by removes, the vector is shrunk to fit,
+    /// and the entry points are shrunk to suit the remaining size
+    /// and relinked.  Useful after removing most of a table.
+    /// Invalidates iterators and pointers into the table.
+    void compact() {
+	finishMigration();
+	size_t nentries = size();
+	if (free_list_size > 0) {
+	    std::vector<bool> is_free(chains.size(), false);
+	    for(IndexT i = free_list; i != null_index; i = chains[i].next) {
+		is_free[i] = true;
+	    }
+	    size_t hole = 0, tail = chains.size();
+	    while (true) {
+		while (hole < nentries && !is_free[hole]) {
+		    ++hole;
+		}
+		if (hole == nentries) {
+		    break;
+		}
+		do {
+		    --tail;
+		} while (is_free[tail]);
+		DEBUG_SINVARIANT(tail > hole);
+		moveData(chains[hole].data, chains[tail].data);
+		++hole;
+	    }
+	    chains.erase(chains.begin() + nentries, chains.end());
+	    free_list = null_index;
+	    free_list_size = 0;
+	}
+#if __cplusplus >= 201103L
+	chains.shrink_to_fit();
+#else
+	if (chains.capacity() > chains.size()) {
+	    hte_vectorT(chains).swap(chains);
+	}
+#endif
+	hash_tableT(bucketsFor(nentries), null_index).swap(entry_points);
+	if (filter != NULL) {
+	    filter->clear();
+	}
+	for(size_t j = 0; j < chains.size(); ++j) {
+	    linkEntry(static_cast<IndexT>(j), doHash(chains[j].data));
+	}
+	if (filter != NULL) {
+	    rebuildFilter();
+	}
+    }
+
+    /// Returns a copy of all the entries sorted by cmp, a strict weak
+    /// ordering on D.  Much faster than copying out through the
+    /// iterators since it reads the chains vector in order.
+    template<class Cmp> std::vector<D> extractSorted(Cmp cmp) const {
+	std::vector<D> ret;
+	ret.reserve(size());
+	if (free_list_size == 0) {
+	    for(size_t i = 0; i < chains.size(); ++i) {
+		ret.push_back(chains[i].data);
+	    }
+	} else {
+	    std::vector<bool> is_free(chains.size(), false);
+	    for(IndexT i = free_list; i != null_index; i = chains[i].next) {
+		is_free[i] = true;
+	    }
+	    for(size_t i = 0; i < chains.size(); ++i) {
+		if (!is_free[i]) {
+		    ret.push_back(chains[i].data);
+		}
+	    }
+	}
+	std::sort(ret.begin(), ret.end(), cmp);
+	return ret;
+    }
+
+    /// Normally when the table grows every entry is rehashed onto the
+    /// new entry points in a single pass, which stalls the caller for
+    /// a long time on big tables.  With a non-zero buckets_per_op, a
+    /// resize is spread over the following add and non-const lookup,
+    /// find or remove operations.  Each of them first fills in 64 *
+    /// buckets_per_op of the new entry points, while the table keeps
+    /// using the old ones; once all are filled, each
+    /// moves buckets_per_op of the old chains over until all of them
+    /// have moved.  Lookups check both sets of entry points until
+    /// then.  The chains vector still grows by copying, so
+    /// reserve(n, false) ahead of time to bound the cost of every add.
+    ///
+    /// While a resize is in progress, the non-const lookup, find and
+    /// remove operations can move entries between chains, so like add
+    /// they invalidate iterators.  0, the default, turns off
+    /// incremental resizing and finishes any resize in progress.
+    void setIncrementalResize(uint32_t buckets_per_op) {
+	incremental_buckets = buckets_per_op;
+	if (incremental_buckets == 0) {
+	    finishMigration();
+	}
+    }
+
+    /// true if an incremental resize has not yet moved all the chains
+    bool resizeInProgress() const {
+	return pending_buckets != 0 || !old_entry_points.empty();
+    }
+
+    /// Put a BlockedBloomFilter with bits_per_key bits per entry in
+    /// front of the table, so that a lookup, find or remove of an
+    /// absent key usually reads one cache line rather than a bucket
+    /// and a chain; worth it when most lookups miss.  The filter is
+    /// rebuilt from the entries once more have been added than it was
+    /// sized for, which also forgets the removed ones.  0 turns the
+    /// filter off; a table without one only pays for a pointer.
+    ///
+    /// With count_stats, lookups also count the checks and false
+    /// positives for filterStats().  The counters are atomic, so
+    /// concurrent const lookups stay safe, but they all write the
+    /// same cache line; without count_stats the const lookups do not
+    /// write anything.
+    void enableFilter(double bits_per_key = 10, bool count_stats = false) {
+	if (bits_per_key == 0) {
+	    delete filter;
+	    filter = NULL;
+	} else {
+	    if (filter == NULL) {
+		filter = new BlockedBloomFilter();
+	    }
+	    rebuildFilter(bits_per_key, count_stats);
+	}
+    }
+
+    bool filterEnabled() const {
+	return filter != NULL;
+    }
+
+    /// Statistics on how well the filter is doing; see
+    /// BlockedBloomFilter::FilterStats.  The check counts are only
+    /// kept if enableFilter() was asked to count them.
+    BlockedBloomFilter::FilterStats filterStats() const {
+	return filter == NULL ? BlockedBloomFilter().stats() : filter->stats();
+    }
+
+    /// Write the table to path so that it can be opened with
+    /// MappedHashTable, which serves lookups straight out of the
+    /// mapped file without rebuilding the table.  D has to be
+    /// trivially copyable, so it can not hold pointers such as a
+    /// std::string, and HashFn has to give the same values in the
+    /// process that maps the file.  Finishes any incremental resize
+    /// first.
+    void save(const std::string &path) {
+	BOOST_STATIC_ASSERT(boost::has_trivial_copy<D>::value);
+	finishMigration();
+	HashTableImageHeader header(sizeof(D), sizeof(IndexT), sizeof(hte), size(),
+				    chains.size(), entry_points.size());
+	HashTable_writeImage(path, header, chains.empty() ? NULL : &chains[0],
+			     entry_points.empty() ? NULL : &entry_points[0]);
     }
 
     hte_vectorT &unsafeGetRawDataVector() {
@@ -545,8 +909,8 @@ public:
 
     /// Paranoid internal check, run in debug mode on calls to size()
     bool verifyFreeListSize() const {
-	uint32_t fls = 0;
-	for(int32_t i = free_list; i != -1; i = chains[i].next) {
+	size_t fls = 0;
+	for(IndexT i = free_list; i != null_index; i = chains[i].next) {
 	    ++fls;
 	}
 	INVARIANT(fls == free_list_size, boost::format("bad free list size %d != %d")
@@ -556,51 +920,179 @@ public:
     }
 
 private:
-    uint32_t doHash(const D &data) const {
-	return static_cast<uint32_t>(hashfn(data));
+    template<class K> uint32_t doHash(const K &key) const {
+	return static_cast<uint32_t>(hashfn(key));
     }
 
     D *internalAdd(const D &data, uint32_t hashof) {
-	if (free_list == -1 && 
+	prepareAdd();
+	IndexT loc;
+	if (free_list == null_index) {
+	    loc = nextEntry();
+	    chains.push_back(hte(data, null_index));
+	} else {
+	    loc = takeFreeEntry();
+	    D *to = &chains[loc].data;
+	    to->~D();
+	    try {
+		new (to) D(data);
+	    } catch (...) {
+		restoreFreeEntry(loc);
+		throw;
+	    }
+	}
+	linkEntry(loc, hashof);
+	return &chains[loc].data;
+    }
+
+#if __cplusplus >= 201103L
+    // Constructs the data for a new entry from args and returns its
+    // index; the caller has to linkEntry() it.
+    template<class... Args> IndexT emplaceEntry(Args&&... args) {
+	prepareAdd();
+	IndexT loc;
+	if (free_list == null_index) {
+	    loc = nextEntry();
+	    chains.emplace_back(HashTable_emplace_tag(), null_index, std::forward<Args>(args)...);
+	} else {
+	    loc = takeFreeEntry();
+	    D *to = &chains[loc].data;
+	    to->~D();
+	    try {
+		new (to) D(std::forward<Args>(args)...);
+	    } catch (...) {
+		restoreFreeEntry(loc);
+		throw;
+	    }
+	}
+	return loc;
+    }
+#endif
+
+    // grow the table if an add would make the chains too long.
+    void prepareAdd() {
+	maybeMigrate();
+	if (free_list == null_index && pending_buckets == 0 &&
 	    chains.size() >= target_chain_length * entry_points.size()) {
 	    resizeHashTable();
 	}
-
 	INVARIANT(entry_points.size() > 0, 
 		  "did not call init() already? probably a static hash table, which is not safe, see Lintel/src/tests/init-order-test.C");
+    }
+
+    // index the next entry appended to chains will have
+    IndexT nextEntry() {
+	DEBUG_SINVARIANT(free_list_size == 0);
+	INVARIANT(chains.size() < null_index,
+		  "HashTable is full, use a larger IndexT");
+	return static_cast<IndexT>(chains.size());
+    }
+
+    // The entries on the free list hold a default D, see clearEntry(),
+    // which the caller destroys and then constructs the new data over.
+    IndexT takeFreeEntry() {
+	IndexT loc = free_list;
+	free_list = chains[free_list].next;
+	DEBUG_SINVARIANT(free_list_size > 0);
+	--free_list_size;
+	return loc;
+    }
+
+    // If constructing the data over a free entry throws, put back
+    // the default D and the entry on the free list.
+    void restoreFreeEntry(IndexT loc) {
+	new (&chains[loc].data) D();
+	chains[loc].next = free_list;
+	free_list = loc;
+	++free_list_size;
+    }
+
+    void linkEntry(IndexT loc, uint32_t hashof) {
 	uint32_t hash = hashof % entry_points.size();
-	if (free_list == -1) {
-	    DEBUG_SINVARIANT(free_list_size == 0);
-	    hte v(data, entry_points[hash]);
-	    DEBUG_SINVARIANT(hash < entry_points.size());
-	    entry_points[hash] = static_cast<int>(chains.size());
-	    chains.push_back(v);
-	    return &(chains.back().data);
-	} else {
-	    int32_t loc = free_list;
-	    
-	    free_list = chains[free_list].next;
-	    DEBUG_SINVARIANT(free_list_size > 0);
-	    --free_list_size;
-	    chains[loc].data = data;
-	    chains[loc].next = entry_points[hash];
-	    entry_points[hash] = loc;
-	    return &chains[loc].data;
+	chains[loc].next = entry_points[hash];
+	entry_points[hash] = loc;
+	if (filter != NULL) {
+	    filter->add(hashof);
+	    if (UNLIKELY(filter->full())) {
+		rebuildFilter();
+	    }
+	}
+    }
+
+    void rebuildFilter() {
+	rebuildFilter(filter->bitsPerKey(), filter->countingStats());
+    }
+
+    // size the filter for twice the current entries, and add them all
+    void rebuildFilter(double bits_per_key, bool count_stats) {
+	filter->init(std::max(2 * size(), static_cast<size_t>(1024)), bits_per_key, count_stats);
+	for(size_t i = 0; i < bucketCount(); ++i) {
+	    for(IndexT j = bucketHead(i); j != null_index; j = chains[j].next) {
+		filter->add(doHash(chains[j].data));
+	    }
+	}
+    }
+
+    // number of entry points for nentries: the first big enough
+    // prime, or the largest.
+    size_t bucketsFor(size_t nentries) const {
+	size_t new_entry_size = static_cast<size_t>(nentries / target_chain_length);
+	unsigned i;
+	for(i=0; HashTable_prime_list[i+1] != 0 && HashTable_prime_list[i] < new_entry_size; ++i) {
+	    // find the first big enough size, or the largest
 	}
+	return HashTable_prime_list[i];
+    }
+
+    static void moveData(D &to, D &from) {
+#if __cplusplus >= 201103L
+	to = std::move(from);
+#else
+	to = from;
+#endif
     }
 
-    template<class V, class C> static inline V *
-    staticInternalLookup(C *me, const D &key, uint32_t hashof) {
+    // Entries on the free list stay constructed since chains owns
+    // them, so destroy the data and leave a default D, releasing
+    // whatever it held now rather than when the entry is reused.
+    void clearEntry(IndexT loc) {
+	D *data = &chains[loc].data;
+	data->~D();
+	new (data) D();
+    }
+
+    template<class V, class C, class K> static inline V *
+    staticInternalLookup(C *me, const K &key, uint32_t hashof) {
 	if (me->entry_points.size() == 0) {
 	    return NULL;
 	}
 	uint32_t hash = hashof % me->entry_points.size();
-	for(int32_t i=me->entry_points[hash]; i != -1; 
+	if (me->filter != NULL) {
+	    // fetch the bucket while checking the filter so that a hit
+	    // doesn't wait for one and then the other.
+	    LINTEL_PREFETCH(&me->entry_points[hash]);
+	    if (!me->filter->check(hashof)) {
+		return NULL;
+	    }
+	}
+	for(IndexT i=me->entry_points[hash]; i != null_index; 
 	    i = me->chains[i].next) {
 	    if (me->equal(key,me->chains[i].data)) {
 		return &(me->chains[i]);
 	    }
 	}
+	if (UNLIKELY(!me->old_entry_points.empty())) {
+	    hash = hashof % me->old_entry_points.size();
+	    for(IndexT i=me->old_entry_points[hash]; i != null_index; 
+		i = me->chains[i].next) {
+		if (me->equal(key,me->chains[i].data)) {
+		    return &(me->chains[i]);
+		}
+	    }
+	}
+	if (me->filter != NULL) {
+	    me->filter->falsePositive();
+	}
 	return NULL;
     }
 
@@ -612,17 +1104,128 @@ private:
 	return staticInternalLookup<const hte>(this, key, hashof);
     }
 
+    template<class V, class C, class K> static inline V *
+    staticLookup(C *me, const K &key) {
+	typedef typename boost::mpl::if_c<boost::is_const<V>::value, 
+	    const hte, hte>::type HteT;
+	HteT *chain = staticInternalLookup<HteT>(me, key, me->doHash(key));
+	return chain == NULL ? NULL : &chain->data;
+    }
+
+    static const size_t batch_group_size = 16;
+    // entry points filled in per bucket moved during an incremental
+    // resize; filling is much cheaper than moving a chain.
+    static const size_t fill_per_bucket = 64;
+
+    // Three stage pipeline over groups of keys: hash a group and
+    // prefetch its entry points, then read the heads of the chains and
+    // prefetch the first entries, then walk the chains.  Hashing the
+    // next group is done between the last two stages so the first
+    // entries have time to arrive.
+    template<class V, class C, class K> static void
+    staticLookupBatch(C *me, const K *keys, size_t n, V **out) {
+	if (me->entry_points.empty() || UNLIKELY(!me->old_entry_points.empty())) {
+	    for(size_t i = 0; i < n; ++i) {
+		out[i] = staticLookup<V>(me, keys[i]);
+	    }
+	    return;
+	}
+	size_t nbuckets = me->entry_points.size();
+	uint32_t buckets[2][batch_group_size];
+	IndexT heads[batch_group_size];
+	
+	size_t group_end = std::min(n, batch_group_size);
+	for(size_t i = 0; i < group_end; ++i) {
+	    buckets[0][i] = batchBucket(me, keys[i], nbuckets);
+	}
+	for(size_t base = 0, cur = 0; base < n; base += batch_group_size, cur ^= 1) {
+	    size_t count = std::min(n - base, batch_group_size);
+	    for(size_t i = 0; i < count; ++i) {
+		heads[i] = buckets[cur][i] == nbuckets ? null_index 
+		    : me->entry_points[buckets[cur][i]];
+		if (heads[i] != null_index) {
+		    LINTEL_PREFETCH(&me->chains[heads[i]]);
+		}
+	    }
+	    size_t next = base + batch_group_size;
+	    size_t next_count = next < n ? std::min(n - next, batch_group_size) : 0;
+	    for(size_t i = 0; i < next_count; ++i) {
+		buckets[cur ^ 1][i] = batchBucket(me, keys[next + i], nbuckets);
+	    }
+	    for(size_t i = 0; i < count; ++i) {
+		V *found = NULL;
+		for(IndexT j = heads[i]; j != null_index; j = me->chains[j].next) {
+		    if (me->equal(keys[base + i], me->chains[j].data)) {
+			found = &me->chains[j].data;
+			break;
+		    }
+		}
+		if (found == NULL && buckets[cur][i] != nbuckets && me->filter != NULL) {
+		    me->filter->falsePositive();
+		}
+		out[base + i] = found;
+	    }
+	}
+    }
+
+    // the bucket of key, with its entry point prefetched, or nbuckets
+    // if the filter says it is absent.
+    template<class C, class K> static inline uint32_t
+    batchBucket(C *me, const K &key, size_t nbuckets) {
+	uint32_t hashof = me->doHash(key);
+	if (me->filter != NULL && !me->filter->check(hashof)) {
+	    return nbuckets;
+	}
+	uint32_t ret = hashof % nbuckets;
+	LINTEL_PREFETCH(&me->entry_points[ret]);
+	return ret;
+    }
+
+    template<class I, class C, class K> static inline I
+    staticFind(C *me, const K &key) {
+	if (me->entry_points.size() == 0) {
+	    return me->end();
+	}
+	uint32_t hashof = me->doHash(key);
+	if (me->filter != NULL && !me->filter->check(hashof)) {
+	    return me->end();
+	}
+	uint32_t hash = hashof % me->entry_points.size();
+	for(IndexT i = me->entry_points[hash]; i != null_index; i = me->chains[i].next) {
+	    if (me->equal(key, me->chains[i].data)) {
+		return I(*me, hash, i);
+	    }
+	}
+	if (UNLIKELY(!me->old_entry_points.empty())) {
+	    hash = hashof % me->old_entry_points.size();
+	    for(IndexT i = me->old_entry_points[hash]; i != null_index; 
+		i = me->chains[i].next) {
+		if (me->equal(key, me->chains[i].data)) {
+		    return I(*me, me->entry_points.size() + hash, i);
+		}
+	    }
+	}
+	if (me->filter != NULL) {
+	    me->filter->falsePositive();
+	}
+	return me->end();
+    }
+
     void init(double _tcl) {
 	INVARIANT(_tcl > 0, 
 		  boost::format("invalid target_chain_length %.6f") % _tcl);
 
 	if (entry_points.capacity() == 0) {
 	    // only do this if we haven't already done the init in add()
-	    free_list = -1;
+	    free_list = null_index;
 	    free_list_size = 0;
 	    // make the "have we initted" call in add() only have
 	    // to test a single possibility
 	    entry_points.reserve(1); 
+	    migrate_pos = 0;
+	    pending_buckets = 0;
+	    incremental_buckets = 0;
+	    filter = NULL;
 	}
 	target_chain_length = _tcl;
     }	
@@ -632,7 +1235,17 @@ private:
 	free_list_size = __in.free_list_size;
 	chains = __in.chains;
 	entry_points = __in.entry_points;
+	old_entry_points = __in.old_entry_points;
+	migrate_pos = __in.migrate_pos;
+	pending_entry_points = __in.pending_entry_points;
+	pending_entry_points.reserve(__in.pending_buckets);
+	pending_buckets = __in.pending_buckets;
+	incremental_buckets = __in.incremental_buckets;
 	target_chain_length = __in.target_chain_length;
+	BlockedBloomFilter *tmp = __in.filter == NULL ? NULL
+	    : new BlockedBloomFilter(*__in.filter);
+	delete filter;
+	filter = tmp;
 	hashfn = __in.hashfn;
 	equal = __in.equal;
 	return *this;
@@ -645,39 +1258,178 @@ private:
     // are fine.
 
     void resizeHashTable() {
-	SINVARIANT(free_list == -1 && free_list_size == 0);
+	SINVARIANT(free_list == null_index && free_list_size == 0);
+	// the table grows ~4x per resize, so with at least one bucket
+	// moved per add a resize is only still in progress here for
+	// tiny tables.
+	finishMigration();
 	uint32_t old_size = entry_points.size();
 	uint32_t new_size;
 	uint32_t i;
-	for(i=0; HashTable_prime_list[i] <= old_size;i++) {
-	    SINVARIANT(HashTable_prime_list[i] != 0);
+	for(i=0; HashTable_prime_list[i] != 0 && HashTable_prime_list[i] <= old_size;i++) {
+	    // find next size
+	}
+	if (HashTable_prime_list[i] == 0) {
+	    // Already as big as a 32 bit hash can use; let the chains
+	    // get longer.
+	    return;
 	}
 	new_size = HashTable_prime_list[i];
+	resizeEntryPoints(new_size);
+    }
+
+    // Switch to new_size entry points, incrementally if turned on.
+    // Any incremental resize has to be finished already.
+    void resizeEntryPoints(size_t new_size) {
+	DEBUG_SINVARIANT(!resizeInProgress());
+	if (incremental_buckets > 0 && !chains.empty()) {
+	    // Only the allocation happens here; the memory is not
+	    // touched until maybeMigrate() fills it in.
+	    pending_entry_points.reserve(new_size);
+	    pending_buckets = new_size;
+	    return;
+	}
+	if (free_list_size > 0) {
+	    // only reserve() gets here; walk the chains so the entries on
+	    // the free list stay off them.
+	    hash_tableT old(new_size, null_index);
+	    old.swap(entry_points);
+	    for(size_t j = 0; j < old.size(); ++j) {
+		relinkChain(old[j]);
+	    }
+	    return;
+	}
+	size_t old_size = entry_points.size();
 	entry_points.reserve(new_size);
-	entry_points.resize(new_size,-1);
+	entry_points.resize(new_size, null_index);
 
 	// Clear old entries & links
-	for(i=0;i<old_size;i++) {
-	    entry_points[i] = -1;
+	for(size_t i=0;i<old_size;i++) {
+	    entry_points[i] = null_index;
+	}
+	for(size_t j=0;j<chains.size();j++) {
+	    chains[j].next = null_index;
 	}
-	for(i=0;i<chains.size();i++) {
-	    chains[i].next = -1;
+
+	for(size_t j=0;j<chains.size();j++) {
+	    uint32_t hash = doHash(chains[j].data) % new_size;
+	    chains[j].next = entry_points[hash];
+	    entry_points[hash] = static_cast<IndexT>(j);
 	}
+    }
 
-	for(i=0;i<chains.size();i++) {
-	    uint32_t hash = doHash(chains[i].data) % new_size;
+    // move the chain starting at i onto entry_points
+    void relinkChain(IndexT i) {
+	while (i != null_index) {
+	    IndexT next = chains[i].next;
+	    uint32_t hash = doHash(chains[i].data) % entry_points.size();
 	    chains[i].next = entry_points[hash];
 	    entry_points[hash] = i;
+	    i = next;
+	}
+    }
+
+    // During an incremental resize, iterators number the buckets with
+    // the new entry points first followed by the old ones.
+    size_t bucketCount() const {
+	return entry_points.size() + old_entry_points.size();
+    }
+
+    IndexT bucketHead(size_t bucket) const {
+	return bucket < entry_points.size() ? entry_points[bucket] 
+	    : old_entry_points[bucket - entry_points.size()];
+    }
+
+    IndexT &bucketHeadRef(size_t bucket) {
+	return bucket < entry_points.size() ? entry_points[bucket] 
+	    : old_entry_points[bucket - entry_points.size()];
+    }
+
+    void maybeMigrate() {
+	if (UNLIKELY(pending_buckets != 0)) {
+	    fillEntryPoints(incremental_buckets * fill_per_bucket);
+	} else if (UNLIKELY(!old_entry_points.empty())) {
+	    migrateBuckets(incremental_buckets);
+	}
+    }
+
+    void finishMigration() {
+	if (pending_buckets != 0) {
+	    fillEntryPoints(pending_buckets);
+	}
+	if (!old_entry_points.empty()) {
+	    migrateBuckets(old_entry_points.size());
+	}
+    }
+
+    // Fill in count more of the pending entry points; once they are
+    // all filled they replace the current ones, which become the old
+    // ones whose chains are moved over by migrateBuckets().
+    void fillEntryPoints(size_t count) {
+	pending_entry_points.resize(std::min(pending_buckets, pending_entry_points.size() + count),
+				    null_index);
+	if (pending_entry_points.size() == pending_buckets) {
+	    DEBUG_SINVARIANT(old_entry_points.empty());
+	    old_entry_points.swap(entry_points);
+	    entry_points.swap(pending_entry_points);
+	    pending_buckets = 0;
+	    migrate_pos = 0;
+	}
+    }
+
+    void migrateBuckets(size_t count) {
+	size_t end = old_entry_points.size() - migrate_pos < count 
+	    ? old_entry_points.size() : migrate_pos + count;
+	for(; migrate_pos < end; ++migrate_pos) {
+	    IndexT i = old_entry_points[migrate_pos];
+	    old_entry_points[migrate_pos] = null_index;
+	    relinkChain(i);
+	}
+	if (migrate_pos == old_entry_points.size()) {
+	    hash_tableT().swap(old_entry_points);
+	    migrate_pos = 0;
 	}
     }
     
-    int32_t free_list; // pointer into chains
-    uint32_t free_list_size; 
+    IndexT free_list; // pointer into chains
+    size_t free_list_size; 
     hte_vectorT chains;
     hash_tableT entry_points;
+    hash_tableT old_entry_points; // non-empty during an incremental resize
+    size_t migrate_pos; // next bucket in old_entry_points to move
+    hash_tableT pending_entry_points; // being filled for an incremental resize
+    size_t pending_buckets; // final size of pending_entry_points, or 0
+    uint32_t incremental_buckets;
     double target_chain_length;
+    BlockedBloomFilter *filter; // NULL unless enableFilter()
     HashFn hashfn;
     Equal equal;
 };
 
+template <class D, class HashFn, class Equal, class IndexT, class AllocHTE, class AllocInt>
+const IndexT HashTable<D, HashFn, Equal, IndexT, AllocHTE, AllocInt>::null_index;
+
+template <class D, class HashFn, class Equal, class IndexT, class AllocHTE, class AllocInt>
+const size_t HashTable<D, HashFn, Equal, IndexT, AllocHTE, AllocInt>::batch_group_size;
+
+template <class D, class HashFn, class Equal, class IndexT, class AllocHTE, class AllocInt>
+const size_t HashTable<D, HashFn, Equal, IndexT, AllocHTE, AllocInt>::fill_per_bucket;
+
+/// \brief Backend selector for HashMap and HashUnique that picks the
+/// chained HashTable; see also FlatHashTableBackend.
+struct HashTableChainedBackend {
+    template <class D, class HashFn, class Equal> struct table {
+	typedef HashTable<D, HashFn, Equal> type;
+    };
+};
+
+/// \brief Backend selector for the chained HashTable with a different
+/// IndexT, e.g. HashMap<K, V, KHash, KEqual,
+/// HashTableIndexBackend<uint64_t> > for more than 2^32-2 entries.
+template <class IndexT> struct HashTableIndexBackend {
+    template <class D, class HashFn, class Equal> struct table {
+	typedef HashTable<D, HashFn, Equal, IndexT> type;
+    };
+};
+
 #endif
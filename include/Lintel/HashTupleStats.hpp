@@ -143,15 +143,8 @@ namespace lintel {
 	/// function, do, it will use additional memory as a result of
 	/// having to sort the tuples.
 	void walkOrdered(const WalkFn &walk_fn) const {
-	    HTSValueVector sorted;
+	    HTSValueVector sorted(data.extractSorted());
 
-	    sorted.reserve(data.size());
-	    // TODO: figure out why the below doesn't work.
-	    //	sorted.push_back(base_data.begin(), base_data.end());
-	    for(HTSconst_iterator i = data.begin(); i != data.end(); ++i) {
-		sorted.push_back(*i);
-	    }
-	    sort(sorted.begin(), sorted.end());
 	    for(HTSVViterator i = sorted.begin(); i != sorted.end(); ++i) {
 		walk_fn(i->first, *i->second);
 	    }
@@ -239,6 +232,14 @@ namespace lintel {
 		}
 	    }
 	}
+
+	/// give back the memory of the entries removed by prune();
+	/// see HashTable::compact.  Worth it after a prune that removed
+	/// most of the entries, but it rehashes the whole table, so not
+	/// after every prune.
+	void compact() {
+	    data.compact();
+	}
     
 	/// clear out all the values in the hash tuple stats.
 	void clear() {
@@ -17,7 +17,8 @@
 /// \brief hash implementation of uniqueifying a set of values; no excess space used.
 template <class K,
           class KHash = HashMap_hash<const K>,
-          class KEqual = std::equal_to<const K> >
+          class KEqual = std::equal_to<const K>,
+          class Backend = HashTableChainedBackend>
 class HashUnique {
 public:
     HashUnique() { }
@@ -36,6 +37,20 @@ public:
 	const K *v = hashtable.lookup(k);
 	return v != NULL;
     }
+
+    /// Sets out[i] to exists(keys[i]) for n keys; see
+    /// HashTable::lookupBatch.
+    void existsBatch(const K *keys, size_t n, bool *out) const {
+	static const size_t chunk = 64;
+	const K *found[chunk];
+	for(size_t base = 0; base < n; base += chunk) {
+	    size_t count = std::min(n - base, chunk);
+	    hashtable.lookupBatch(keys + base, count, found);
+	    for(size_t i = 0; i < count; ++i) {
+		out[base + i] = found[i] != NULL;
+	    }
+	}
+    }
     
     // add the key to the table if it does not exist.  if
     // it does exist, nothing happens.  returns true iff
@@ -50,6 +65,14 @@ public:
 	}
     }
 
+#if __cplusplus >= 201103L
+    /// Same as add(const K &), but moves k into the table if it is
+    /// added.
+    bool add(K &&k) {
+	return hashtable.try_emplace(k, std::move(k)).second;
+    }
+#endif
+
     // add the key or replace it if it exists.  returns true
     // iff a replacement occurred.
     bool addOrReplace(const K &k) {
@@ -62,7 +85,7 @@ public:
 	hashtable.remove(k, must_exist);
     }
 
-    typedef HashTable<K, KHash, KEqual> HashTableT;
+    typedef typename Backend::template table<K, KHash, KEqual>::type HashTableT;
 
     typedef typename HashTableT::iterator iterator;
     
@@ -88,7 +111,7 @@ public:
 	hashtable.clear();
     }
     
-    uint32_t size() const {
+    size_t size() const {
 	return hashtable.size();
     }
 
@@ -96,10 +119,40 @@ public:
         return hashtable.capacity();
     }
 
-    void reserve(unsigned expected_entries) {
+    void reserve(size_t expected_entries) {
 	hashtable.reserve(expected_entries);
     }
 
+    /// See HashTable::reserve; only for the chained backend.
+    void reserve(size_t expected_entries, bool resize_buckets) {
+	hashtable.reserve(expected_entries, resize_buckets);
+    }
+
+    /// See HashTable::compact.
+    void compact() {
+	hashtable.compact();
+    }
+
+    /// See HashTable::enableFilter; only for the chained backend.
+    /// Useful when most of the keys checked with exists() or added
+    /// are new.
+    void enableFilter(double bits_per_key = 10, bool count_stats = false) {
+	hashtable.enableFilter(bits_per_key, count_stats);
+    }
+
+    BlockedBloomFilter::FilterStats filterStats() const {
+	return hashtable.filterStats();
+    }
+
+    /// Copy of all the keys sorted by cmp; see HashTable::extractSorted.
+    template<class Cmp> std::vector<K> extractSorted(Cmp cmp) const {
+	return hashtable.extractSorted(cmp);
+    }
+
+    std::vector<K> extractSorted() const {
+	return hashtable.extractSorted(std::less<K>());
+    }
+
     /// Get statistics for the chain lengths of all the chains in the
     /// underlying hash table.  Useful for detecting a bad hash
     /// function.
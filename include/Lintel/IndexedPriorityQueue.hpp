@@ -0,0 +1,228 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for IndexedPriorityQueue class
+*/
+
+#ifndef LINTEL_INDEXED_PRIORITY_QUEUE_HPP
+#define LINTEL_INDEXED_PRIORITY_QUEUE_HPP
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <boost/static_assert.hpp>
+#include <boost/utility.hpp>
+
+#include <Lintel/AssertBoost.hpp>
+
+/// \brief Priority queue whose values can be changed or removed
+///
+/// A heap like PriorityQueue, with the same LessImportant and Arity
+/// parameters, for when queued values have to be cancelled or
+/// rescheduled, as events in a simulator are.  push() returns a handle
+/// for the value, which update(), erase() and contains() take; each
+/// is O(log n).  The heap holds (value, handle slot) pairs, and a flat
+/// array indexed by slot holds each value's position in the heap.
+///
+/// A handle stays valid until its value is popped or erased.  Slots
+/// are reused, but a handle also carries the generation of its slot,
+/// so contains() on an old handle is false rather than referring to a
+/// later value; the other methods check that only in debug builds.
+template<class T, class LessImportant = std::less_equal<T>, unsigned Arity = 2>
+class IndexedPriorityQueue : boost::noncopyable {
+public:
+    BOOST_STATIC_ASSERT(Arity >= 2);
+
+    typedef uint64_t Handle;
+
+    IndexedPriorityQueue() : free_slot(no_slot) { }
+
+    explicit IndexedPriorityQueue(const LessImportant &li)
+	: lessimportant(li), free_slot(no_slot) { }
+
+    const T &top() const { DEBUG_SINVARIANT(!empty()); return heap[0].val; }
+    Handle topHandle() const { DEBUG_SINVARIANT(!empty()); return handleOf(heap[0].slot); }
+
+    Handle push(const T &val) {
+	INVARIANT(heap.size() < no_slot, "IndexedPriorityQueue is limited to 2^32 - 1 values");
+	uint32_t slot = allocSlot();
+	Entry e = { val, slot };
+	heap.push_back(e);
+	siftUp(heap.size() - 1, e);
+	return handleOf(slot);
+    }
+
+    void pop() {
+	DEBUG_SINVARIANT(!empty());
+	removeAt(0);
+    }
+
+    bool contains(Handle h) const {
+	uint32_t slot = static_cast<uint32_t>(h);
+	return slot < slots.size() && slots[slot].generation == (h >> 32)
+	    && slots[slot].pos != no_slot;
+    }
+
+    /// the value for a handle that is contained
+    const T &get(Handle h) const {
+	DEBUG_SINVARIANT(contains(h));
+	return heap[slots[static_cast<uint32_t>(h)].pos].val;
+    }
+
+    /// Change the value for a handle that is contained; it keeps its handle.
+    void update(Handle h, const T &val) {
+	DEBUG_SINVARIANT(contains(h));
+	uint32_t slot = static_cast<uint32_t>(h);
+	uint32_t pos = slots[slot].pos;
+	Entry e = { val, slot };
+	if (pos > 0 && !lessimportant(val, heap[(pos - 1) / Arity].val)) {
+	    siftUp(pos, e);
+	} else {
+	    siftDown(pos, e);
+	}
+    }
+
+    /// Remove the value for a handle that is contained.
+    void erase(Handle h) {
+	DEBUG_SINVARIANT(contains(h));
+	removeAt(slots[static_cast<uint32_t>(h)].pos);
+    }
+
+    size_t size() const {
+	return heap.size();
+    }
+
+    bool empty() const {
+	return heap.empty();
+    }
+
+    /// Remove all of the values; all of the handles become invalid.
+    void clear() {
+	for(size_t i = 0; i < heap.size(); ++i) {
+	    freeSlot(heap[i].slot);
+	}
+	heap.clear();
+    }
+
+    size_t memoryUsage() const {
+	return heap.capacity() * sizeof(Entry) + slots.capacity() * sizeof(Slot);
+    }
+
+    void selfVerify() {
+	for(uint32_t i = 0; i < heap.size(); ++i) {
+	    SINVARIANT(slots[heap[i].slot].pos == i);
+	    if (i > 0) {
+		const T &up(heap[(i - 1) / Arity].val);
+		SINVARIANT(!lessimportant(up, heap[i].val) || lessimportant(heap[i].val, up));
+	    }
+	}
+    }
+
+private:
+    static const uint32_t no_slot = 0xFFFFFFFFU;
+
+    struct Entry {
+	T val;
+	uint32_t slot;
+    };
+
+    /// pos is no_slot for a free slot, whose generation has already
+    /// been advanced; next_free chains the free slots.
+    struct Slot {
+	uint32_t pos;
+	uint32_t generation;
+	uint32_t next_free;
+    };
+
+    Handle handleOf(uint32_t slot) const {
+	return (static_cast<Handle>(slots[slot].generation) << 32) | slot;
+    }
+
+    uint32_t allocSlot() {
+	if (free_slot == no_slot) {
+	    Slot s = { no_slot, 0, no_slot };
+	    slots.push_back(s);
+	    return slots.size() - 1;
+	} else {
+	    uint32_t ret = free_slot;
+	    free_slot = slots[ret].next_free;
+	    return ret;
+	}
+    }
+
+    void freeSlot(uint32_t slot) {
+	slots[slot].pos = no_slot;
+	++slots[slot].generation;
+	slots[slot].next_free = free_slot;
+	free_slot = slot;
+    }
+
+    void place(uint32_t pos, const Entry &e) {
+	heap[pos] = e;
+	slots[e.slot].pos = pos;
+    }
+
+    // move the hole at pos up until e fits there
+    void siftUp(uint32_t pos, const Entry &e) {
+	while (pos > 0) {
+	    uint32_t up = (pos - 1) / Arity;
+	    if (lessimportant(e.val, heap[up].val)) {
+		break;
+	    }
+	    place(pos, heap[up]);
+	    pos = up;
+	}
+	place(pos, e);
+    }
+
+    // move the hole at pos down until e fits there
+    void siftDown(uint32_t pos, const Entry &e) {
+	uint32_t size = heap.size();
+	while (true) {
+	    uint32_t first = Arity * pos + 1;
+	    if (first >= size) {
+		break;
+	    }
+	    uint32_t last = first + Arity < size ? first + Arity : size;
+	    uint32_t down = first;
+	    for(uint32_t j = first + 1; j < last; ++j) {
+		if (!lessimportant(heap[j].val, heap[down].val)) {
+		    down = j;
+		}
+	    }
+	    if (!lessimportant(e.val, heap[down].val)) {
+		break;
+	    }
+	    place(pos, heap[down]);
+	    pos = down;
+	}
+	place(pos, e);
+    }
+
+    void removeAt(uint32_t pos) {
+	freeSlot(heap[pos].slot);
+	Entry last = heap.back();
+	heap.pop_back();
+	if (pos == heap.size()) {
+	    return;
+	}
+	if (pos > 0 && !lessimportant(last.val, heap[(pos - 1) / Arity].val)) {
+	    siftUp(pos, last);
+	} else {
+	    siftDown(pos, last);
+	}
+    }
+
+    LessImportant lessimportant;
+    std::vector<Entry> heap;
+    std::vector<Slot> slots;
+    uint32_t free_slot;
+};
+
+#endif
@@ -0,0 +1,179 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for MPMCBoundedQueue class
+*/
+
+#ifndef LINTEL_MPMC_BOUNDED_QUEUE_HPP
+#define LINTEL_MPMC_BOUNDED_QUEUE_HPP
+
+#include <sched.h>
+
+#include <boost/utility.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/EventCount.hpp>
+
+/// \brief Bounded queue for any number of producer and consumer threads
+///
+/// Dmitry Vyukov's bounded MPMC queue: a rotating array where each
+/// cell has a sequence number saying whether it is ready to be filled
+/// or emptied on the current lap.  A push or pop claims its cell with
+/// one compare and swap on the shared enqueue or dequeue position,
+/// then fills or empties the cell and publishes it with a release
+/// store of the sequence number.  Pushes and pops only touch each
+/// other's cache lines at the cells, and a thread stalled between the
+/// claim and the publish only holds up the consumers of that cell.
+///
+/// Made with blocking = true, push() and pop() sleep while the queue
+/// is full or empty, as for SPSCRing.  T must be default
+/// constructible and assignable.  Needs to be linked with
+/// LintelPThread.
+template<class T> class MPMCBoundedQueue : boost::noncopyable {
+public:
+    /// capacity is rounded up to a power of two, at least 2.
+    explicit MPMCBoundedQueue(size_t capacity, bool blocking = false)
+	: enqueue_pos(0), dequeue_pos(0), blocking(blocking) {
+	size_t size = 2;
+	while (size < capacity) {
+	    size *= 2;
+	}
+	mask = size - 1;
+	cells = new Cell[size];
+	for(size_t i = 0; i < size; ++i) {
+	    cells[i].sequence.store(i, lintel::memory_order_relaxed);
+	}
+    }
+
+    ~MPMCBoundedQueue() {
+	delete [] cells;
+    }
+
+    /// Returns false if the queue is full.
+    bool tryPush(const T &v) {
+	Cell *cell;
+	size_t pos = enqueue_pos.load(lintel::memory_order_relaxed);
+	while (true) {
+	    cell = &cells[pos & mask];
+	    size_t seq = cell->sequence.load(lintel::memory_order_acquire);
+	    ptrdiff_t dif = static_cast<ptrdiff_t>(seq - pos);
+	    if (dif == 0) {
+		// on failure pos is updated to the current position
+		if (enqueue_pos.compare_exchange_strong(&pos, pos + 1)) {
+		    break;
+		}
+	    } else if (dif < 0) {
+		return false; // the cell has not been emptied from the last lap
+	    } else {
+		pos = enqueue_pos.load(lintel::memory_order_relaxed);
+	    }
+	}
+	cell->data = v;
+	cell->sequence.store(pos + 1, lintel::memory_order_release);
+	if (blocking) {
+	    not_empty.notifyOne();
+	}
+	return true;
+    }
+
+    /// Returns false if the queue is empty.
+    bool tryPop(T &out) {
+	Cell *cell;
+	size_t pos = dequeue_pos.load(lintel::memory_order_relaxed);
+	while (true) {
+	    cell = &cells[pos & mask];
+	    size_t seq = cell->sequence.load(lintel::memory_order_acquire);
+	    ptrdiff_t dif = static_cast<ptrdiff_t>(seq - (pos + 1));
+	    if (dif == 0) {
+		if (dequeue_pos.compare_exchange_strong(&pos, pos + 1)) {
+		    break;
+		}
+	    } else if (dif < 0) {
+		return false; // the cell has not been filled on this lap
+	    } else {
+		pos = dequeue_pos.load(lintel::memory_order_relaxed);
+	    }
+	}
+#if __cplusplus >= 201103L
+	out = std::move(cell->data);
+#else
+	out = cell->data;
+#endif
+	cell->sequence.store(pos + mask + 1, lintel::memory_order_release);
+	if (blocking) {
+	    not_full.notifyOne();
+	}
+	return true;
+    }
+
+    /// Waits while the queue is full.
+    void push(const T &v) {
+	SINVARIANT(blocking);
+	for(uint32_t tries = 0; !tryPush(v); ++tries) {
+	    if (tries < EventCount::yields_before_wait) {
+		sched_yield();
+		continue;
+	    }
+	    uint32_t key = not_full.prepareWait();
+	    if (tryPush(v)) {
+		not_full.cancelWait();
+		return;
+	    }
+	    not_full.wait(key);
+	}
+    }
+
+    /// Waits while the queue is empty.
+    void pop(T &out) {
+	SINVARIANT(blocking);
+	for(uint32_t tries = 0; !tryPop(out); ++tries) {
+	    if (tries < EventCount::yields_before_wait) {
+		sched_yield();
+		continue;
+	    }
+	    uint32_t key = not_empty.prepareWait();
+	    if (tryPop(out)) {
+		not_empty.cancelWait();
+		return;
+	    }
+	    not_empty.wait(key);
+	}
+    }
+
+    /// Only a snapshot while other threads are pushing or popping.
+    size_t size() const {
+	size_t d = dequeue_pos.load(), e = enqueue_pos.load();
+	return e > d ? e - d : 0;
+    }
+
+    bool empty() const {
+	return size() == 0;
+    }
+
+    size_t capacity() const {
+	return mask + 1;
+    }
+
+private:
+    struct Cell {
+	lintel::Atomic<size_t> sequence;
+	T data;
+    };
+
+    char padding0[64];
+    lintel::Atomic<size_t> enqueue_pos;
+    char padding1[64];
+    lintel::Atomic<size_t> dequeue_pos;
+    char padding2[64];
+    Cell *cells;
+    size_t mask;
+    bool blocking;
+    EventCount not_empty, not_full;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief read-only hash tables served from a file written by
+    HashTable::save or HashMap::save
+*/
+
+#ifndef LINTEL_MAPPED_HASH_TABLE_HPP
+#define LINTEL_MAPPED_HASH_TABLE_HPP
+
+#include <string>
+
+#include <boost/utility.hpp>
+
+#include <Lintel/HashMap.hpp>
+#include <Lintel/HashTable.hpp>
+
+/// \cond SEMI_INTERNAL_CLASSES
+/// The type independent part of MappedHashTable; maps the file
+/// read-only and checks the header against the expected sizes.
+class MappedHashTableImage : boost::noncopyable {
+public:
+    MappedHashTableImage(const std::string &path, uint32_t data_size,
+			 uint32_t index_size, uint32_t entry_size);
+    ~MappedHashTableImage();
+
+    const HashTableImageHeader &header() const {
+	return *static_cast<const HashTableImageHeader *>(base);
+    }
+    const void *chains() const {
+	return static_cast<const char *>(base) + header().chains_offset;
+    }
+    const void *entryPoints() const {
+	return static_cast<const char *>(base) + header().entry_points_offset;
+    }
+
+private:
+    void *base;
+    size_t length;
+};
+/// \endcond
+
+/// \brief Read-only HashTable mapped from a file written by HashTable::save
+///
+/// The file is mmap'd read-only and lookups walk the saved chains in
+/// place, so opening a table of any size is nearly free, pages are
+/// only read in as lookups touch them, and processes mapping the same
+/// file share its page cache.  D, HashFn, Equal and IndexT have to be
+/// the same as for the HashTable that was saved; the sizes of D and
+/// IndexT are checked when opening, the hash function can not be, so
+/// it should not depend on anything that varies between processes
+/// such as pointer values.  The file must not be rewritten in place
+/// while it is mapped; HashTable::save replaces it with a new file.
+template <class D, class HashFn, class Equal, class IndexT = uint32_t>
+class MappedHashTable : boost::noncopyable {
+public:
+    typedef HashTable_hte<D, IndexT> hte;
+
+    explicit MappedHashTable(const std::string &path)
+	: image(path, sizeof(D), sizeof(IndexT), sizeof(hte)),
+	  chains(static_cast<const hte *>(image.chains())),
+	  entry_points(static_cast<const IndexT *>(image.entryPoints())),
+	  nbuckets(image.header().nentry_points) { }
+
+    const D *lookup(const D &key) const {
+	return internalLookup(key);
+    }
+
+    /// lookup using a key of a type other than D; same requirements
+    /// as for HashTable.
+    template<class K2> typename HashTable_otherKey<K2, D, const D *>::type
+    lookup(const K2 &key) const {
+	return internalLookup(key);
+    }
+
+    size_t size() const {
+	return image.header().nentries;
+    }
+
+    bool empty() const {
+	return size() == 0;
+    }
+
+private:
+    static const IndexT null_index = static_cast<IndexT>(~static_cast<IndexT>(0));
+
+    template<class K> const D *internalLookup(const K &key) const {
+	if (nbuckets == 0) {
+	    return NULL;
+	}
+	uint32_t hash = static_cast<uint32_t>(hashfn(key)) % nbuckets;
+	for(IndexT i = entry_points[hash]; i != null_index; i = chains[i].next) {
+	    if (equal(key, chains[i].data)) {
+		return &chains[i].data;
+	    }
+	}
+	return NULL;
+    }
+
+    MappedHashTableImage image;
+    const hte *chains;
+    const IndexT *entry_points;
+    size_t nbuckets;
+    HashFn hashfn;
+    Equal equal;
+};
+
+/// \brief Read-only HashMap mapped from a file written by HashMap::save
+///
+/// See MappedHashTable for the requirements; K and V have to be
+/// trivially copyable, and the map has to have used the default
+/// chained backend.
+template <class K, class V,
+          class KHash = HashMap_hash<const K>,
+          class KEqual = std::equal_to<const K> >
+class MappedHashMap : boost::noncopyable {
+public:
+    typedef HashMap<K, V, KHash, KEqual> HashMapT;
+    typedef typename HashMapT::value_type value_type;
+
+    explicit MappedHashMap(const std::string &path) : table(path) { }
+
+    const V *lookup(const K &k) const {
+	return internalLookup(k);
+    }
+
+    template<class K2> typename HashTable_otherKey<K2, K, const V *>::type
+    lookup(const K2 &k) const {
+	return internalLookup(k);
+    }
+
+    bool exists(const K &k) const {
+	return lookup(k) != NULL;
+    }
+
+    size_t size() const {
+	return table.size();
+    }
+
+    bool empty() const {
+	return table.empty();
+    }
+
+private:
+    template<class K2> const V *internalLookup(const K2 &k) const {
+	const value_type *v = table.lookup(k);
+	return v == NULL ? NULL : &v->second;
+    }
+
+    MappedHashTable<value_type, typename HashMapT::value_typeHash,
+		    typename HashMapT::value_typeEqual> table;
+};
+
+#endif
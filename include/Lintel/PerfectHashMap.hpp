@@ -0,0 +1,359 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for PerfectHashMap class
+*/
+
+#ifndef LINTEL_PERFECT_HASHMAP_HPP
+#define LINTEL_PERFECT_HASHMAP_HPP
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/CompilerMarkup.hpp>
+#include <Lintel/HashFns.hpp>
+
+/// \brief A map over a fixed set of keys using a minimal perfect hash
+///
+/// For key sets that are known up front and then only looked up, such
+/// as vocabularies or column names.  The keys are split into buckets
+/// of about six by their 64 bit hash, and each bucket gets a 16 bit
+/// pilot that moves its keys to free slots of a table a bit larger
+/// than the number of keys; the few slots past the end are remapped
+/// into the holes.  This is the PTHash variant of CHD.  The entries
+/// are stored densely in the order of their slots, so the map costs
+/// the entries plus about 3 bits per key, and a lookup reads the
+/// pilot and then the entry, usually two cache lines.
+///
+/// Keys are hashed with KHash, which returns a 64 bit hash, by default
+/// lintel::Hash64.  The few keys that share a 64 bit hash with another
+/// key can't be told apart by any pilot; they are stored after the
+/// others and searched linearly when a lookup misses.  The values can
+/// be changed, the keys can't.  Building is slow, around a
+/// microsecond per key, and takes about 20 bytes per key on top of the
+/// copy of the entries.
+///
+/// lookup(), indexOf() and exists() also accept a key of another type
+/// K2 when KHash and KEqual do, as for HashMap.
+template <class K, class V,
+	  class KHash = lintel::Hash64<K>,
+	  class KEqual = std::equal_to<const K> >
+class PerfectHashMap {
+public:
+    typedef std::pair<K, V> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    PerfectHashMap() {
+	build(std::vector<value_type>());
+    }
+
+    /// Copy the entries of from, which can be a HashMap, a std::map,
+    /// a vector of pairs, or anything else with begin(), end() and
+    /// value_type pair<K, V>; its keys have to be distinct.
+    template<class Map> explicit PerfectHashMap(const Map &from) {
+	build(std::vector<value_type>(from.begin(), from.end()));
+    }
+
+    /// Map the distinct keys to default constructed values.
+    explicit PerfectHashMap(const std::vector<K> &keys) {
+	std::vector<value_type> from;
+	from.reserve(keys.size());
+	for(size_t i = 0; i < keys.size(); ++i) {
+	    from.push_back(value_type(keys[i], V()));
+	}
+	build(from);
+    }
+
+    /// The position of the entry for k in [begin(), end()), or size()
+    /// if k is not present.  Positions run from 0 to size() - 1, so
+    /// they can index a separate array of values.
+    template<class K2> size_t indexOf(const K2 &k) const {
+	if (entries.empty()) {
+	    return 0;
+	}
+	uint64_t h = keyHash(k);
+	uint32_t pos = slotOf(h, pilots[bucketOf(h)]);
+	if (UNLIKELY(pos >= nplaced)) {
+	    pos = remap[pos - nplaced];
+	}
+	if (LIKELY(kequal(k, entries[pos].first))) {
+	    return pos;
+	}
+	for(size_t i = nplaced; i < entries.size(); ++i) {
+	    if (kequal(k, entries[i].first)) {
+		return i;
+	    }
+	}
+	return entries.size();
+    }
+
+    template<class K2> V *lookup(const K2 &k) {
+	size_t i = indexOf(k);
+	return i == entries.size() ? NULL : &entries[i].second;
+    }
+
+    template<class K2> const V *lookup(const K2 &k) const {
+	size_t i = indexOf(k);
+	return i == entries.size() ? NULL : &entries[i].second;
+    }
+
+    template<class K2> bool exists(const K2 &k) const {
+	return indexOf(k) != entries.size();
+    }
+
+    size_t size() const {
+	return entries.size();
+    }
+
+    bool empty() const {
+	return entries.empty();
+    }
+
+    iterator begin() {
+	return entries.begin();
+    }
+
+    iterator end() {
+	return entries.end();
+    }
+
+    const_iterator begin() const {
+	return entries.begin();
+    }
+
+    const_iterator end() const {
+	return entries.end();
+    }
+
+    size_t memoryUsage() const {
+	return sizeof(value_type) * entries.capacity() + sizeof(uint16_t) * pilots.capacity()
+	    + sizeof(uint32_t) * remap.capacity();
+    }
+
+    /// Bits per key used beyond the entries themselves
+    double overheadBitsPerKey() const {
+	return entries.empty() ? 0
+	    : 8.0 * (sizeof(uint16_t) * pilots.size() + sizeof(uint32_t) * remap.size())
+	    / entries.size();
+    }
+
+private:
+    static const uint32_t keys_per_bucket = 6;
+    static const uint32_t max_pilot = 0xFFFF;
+    static const unsigned max_seeds = 16;
+    // 60% of the keys go to the first 30% of the buckets, so the big
+    // buckets are placed while the table is still empty.
+    static const uint64_t dense_split = 2576980377ULL; // 0.6 * 2^32
+
+    static uint64_t mulHigh(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+	return static_cast<uint64_t>((static_cast<__uint128_t>(a) * b) >> 64);
+#else
+	uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+	uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+	uint64_t cross = ((a_lo * b_lo) >> 32) + ((a_hi * b_lo) & 0xFFFFFFFF) + a_lo * b_hi;
+	return a_hi * b_hi + ((a_hi * b_lo) >> 32) + (cross >> 32);
+#endif
+    }
+
+    template<class K2> uint64_t keyHash(const K2 &k) const {
+	return lintel::mix64(static_cast<uint64_t>(khash(k)) ^ seed);
+    }
+
+    uint32_t bucketOf(uint64_t h) const {
+	uint64_t top = h >> 32;
+	if (top < dense_split) {
+	    return static_cast<uint32_t>((top * dense_mul) >> 32);
+	} else {
+	    return dense_buckets + static_cast<uint32_t>(((top - dense_split) * sparse_mul) >> 32);
+	}
+    }
+
+    // keys in one bucket share the top bits of h, the multiply mixes
+    // the low bits up before the top ones pick the slot.
+    uint32_t slotOf(uint64_t h, uint16_t pilot) const {
+	return static_cast<uint32_t>
+	    (mulHigh((h ^ lintel::mix64(pilot + 1)) * 0x9e3779b97f4a7c15ULL, nslots));
+    }
+
+    void setSizes(size_t nkeys) {
+	uint32_t nbuckets = std::max<size_t>(2, (nkeys + keys_per_bucket - 1) / keys_per_bucket);
+	dense_buckets = std::max<uint32_t>(1, nbuckets * 3 / 10);
+	dense_mul = (static_cast<uint64_t>(dense_buckets) << 32) / dense_split;
+	sparse_mul = (static_cast<uint64_t>(nbuckets - dense_buckets) << 32)
+	    / ((1ULL << 32) - dense_split);
+	pilots.assign(nbuckets, 0);
+    }
+
+    void build(const std::vector<value_type> &from) {
+	INVARIANT(from.size() < (1U << 31), "PerfectHashMap is limited to 2^31 keys");
+	std::vector<uint32_t> placed, unplaced;
+	for(unsigned attempt = 0; ; ++attempt) {
+	    INVARIANT(attempt < max_seeds, "PerfectHashMap could not place the keys");
+	    seed = lintel::mix64(attempt + 0x5851f42d4c957f2dULL);
+	    if (place(from, placed, unplaced)) {
+		break;
+	    }
+	}
+	entries.clear();
+	entries.reserve(from.size());
+	for(size_t i = 0; i < placed.size(); ++i) {
+	    entries.push_back(from[placed[i]]);
+	}
+	for(size_t i = 0; i < unplaced.size(); ++i) {
+	    entries.push_back(from[unplaced[i]]);
+	}
+    }
+
+    // Pick the pilots; on success placed[i] is the index in from of
+    // the key in slot i and unplaced has the keys sharing a hash with
+    // an earlier one.  Fails if some bucket fits with no pilot.
+    bool place(const std::vector<value_type> &from, std::vector<uint32_t> &placed,
+	       std::vector<uint32_t> &unplaced) {
+	size_t n = from.size();
+	setSizes(n);
+	uint32_t nbuckets = static_cast<uint32_t>(pilots.size());
+
+	// group the keys by bucket
+	std::vector<uint64_t> hashes(n);
+	std::vector<uint32_t> bucket_start(nbuckets + 1, 0);
+	for(size_t i = 0; i < n; ++i) {
+	    hashes[i] = keyHash(from[i].first);
+	    ++bucket_start[bucketOf(hashes[i]) + 1];
+	}
+	for(uint32_t b = 0; b < nbuckets; ++b) {
+	    bucket_start[b + 1] += bucket_start[b];
+	}
+	std::vector<uint32_t> by_bucket(n);
+	{
+	    std::vector<uint32_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+	    for(size_t i = 0; i < n; ++i) {
+		by_bucket[fill[bucketOf(hashes[i])]++] = i;
+	    }
+	}
+
+	// pull out the keys whose hash matches an earlier key's
+	unplaced.clear();
+	std::vector<uint32_t> bucket_size(nbuckets);
+	uint32_t max_size = 0;
+	for(uint32_t b = 0; b < nbuckets; ++b) {
+	    uint32_t end = bucket_start[b];
+	    for(uint32_t i = bucket_start[b]; i < bucket_start[b + 1]; ++i) {
+		uint32_t k = by_bucket[i];
+		bool dup = false;
+		for(uint32_t j = bucket_start[b]; j < end && !dup; ++j) {
+		    if (hashes[by_bucket[j]] == hashes[k]) {
+			INVARIANT(!kequal(from[k].first, from[by_bucket[j]].first),
+				  "PerfectHashMap built from duplicate keys");
+			dup = true;
+		    }
+		}
+		if (dup) {
+		    unplaced.push_back(k);
+		} else {
+		    by_bucket[end++] = k;
+		}
+	    }
+	    bucket_size[b] = end - bucket_start[b];
+	    max_size = std::max(max_size, bucket_size[b]);
+	}
+	nslots = (n - unplaced.size()) + (n - unplaced.size()) / 64 + 1;
+
+	// biggest buckets first
+	std::vector<uint32_t> order(nbuckets);
+	{
+	    std::vector<uint32_t> size_start(max_size + 2, 0);
+	    for(uint32_t b = 0; b < nbuckets; ++b) {
+		++size_start[max_size - bucket_size[b] + 1];
+	    }
+	    for(uint32_t s = 0; s <= max_size; ++s) {
+		size_start[s + 1] += size_start[s];
+	    }
+	    for(uint32_t b = 0; b < nbuckets; ++b) {
+		order[size_start[max_size - bucket_size[b]]++] = b;
+	    }
+	}
+
+	std::vector<uint64_t> pilot_hash(max_pilot + 1);
+	for(uint32_t p = 0; p <= max_pilot; ++p) {
+	    pilot_hash[p] = lintel::mix64(p + 1);
+	}
+	std::vector<uint64_t> taken((nslots + 63) / 64, 0);
+	std::vector<uint32_t> owner(nslots);
+	std::vector<uint32_t> slots(max_size);
+	for(uint32_t i = 0; i < nbuckets && bucket_size[order[i]] > 0; ++i) {
+	    uint32_t b = order[i];
+	    const uint32_t *keys = &by_bucket[bucket_start[b]];
+	    uint32_t size = bucket_size[b];
+	    uint32_t pilot = 0;
+	    for(; pilot <= max_pilot; ++pilot) {
+		uint32_t j = 0;
+		for(; j < size; ++j) {
+		    uint32_t s = static_cast<uint32_t>
+			(mulHigh((hashes[keys[j]] ^ pilot_hash[pilot]) * 0x9e3779b97f4a7c15ULL,
+				 nslots));
+		    if ((taken[s / 64] >> (s % 64)) & 1) {
+			break;
+		    }
+		    if (std::find(&slots[0], &slots[0] + j, s) != &slots[0] + j) {
+			break;
+		    }
+		    slots[j] = s;
+		}
+		if (j == size) {
+		    break;
+		}
+	    }
+	    if (pilot > max_pilot) {
+		return false;
+	    }
+	    pilots[b] = pilot;
+	    for(uint32_t j = 0; j < size; ++j) {
+		taken[slots[j] / 64] |= 1ULL << (slots[j] % 64);
+		owner[slots[j]] = keys[j];
+	    }
+	}
+
+	// move the keys in the slots past the end into the holes
+	nplaced = n - unplaced.size();
+	remap.assign(nslots - nplaced, 0);
+	placed.resize(nplaced);
+	uint32_t hole = 0;
+	for(uint32_t s = 0; s < nslots; ++s) {
+	    if (((taken[s / 64] >> (s % 64)) & 1) == 0) {
+		continue;
+	    }
+	    if (s < nplaced) {
+		placed[s] = owner[s];
+	    } else {
+		while ((taken[hole / 64] >> (hole % 64)) & 1) {
+		    ++hole;
+		}
+		SINVARIANT(hole < nplaced);
+		remap[s - nplaced] = hole;
+		placed[hole] = owner[s];
+		++hole;
+	    }
+	}
+	return true;
+    }
+
+    std::vector<value_type> entries;
+    std::vector<uint16_t> pilots;
+    std::vector<uint32_t> remap;
+    uint64_t seed, dense_mul, sparse_mul;
+    uint32_t dense_buckets, nslots, nplaced;
+    KHash khash;
+    KEqual kequal;
+};
+
+#endif
@@ -14,6 +14,7 @@
 
 #include <stdint.h>
 
+#include <boost/static_assert.hpp>
 #include <boost/utility.hpp>
 
 #include <Lintel/AssertBoost.hpp>
@@ -48,24 +49,32 @@
 /// 
 /// The net effect of the above will be to return the data from smallest
 /// key value to largest key value from the priority queue.
-template<class T, class LessImportant = std::less_equal<T> > 
+///
+/// Arity is the number of children of each entry.  A 4 or 8 way heap
+/// is shallower, and keeps the children of an entry in one cache line,
+/// which helps large queues of small values; it does more comparisons
+/// per level, which hurts when they are expensive.  priority_queue_speed
+/// compares the choices, and SequenceHeap, on a given workload.
+template<class T, class LessImportant = std::less_equal<T>, unsigned Arity = 2>
 class PriorityQueue : boost::noncopyable {
 public:
+    BOOST_STATIC_ASSERT(Arity >= 2);
+
     PriorityQueue(int initial_size = 1024/sizeof(T)) 
-	: size_available(initial_size), pq_size(0) {
-	pq = new T[initial_size];
+	: size_available(0), pq_size(0), storage(NULL), pq(NULL) {
+	allocate(initial_size);
     }
 
     PriorityQueue(const LessImportant &li, int initial_size = 1024/sizeof(T)) 
-	: lessimportant(li), size_available(initial_size), pq_size(0) {
-	pq = new T[initial_size];
+	: lessimportant(li), size_available(0), pq_size(0), storage(NULL), pq(NULL) {
+	allocate(initial_size);
     }
 
     ~PriorityQueue() {
-	delete [] pq;
-	pq = NULL;
+	delete [] storage;
+	storage = pq = NULL;
     }
-    typedef PriorityQueue<T, LessImportant> mytype;
+    typedef PriorityQueue<T, LessImportant, Arity> mytype;
 
     T &top() { DEBUG_SINVARIANT(!empty()); return pq[0]; }
     const T &top() const { DEBUG_SINVARIANT(!empty()); return pq[0]; }
@@ -76,18 +85,11 @@ public:
 	if (pq_size > 0) {
 	    uint32_t cur_pos = 0;
 	    while(1) {
-		uint32_t down_left = 2*cur_pos + 1;
-		if (down_left >= pq_size)
+		uint32_t smaller_down = mostImportantChild(cur_pos);
+		if (smaller_down >= pq_size)
 		    break;
-		uint32_t down_right = down_left + 1;
-		
-		uint32_t smaller_down = down_left;
-		if (down_right < pq_size &&
-		    !lessimportant(pq[down_right],pq[down_left])) {
-		    smaller_down = down_right;
-		}
 		if (!lessimportant(pq[pq_size],pq[smaller_down])) {
-		    break; // done, down moving value less than both children
+		    break; // done, down moving value less than all children
 		}
 		pq[cur_pos] = pq[smaller_down];
 		cur_pos = smaller_down;
@@ -103,32 +105,27 @@ public:
     // implementation is slower than the one above, and the one they have.  Some
     // possibilities: 1) it's the 2*n + 1 calculation and we should index the
     // priority queue starting at 1.  2) It's the extra size check on the way
-    // down.
+    // down.  SequenceHeap is the rest of the second paper.
     void pop_bottom_up_heuristic() {
 	DEBUG_SINVARIANT(pq_size > 0);
 	uint32_t hole = 0;
-	uint32_t down = 1;
+	uint32_t down = mostImportantChild(0);
 
 	while(down < pq_size) {
-	    if (down + 1 == pq_size || lessimportant(pq[down+1], pq[down])) { 
-		// one child, or rhs < lhs, so pick lhs
-	    } else { // rhs bubbles up
-		++down;
-	    } 
 	    pq[hole] = pq[down];
 	    hole = down; 
-	    down = 2*down + 1;
+	    down = mostImportantChild(hole);
 	}
 
 	T &back(pq[pq_size - 1]);
 	if (hole > 0) {
 	    SINVARIANT(lessimportant(back, back)); // make sure loop below will terminate
 
-	    uint32_t up = (hole - 1) / 2;
+	    uint32_t up = (hole - 1) / Arity;
 	    while (!lessimportant(back, pq[up])) { // back more important, move hole up
 		pq[hole] = pq[up];
 		hole = up;
-		up = (hole - 1) / 2;
+		up = (hole - 1) / Arity;
 	    }
 	}
 
@@ -140,9 +137,9 @@ public:
 	if (pq_size == size_available) {
 	    double_size();
 	}
-	int end_pos = pq_size;
+	uint32_t end_pos = pq_size;
 	while(end_pos > 0) {
-	    int up_pos = (end_pos - 1)/2;
+	    uint32_t up_pos = (end_pos - 1)/Arity;
 	    if (!lessimportant(val,pq[up_pos])) {
 		pq[end_pos] = pq[up_pos];
 		end_pos = up_pos;
@@ -159,16 +156,10 @@ public:
     void replaceTop(const T &val) {
 	uint32_t cur_pos = 0;
 	while(1) {
-	    uint32_t down_left = 2*cur_pos + 1;
-	    if (down_left >= pq_size)
+	    // First decide which child we would swap with
+	    uint32_t more_important_down = mostImportantChild(cur_pos);
+	    if (more_important_down >= pq_size)
 		break;
-	    uint32_t down_right = down_left + 1;
-
-	    // First decide which side we would swap with
-	    uint32_t more_important_down = down_left;
-	    if (down_right < pq_size && lessimportant(pq[down_left], pq[down_right])) {
-		more_important_down = down_right;
-	    }
 	    if (lessimportant(val, pq[more_important_down])) {
 		pq[cur_pos] = pq[more_important_down];
 		cur_pos = more_important_down;
@@ -196,20 +187,17 @@ public:
 	INVARIANT(empty(), "Lame implementation only able to reserve empty priority queue");
 		  
 	if (amt > pq_size) {
-	    delete [] pq;
-	    pq = new T[amt];
-	    size_available = amt;
+	    delete [] storage;
+	    storage = pq = NULL;
+	    allocate(amt);
 	}
     }
 	
     void selfVerify() {
-	for(uint32_t i = 0; i < pq_size; ++i) {
-	    uint32_t down_left = 2 * i + 1;
-	    if (down_left >= pq_size) break;
-	    SINVARIANT(!lessimportant(pq[i], pq[down_left]));
-	    uint32_t down_right = down_left + 1;
-	    if (down_right >= pq_size) break;
-	    SINVARIANT(!lessimportant(pq[i], pq[down_right]));
+	for(uint32_t i = 1; i < pq_size; ++i) {
+	    const T &up(pq[(i - 1) / Arity]);
+	    // equal values are fine
+	    SINVARIANT(!lessimportant(up, pq[i]) || lessimportant(pq[i], up));
 	}
     }
 
@@ -218,18 +206,53 @@ public:
     T *PQ_End() { return pq + pq_size; }
 private:
     LessImportant lessimportant;
+
+    // the children of i are Arity * i + 1 .. Arity * i + Arity; pq[0]
+    // is placed Arity - 1 entries into a cache line, so that all of
+    // the children of an entry start on a multiple of Arity from the
+    // start of the line, and fit in one line if Arity * sizeof(T) <= 64.
+    void allocate(uint32_t amt) {
+	static const size_t line_entries = (64 % sizeof(T)) == 0 ? 64 / sizeof(T) : 1;
+	if (amt == 0) {
+	    amt = Arity;
+	}
+	storage = new T[amt + Arity - 1 + line_entries - 1];
+	size_t misalign = (64 - reinterpret_cast<size_t>(storage) % 64) % 64;
+	size_t skip = misalign % sizeof(T) == 0 ? (misalign / sizeof(T)) % line_entries : 0;
+	pq = storage + skip + Arity - 1;
+	size_available = amt;
+    }
+
+    // returns pq_size if i has no children
+    uint32_t mostImportantChild(uint32_t i) {
+	uint32_t first = Arity * i + 1;
+	if (first >= pq_size) {
+	    return pq_size;
+	}
+	uint32_t last = first + Arity < pq_size ? first + Arity : pq_size;
+	uint32_t ret = first;
+	for(uint32_t j = first + 1; j < last; ++j) {
+	    if (!lessimportant(pq[j], pq[ret])) {
+		ret = j;
+	    }
+	}
+	return ret;
+    }
+
     void double_size() {
-	T *pq_new = new T[size_available * 2];
-	for(unsigned i=0;i<size_available;i++) {
-	    pq_new[i] = pq[i];
+	T *old_storage = storage, *old_pq = pq;
+	uint32_t old_size = size_available;
+	allocate(size_available * 2);
+	for(unsigned i=0;i<old_size;i++) {
+	    pq[i] = old_pq[i];
 	}
-	delete [] pq;
-	pq = pq_new;
-	size_available = size_available * 2;
+	delete [] old_storage;
     }
     uint32_t size_available;
     uint32_t pq_size;
+    T *storage;
     T *pq;
+    // for Arity = 2:
     // 0 -> 1,2
     // 1 -> 3,4
     // 2 -> 5,6
@@ -0,0 +1,142 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for RadixHeap class
+*/
+
+#ifndef LINTEL_RADIX_HEAP_HPP
+#define LINTEL_RADIX_HEAP_HPP
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <boost/static_assert.hpp>
+#include <boost/utility.hpp>
+
+#include <Lintel/AssertBoost.hpp>
+
+/// \brief Monotone priority queue over unsigned integer keys
+///
+/// For queues where the keys pushed are never less than the last key
+/// popped, as with event times in Clock::Tfrac or cycle counts; top()
+/// is the value with the smallest key.  Bucket i > 0 holds the values
+/// whose key first differs from the last key popped in bit i - 1, and
+/// bucket 0 those whose key equals it.  Popping takes from bucket 0;
+/// when that runs out, the lowest non-empty bucket is spread over the
+/// buckets below it, so each value moves at most once per bit of Key,
+/// and no comparisons between values are made.  Values with the same
+/// key come out in no particular order.
+template<class Key, class Value>
+class RadixHeap : boost::noncopyable {
+public:
+    BOOST_STATIC_ASSERT(std::numeric_limits<Key>::is_integer
+			&& !std::numeric_limits<Key>::is_signed);
+
+    typedef std::pair<Key, Value> value_type;
+
+    RadixHeap() : last(0), nvalues(0), cached_top(NULL) { }
+
+    /// key has to be at least the key of the last value popped
+    void push(Key key, const Value &val) {
+	INVARIANT(key >= last, "RadixHeap keys have to be at least the last key popped");
+	buckets[bucketFor(key)].push_back(value_type(key, val));
+	++nvalues;
+	cached_top = NULL;
+    }
+
+    const value_type &top() const {
+	DEBUG_SINVARIANT(!empty());
+	if (!buckets[0].empty()) {
+	    return buckets[0].back();
+	}
+	if (cached_top == NULL) {
+	    cached_top = &minOf(buckets[lowestBucket()]);
+	}
+	return *cached_top;
+    }
+
+    void pop() {
+	DEBUG_SINVARIANT(!empty());
+	if (buckets[0].empty()) {
+	    pull();
+	}
+	buckets[0].pop_back();
+	--nvalues;
+    }
+
+    size_t size() const {
+	return nvalues;
+    }
+
+    bool empty() const {
+	return nvalues == 0;
+    }
+
+    /// Remove all of the values; any key can be pushed afterwards.
+    void clear() {
+	for(unsigned i = 0; i < nbuckets; ++i) {
+	    buckets[i].clear();
+	}
+	last = 0;
+	nvalues = 0;
+	cached_top = NULL;
+    }
+
+private:
+    static const unsigned nbuckets = std::numeric_limits<Key>::digits + 1;
+
+    unsigned bucketFor(Key key) const {
+	Key diff = key ^ last;
+	return diff == 0 ? 0 : 64 - __builtin_clzll(static_cast<unsigned long long>(diff));
+    }
+
+    unsigned lowestBucket() const {
+	unsigned i = 1;
+	while (buckets[i].empty()) {
+	    ++i;
+	    DEBUG_SINVARIANT(i < nbuckets);
+	}
+	return i;
+    }
+
+    static const value_type &minOf(const std::vector<value_type> &bucket) {
+	const value_type *ret = &bucket[0];
+	for(size_t j = 1; j < bucket.size(); ++j) {
+	    if (bucket[j].first < ret->first) {
+		ret = &bucket[j];
+	    }
+	}
+	return *ret;
+    }
+
+    // All of bucket 0 has been popped; make the smallest remaining key
+    // the last one, which moves the lowest non-empty bucket down.  This
+    // waits for pop(), since keys down to the last one popped can still
+    // be pushed until then.
+    void pull() {
+	unsigned i = lowestBucket();
+	std::vector<value_type> &from(buckets[i]);
+	last = (cached_top != NULL ? *cached_top : minOf(from)).first;
+	cached_top = NULL;
+	for(size_t j = 0; j < from.size(); ++j) {
+	    unsigned to = bucketFor(from[j].first);
+	    DEBUG_SINVARIANT(to < i);
+	    buckets[to].push_back(from[j]);
+	}
+	from.clear();
+    }
+
+    std::vector<value_type> buckets[nbuckets];
+    Key last;
+    size_t nvalues;
+    // the smallest value, once found by top() while bucket 0 is empty
+    mutable const value_type *cached_top;
+};
+
+#endif
@@ -12,34 +12,39 @@
 #ifndef LINTEL_ROTATING_HASHMAP_HPP
 #define LINTEL_ROTATING_HASHMAP_HPP
 
+#include <vector>
+
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 
+#include <Lintel/Clock.hpp>
 #include <Lintel/HashMap.hpp>
 
-// TODO: may be worth making the number of tables we keep a parameter,
-// rationale is the following: Imagine you have a stream of data with
-// time and some value; You want to rotate the stored data such that
-// all values would be in the table for x seconds.  With two tables,
-// you have to rotate every x seconds, at a cost of 2x memory.  If you
-// kept 3 tables, you could rotate every x/2 seconds, because then
-// even a value evicted from the first table immediately would site in
-// the next to for a total of x seconds, at a cost of 3/2 x memory.
-// Further tables get diminishing returns, 4 tables gets you to 4/3 x,
-// and so on, and they have a linear increase in the number of tables
-// that the functions have to search through.  A pity we haven't
-// opened up the implementation a little more so we could (for
-// example) only calculate the hash once.
-
 /// \brief A rotating hash map
 ///
 /// A rotating hash map.  The idea is that we want to store hash
 /// entries and from time to time, flush the table of "old" values.
-/// The clever optimization is to have two hash tables, and from time
-/// to time, rotate the tables, deleting the old one.  If we get an
-/// access to the old table, we move it to the recent one.
-/// Eventually, we can have built-in rules for when to rotate can be
-/// added, but for now just provide the help.
+/// The clever optimization is to have several hash tables, or
+/// generations, and from time to time, rotate the tables, deleting
+/// the oldest one.  If we get an access to an older table, we move it
+/// to the recent one.  The key is hashed once and the same hash is
+/// used to probe every generation.
+///
+/// The number of generations trades memory for lookup cost.  Imagine
+/// a stream of data with time and some value, where each value has to
+/// stay in the map for x seconds after it was last used.  With two
+/// tables, you have to rotate every x seconds, and hold up to 2x
+/// seconds of values.  With K tables, a value untouched since it went
+/// into the recent table is dropped by the K'th rotation after, so
+/// rotating every x/(K-1) seconds keeps it for at least x seconds and
+/// holds up to K/(K-1) x seconds of values; 3 tables gets you to 3/2
+/// x, 4 to 4/3 x, and so on.  A miss probes all K tables.
+/// setRotateInterval() and maybeRotate() implement that policy.
+///
+/// Dropping the oldest table frees all of its entries, which can take
+/// a while for a big table.  setBackgroundRunner() hands the table and
+/// the RotateFn to, for example, a BackgroundTasks thread, so that the
+/// rotation returns right away.
 template <class K, class V,
 	  class KHash = HashMap_hash<const K>,
 	  class KEqual = std::equal_to<const K> >
@@ -50,40 +55,37 @@ public:
     // the rotating hash-map.
     typedef boost::function<void (const K &, V &)> RotateFn;
     typedef HashMap<K,V,KHash,KEqual> HashMapT;
+    typedef boost::function<void ()> Task;
+    typedef boost::function<void (const Task &)> TaskRunner;
 
-    RotatingHashMap() {
-	table_recent = new HashMapT; // HashMap<K,V>;
-	table_old = new HashMapT; // HashMap<K,V>;
+    explicit RotatingHashMap(size_t ngenerations = 2)
+	: rotate_interval(0), last_rotate(0), rotate_started(false) {
+	SINVARIANT(ngenerations >= 2);
+	tables.reserve(ngenerations);
+	for(size_t i = 0; i < ngenerations; ++i) {
+	    tables.push_back(new HashMapT);
+	}
     }
 
     ~RotatingHashMap() {
-	delete table_recent;
-	delete table_old;
+	for(size_t i = 0; i < tables.size(); ++i) {
+	    delete tables[i];
+	}
     }
 
     V *lookup(const K &k) {
-	V *ret = table_recent->lookup(k);
-	if (ret == NULL) {
-	    ret = table_old->lookup(k);
-	    if (ret != NULL) {
-		V &tmp = (*table_recent)[k] = *ret;
-		table_old->remove(k);
-		ret = &tmp;
-	    }
-	} else {
-	    DEBUG_SINVARIANT(table_old->lookup(k) == NULL);
-	}
-	return ret;
+	return lookupWithHash(k, tables[0]->hashOf(k));
     }
 
     /// Returns the value associated with the key, if it
     /// exists. Otherwise, creates an entry initialized with the
-    /// default value. If it exists in the old hashmap, it moves the
+    /// default value. If it exists in an older hashmap, it moves the
     /// key-value pair to the recent hashmap.
     V &operator[](const K &k) {
-	V *v = lookup(k);
+	uint32_t hash = tables[0]->hashOf(k);
+	V *v = lookupWithHash(k, hash);
 	if (v == NULL) {
-	    return (*table_recent)[k];
+	    return *tables[0]->addWithHash(k, V(), hash);
 	} else {
 	    return *v;
 	}
@@ -99,95 +101,228 @@ public:
     /// Check to see whether a particular value exists in the rotating
     /// hash map.  This version does not count as an access, so does
     /// not promote an old value to the recent table.
-    bool existsNoPromote(const K &k) {
-	V *ret = table_recent->lookup(k);
-	if (ret != NULL) return true;
-	return table_old->lookup(k) != NULL;
+    bool existsNoPromote(const K &k) const {
+	uint32_t hash = tables[0]->hashOf(k);
+	for(size_t i = 0; i < tables.size(); ++i) {
+	    if (tables[i]->lookupWithHash(k, hash) != NULL) {
+		return true;
+	    }
+	}
+	return false;
     }
 
     /** returns true if something was removed */
     bool remove(const K &k, bool must_exist = true) {
-	bool exists_recent = table_recent->remove(k, false);
-	bool exists_old = table_old->remove(k, false);
-	DEBUG_SINVARIANT(!exists_recent || !exists_old);
- 	SINVARIANT(!must_exist || exists_recent || exists_old);
-	return exists_recent || exists_old;
+	uint32_t hash = tables[0]->hashOf(k);
+	bool removed = false;
+	for(size_t i = 0; i < tables.size(); ++i) {
+	    if (tables[i]->removeWithHash(k, hash, false)) {
+		DEBUG_SINVARIANT(!removed);
+		removed = true;
+	    }
+	}
+	SINVARIANT(!must_exist || removed);
+	return removed;
     }
 
+    /// Delete the oldest table and start a new recent one.
     void rotate() {
-	delete table_old;
-	table_old = table_recent;
-	table_recent = new HashMapT; // HashMap<K,V>();
+	dropTable(rotateDetach(), RotateFn());
     }
 
     /** use like rotate(boost::bind(test_fn, _1, _2)); with test_fn
 	taking K,V parameters, or rotate(boost::bind(&Class::fn, this,
-	_1, _2)); for a class function.
+	_1, _2)); for a class function.  fn is called on the entries
+	of the oldest table, which are the ones being dropped.
 	Note, it is not safe to access the RotatingHashMap that is being
-	rotated in the bound function.
+	rotated in the bound function.  With a background runner, fn
+	is called on the runner's thread after rotate returns.
      */
     void rotate(const RotateFn fn) {
-	for(hm_iterator i = table_old->begin();
-	    i != table_old->end(); ++i) {
-		fn(i->first, i->second);
-	    }
-	rotate();
+	dropTable(rotateDetach(), fn);
+    }
+
+    /// Start a new recent table, and return the oldest one rather
+    /// than deleting it; the caller then owns it.
+    HashMapT *rotateDetach() {
+	HashMapT *ret = tables.back();
+	tables.pop_back();
+	tables.insert(tables.begin(), new HashMapT);
+	return ret;
+    }
+
+    /// Once set, rotations call runner with a task that calls the
+    /// RotateFn on the dropped entries and deletes them, rather than
+    /// doing that before returning.  Use like
+    /// setBackgroundRunner(boost::bind(&BackgroundTasks::add, &tasks, _1)).
+    /// The tasks only touch the dropped table, so they can run on
+    /// another thread.  An empty runner goes back to dropping in the
+    /// caller.
+    void setBackgroundRunner(const TaskRunner &runner) {
+	background_runner = runner;
     }
     
     /*** rotate enough times so that the hash map is empty */
     void flushRotate() {
-	rotate();
-	rotate();
+	for(size_t i = 0; i < tables.size(); ++i) {
+	    rotate();
+	}
     }
 
     /*** rotate enough times so that the hash map is empty */
     void flushRotate(const RotateFn fn) {
-	rotate(fn);
-	rotate(fn);
+	for(size_t i = 0; i < tables.size(); ++i) {
+	    rotate(fn);
+	}
     }
 
-    void walk(const RotateFn fn) {
-	for(hm_iterator i = table_recent->begin(); i != table_recent->end(); ++i) {
-	    fn(i->first, i->second);
+    /// Set the interval for maybeRotate(); to keep entries for at
+    /// least x after their last use, use x / (ngenerations() - 1).
+    void setRotateInterval(Clock::Tfrac interval) {
+	SINVARIANT(interval > 0);
+	rotate_interval = interval;
+    }
+
+    /// Rotate once for each full rotate interval that has passed
+    /// since the last rotation, up to ngenerations() times, since
+    /// after that the map is empty.  The first call just records now
+    /// as the start of the first interval.  Returns true if it
+    /// rotated.  Call it with the time of each piece of data in a
+    /// stream, or the current time for a cache.
+    bool maybeRotate(Clock::Tfrac now) {
+	return maybeRotate(now, RotateFn());
+    }
+
+    /// Same as maybeRotate(now), calling fn on each of the dropped
+    /// entries as rotate(fn) does.
+    bool maybeRotate(Clock::Tfrac now, const RotateFn fn) {
+	INVARIANT(rotate_interval > 0, "setRotateInterval() has not been called");
+	if (!rotate_started) {
+	    rotate_started = true;
+	    last_rotate = now;
+	    return false;
 	}
-	for(hm_iterator i = table_old->begin(); i != table_old->end(); ++i) {
-	    fn(i->first, i->second);
+	if (now < last_rotate || now - last_rotate < rotate_interval) {
+	    return false;
 	}
+	Clock::Tfrac nintervals = (now - last_rotate) / rotate_interval;
+	last_rotate += nintervals * rotate_interval;
+	if (nintervals > tables.size()) {
+	    nintervals = tables.size();
+	}
+	for(Clock::Tfrac i = 0; i < nintervals; ++i) {
+	    rotate(fn);
+	}
+	return true;
     }
 
-    size_t size_recent() {
-	return table_recent->size();
+    void walk(const RotateFn fn) {
+	for(size_t j = 0; j < tables.size(); ++j) {
+	    for(hm_iterator i = tables[j]->begin(); i != tables[j]->end(); ++i) {
+		fn(i->first, i->second);
+	    }
+	}
+    }
+
+    size_t ngenerations() const {
+	return tables.size();
     }
 
-    size_t size_old() {
-	return table_old->size();
+    size_t size_recent() const {
+	return tables[0]->size();
+    }
+
+    /// Number of entries in all of the tables but the recent one
+    size_t size_old() const {
+	size_t ret = 0;
+	for(size_t i = 1; i < tables.size(); ++i) {
+	    ret += tables[i]->size();
+	}
+	return ret;
     }
 
-    size_t size() {
+    size_t size() const {
 	return size_recent() + size_old();
     }
 
     bool empty() const {
-	return table_recent->empty() && table_old->empty();
+	for(size_t i = 0; i < tables.size(); ++i) {
+	    if (!tables[i]->empty()) {
+		return false;
+	    }
+	}
+	return true;
     }
 
     /// Mostly for debugging purposes
-    bool exists_recent(const K &k) {
-	return table_recent->exists(k);
+    bool exists_recent(const K &k) const {
+	return tables[0]->exists(k);
     }
 
-    /// Mostly for debugging purposes
-    bool exists_old(const K &k) {
-	return table_old->exists(k);
+    /// Mostly for debugging purposes; true if k is in any of the
+    /// tables but the recent one.
+    bool exists_old(const K &k) const {
+	for(size_t i = 1; i < tables.size(); ++i) {
+	    if (tables[i]->exists(k)) {
+		return true;
+	    }
+	}
+	return false;
     }
 
-    size_t memoryUsage() {
-	return table_recent->memoryUsage() + table_old->memoryUsage();
+    size_t memoryUsage() const {
+	size_t ret = 0;
+	for(size_t i = 0; i < tables.size(); ++i) {
+	    ret += tables[i]->memoryUsage();
+	}
+	return ret;
     }
 private:
     typedef typename HashMapT::iterator hm_iterator;
-    // HashMap<K,V> *table_recent, *table_old;
-    HashMapT *table_recent, *table_old;
+
+    V *lookupWithHash(const K &k, uint32_t hash) {
+	V *ret = tables[0]->lookupWithHash(k, hash);
+	if (ret != NULL) {
+	    DEBUG_SINVARIANT(!exists_old(k));
+	    return ret;
+	}
+	for(size_t i = 1; i < tables.size(); ++i) {
+	    ret = tables[i]->lookupWithHash(k, hash);
+	    if (ret != NULL) {
+#if __cplusplus >= 201103L
+		V *tmp = tables[0]->addWithHash(k, std::move(*ret), hash);
+#else
+		V *tmp = tables[0]->addWithHash(k, *ret, hash);
+#endif
+		tables[i]->removeWithHash(k, hash);
+		return tmp;
+	    }
+	}
+	return NULL;
+    }
+
+    void dropTable(HashMapT *table, const RotateFn &fn) {
+	if (background_runner.empty() || table->empty()) {
+	    applyAndDelete(table, fn);
+	} else {
+	    background_runner(boost::bind(&RotatingHashMap::applyAndDelete, table, fn));
+	}
+    }
+
+    static void applyAndDelete(HashMapT *table, const RotateFn &fn) {
+	if (!fn.empty()) {
+	    for(hm_iterator i = table->begin(); i != table->end(); ++i) {
+		fn(i->first, i->second);
+	    }
+	}
+	delete table;
+    }
+
+    // tables[0] is the recent table, tables.back() the oldest
+    std::vector<HashMapT *> tables;
+    Clock::Tfrac rotate_interval, last_rotate;
+    bool rotate_started;
+    TaskRunner background_runner;
 };
 
 #endif
@@ -0,0 +1,171 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for SPSCRing class
+*/
+
+#ifndef LINTEL_SPSC_RING_HPP
+#define LINTEL_SPSC_RING_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <sched.h>
+
+#include <boost/utility.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/EventCount.hpp>
+
+/// \brief Bounded queue from one producer thread to one consumer thread
+///
+/// The rotating array of Deque, without locks: the producer owns the
+/// head index and the consumer the tail, each publishes its index with
+/// a release store, and each caches the other's index so it only
+/// reads the shared cache line when the ring looks full or empty.  The
+/// indices are on separate cache lines.  The array versions of
+/// tryPush() and tryPop() move a batch with one publish.
+///
+/// Made with blocking = true, push() and pop() sleep while the ring
+/// is full or empty; every operation then pays a fence to check for
+/// sleepers, so leave it off when polling.  T must be default
+/// constructible and assignable; popped slots keep their old value
+/// until overwritten.  Needs to be linked with LintelPThread.
+template<class T> class SPSCRing : boost::noncopyable {
+public:
+    /// capacity is rounded up to a power of two.
+    explicit SPSCRing(size_t capacity, bool blocking = false)
+	: head(0), tail_cache(0), tail(0), head_cache(0), blocking(blocking) {
+	SINVARIANT(capacity > 0);
+	size_t size = 1;
+	while (size < capacity) {
+	    size *= 2;
+	}
+	slots.resize(size);
+	mask = size - 1;
+    }
+
+    /// Producer only.  Returns false if the ring is full.
+    bool tryPush(const T &v) {
+	return tryPush(&v, 1) == 1;
+    }
+
+    /// Producer only.  Push the first n of vals that fit, and return
+    /// how many that was.
+    size_t tryPush(const T *vals, size_t n) {
+	size_t h = head.load(lintel::memory_order_relaxed);
+	if (h - tail_cache + n > slots.size()) {
+	    tail_cache = tail.load(lintel::memory_order_acquire);
+	}
+	n = std::min(n, slots.size() - (h - tail_cache));
+	if (n == 0) {
+	    return 0;
+	}
+	for(size_t i = 0; i < n; ++i) {
+	    slots[(h + i) & mask] = vals[i];
+	}
+	head.store(h + n, lintel::memory_order_release);
+	if (blocking) {
+	    not_empty.notifyOne();
+	}
+	return n;
+    }
+
+    /// Consumer only.  Returns false if the ring is empty.
+    bool tryPop(T &out) {
+	return tryPop(&out, 1) == 1;
+    }
+
+    /// Consumer only.  Pop up to max values into out, and return how
+    /// many there were.
+    size_t tryPop(T *out, size_t max) {
+	size_t t = tail.load(lintel::memory_order_relaxed);
+	if (head_cache - t < max) {
+	    head_cache = head.load(lintel::memory_order_acquire);
+	}
+	size_t n = std::min(max, head_cache - t);
+	if (n == 0) {
+	    return 0;
+	}
+	for(size_t i = 0; i < n; ++i) {
+#if __cplusplus >= 201103L
+	    out[i] = std::move(slots[(t + i) & mask]);
+#else
+	    out[i] = slots[(t + i) & mask];
+#endif
+	}
+	tail.store(t + n, lintel::memory_order_release);
+	if (blocking) {
+	    not_full.notifyOne();
+	}
+	return n;
+    }
+
+    /// Producer only; waits while the ring is full.
+    void push(const T &v) {
+	SINVARIANT(blocking);
+	for(uint32_t tries = 0; !tryPush(v); ++tries) {
+	    if (tries < EventCount::yields_before_wait) {
+		sched_yield();
+		continue;
+	    }
+	    uint32_t key = not_full.prepareWait();
+	    if (tryPush(v)) {
+		not_full.cancelWait();
+		return;
+	    }
+	    not_full.wait(key);
+	}
+    }
+
+    /// Consumer only; waits while the ring is empty.
+    void pop(T &out) {
+	SINVARIANT(blocking);
+	for(uint32_t tries = 0; !tryPop(out); ++tries) {
+	    if (tries < EventCount::yields_before_wait) {
+		sched_yield();
+		continue;
+	    }
+	    uint32_t key = not_empty.prepareWait();
+	    if (tryPop(out)) {
+		not_empty.cancelWait();
+		return;
+	    }
+	    not_empty.wait(key);
+	}
+    }
+
+    /// Exact only in the producer or consumer thread, and then only a
+    /// lower or upper bound as the other side moves.
+    size_t size() const {
+	return head.load() - tail.load();
+    }
+
+    bool empty() const {
+	return size() == 0;
+    }
+
+    size_t capacity() const {
+	return slots.size();
+    }
+
+private:
+    char padding0[64];
+    lintel::Atomic<size_t> head; // next slot to fill
+    size_t tail_cache; // producer's view of tail
+    char padding1[64];
+    lintel::Atomic<size_t> tail; // next slot to empty
+    size_t head_cache; // consumer's view of head
+    char padding2[64];
+    std::vector<T> slots;
+    size_t mask;
+    bool blocking;
+    EventCount not_empty, not_full;
+};
+
+#endif
@@ -0,0 +1,279 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for SequenceHeap class
+*/
+
+#ifndef LINTEL_SEQUENCE_HEAP_HPP
+#define LINTEL_SEQUENCE_HEAP_HPP
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/PriorityQueue.hpp>
+
+/// \brief Priority queue for very large queues, after Sanders' sequence heaps
+///
+/// Same interface and LessImportant convention as PriorityQueue.  New
+/// values go into a small insertion heap; when it fills up it is
+/// emptied into a sorted run.  Runs are kept in groups of up to
+/// merge_ways runs, and a full group is merged into one run of the
+/// next group, so most values are touched by sequential merges rather
+/// than by sifts through a heap far larger than the cache.  The most
+/// important values of all the runs are merged out ahead of time into
+/// a deletion buffer, which is never less important than anything left
+/// in a run; top() compares its front to the top of the insertion heap.
+///
+/// Unlike Sanders, the deletion buffer is refilled by merging all of
+/// the runs at once, with a PriorityQueue of their fronts in place of
+/// loser trees.  Like PriorityQueue::pop_bottom_up_heuristic(), it
+/// needs LessImportant(a, a) to be true, as it is for the default.
+template<class T, class LessImportant = std::less_equal<T> >
+class SequenceHeap : boost::noncopyable {
+public:
+    SequenceHeap(uint32_t insert_size = 4096, uint32_t merge_ways = 32)
+	: insert_heap(insert_size), nvalues(0), insert_size(insert_size),
+	  merge_ways(merge_ways) {
+	checkSizes();
+    }
+
+    SequenceHeap(const LessImportant &li, uint32_t insert_size = 4096,
+		 uint32_t merge_ways = 32)
+	: lessimportant(li), insert_heap(li, insert_size), nvalues(0),
+	  insert_size(insert_size), merge_ways(merge_ways) {
+	checkSizes();
+    }
+
+    const T &top() const {
+	DEBUG_SINVARIANT(!empty());
+	return topFromBuffer() ? delete_buffer.back() : insert_heap.top();
+    }
+
+    void pop() {
+	DEBUG_SINVARIANT(!empty());
+	if (topFromBuffer()) {
+	    delete_buffer.pop_back();
+	    if (delete_buffer.empty()) {
+		refill();
+	    }
+	} else {
+	    insert_heap.pop();
+	}
+	--nvalues;
+    }
+
+    void push(const T &val) {
+	if (insert_heap.size() == insert_size) {
+	    flushInsertHeap();
+	}
+	insert_heap.push(val);
+	++nvalues;
+    }
+
+    size_t size() const {
+	return nvalues;
+    }
+
+    bool empty() const {
+	return nvalues == 0;
+    }
+
+    void clear() {
+	insert_heap.clear();
+	delete_buffer.clear();
+	groups.clear();
+	nvalues = 0;
+    }
+
+    /// Number of sorted runs waiting to be merged
+    size_t nruns() const {
+	size_t ret = 0;
+	for(size_t i = 0; i < groups.size(); ++i) {
+	    ret += groups[i].size();
+	}
+	return ret;
+    }
+
+private:
+    /// values [pos, vals.size()) are left, most important first
+    struct Run {
+	std::vector<T> vals;
+	size_t pos;
+
+	Run() : pos(0) { }
+	size_t size() const { return vals.size() - pos; }
+    };
+
+    struct Front {
+	const T *val;
+	uint32_t run;
+    };
+
+    class FrontLessImportant {
+    public:
+	explicit FrontLessImportant(const LessImportant &li) : li(li) { }
+	bool operator()(const Front &a, const Front &b) const {
+	    return li(*a.val, *b.val);
+	}
+    private:
+	LessImportant li;
+    };
+
+    void checkSizes() {
+	INVARIANT(insert_size > 0 && merge_ways > 1,
+		  "SequenceHeap needs insert_size > 0 and merge_ways > 1");
+    }
+
+    bool topFromBuffer() const {
+	return !delete_buffer.empty()
+	    && (insert_heap.empty() || !lessimportant(delete_buffer.back(), insert_heap.top()));
+    }
+
+    // Merge up to max_out values from the runs onto the end of out,
+    // most important first, and advance the runs past them.
+    void mergeRuns(const std::vector<Run *> &runs, size_t max_out, std::vector<T> &out) {
+	PriorityQueue<Front, FrontLessImportant> fronts(FrontLessImportant(lessimportant),
+							runs.size());
+	for(uint32_t i = 0; i < runs.size(); ++i) {
+	    if (runs[i]->size() > 0) {
+		Front f = { &runs[i]->vals[runs[i]->pos], i };
+		fronts.push(f);
+	    }
+	}
+	for(size_t n = 0; n < max_out && !fronts.empty(); ++n) {
+	    Front f = fronts.top();
+	    Run &run(*runs[f.run]);
+#if __cplusplus >= 201103L
+	    out.push_back(std::move(run.vals[run.pos]));
+#else
+	    out.push_back(*f.val);
+#endif
+	    ++run.pos;
+	    if (run.pos < run.vals.size()) {
+		f.val = &run.vals[run.pos];
+		fronts.replaceTop(f);
+	    } else {
+		fronts.pop();
+	    }
+	}
+    }
+
+    // Sort the insertion heap into a run, merge it with the deletion
+    // buffer, and keep as many of the most important values in the
+    // buffer as it had; they are no less important than anything in
+    // the runs, because what they replaced was not.
+    void flushInsertHeap() {
+	Run run;
+	run.vals.reserve(insert_heap.size());
+	while (!insert_heap.empty()) {
+	    run.vals.push_back(insert_heap.top());
+	    insert_heap.pop();
+	}
+	if (!groups.empty() && lessimportant(run.vals[0], delete_buffer.front())) {
+	    addRun(0, run); // usual for a large heap, nothing goes in the buffer
+	    return;
+	}
+
+	std::vector<T> buffer;
+	buffer.reserve(delete_buffer.size());
+	for(size_t i = delete_buffer.size(); i > 0; --i) {
+	    buffer.push_back(delete_buffer[i - 1]);
+	}
+	Run buffer_run;
+	buffer_run.vals.swap(buffer);
+	bool no_runs = groups.empty();
+	size_t keep = no_runs ? std::min(run.vals.size() + buffer_run.size(),
+					 static_cast<size_t>(insert_size))
+	    : buffer_run.size();
+
+	std::vector<Run *> both;
+	both.push_back(&buffer_run);
+	both.push_back(&run);
+	delete_buffer.clear();
+	mergeRuns(both, keep, delete_buffer);
+	std::reverse(delete_buffer.begin(), delete_buffer.end());
+
+	Run rest;
+	rest.vals.reserve(buffer_run.size() + run.size());
+	mergeRuns(both, buffer_run.size() + run.size(), rest.vals);
+	if (rest.size() > 0) {
+	    addRun(0, rest);
+	}
+    }
+
+    // takes the values of run
+    void addRun(size_t group, Run &run) {
+	if (group == groups.size()) {
+	    groups.push_back(std::vector<Run>());
+	    groups.back().reserve(merge_ways);
+	}
+	groups[group].push_back(Run());
+	groups[group].back().vals.swap(run.vals);
+	groups[group].back().pos = run.pos;
+	if (groups[group].size() == merge_ways) {
+	    std::vector<Run *> runs;
+	    size_t total = 0;
+	    for(size_t i = 0; i < groups[group].size(); ++i) {
+		runs.push_back(&groups[group][i]);
+		total += groups[group][i].size();
+	    }
+	    Run merged;
+	    merged.vals.reserve(total);
+	    mergeRuns(runs, total, merged.vals);
+	    groups[group].clear();
+	    addRun(group + 1, merged);
+	}
+    }
+
+    void refill() {
+	std::vector<Run *> runs;
+	for(size_t i = 0; i < groups.size(); ++i) {
+	    for(size_t j = 0; j < groups[i].size(); ++j) {
+		runs.push_back(&groups[i][j]);
+	    }
+	}
+	if (runs.empty()) {
+	    return;
+	}
+	DEBUG_SINVARIANT(delete_buffer.empty());
+	mergeRuns(runs, insert_size, delete_buffer);
+	std::reverse(delete_buffer.begin(), delete_buffer.end());
+
+	// drop the finished runs, and the groups left empty at the end
+	for(size_t i = 0; i < groups.size(); ++i) {
+	    std::vector<Run> &group(groups[i]);
+	    for(size_t j = 0; j < group.size(); ) {
+		if (group[j].size() == 0) {
+		    group[j].vals.swap(group.back().vals);
+		    group[j].pos = group.back().pos;
+		    group.pop_back();
+		} else {
+		    ++j;
+		}
+	    }
+	}
+	while (!groups.empty() && groups.back().empty()) {
+	    groups.pop_back();
+	}
+    }
+
+    LessImportant lessimportant;
+    PriorityQueue<T, LessImportant> insert_heap;
+    // most important value at the back
+    std::vector<T> delete_buffer;
+    // group i holds runs made by merging merge_ways^i insertion heaps
+    std::deque<std::vector<Run> > groups;
+    size_t nvalues;
+    uint32_t insert_size, merge_ways;
+};
+
+#endif
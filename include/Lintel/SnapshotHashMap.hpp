@@ -0,0 +1,108 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    \brief header file for SnapshotHashMap class
+*/
+
+#ifndef LINTEL_SNAPSHOT_HASHMAP_HPP
+#define LINTEL_SNAPSHOT_HASHMAP_HPP
+
+#include <boost/utility.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/EpochReclaimer.hpp>
+#include <Lintel/FrozenHashMap.hpp>
+
+/// \brief A read-mostly map that readers use without locks
+///
+/// Holds a FrozenHashMap snapshot; a writer builds a new one, usually
+/// from a HashMap it keeps to itself, and publishes it with a single
+/// pointer exchange.  Readers load the current snapshot under an
+/// EpochReclaimer::ReadGuard, so they take no locks and make no atomic
+/// read-modify-write operations, and replaced snapshots are deleted
+/// once the last reader that could have seen them finishes.
+///
+/// Meant for tables such as configuration or routing data that are
+/// read on every request and change every few seconds; each publish
+/// copies the whole table.  Concurrent publishes are safe, but the
+/// last one wins.  Needs to be linked with LintelPThread.
+template <class K, class V,
+	  class KHash = HashMap_hash<const K>,
+	  class KEqual = std::equal_to<const K> >
+class SnapshotHashMap : boost::noncopyable {
+public:
+    typedef FrozenHashMap<K, V, KHash, KEqual> Snapshot;
+
+    SnapshotHashMap() : current(new Snapshot()) { }
+
+    /// Readers must have finished before the map is destroyed.
+    ~SnapshotHashMap() {
+	delete current.load();
+    }
+
+    /// Replace the contents with a copy of those of from.
+    template<class Map> void publish(const Map &from) {
+	publish(new Snapshot(from));
+    }
+
+    /// Replace the contents with snapshot, which is now owned by the
+    /// map.
+    void publish(Snapshot *snapshot) {
+	SINVARIANT(snapshot != NULL);
+	EpochReclaimer::retire(current.exchange(snapshot));
+    }
+
+    /// Copies the value for key k into out and returns true if the key
+    /// is present, otherwise returns false and leaves out alone.
+    template<class K2> bool lookup(const K2 &k, V &out) const {
+	EpochReclaimer::ReadGuard guard;
+	const V *v = current.load()->lookup(k);
+	if (v == NULL) {
+	    return false;
+	} else {
+	    out = *v;
+	    return true;
+	}
+    }
+
+    template<class K2> bool exists(const K2 &k) const {
+	EpochReclaimer::ReadGuard guard;
+	return current.load()->exists(k);
+    }
+
+    size_t size() const {
+	EpochReclaimer::ReadGuard guard;
+	return current.load()->size();
+    }
+
+    /// Holds on to the current snapshot, for reading several entries
+    /// from the same version without copying them out.  Keep short
+    /// lived, the snapshots published meanwhile can't be deleted.
+    class Reader : boost::noncopyable {
+    public:
+	explicit Reader(const SnapshotHashMap &map) : snapshot(map.current.load()) { }
+
+	const Snapshot &operator*() const {
+	    return *snapshot;
+	}
+
+	const Snapshot *operator->() const {
+	    return snapshot;
+	}
+
+    private:
+	// constructed before snapshot is loaded
+	EpochReclaimer::ReadGuard guard;
+	const Snapshot *snapshot;
+    };
+
+private:
+    lintel::Atomic<Snapshot *> current;
+};
+
+#endif
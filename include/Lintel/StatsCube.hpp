@@ -169,7 +169,8 @@ namespace lintel {
 	void addToCube(const Tuple &key, StatsT &value) {
 	    MyAny tmp_key(key);
 
-	    cubeAddOne(tmp_key, 0, false, value);
+	    partial_hashes.reset(key);
+	    cubeAddOne(tmp_key, 0, 0, false, value);
 	}
 
 	/// Walk over all the entries in the cube in a pseudo-random
@@ -256,25 +257,38 @@ namespace lintel {
 	/// returns it.
 	HashTupleStats<Tuple, BaseStatsT> base_data;
     private:
-	void cubeAddOne(MyAny &key, size_t pos, bool had_any, const StatsT &value) {
+	// any_mask has bit i set for key.any[i], to pick the hash of the
+	// partial tuple out of partial_hashes.
+	void cubeAddOne(MyAny &key, size_t pos, uint32_t any_mask, bool had_any,
+			const StatsT &value) {
 	    if (pos == key.length) {
 		if (optional_cube_partial_fn(had_any, key)) {
-		    cube_stats_add_fn(getCubeEntry(key), value);
+		    cube_stats_add_fn(cubeEntry(key, partial_hashes[any_mask]), value);
 		}
 	    } else {
 		DEBUG_SINVARIANT(pos < key.length);
 		key.any[pos] = false;
-		cubeAddOne(key, pos + 1, had_any, value);
+		cubeAddOne(key, pos + 1, any_mask, had_any, value);
 		key.any[pos] = true;
-		cubeAddOne(key, pos + 1, true, value);
+		cubeAddOne(key, pos + 1, any_mask | (1U << pos), true, value);
 	    }
 	}
 
+	StatsT &cubeEntry(const MyAny &key, uint32_t hash) {
+	    DEBUG_SINVARIANT(hash == cube_data.hashOf(key));
+	    StatsT **v = cube_data.lookupWithHash(key, hash);
+	    if (v == NULL) {
+		v = cube_data.addWithHash(key, stats_factory_fn(), hash);
+	    }
+	    return **v;
+	}
+
 	StatsFactoryFn stats_factory_fn;
 	OptionalCubeFn optional_cube_partial_fn;
 	CubeStatsAddFn cube_stats_add_fn;
 
 	PartialTupleCubeMap cube_data;
+	tuples::BitsetAnyTupleHashes<Tuple> partial_hashes;
     };
 }
 
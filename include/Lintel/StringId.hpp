@@ -12,57 +12,132 @@
 #define LINTEL_STRINGID_HPP
 
 #include <string>
-#include <map>
+#include <vector>
 
+#include <boost/utility.hpp>
+
+#include <Lintel/HashFns.hpp>
 #include <Lintel/HashTable.hpp>
+#include <Lintel/SimpleMutex.hpp>
 
 /// \brief String to small integer mapping
-class StringId {
+///
+/// Assigns each distinct string the next id, starting from 1, for
+/// dictionary encoding.  The bytes of all the strings are kept back to
+/// back in one arena, with a vector of offsets into it indexed by id,
+/// so getString() is an array lookup.  The hash table used by getId()
+/// holds only the id and hash of each string.  A string costs its bytes
+/// plus about 22 bytes, and the slack from growing the vectors, rather
+/// than a std::string and two hash table entries.
+///
+/// If constructed thread safe, all of the methods can be called from
+/// multiple threads; they share a single lock, so use getIds() to
+/// assign ids to many strings under one acquisition of it.
+class StringId : boost::noncopyable {
 public:
-    StringId();
-    unsigned int getId(const std::string &str);
-    const std::string &getString(unsigned int id);
-    unsigned int maxId() { return nextid; }
+    explicit StringId(bool thread_safe = false);
+    ~StringId();
+
+    unsigned int getId(const std::string &str) {
+	return getId(lintel::StringRef(str));
+    }
+    unsigned int getId(const lintel::StringRef &str);
+
+    /// Set ids[i] to getId(strs[i]) for all of the strings.  The
+    /// strings are hashed before taking the lock, and looked up in
+    /// batches with the hash table misses overlapped.
+    void getIds(const std::vector<lintel::StringRef> &strs, std::vector<unsigned int> &ids);
+    void getIds(const std::vector<std::string> &strs, std::vector<unsigned int> &ids);
+
+    std::string getString(unsigned int id) const {
+	std::string ret;
+	getString(id, ret);
+	return ret;
+    }
+    /// Same as getString(id), but reuses the space in out.
+    void getString(unsigned int id, std::string &out) const;
+
+    /// One more than the largest id assigned so far
+    unsigned int maxId() const {
+	MaybeLock lock(mutex);
+	return offsets.size() - 1;
+    }
+
+    /// Number of distinct strings
+    size_t size() const {
+	return maxId() - 1;
+    }
+
+    /// Bytes used by the arena, offsets and hash table
+    size_t memoryUsage() const;
 
     /// \cond SEMI_INTERNAL_CLASSES
     struct HTE {
-	const std::string *str;
-	unsigned int id;
-	HTE(const std::string &_str) : str(&_str), id(0) {}
-	HTE(const unsigned int _id) : id(_id) {}
+	uint32_t id;
+	uint32_t hash;
     };
-    class HTEHashStr {
-    public:
-	unsigned int operator()(const HTE &k) {
-	    return HashTable_hashbytes(k.str->data(),k.str->size());
-	}
+    struct Probe {
+	lintel::StringRef str;
+	uint32_t hash;
+	Probe(const lintel::StringRef &str)
+	    : str(str), hash(lintel::hashBytes(str.data, str.size)) { }
     };
-    class HTEEqualStr {
+    class HTEHash {
     public:
-	bool operator()(const HTE &a, const HTE &b) {
-	    return *(a.str) == *(b.str);
+	uint32_t operator()(const HTE &k) const {
+	    return k.hash;
 	}
-    };
-    class HTEHashId {
-    public:
-	unsigned int operator()(const HTE &k) {
-	    return k.id;
+	uint32_t operator()(const Probe &k) const {
+	    return k.hash;
 	}
     };
-    class HTEEqualId {
+    class HTEEqual {
     public:
-	bool operator()(const HTE &a, const HTE &b) {
+	explicit HTEEqual(const StringId *sid = NULL) : sid(sid) { }
+	bool operator()(const HTE &a, const HTE &b) const {
 	    return a.id == b.id;
 	}
+	bool operator()(const Probe &a, const HTE &b) const {
+	    return a.hash == b.hash && sid->equal(a.str, b.id);
+	}
+    private:
+	const StringId *sid;
     };
     /// \endcond
 
 private:
-    HashTable<HTE, HTEHashStr, HTEEqualStr> idmap;
-    HashTable<HTE, HTEHashId, HTEEqualId> revmap;
+    class MaybeLock : boost::noncopyable {
+    public:
+	explicit MaybeLock(SimpleMutex *m) : m(m) {
+	    if (m != NULL) {
+		m->lock();
+	    }
+	}
+	~MaybeLock() {
+	    if (m != NULL) {
+		m->unlock();
+	    }
+	}
+    private:
+	SimpleMutex *m;
+    };
+
+    const char *bytes(uint32_t id) const {
+	return arena.empty() ? NULL : &arena[0] + offsets[id];
+    }
+
+    bool equal(const lintel::StringRef &str, uint32_t id) const {
+	size_t len = offsets[id + 1] - offsets[id];
+	return len == str.size && (len == 0 || memcmp(bytes(id), str.data, len) == 0);
+    }
 
-    unsigned int nextid;
+    unsigned int lockedGetId(const Probe &probe);
+
+    HashTable<HTE, HTEHash, HTEEqual> idmap;
+    // the bytes of id i are [offsets[i], offsets[i+1]) in arena
+    std::vector<char> arena;
+    std::vector<uint64_t> offsets;
+    SimpleMutex *mutex;
 };
 
 #endif
-
@@ -0,0 +1,79 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    BackgroundTasks implementation
+*/
+
+#include <boost/bind.hpp>
+
+#include <Lintel/BackgroundTasks.hpp>
+
+BackgroundTasks::BackgroundTasks()
+    : running(false), stopping(false), thread(boost::bind(&BackgroundTasks::run, this))
+{
+    thread.start();
+}
+
+BackgroundTasks::~BackgroundTasks()
+{
+    {
+	PThreadScopedLock lock(mutex);
+	stopping = true;
+	work_cond.signal();
+    }
+    thread.join();
+    SINVARIANT(tasks.empty());
+}
+
+void
+BackgroundTasks::add(const Task &task)
+{
+    PThreadScopedLock lock(mutex);
+    SINVARIANT(!stopping);
+    tasks.push_back(task);
+    work_cond.signal();
+}
+
+void
+BackgroundTasks::wait()
+{
+    PThreadScopedLock lock(mutex);
+    while (running || !tasks.empty()) {
+	done_cond.wait(mutex);
+    }
+}
+
+size_t
+BackgroundTasks::pending() const
+{
+    PThreadScopedLock lock(mutex);
+    return tasks.size() + (running ? 1 : 0);
+}
+
+void *
+BackgroundTasks::run()
+{
+    PThreadScopedLock lock(mutex);
+    while (true) {
+	if (tasks.empty()) {
+	    done_cond.broadcast();
+	    if (stopping) {
+		return NULL;
+	    }
+	    work_cond.wait(mutex);
+	    continue;
+	}
+	Task task(tasks.front());
+	tasks.pop_front();
+	running = true;
+	{
+	    PThreadScopedUnlock unlock(lock);
+	    task();
+	}
+	running = false;
+    }
+}
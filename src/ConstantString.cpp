@@ -8,122 +8,331 @@
     Constant String implementation
 */
 
-// TODO: write a regression test; make sure to test strings that are C
-// strings and binary data that includes nulls; previous version of
-// code collided strings that were identical up to the first null.
-
-// TODO: switch this whole thing to having a ConstantStringPool
-// argument also.
-
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
+#include <vector>
+
 #include <Lintel/AssertBoost.hpp>
+#include <Lintel/AtomicCounter.hpp>
 #include <Lintel/ConstantString.hpp>
+#include <Lintel/SimpleMutex.hpp>
 
 using namespace std;
 using boost::format;
 
-int ConstantString::nstrings = 0;
-int ConstantString::string_bytes = 0;
-ConstantString::bufvect *ConstantString::buffers;
-ConstantString::CS_hashtable *ConstantString::hashtable;
-ConstantStringValue *ConstantString::empty_string_myptr;
+// lintel::hashBytes("", 0); checked by the constant_string test.
+uint32_t ConstantString::empty_string[3] = { 0x096a2819, 0, 0 };
 
-static char *init_buffer;
-static uint32_t init_buffer_len;
-static const bool enable_constant_folding = true;
+namespace {
 
-void
-ConstantString::init(const void *s, uint32_t slen)
-{
-    if (buffers == NULL) {
-	buffers = new bufvect;
-	hashtable = new CS_hashtable;
-    }
-    if (slen == 0 && empty_string_myptr != NULL) {
-	myptr = empty_string_myptr;
-	return;
-    }
-    if (enable_constant_folding) {
-	// TODO: update the hashtable code so that we can specify a
-	// key that is not in the stored data format; there was some
-	// other case where this would be useful, probably in
-	// accessing variable32 data in dataseries and wanting to do a
-	// lookup based on that without having to convert to a string
-	// first.
-	if (init_buffer_len < 5 + slen) {
-	    delete [] init_buffer;
-	    init_buffer = new char[5 + slen];
-	    init_buffer_len = 5 + slen;
-	}
-	*reinterpret_cast<uint32_t *>(init_buffer) = slen;
-	memcpy(init_buffer + 4, s, slen);
-	init_buffer[4+slen] = '\0';
-	
-	ConstantStringValue *tmp = reinterpret_cast<ConstantStringValue *>(init_buffer + 4);
-	ConstantStringValue **ptr = hashtable->lookup(tmp);
-	if (ptr != NULL) {
-	    myptr = *ptr;
+// A thread's buffers for a pool start small so that small pools stay
+// small, and double up to the max size.
+const uint32_t min_buffer_size = 4096;
+const uint32_t max_buffer_size = 512*1024;
+
+// Each thread copies the strings it adds into its own buffer, so
+// adding strings from many threads doesn't contend on the allocator.
+// A thread keeps buffers for the last few pools it used, found by the
+// id of the pool, which changes on reset so that a thread never uses
+// a freed buffer.  The unused tail of a buffer is lost when the
+// thread exits or moves on to other pools.
+struct Arena {
+    uint64_t pool_id;
+    char *cur;
+    char *end;
+    uint32_t next_size;
+};
+
+const int narenas = 4;
+__thread Arena arenas[narenas];
+__thread uint32_t next_arena;
+
+// function static so pools can be created during static initialization
+uint64_t nextPoolId() {
+    static lintel::Atomic<uint64_t> last_id;
+    return ++last_id;
+}
+
+// The index of a shard is an open addressed table of the strings,
+// probed linearly.  Lookups walk it without taking the shard lock, so
+// a slot only ever changes once, from NULL to its string, with the
+// hash filled in first.  When the table fills up a bigger one replaces
+// it; the old one is kept until the pool is reset since a lookup may
+// still be walking it, which at most doubles the space used by the
+// tables.  A lookup that misses on an old table just falls through to
+// the locked path.
+struct Slot {
+    lintel::Atomic<ConstantStringValue *> value;
+    uint32_t hash;
+};
+
+struct Table : boost::noncopyable {
+    explicit Table(uint32_t size) : mask(size - 1), slots(new Slot[size]) { }
+    ~Table() {
+	delete [] slots;
+    }
+
+    ConstantStringValue *find(uint32_t hash, const char *s, uint32_t slen) const {
+	for(uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+	    ConstantStringValue *v = slots[i].value.load();
+	    if (v == NULL) {
+		return NULL;
+	    }
+	    if (slots[i].hash == hash && ConstantString_length(v) == slen
+		&& memcmp(ConstantString_c_str(v), s, slen) == 0) {
+		return v;
+	    }
+	}
+    }
+
+    void add(uint32_t hash, ConstantStringValue *v) {
+	uint32_t i = hash & mask;
+	while (slots[i].value.load() != NULL) {
+	    i = (i + 1) & mask;
+	}
+	slots[i].hash = hash;
+	slots[i].value.store(v);
+    }
+
+    uint32_t mask;
+    Slot *slots;
+};
+
+// The padding keeps the mutex of one shard out of the cache line of
+// the counters of the previous one.
+struct Shard {
+    Shard() : table(NULL) { }
+
+    void init() {
+	table = new Table(16);
+	nstrings = 0;
+	string_bytes = 0;
+    }
+
+    void clear() {
+	Table *t = table.load();
+	if (t != NULL) {
+	    retired.push_back(t);
+	}
+	for(size_t i = 0; i < retired.size(); ++i) {
+	    delete retired[i];
+	}
+	retired.clear();
+	table = NULL;
+    }
+
+    lintel::Atomic<Table *> table;
+    SimpleMutex mutex;
+    vector<Table *> retired;
+    uint32_t nstrings;
+    uint64_t string_bytes;
+    char padding[64];
+};
+
+}
+
+class ConstantStringPool::Impl {
+public:
+    explicit Impl(uint32_t nshards) : shard_bits(0), memory_usage(0) {
+	SINVARIANT(nshards > 0 && nshards <= (1U << 16));
+	while ((1U << shard_bits) < nshards) {
+	    ++shard_bits;
+	}
+	shards = new Shard[1U << shard_bits];
+	init();
+    }
+
+    ~Impl() {
+	clear();
+	delete [] shards;
+    }
+
+    void reset() {
+	clear();
+	init();
+    }
+
+    ConstantStringValue *intern(const char *s, uint32_t slen) {
+	uint32_t hash = lintel::hashBytes(s, slen);
+	// the top bits pick the shard, the bottom ones the slot
+	Shard &shard(shards[shard_bits == 0 ? 0 : hash >> (32 - shard_bits)]);
+	ConstantStringValue *ret = shard.table.load()->find(hash, s, slen);
+	if (ret != NULL) {
+	    return ret;
+	}
+
+	// copy the string before taking the lock; if another thread
+	// added it in the mean time, we can hand the space back since
+	// this thread's buffer has not been used since.
+	uint32_t space_used = (2 * sizeof(uint32_t) + slen + 1 + 3) & ~3;
+	INVARIANT(space_used < max_buffer_size / 64,
+		  "Reduce possible badness by limiting max string size");
+	Arena &arena(arenaFor());
+	char *space = allocate(arena, space_used);
+	reinterpret_cast<uint32_t *>(space)[0] = hash;
+	reinterpret_cast<uint32_t *>(space)[1] = slen;
+	char *bytes = space + 2 * sizeof(uint32_t);
+	memcpy(bytes, s, slen);
+	bytes[slen] = '\0';
+
+	SimpleScopedLock lock(shard.mutex);
+	Table *table = shard.table.load();
+	ret = table->find(hash, s, slen);
+	if (ret != NULL) {
+	    arena.cur -= space_used;
+	    return ret;
+	}
+	if (2 * (shard.nstrings + 1) > table->mask + 1) {
+	    table = grow(shard);
+	}
+	ret = reinterpret_cast<ConstantStringValue *>(bytes);
+	table->add(hash, ret);
+	++shard.nstrings;
+	shard.string_bytes += slen + 1;
+	return ret;
+    }
+
+    size_t size() const {
+	size_t ret = 0;
+	for(uint32_t i = 0; i < (1U << shard_bits); ++i) {
+	    SimpleScopedLock lock(shards[i].mutex);
+	    ret += shards[i].nstrings;
+	}
+	return ret;
+    }
+
+    size_t memoryUsage() const {
+	SimpleScopedLock lock(buffers_mutex);
+	return memory_usage;
+    }
+
+    void dumpInfo() const {
+	uint64_t string_bytes = 0;
+	for(uint32_t i = 0; i < (1U << shard_bits); ++i) {
+	    SimpleScopedLock lock(shards[i].mutex);
+	    string_bytes += shards[i].string_bytes;
+	}
+	size_t nstrings = size();
+	SimpleScopedLock lock(buffers_mutex);
+	if (buffers.empty()) {
+	    cout << "CSInfo: never used\n";
 	    return;
 	}
+	cout << format("CSInfo: %d strings, bytes: %d string, %d alloced in %d buffers\n")
+	    % nstrings % string_bytes % memory_usage % buffers.size();
+    }
+
+private:
+    void init() {
+	id = nextPoolId();
+	for(uint32_t i = 0; i < (1U << shard_bits); ++i) {
+	    shards[i].init();
+	}
+    }
+
+    void clear() {
+	for(uint32_t i = 0; i < (1U << shard_bits); ++i) {
+	    shards[i].clear();
+	}
+	for(size_t i = 0; i < buffers.size(); ++i) {
+	    delete [] buffers[i];
+	}
+	buffers.clear();
+	memory_usage = 0;
+    }
+
+    Arena &arenaFor() {
+	for(int i = 0; i < narenas; ++i) {
+	    if (arenas[i].pool_id == id) {
+		return arenas[i];
+	    }
+	}
+	Arena &ret(arenas[next_arena]);
+	next_arena = (next_arena + 1) % narenas;
+	ret.pool_id = id;
+	ret.cur = ret.end = NULL;
+	ret.next_size = min_buffer_size;
+	return ret;
     }
-    slen += 1; // "null at end of string"
-    ++nstrings;
-    string_bytes += slen;
-    int space_used = slen + ((4 - (slen % 4))%4) + sizeof(uint32_t);
-    slen -= 1;
-
-    for(unsigned int i = 0;i<buffers->size();i++) {
-	if (((*buffers)[i].size - (*buffers)[i].amt_used) >= space_used) {
-	    char *ptr = reinterpret_cast<char *>((*buffers)[i].data);
-	    ptr += (*buffers)[i].amt_used;
-	    *reinterpret_cast<uint32_t *>(ptr) = slen;
-	    ptr += 4;
-	    memcpy(ptr,s,slen);
-	    ptr[slen] = '\0';
-	    (*buffers)[i].amt_used += space_used;
-	    myptr = reinterpret_cast<ConstantStringValue *>(ptr);
-
-	    if (slen == 0) {
-		empty_string_myptr = myptr;
+
+    char *allocate(Arena &arena, uint32_t space_used) {
+	if (arena.end - arena.cur < static_cast<ptrdiff_t>(space_used)) {
+	    uint32_t size = max(arena.next_size, space_used);
+	    arena.next_size = min(2 * size, max_buffer_size);
+	    char *buffer = new char[size];
+	    {
+		SimpleScopedLock lock(buffers_mutex);
+		buffers.push_back(buffer);
+		memory_usage += size;
 	    }
-	    if (enable_constant_folding) {
-		SINVARIANT(c_str() == reinterpret_cast<const char *>(myptr));
-		hashtable->add(myptr);
+	    arena.cur = buffer;
+	    arena.end = buffer + size;
+	}
+	char *ret = arena.cur;
+	arena.cur += space_used;
+	return ret;
+    }
+
+    Table *grow(Shard &shard) {
+	Table *old_table = shard.table.load();
+	Table *new_table = new Table(2 * (old_table->mask + 1));
+	for(uint32_t i = 0; i <= old_table->mask; ++i) {
+	    ConstantStringValue *v = old_table->slots[i].value.load();
+	    if (v != NULL) {
+		new_table->add(old_table->slots[i].hash, v);
 	    }
-	    return;
 	}
+	shard.table.store(new_table);
+	shard.retired.push_back(old_table);
+	return new_table;
     }
-    INVARIANT(space_used < buffer_size / 64,
-	      "Reduce possible badness by limiting max string size");
 
-    buffer new_buffer;
-    new_buffer.data = reinterpret_cast<ConstantStringValue *>(new char[buffer_size]);
-    new_buffer.size = buffer_size;
-    new_buffer.amt_used = 0;
-    buffers->push_back(new_buffer);
-    init(s,slen); // simpler than re-writing the alloc stuff
+    Shard *shards;
+    uint32_t shard_bits;
+    uint64_t id;
+    mutable SimpleMutex buffers_mutex;
+    vector<char *> buffers;
+    size_t memory_usage;
+};
+
+ConstantStringPool::ConstantStringPool(uint32_t nshards)
+    : impl(new Impl(nshards)) { }
+
+ConstantStringPool::~ConstantStringPool() {
+    delete impl;
+}
+
+void ConstantStringPool::reset() {
+    impl->reset();
+}
+
+size_t ConstantStringPool::size() const {
+    return impl->size();
+}
+
+size_t ConstantStringPool::memoryUsage() const {
+    return impl->memoryUsage();
+}
+
+void ConstantStringPool::dumpInfo() const {
+    impl->dumpInfo();
+}
+
+ConstantStringPool &ConstantStringPool::global() {
+    // allocated on first use so that ConstantStrings can be created
+    // during static initialization, and never freed so they can be
+    // used during static destruction.
+    static ConstantStringPool *pool = new ConstantStringPool();
+    return *pool;
+}
+
+ConstantStringValue *ConstantStringPool::intern(const char *s, uint32_t slen) {
+    return impl->intern(s, slen);
 }
 
 void
 ConstantString::dumpInfo()
 {
-    if (buffers == 0) {
-	cout << "CSInfo: never used\n";
-	return;
-    }
-    int total_data = 0;
-    int total_used = 0;
-    for(unsigned int i=0;i<buffers->size();i++) {
-	total_data += (*buffers)[i].amt_used;
-	total_used += (*buffers)[i].size;
-    }
-    cout << format("CSInfo: %d strings, bytes: %d string, %d used, %d alloced\n")
-	% nstrings % string_bytes % total_data % total_used;
-    for(unsigned int i=0;i<buffers->size();i++) {
-	cout << format("CSInfo: buffer %d, %d/%d used\n")
-	    % i % (*buffers)[i].amt_used % (*buffers)[i].size;
-    }
+    ConstantStringPool::global().dumpInfo();
 }
-
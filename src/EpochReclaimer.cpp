@@ -0,0 +1,216 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    EpochReclaimer implementation
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/EpochReclaimer.hpp>
+#include <Lintel/PThread.hpp>
+
+using namespace std;
+
+__thread EpochReclaimer::ThreadState *EpochReclaimer::thread_state;
+volatile uint64_t EpochReclaimer::global_epoch = 1;
+bool EpochReclaimer::asymmetric_barrier;
+
+namespace {
+
+// from linux/membarrier.h, which older systems lack
+const int membarrier_cmd_query = 0;
+const int membarrier_cmd_private_expedited = 1 << 3;
+const int membarrier_cmd_register_private_expedited = 1 << 4;
+
+// The epoch a thread announced when it entered its outermost
+// ReadGuard, or 0 if it is not reading; padded so readers in
+// different threads don't share a cache line.
+struct ReaderSlot {
+    ReaderSlot() : epoch(0), in_use(false) { }
+    volatile uint64_t epoch;
+    bool in_use;
+    char padding[64 - sizeof(uint64_t) - sizeof(bool)];
+};
+
+struct Retired {
+    void (*deleter)(void *);
+    void *ptr;
+    uint64_t epoch;
+};
+
+void releaseThread(void *arg);
+
+// Never freed, so threads can exit and data be retired during static
+// destruction.
+struct Domain {
+    Domain() {
+	INVARIANT(pthread_key_create(&key, releaseThread) == 0, "pthread_key_create failed");
+    }
+
+    PThreadMutex mutex;
+    vector<ReaderSlot *> slots;
+    vector<Retired> retired;
+    pthread_key_t key;
+};
+
+bool registerBarrier() {
+#if defined(__linux__) && defined(SYS_membarrier)
+    long cmds = syscall(SYS_membarrier, membarrier_cmd_query, 0);
+    return cmds > 0 && (cmds & membarrier_cmd_private_expedited) != 0
+	&& syscall(SYS_membarrier, membarrier_cmd_register_private_expedited, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+Domain &domain() {
+    static Domain *ret = new Domain();
+    return *ret;
+}
+
+// Makes the announcements of readers visible to this thread, and this
+// thread's stores visible to them before they next load.
+void writerBarrier() {
+    if (EpochReclaimer::asymmetricBarrier()) {
+#if defined(__linux__) && defined(SYS_membarrier)
+	INVARIANT(syscall(SYS_membarrier, membarrier_cmd_private_expedited, 0) == 0,
+		  "membarrier failed");
+#endif
+    } else {
+	lintel::atomic_thread_fence(lintel::memory_order_seq_cst);
+    }
+}
+
+void releaseThread(void *arg) {
+    EpochReclaimer::ThreadState *state = static_cast<EpochReclaimer::ThreadState *>(arg);
+    SINVARIANT(state->nesting == 0);
+    Domain &d(domain());
+    {
+	PThreadScopedLock lock(d.mutex);
+	static_cast<ReaderSlot *>(state->slot)->in_use = false;
+    }
+    delete state;
+}
+
+// Remove the retired entries no active reader can see from d.retired,
+// and return them; d.mutex must be held.
+vector<Retired> collect(Domain &d) {
+    writerBarrier();
+    uint64_t min_active = ~static_cast<uint64_t>(0);
+    for(size_t i = 0; i < d.slots.size(); ++i) {
+	uint64_t epoch = d.slots[i]->epoch;
+	if (epoch != 0 && epoch < min_active) {
+	    min_active = epoch;
+	}
+    }
+    vector<Retired> ret;
+    size_t keep = 0;
+    for(size_t i = 0; i < d.retired.size(); ++i) {
+	// a reader that announced a later epoch loaded the pointer
+	// after it was replaced.
+	if (d.retired[i].epoch < min_active) {
+	    ret.push_back(d.retired[i]);
+	} else {
+	    d.retired[keep++] = d.retired[i];
+	}
+    }
+    d.retired.resize(keep);
+    return ret;
+}
+
+void freeAll(const vector<Retired> &done) {
+    for(size_t i = 0; i < done.size(); ++i) {
+	done[i].deleter(done[i].ptr);
+    }
+}
+
+}
+
+EpochReclaimer::ThreadState *
+EpochReclaimer::registerThread()
+{
+    Domain &d(domain());
+    ThreadState *state = new ThreadState();
+    state->nesting = 0;
+    {
+	PThreadScopedLock lock(d.mutex);
+	if (d.slots.empty()) {
+	    asymmetric_barrier = registerBarrier();
+	}
+	ReaderSlot *slot = NULL;
+	for(size_t i = 0; i < d.slots.size(); ++i) {
+	    if (!d.slots[i]->in_use) {
+		slot = d.slots[i];
+		break;
+	    }
+	}
+	if (slot == NULL) {
+	    slot = new ReaderSlot();
+	    d.slots.push_back(slot);
+	}
+	slot->in_use = true;
+	state->slot = slot;
+	state->epoch = &slot->epoch;
+    }
+    INVARIANT(pthread_setspecific(d.key, state) == 0, "pthread_setspecific failed");
+    thread_state = state;
+    return state;
+}
+
+void
+EpochReclaimer::retire(void (*deleter)(void *), void *ptr)
+{
+    Domain &d(domain());
+    vector<Retired> done;
+    {
+	PThreadScopedLock lock(d.mutex);
+	Retired r = { deleter, ptr, global_epoch };
+	d.retired.push_back(r);
+	global_epoch = global_epoch + 1;
+	done = collect(d);
+    }
+    freeAll(done);
+}
+
+void
+EpochReclaimer::synchronize()
+{
+    INVARIANT(thread_state == NULL || thread_state->nesting == 0,
+	      "EpochReclaimer::synchronize() called inside a ReadGuard");
+    Domain &d(domain());
+    while (true) {
+	vector<Retired> done;
+	bool finished;
+	{
+	    PThreadScopedLock lock(d.mutex);
+	    // readers that start from here on can't see anything retired
+	    global_epoch = global_epoch + 1;
+	    done = collect(d);
+	    finished = d.retired.empty();
+	}
+	freeAll(done);
+	if (finished) {
+	    return;
+	}
+	usleep(1000);
+    }
+}
+
+size_t
+EpochReclaimer::pending()
+{
+    Domain &d(domain());
+    PThreadScopedLock lock(d.mutex);
+    return d.retired.size();
+}
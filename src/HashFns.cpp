@@ -1,3 +1,8 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+#include <Lintel/CompilerMarkup.hpp>
 #include <Lintel/HashFns.hpp>
 
 /* -*-C++-*-
@@ -127,3 +132,186 @@ uint32_t lintel::bobJenkinsHash(const uint32_t initval, const void *_k,
    return c;
 }
 
+
+// hashBytes64 follows the final version of Wang Yi's wyhash, which
+// is in the public domain: https://github.com/wangyi-fudan/wyhash
+
+namespace {
+    const uint64_t wy_secret[4] = {
+	0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 
+	0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL
+    };
+
+    inline uint64_t wyr8(const uint8_t *p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+    }
+
+    inline uint64_t wyr4(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+    }
+
+    inline uint64_t wyr3(const uint8_t *p, size_t k) {
+	return (static_cast<uint64_t>(p[0]) << 16) 
+	    | (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+    }
+
+    // the 128 bit product of a and b, low half in a, high in b
+    inline void wymum(uint64_t &a, uint64_t &b) {
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = static_cast<__uint128_t>(a) * b;
+	a = static_cast<uint64_t>(r);
+	b = static_cast<uint64_t>(r >> 64);
+#else
+	uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+	uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+	uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+	uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+	b = hi_hi + (hi_lo >> 32) + (cross >> 32);
+	a = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+    }
+
+    inline uint64_t wymix(uint64_t a, uint64_t b) {
+	wymum(a, b);
+	return a ^ b;
+    }
+}
+
+uint64_t lintel::hashBytes64(const void *bytes, const size_t size, uint64_t seed) {
+    const uint8_t *p = static_cast<const uint8_t *>(bytes);
+    seed ^= wymix(seed ^ wy_secret[0], wy_secret[1]);
+    uint64_t a, b;
+    if (LIKELY(size <= 16)) {
+	if (LIKELY(size >= 4)) {
+	    a = (wyr4(p) << 32) | wyr4(p + ((size >> 3) << 2));
+	    b = (wyr4(p + size - 4) << 32) | wyr4(p + size - 4 - ((size >> 3) << 2));
+	} else if (LIKELY(size > 0)) {
+	    a = wyr3(p, size);
+	    b = 0;
+	} else {
+	    a = b = 0;
+	}
+    } else {
+	size_t i = size;
+	if (UNLIKELY(i > 48)) {
+	    uint64_t see1 = seed, see2 = seed;
+	    do {
+		seed = wymix(wyr8(p) ^ wy_secret[1], wyr8(p + 8) ^ seed);
+		see1 = wymix(wyr8(p + 16) ^ wy_secret[2], wyr8(p + 24) ^ see1);
+		see2 = wymix(wyr8(p + 32) ^ wy_secret[3], wyr8(p + 40) ^ see2);
+		p += 48;
+		i -= 48;
+	    } while (LIKELY(i > 48));
+	    seed ^= see1 ^ see2;
+	}
+	while (UNLIKELY(i > 16)) {
+	    seed = wymix(wyr8(p) ^ wy_secret[1], wyr8(p + 8) ^ seed);
+	    i -= 16;
+	    p += 16;
+	}
+	a = wyr8(p + i - 16);
+	b = wyr8(p + i - 8);
+    }
+    a ^= wy_secret[1];
+    b ^= seed;
+    wymum(a, b);
+    return wymix(a ^ wy_secret[0] ^ size, b ^ wy_secret[1]);
+}
+
+// CRC32C uses the Castagnoli polynomial, reflected 0x82F63B78.  The
+// table is built during static initialization; crc32c picks the
+// implementation the first time it is called.
+
+namespace {
+    struct Crc32cTable {
+	uint32_t table[256];
+	Crc32cTable() {
+	    for(uint32_t i = 0; i < 256; ++i) {
+		uint32_t crc = i;
+		for(int j = 0; j < 8; ++j) {
+		    crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+		}
+		table[i] = crc;
+	    }
+	}
+    };
+
+    const Crc32cTable &crc32cTable() {
+	static Crc32cTable table;
+	return table;
+    }
+
+    typedef uint32_t (*Crc32cFn)(uint32_t, const void *, size_t);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINTEL_CRC32C_HARDWARE 1
+    __attribute__((target("sse4.2")))
+    uint32_t crc32cSSE42(uint32_t prev_crc, const void *bytes, size_t size) {
+	const uint8_t *p = static_cast<const uint8_t *>(bytes);
+	uint32_t crc = ~prev_crc;
+#if defined(__x86_64__)
+	uint64_t crc64 = crc;
+	for(; size >= 8; size -= 8, p += 8) {
+	    uint64_t v;
+	    memcpy(&v, p, 8);
+	    crc64 = __builtin_ia32_crc32di(crc64, v);
+	}
+	crc = static_cast<uint32_t>(crc64);
+#endif
+	for(; size >= 4; size -= 4, p += 4) {
+	    uint32_t v;
+	    memcpy(&v, p, 4);
+	    crc = __builtin_ia32_crc32si(crc, v);
+	}
+	for(; size > 0; --size, ++p) {
+	    crc = __builtin_ia32_crc32qi(crc, *p);
+	}
+	return ~crc;
+    }
+
+    bool cpuHasSSE42() {
+	unsigned eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+	    return false;
+	}
+	return (ecx & bit_SSE4_2) != 0;
+    }
+#endif
+
+    Crc32cFn chooseCrc32c() {
+#ifdef LINTEL_CRC32C_HARDWARE
+	if (cpuHasSSE42()) {
+	    return crc32cSSE42;
+	}
+#endif
+	return lintel::detail::crc32cSoftware;
+    }
+
+    Crc32cFn crc32cImpl() {
+	static Crc32cFn fn = chooseCrc32c();
+	return fn;
+    }
+}
+
+uint32_t lintel::detail::crc32cSoftware(uint32_t prev_crc, const void *bytes, size_t size) {
+    const uint32_t *table = crc32cTable().table;
+    const uint8_t *p = static_cast<const uint8_t *>(bytes);
+    uint32_t crc = ~prev_crc;
+    for(; size > 0; --size, ++p) {
+	crc = table[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool lintel::detail::crc32cHardware() {
+    return crc32cImpl() != crc32cSoftware;
+}
+
+uint32_t lintel::crc32c(const uint32_t prev_crc, const void *bytes, const size_t size) {
+    return crc32cImpl()(prev_crc, bytes, size);
+}
@@ -5,16 +5,86 @@
 */
 
 /** @file
-    prime list
+    prime list, and saving HashTable images
 */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <Lintel/HashTable.hpp>
 
+using namespace std;
+using boost::format;
+
 // Set to be about 4x increment each time; resizing the hash table is 
-// expensive, and we only pay 4 bytes/entry
+// expensive, and we only pay 4 bytes/entry.  The last entry is the
+// largest 32 bit prime since hash values are 32 bits.
 uint32_t HashTable_prime_list[] = {
   5, 23, 107, 
   433, 1543, 6091, 24281, 100169, 487651, 1179589, 2471093, 
-  7368787, 32452843, 141650939, 0
+  7368787, 32452843, 141650939, 566603759, 2266415071U, 4294967291U, 0
 };
 
+
+const uint32_t HashTableImageHeader::current_version;
+const uint32_t HashTableImageHeader::byte_order_mark;
+const uint64_t HashTableImageHeader::alignment;
+
+HashTableImageHeader::HashTableImageHeader(uint32_t data_size, uint32_t index_size,
+					   uint32_t entry_size, uint64_t nentries,
+					   uint64_t nchains, uint64_t nentry_points)
+    : version(current_version), byte_order(byte_order_mark), 
+      data_size(data_size), index_size(index_size), entry_size(entry_size), 
+      unused(0), nentries(nentries), nchains(nchains), nentry_points(nentry_points)
+{
+    memcpy(magic, "LintelHT", sizeof(magic));
+    chains_offset = roundUp(sizeof(HashTableImageHeader));
+    entry_points_offset = roundUp(chains_offset + nchains * entry_size);
+    file_size = entry_points_offset + nentry_points * index_size;
+}
+
+uint64_t HashTableImageHeader::roundUp(uint64_t offset) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static void writeAll(int fd, const void *buf, size_t nbytes, const string &path) {
+    const char *from = static_cast<const char *>(buf);
+    while (nbytes > 0) {
+	ssize_t amt = ::write(fd, from, nbytes);
+	if (amt == -1 && errno == EINTR) {
+	    continue;
+	}
+	INVARIANT(amt > 0, format("error writing %s: %s") % path % strerror(errno));
+	from += amt;
+	nbytes -= amt;
+    }
+}
+
+// pad from offset up to the next array, which is at most alignment away
+static void writePadding(int fd, uint64_t offset, uint64_t to, const string &path) {
+    static const char zeros[HashTableImageHeader::alignment] = { 0 };
+    SINVARIANT(to >= offset && to - offset < HashTableImageHeader::alignment);
+    writeAll(fd, zeros, to - offset, path);
+}
+
+void HashTable_writeImage(const string &path, const HashTableImageHeader &header,
+			  const void *chains, const void *entry_points) {
+    string tmp_path = (format("%s.tmp.%d") % path % getpid()).str();
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    INVARIANT(fd != -1, format("error opening %s: %s") % tmp_path % strerror(errno));
+
+    writeAll(fd, &header, sizeof(header), tmp_path);
+    writePadding(fd, sizeof(header), header.chains_offset, tmp_path);
+    uint64_t chains_bytes = header.nchains * header.entry_size;
+    writeAll(fd, chains, chains_bytes, tmp_path);
+    writePadding(fd, header.chains_offset + chains_bytes, header.entry_points_offset, tmp_path);
+    writeAll(fd, entry_points, header.nentry_points * header.index_size, tmp_path);
+
+    INVARIANT(fsync(fd) == 0, format("error syncing %s: %s") % tmp_path % strerror(errno));
+    INVARIANT(::close(fd) == 0, format("error closing %s: %s") % tmp_path % strerror(errno));
+    INVARIANT(rename(tmp_path.c_str(), path.c_str()) == 0, 
+	      format("error renaming %s to %s: %s") % tmp_path % path % strerror(errno));
+}
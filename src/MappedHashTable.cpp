@@ -0,0 +1,62 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Mapping of saved HashTable images
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Lintel/MappedHashTable.hpp>
+
+using namespace std;
+using boost::format;
+
+MappedHashTableImage::MappedHashTableImage(const string &path, uint32_t data_size,
+					   uint32_t index_size, uint32_t entry_size)
+    : base(NULL), length(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    INVARIANT(fd != -1, format("error opening %s: %s") % path % strerror(errno));
+
+    // check the header before mapping so a bad file doesn't leave a
+    // mapping behind.
+    HashTableImageHeader header(0, 0, 0, 0, 0, 0);
+    ssize_t amt = ::pread(fd, &header, sizeof(header), 0);
+    INVARIANT(amt != -1, format("error reading %s: %s") % path % strerror(errno));
+    INVARIANT(amt == sizeof(header) && memcmp(header.magic, "LintelHT", sizeof(header.magic)) == 0,
+	      format("%s is not a saved HashTable") % path);
+    INVARIANT(header.byte_order == HashTableImageHeader::byte_order_mark,
+	      format("%s was saved on a machine with a different byte order") % path);
+    INVARIANT(header.version == HashTableImageHeader::current_version,
+	      format("%s has HashTable image version %d, expected %d")
+	      % path % header.version % HashTableImageHeader::current_version);
+    INVARIANT(header.data_size == data_size && header.index_size == index_size
+	      && header.entry_size == entry_size,
+	      format("%s was saved with data size %d and index size %d, expected %d and %d")
+	      % path % header.data_size % header.index_size % data_size % index_size);
+
+    struct stat st;
+    INVARIANT(fstat(fd, &st) == 0, format("error on stat(%s): %s") % path % strerror(errno));
+    INVARIANT(static_cast<uint64_t>(st.st_size) == header.file_size
+	      && header.chains_offset + header.nchains * entry_size <= header.entry_points_offset
+	      && header.entry_points_offset + header.nentry_points * index_size <= header.file_size,
+	      format("%s is truncated or corrupt") % path);
+
+    length = st.st_size;
+    base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    INVARIANT(base != MAP_FAILED, format("error mapping %s: %s") % path % strerror(errno));
+    INVARIANT(::close(fd) == 0, format("error closing %s: %s") % path % strerror(errno));
+}
+
+MappedHashTableImage::~MappedHashTableImage() {
+    INVARIANT(munmap(base, length) == 0, format("error on munmap: %s") % strerror(errno));
+}
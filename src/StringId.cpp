@@ -11,54 +11,95 @@
 #include <Lintel/AssertBoost.hpp>
 #include <Lintel/StringId.hpp>
 
-StringId::StringId()
-    : revmap(4.0) // equal is very fast, so use longer chains
+using namespace std;
+
+static const size_t batch_size = 64;
+
+StringId::StringId(bool thread_safe)
+    : idmap(HTEHash(), HTEEqual(this)), mutex(thread_safe ? new SimpleMutex() : NULL)
+{
+    // id 0 is never assigned, give it an empty string.
+    offsets.push_back(0);
+    offsets.push_back(0);
+}
+
+StringId::~StringId()
 {
-    nextid = 1;
+    delete mutex;
 }
 
 unsigned int
-StringId::getId(const std::string &str)
+StringId::getId(const lintel::StringRef &str)
 {
-#if 0
-    unsigned int tmp = idmap[str];
-    if (tmp > 0)
-	return tmp;
-    idmap[str] = nextid;
-    revmap[nextid] = str;
-    tmp = nextid;
-    nextid += 1;
-    return tmp;
-#else
-    HTE ent(str);
-    const HTE *d = idmap.lookup(ent);
-    if (d == NULL) {
-	std::string *alloc = new std::string(str);
-	ent.str = alloc;
-	ent.id = nextid;
-	idmap.add(ent);
-	revmap.add(ent);
-	nextid += 1;
-    } else {
-	ent.id = d->id;
+    Probe probe(str);
+    MaybeLock lock(mutex);
+    return lockedGetId(probe);
+}
+
+void
+StringId::getIds(const vector<lintel::StringRef> &strs, vector<unsigned int> &ids)
+{
+    ids.resize(strs.size());
+    vector<Probe> probes(strs.begin(), strs.end());
+    MaybeLock lock(mutex);
+    HTE *found[batch_size];
+    for(size_t i = 0; i < probes.size(); i += batch_size) {
+	size_t n = min(batch_size, probes.size() - i);
+	idmap.lookupBatch(&probes[i], n, found);
+	// copy out the hits before adding anything moves the entries;
+	// a miss may have been added by an earlier string in the batch.
+	for(size_t j = 0; j < n; ++j) {
+	    ids[i + j] = found[j] == NULL ? 0 : found[j]->id;
+	}
+	for(size_t j = 0; j < n; ++j) {
+	    if (ids[i + j] == 0) {
+		ids[i + j] = lockedGetId(probes[i + j]);
+	    }
+	}
     }
-    return ent.id;
-#endif
 }
 
-const std::string &
-StringId::getString(unsigned int id)
+void
+StringId::getIds(const vector<string> &strs, vector<unsigned int> &ids)
+{
+    vector<lintel::StringRef> refs(strs.begin(), strs.end());
+    getIds(refs, ids);
+}
+
+void
+StringId::getString(unsigned int id, string &out) const
 {
-#if 0    
-    SINVARIANT(id < nextid);
-    return revmap[id];
-#else
-    HTE ent(id);
-    const HTE *d = revmap.lookup(ent);
-    INVARIANT(d != NULL,
-	      boost::format("internal error id %u has no std::string?!") % id);
-    return *(d->str);
-#endif
+    MaybeLock lock(mutex);
+    INVARIANT(id > 0 && id + 1 < offsets.size(),
+	      boost::format("invalid id %u, max id is %u") % id % (offsets.size() - 1));
+    size_t len = offsets[id + 1] - offsets[id];
+    if (len == 0) {
+	out.clear();
+    } else {
+	out.assign(bytes(id), len);
+    }
+}
 
+size_t
+StringId::memoryUsage() const
+{
+    MaybeLock lock(mutex);
+    return arena.capacity() + sizeof(uint64_t) * offsets.capacity() + idmap.memoryUsage();
 }
 
+unsigned int
+StringId::lockedGetId(const Probe &probe)
+{
+    const HTE *d = idmap.lookup(probe);
+    if (d != NULL) {
+	return d->id;
+    }
+    HTE ent;
+    ent.id = offsets.size() - 1;
+    ent.hash = probe.hash;
+    INVARIANT(ent.id != 0, "StringId ran out of ids");
+    arena.insert(arena.end(), probe.str.data, probe.str.data + probe.str.size);
+    offsets.push_back(arena.size());
+    idmap.add(ent);
+    return ent.id;
+}
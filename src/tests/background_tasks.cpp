@@ -0,0 +1,82 @@
+/* -*-C++-*- */
+/*
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Test BackgroundTasks, and time how long a RotatingHashMap rotation
+    keeps the caller when the dropped table is freed in the caller and
+    on a BackgroundTasks thread.
+
+    Usage: background_tasks [nentries]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+
+#include <Lintel/BackgroundTasks.hpp>
+#include <Lintel/RotatingHashMap.hpp>
+
+using namespace std;
+using boost::format;
+
+void append(vector<int> &out, int i) {
+    out.push_back(i);
+}
+
+void testOrder() {
+    vector<int> out;
+    {
+	BackgroundTasks tasks;
+	for(int i = 0; i < 1000; ++i) {
+	    tasks.add(boost::bind(append, boost::ref(out), i));
+	}
+	tasks.wait();
+	SINVARIANT(tasks.pending() == 0 && out.size() == 1000);
+	for(int i = 0; i < 1000; ++i) {
+	    SINVARIANT(out[i] == i);
+	}
+	tasks.add(boost::bind(append, boost::ref(out), 1000));
+    }
+    // the destructor waits for the last task
+    SINVARIANT(out.size() == 1001 && out[1000] == 1000);
+    cout << "order test passed.\n";
+}
+
+void countValues(int64_t &sum, const int64_t &, int64_t &v) {
+    sum += v;
+}
+
+void rotateTest(size_t nentries, bool background) {
+    BackgroundTasks tasks;
+    RotatingHashMap<int64_t, int64_t> map;
+    if (background) {
+	map.setBackgroundRunner(boost::bind(&BackgroundTasks::add, &tasks, _1));
+    }
+    for(size_t i = 0; i < nentries; ++i) {
+	map[i] = 1;
+    }
+    map.rotate();
+    int64_t sum = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    map.rotate(boost::bind(countValues, boost::ref(sum), _1, _2));
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    tasks.wait();
+    SINVARIANT(sum == static_cast<int64_t>(nentries) && map.empty());
+    cout << format("%s: rotating out %d entries took %.3f ms in the caller\n")
+	% (background ? "background" : "inline") % nentries % (elapsed * 1.0e3);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 2, "Usage: background_tasks [nentries]");
+    size_t nentries = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+
+    testOrder();
+    rotateTest(nentries, false);
+    rotateTest(nentries, true);
+    cout << "success.\n";
+    return 0;
+}
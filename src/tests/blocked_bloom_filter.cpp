@@ -0,0 +1,127 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Test BlockedBloomFilter, and the filter in front of HashTable,
+    HashMap and HashUnique.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Lintel/BlockedBloomFilter.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/HashUnique.hpp>
+#include <Lintel/TestUtil.hpp>
+
+using namespace std;
+using boost::format;
+
+void testFilter() {
+    BlockedBloomFilter filter;
+    SINVARIANT(!filter.enabled());
+    filter.init(100000, 10, true);
+    SINVARIANT(filter.enabled() && filter.stats().capacity >= 100000);
+    for(uint32_t i = 0; i < 100000; ++i) {
+	filter.add(lintel::hash(i));
+    }
+    SINVARIANT(!filter.full());
+    for(uint32_t i = 0; i < 100000; ++i) {
+	SINVARIANT(filter.check(lintel::hash(i)));
+    }
+    size_t positives = 0;
+    for(uint32_t i = 100000; i < 1100000; ++i) {
+	if (filter.mayContain(lintel::hash(i))) {
+	    ++positives;
+	}
+    }
+    BlockedBloomFilter::FilterStats stats(filter.stats());
+    cout << format("%.2f bits per key, %.3f%% false positives\n")
+	% stats.bits_per_key % (positives / 1.0e4);
+    SINVARIANT(stats.keys == 100000 && stats.bits_per_key >= 10);
+    SINVARIANT(positives < 20000 && stats.checks == 100000 && stats.negatives == 0);
+
+    filter.clear();
+    SINVARIANT(filter.stats().keys == 0 && !filter.mayContain(lintel::hash(1U)));
+    BlockedBloomFilter copy(filter);
+    SINVARIANT(copy.stats().checks == 100000 && copy.bitsPerKey() == 10);
+
+    // without counting, checks leave the statistics alone
+    filter.init(1000, 10);
+    filter.add(lintel::hash(1U));
+    SINVARIANT(filter.check(lintel::hash(1U)) && !filter.countingStats());
+    SINVARIANT(filter.stats().checks == 100000);
+    TEST_INVARIANT_MSG1(filter.init(10, 0.5), "invalid bits_per_key 0.500000");
+}
+
+void testHashUnique() {
+    HashUnique<int64_t> unique;
+    unique.enableFilter(10, true);
+    for(int64_t i = 0; i < 100000; ++i) {
+	SINVARIANT(unique.add(i * 3));
+    }
+    for(int64_t i = 0; i < 300000; ++i) {
+	SINVARIANT(unique.exists(i) == (i % 3 == 0));
+    }
+    BlockedBloomFilter::FilterStats stats(unique.filterStats());
+    // grew by rebuilding, so still sized for the keys
+    SINVARIANT(stats.keys == 100000 && stats.capacity >= 100000);
+    SINVARIANT(stats.falsePositiveRate() < 0.05 && stats.negatives > 150000);
+
+    bool exists[1000];
+    vector<int64_t> keys;
+    for(int64_t i = 0; i < 1000; ++i) {
+	keys.push_back(i * 7);
+    }
+    unique.existsBatch(&keys[0], keys.size(), exists);
+    for(size_t i = 0; i < keys.size(); ++i) {
+	SINVARIANT(exists[i] == (keys[i] % 3 == 0));
+    }
+
+    // removes leave the bits set until a rebuild
+    for(int64_t i = 0; i < 300000; i += 6) {
+	unique.remove(i);
+    }
+    SINVARIANT(!unique.exists(0) && unique.exists(3) && unique.size() == 50000);
+    unique.compact();
+    SINVARIANT(unique.filterStats().keys == 50000 && !unique.exists(6) && unique.exists(9));
+
+    HashUnique<int64_t> copy(unique);
+    SINVARIANT(copy.exists(9) && !copy.exists(6) && copy.filterStats().keys == 50000);
+    unique.clear();
+    SINVARIANT(!unique.exists(9) && unique.filterStats().keys == 0);
+    unique.add(9);
+    SINVARIANT(unique.exists(9));
+}
+
+void testHashMap() {
+    HashMap<string, int> map;
+    map["a"] = 1;
+    map.enableFilter(16);
+    SINVARIANT(map.filterStats().keys == 1);
+    for(int i = 0; i < 10000; ++i) {
+	map[str(format("key %d") % i)] = i;
+    }
+    for(int i = 0; i < 20000; ++i) {
+	string k(str(format("key %d") % i));
+	SINVARIANT((map.find(k) != map.end()) == (i < 10000));
+	SINVARIANT(map.exists(k) == (i < 10000));
+	SINVARIANT(map.remove(k, false) == (i < 10000));
+    }
+    SINVARIANT(map.size() == 1 && map["a"] == 1);
+    SINVARIANT(map.filterStats().checks == 0);
+    map.enableFilter(0);
+    SINVARIANT(map.filterStats().keys == 0 && map.exists("a"));
+}
+
+int main() {
+    testFilter();
+    testHashUnique();
+    testHashMap();
+    cout << "success.\n";
+    return 0;
+}
@@ -0,0 +1,103 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    test for CalendarQueue, against std::priority_queue
+*/
+
+#include <iostream>
+#include <queue>
+#include <vector>
+
+#include <Lintel/CalendarQueue.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef priority_queue<uint64_t, vector<uint64_t>, greater<uint64_t> > Expect;
+
+void check(const Expect &expect, const CalendarQueue<uint64_t, int> &cq) {
+    SINVARIANT(expect.size() == cq.size());
+    if (!expect.empty()) {
+	INVARIANT(expect.top() == cq.top().first,
+		  format("%d != %d") % expect.top() % cq.top().first);
+	SINVARIANT(static_cast<int>(cq.top().first % 1000) == cq.top().second);
+    }
+}
+
+void push(Expect &expect, CalendarQueue<uint64_t, int> &cq, uint64_t key) {
+    expect.push(key);
+    cq.push(key, static_cast<int>(key % 1000));
+}
+
+// Grow to max_size and back to empty a few times, holding for a
+// while at the peak.  New keys are now + a random delta below 2^spread_bits,
+// and sometimes before now, which a calendar queue allows.
+void testRandom(uint32_t seed, unsigned spread_bits, size_t max_size) {
+    MersenneTwisterRandom mt(seed);
+    Expect expect;
+    CalendarQueue<uint64_t, int> cq;
+    uint64_t now = 1ULL << 40;
+
+    for(unsigned round = 0; round < 3; ++round) {
+	while (cq.size() < max_size) {
+	    uint64_t delta = mt.randLongLong() >> (64 - spread_bits);
+	    push(expect, cq, mt.randInt(10) == 0 ? now - delta : now + delta);
+	    check(expect, cq);
+	}
+	SINVARIANT(cq.nbuckets() >= max_size / 2);
+	for(size_t i = 0; i < 4 * max_size; ++i) {
+	    now = cq.top().first;
+	    expect.pop();
+	    cq.pop();
+	    push(expect, cq, now + (mt.randLongLong() >> (64 - spread_bits)));
+	    check(expect, cq);
+	}
+	while (!cq.empty()) {
+	    now = cq.top().first;
+	    expect.pop();
+	    cq.pop();
+	    check(expect, cq);
+	}
+	SINVARIANT(cq.nbuckets() == 16);
+    }
+}
+
+// a few events a long way apart, so that pop has to search for the next one
+void testSparse() {
+    Expect expect;
+    CalendarQueue<uint64_t, int> cq;
+    for(uint64_t i = 0; i < 200; ++i) {
+	push(expect, cq, i); // day length of a few ticks
+    }
+    for(uint64_t i = 0; i < 190; ++i) {
+	expect.pop();
+	cq.pop();
+    }
+    push(expect, cq, 1ULL << 50);
+    push(expect, cq, 1ULL << 45);
+    push(expect, cq, (1ULL << 45) + 1);
+    while (!cq.empty()) {
+	check(expect, cq);
+	expect.pop();
+	cq.pop();
+    }
+    check(expect, cq);
+    cq.push(17, 17);
+    cq.clear();
+    SINVARIANT(cq.empty());
+}
+
+int main() {
+    testRandom(1, 4, 1000);
+    testRandom(2, 20, 5000);
+    testRandom(3, 40, 5000);
+    testRandom(4, 10, 100);
+    testSparse();
+    cout << "calendar queue tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    ConcurrentHashMap test program
+*/
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/ConcurrentHashMap.hpp>
+#include <Lintel/PThread.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef ConcurrentHashMap<int32_t, int64_t> CountMap;
+
+static const int32_t nkeys = 1000;
+static const int32_t nrounds = 100;
+
+struct AddTo {
+    int64_t amount;
+    explicit AddTo(int64_t amount) : amount(amount) { }
+    void operator()(int64_t &v) const { v += amount; }
+};
+
+// each thread adds thread_num+1 to every key nrounds times
+void *countWorker(CountMap *map, int32_t thread_num) {
+    for(int32_t round = 0; round < nrounds; ++round) {
+	for(int32_t k = 0; k < nkeys; ++k) {
+	    map->upsert((k * 7 + thread_num) % nkeys, AddTo(thread_num + 1));
+	}
+    }
+    return NULL;
+}
+
+struct SumAll {
+    lintel::Atomic<int64_t> *sum;
+    lintel::Atomic<int32_t> *count;
+    void operator()(const int32_t &, int64_t &v) const {
+	sum->fetch_add(v);
+	count->fetch_add(1);
+    }
+};
+
+void basicTest() {
+    CountMap map(5);
+    SINVARIANT(map.nShards() == 8);
+    int64_t v = 0;
+    SINVARIANT(!map.lookup(3, v) && v == 0);
+    SINVARIANT(map.upsert(3, AddTo(5)));
+    SINVARIANT(!map.upsert(3, AddTo(2)));
+    SINVARIANT(map.lookup(3, v) && v == 7);
+    map.set(4, 11);
+    SINVARIANT(map.lookup(4, v) && v == 11 && map.exists(4) && map.size() == 2);
+    SINVARIANT(map.remove(4) && !map.remove(4, false) && !map.exists(4));
+    map.clear();
+    SINVARIANT(map.size() == 0);
+
+    ConcurrentHashMap<int32_t, int64_t> one(1);
+    SINVARIANT(one.nShards() == 1);
+    for(int32_t i = 0; i < 100; ++i) {
+	one.set(i, i);
+    }
+    SINVARIANT(one.size() == 100 && one.lookup(99, v) && v == 99);
+}
+
+// small int32_t keys hash to themselves, so they only spread over the
+// shards if the shard is picked from mixed bits.
+void spreadTest() {
+    CountMap map(64);
+    static const int32_t nspread = 64 * 1000;
+    for(int32_t i = 0; i < nspread; ++i) {
+	map.set(i, i);
+    }
+    size_t total = 0;
+    for(uint32_t i = 0; i < map.nShards(); ++i) {
+	size_t n = map.shardSize(i);
+	INVARIANT(n > 1000 / 2 && n < 1000 * 2,
+		  format("shard %d has %d of %d keys") % i % n % nspread);
+	total += n;
+    }
+    SINVARIANT(total == static_cast<size_t>(nspread));
+    cout << "spread test passed.\n";
+}
+
+void threadedTest(int32_t nthreads) {
+    CountMap map(16);
+    vector<PThreadFunction *> threads;
+    for(int32_t i = 0; i < nthreads; ++i) {
+	threads.push_back(new PThreadFunction(boost::bind(countWorker, &map, i)));
+	threads.back()->start();
+    }
+    for(int32_t i = 0; i < nthreads; ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+
+    SINVARIANT(map.size() == static_cast<size_t>(nkeys));
+    int64_t per_key = static_cast<int64_t>(nrounds) * nthreads * (nthreads + 1) / 2;
+    for(int32_t k = 0; k < nkeys; ++k) {
+	int64_t v;
+	SINVARIANT(map.lookup(k, v));
+	INVARIANT(v == per_key, format("key %d: %d != %d") % k % v % per_key);
+    }
+
+    for(int forEach_threads = 1; forEach_threads <= 4; ++forEach_threads) {
+	lintel::Atomic<int64_t> sum(0);
+	lintel::Atomic<int32_t> count(0);
+	SumAll fn;
+	fn.sum = &sum;
+	fn.count = &count;
+	map.forEach(fn, forEach_threads);
+	SINVARIANT(count.load() == nkeys && sum.load() == per_key * nkeys);
+    }
+    cout << format("%d thread test passed.\n") % nthreads;
+}
+
+int main() {
+    basicTest();
+    spreadTest();
+    threadedTest(1);
+    threadedTest(4);
+    cout << "success.\n";
+    return 0;
+}
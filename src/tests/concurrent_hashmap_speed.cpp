@@ -0,0 +1,85 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare aggregation throughput of ConcurrentHashMap against a
+    HashMap behind a single mutex for 1 to max-threads threads.
+
+    Usage: concurrent_hashmap_speed [max-threads [ops-per-thread [nkeys]]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/ConcurrentHashMap.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PThread.hpp>
+
+using namespace std;
+using boost::format;
+
+struct Increment {
+    void operator()(int64_t &v) const { ++v; }
+};
+
+class LockedMap {
+public:
+    void upsert(int64_t k, Increment fn) {
+	PThreadScopedLock lock(mutex);
+	fn(map[k]);
+    }
+private:
+    PThreadMutex mutex;
+    HashMap<int64_t, int64_t> map;
+};
+
+template<class M> void *worker(M *map, uint32_t seed, size_t nops, uint32_t nkeys) {
+    MersenneTwisterRandom rng(seed);
+    for(size_t i = 0; i < nops; ++i) {
+	map->upsert(rng.randInt(nkeys), Increment());
+    }
+    return NULL;
+}
+
+template<class M> double runTest(M &map, int nthreads, size_t nops, uint32_t nkeys) {
+    vector<PThreadFunction *> threads;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(int i = 0; i < nthreads; ++i) {
+	threads.push_back(new PThreadFunction(boost::bind(worker<M>, &map, i + 1, nops, nkeys)));
+	threads.back()->start();
+    }
+    for(int i = 0; i < nthreads; ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    return nthreads * nops / elapsed / 1.0e6;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 4, "Usage: concurrent_hashmap_speed [max-threads [ops-per-thread [nkeys]]]");
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    size_t nops = argc > 2 ? strtoul(argv[2], NULL, 10) : 2*1000*1000;
+    uint32_t nkeys = argc > 3 ? strtoul(argv[3], NULL, 10) : 1000*1000;
+    SINVARIANT(max_threads > 0 && nops > 0 && nkeys > 0);
+
+    cout << format("%d ops/thread, %d keys, %d cpus\n") % nops % nkeys
+	% PThreadMisc::getNCpus();
+    for(int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+	LockedMap locked;
+	ConcurrentHashMap<int64_t, int64_t> concurrent(256);
+	double locked_mops = runTest(locked, nthreads, nops, nkeys);
+	double concurrent_mops = runTest(concurrent, nthreads, nops, nkeys);
+	cout << format("%2d threads: mutex HashMap %7.2f Mops/s, ConcurrentHashMap %7.2f Mops/s\n")
+	    % nthreads % locked_mops % concurrent_mops;
+    }
+    return 0;
+}
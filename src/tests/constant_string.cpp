@@ -0,0 +1,150 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Test ConstantString, including creating the same strings from
+    many threads at once.
+*/
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/ConstantString.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PThread.hpp>
+
+using namespace std;
+using boost::format;
+
+void testBasic() {
+    ConstantString empty, empty2(""), empty3(static_cast<const void *>(NULL), 0);
+    SINVARIANT(empty.empty() && empty.size() == 0 && *empty.c_str() == '\0');
+    SINVARIANT(empty == empty2 && empty == empty3);
+
+    ConstantString a("hello"), b(string("hello")), c("hellO");
+    SINVARIANT(a == b && a.c_str() == b.c_str() && a != c);
+    SINVARIANT(a.size() == 5 && a.c_str()[5] == '\0' && a.str() == "hello");
+    SINVARIANT(c < a && a.compare(string("hello")) == 0 && a != "world");
+
+    // binary data with nulls has to be kept apart from the C string
+    // that is its prefix.
+    ConstantString bin1("ab\0cd", 5), bin2("ab\0ce", 5), bin3(string("ab\0cd", 5)), prefix("ab");
+    SINVARIANT(bin1 != bin2 && bin1 != prefix && bin1 == bin3);
+    SINVARIANT(bin1.size() == 5 && prefix.size() == 2 && bin1[3] == 'c');
+
+    // the stored hash is the hash of the bytes
+    SINVARIANT(empty.hash() == lintel::hashBytes("", 0));
+    SINVARIANT(a.hash() == lintel::hash(string("hello")) && lintel::hash(a) == a.hash());
+    SINVARIANT(bin1.hash() == lintel::hashBytes("ab\0cd", 5));
+
+    HashMap<ConstantString, int> map;
+    for(int i = 0; i < 10000; ++i) {
+	map[ConstantString((format("string %d") % i).str())] = i;
+    }
+    for(int i = 0; i < 10000; ++i) {
+	SINVARIANT(map[ConstantString((format("string %d") % i).str())] == i);
+    }
+    cout << "basic test passed.\n";
+}
+
+void testPools() {
+    ConstantStringPool pool1, pool2(1);
+    SINVARIANT(pool1.size() == 0 && pool1.memoryUsage() == 0);
+    ConstantString a("pooled", pool1), b(string("pooled"), pool2), c("pooled");
+    ConstantString a2("pooled", 6, pool1);
+    SINVARIANT(a.c_str() == a2.c_str() && a.c_str() != b.c_str() && a.c_str() != c.c_str());
+    SINVARIANT(a == b && b == c && a.hash() == b.hash() && a.compare(b) == 0);
+    SINVARIANT(a != ConstantString("pooleD", pool2) && a != ConstantString("poole", pool2));
+    SINVARIANT(pool1.size() == 1 && pool2.size() == 3 && pool1.memoryUsage() > 0);
+
+    // keys from different pools find each other
+    HashMap<ConstantString, int> map;
+    for(int i = 0; i < 1000; ++i) {
+	map[ConstantString((format("key %d") % i).str(), pool1)] = i;
+    }
+    for(int i = 0; i < 1000; ++i) {
+	SINVARIANT(map[ConstantString((format("key %d") % i).str(), pool2)] == i);
+    }
+    map.clear();
+
+    // empty strings are not in any pool
+    ConstantString empty("", pool1);
+    SINVARIANT(empty == ConstantString() && pool1.size() == 1001);
+
+    pool1.reset();
+    SINVARIANT(pool1.size() == 0 && pool1.memoryUsage() == 0 && empty.empty());
+    ConstantString d("pooled", pool1);
+    SINVARIANT(d == b && pool1.size() == 1);
+
+    // strings bigger than a buffer would start out as
+    string big(8000, 'b');
+    ConstantString e(big, pool1), f(big, pool1);
+    SINVARIANT(e.str() == big && e.c_str() == f.c_str());
+    cout << "pool test passed.\n";
+}
+
+void *internWorker(const vector<string> *strings, uint32_t seed,
+		   vector<const char *> *out, ConstantStringPool *pool) {
+    MersenneTwisterRandom rng(seed);
+    vector<size_t> order(strings->size());
+    for(size_t i = 0; i < order.size(); ++i) {
+	order[i] = i;
+    }
+    for(size_t i = order.size(); i > 1; --i) {
+	swap(order[i - 1], order[rng.randInt(i)]);
+    }
+    out->resize(strings->size());
+    for(size_t i = 0; i < order.size(); ++i) {
+	ConstantString cs((*strings)[order[i]], *pool);
+	(*out)[order[i]] = cs.c_str();
+    }
+    return NULL;
+}
+
+// Every thread interns the same strings in a different order; they
+// have to all end up with the same copy of each one.
+void testThreads(int nthreads, size_t nstrings, ConstantStringPool &pool) {
+    vector<string> strings;
+    for(size_t i = 0; i < nstrings; ++i) {
+	strings.push_back((format("threaded %d %s") % i % string(i % 50, 'x')).str());
+    }
+    vector<vector<const char *> > results(nthreads);
+    vector<PThreadFunction *> threads;
+    for(int i = 0; i < nthreads; ++i) {
+	threads.push_back(new PThreadFunction
+			  (boost::bind(internWorker, &strings, i + 1, &results[i], &pool)));
+	threads.back()->start();
+    }
+    for(int i = 0; i < nthreads; ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+    for(size_t i = 0; i < nstrings; ++i) {
+	ConstantString cs(strings[i], pool);
+	SINVARIANT(cs.str() == strings[i]);
+	for(int j = 0; j < nthreads; ++j) {
+	    SINVARIANT(results[j][i] == cs.c_str());
+	}
+    }
+    cout << format("thread test with %d threads passed.\n") % nthreads;
+}
+
+int main() {
+    testBasic();
+    testPools();
+    testThreads(8, 100000, ConstantStringPool::global());
+    ConstantString::dumpInfo();
+    // and again after a reset, when the threads have cached buffers
+    // that were freed
+    ConstantStringPool pool(8);
+    testThreads(8, 10000, pool);
+    pool.reset();
+    testThreads(8, 10000, pool);
+    SINVARIANT(pool.size() == 10000);
+    return 0;
+}
@@ -0,0 +1,79 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare std::string and ConstantString as keys of HashMap and
+    HashTupleStats, counting a stream of path-like identifiers; the
+    ConstantStrings are created before timing, as they would be by the
+    code reading the identifiers.
+
+    Usage: constant_string_key_speed [nkeys [nops]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/ConstantString.hpp>
+#include <Lintel/HashTupleStats.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+template<class K> double mapTest(const vector<K> &keys, const vector<uint32_t> &stream) {
+    HashMap<K, int64_t> map;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < stream.size(); ++i) {
+	++map[keys[stream[i]]];
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    SINVARIANT(map.size() <= keys.size());
+    return elapsed * 1.0e9 / stream.size();
+}
+
+template<class K> double tupleStatsTest(const vector<K> &keys, const vector<uint32_t> &stream) {
+    typedef boost::tuple<K, K> Tuple;
+    lintel::HashTupleStats<Tuple> hts;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i + 1 < stream.size(); ++i) {
+	hts.add(Tuple(keys[stream[i]], keys[stream[i + 1] % 64]), i);
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    return elapsed * 1.0e9 / (stream.size() - 1);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: constant_string_key_speed [nkeys [nops]]");
+    size_t nkeys = argc > 1 ? strtoul(argv[1], NULL, 10) : 100*1000;
+    size_t nops = argc > 2 ? strtoul(argv[2], NULL, 10) : 10*1000*1000;
+    SINVARIANT(nkeys >= 64 && nops > 1);
+
+    MersenneTwisterRandom rng;
+    cout << format("%d keys, %d ops, seed %d\n") % nkeys % nops % rng.seedUsed();
+    vector<string> strings;
+    vector<ConstantString> constant_strings;
+    for(size_t i = 0; i < nkeys; ++i) {
+	char buf[128];
+	snprintf(buf, sizeof(buf), "/home/user%lu/projects/dataseries/src/file-%lu.cpp",
+		 static_cast<unsigned long>(i % 97), static_cast<unsigned long>(i));
+	strings.push_back(buf);
+	constant_strings.push_back(ConstantString(buf));
+    }
+    vector<uint32_t> stream;
+    for(size_t i = 0; i < nops; ++i) {
+	stream.push_back(rng.randInt(nkeys));
+    }
+
+    cout << format("HashMap:        std::string %6.1f ns/op, ConstantString %6.1f ns/op\n")
+	% mapTest(strings, stream) % mapTest(constant_strings, stream);
+    cout << format("HashTupleStats: std::string %6.1f ns/op, ConstantString %6.1f ns/op\n")
+	% tupleStatsTest(strings, stream) % tupleStatsTest(constant_strings, stream);
+    return 0;
+}
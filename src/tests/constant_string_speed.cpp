@@ -0,0 +1,110 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Measure the throughput of creating ConstantStrings from 1 to
+    max-threads threads, both for strings that are new and for strings
+    that are already in the pool, and the time to free a pool of
+    strings compared to freeing the same strings held as std::string.
+
+    Usage: constant_string_speed [max-threads [strings-per-thread]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/ConstantString.hpp>
+#include <Lintel/PThread.hpp>
+
+using namespace std;
+using boost::format;
+
+void *internWorker(const vector<string> *strings) {
+    for(size_t i = 0; i < strings->size(); ++i) {
+	ConstantString cs((*strings)[i]);
+    }
+    return NULL;
+}
+
+double runTest(vector<vector<string> > &strings) {
+    vector<PThreadFunction *> threads;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < strings.size(); ++i) {
+	threads.push_back(new PThreadFunction(boost::bind(internWorker, &strings[i])));
+	threads.back()->start();
+    }
+    for(size_t i = 0; i < threads.size(); ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    return strings.size() * strings[0].size() / elapsed / 1.0e6;
+}
+
+void teardownTest(const vector<string> &strings) {
+    Clock::Tfrac start = Clock::todTfrac();
+    vector<string> *copies = new vector<string>(strings.begin(), strings.end());
+    double string_build = Clock::TfracToDouble(Clock::todTfrac() - start);
+    start = Clock::todTfrac();
+    delete copies;
+    double string_free = Clock::TfracToDouble(Clock::todTfrac() - start);
+
+    start = Clock::todTfrac();
+    ConstantStringPool *pool = new ConstantStringPool();
+    for(size_t i = 0; i < strings.size(); ++i) {
+	ConstantString cs(strings[i], *pool);
+    }
+    double pool_build = Clock::TfracToDouble(Clock::todTfrac() - start);
+    start = Clock::todTfrac();
+    delete pool;
+    double pool_free = Clock::TfracToDouble(Clock::todTfrac() - start);
+    cout << format("%d strings: std::string build %.3fs free %.3fs; "
+		   "ConstantStringPool build %.3fs free %.3fs\n")
+	% strings.size() % string_build % string_free % pool_build % pool_free;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: constant_string_speed [max-threads [strings-per-thread]]");
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    size_t nstrings = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000*1000;
+    SINVARIANT(max_threads > 0 && nstrings > 0);
+
+    cout << format("%d strings/thread, %d cpus\n") % nstrings % PThreadMisc::getNCpus();
+    for(int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+	// every thread has its own strings, half of which are shared
+	// with the next thread, so new strings are added both with and
+	// without contention.
+	vector<vector<string> > strings(nthreads);
+	for(int i = 0; i < nthreads; ++i) {
+	    for(size_t j = 0; j < nstrings; ++j) {
+		char buf[64];
+		snprintf(buf, sizeof(buf), "%d-%d-%lu", nthreads, (i + static_cast<int>(j % 2)) % nthreads,
+			 static_cast<unsigned long>(j));
+		strings[i].push_back(buf);
+	    }
+	}
+	double new_mops = runTest(strings);
+	double existing_mops = runTest(strings);
+	cout << format("%2d threads: new strings %7.2f Mops/s, existing strings %7.2f Mops/s\n")
+	    % nthreads % new_mops % existing_mops;
+    }
+    ConstantString::dumpInfo();
+
+    vector<string> strings;
+    for(size_t i = 0; i < nstrings; ++i) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "/some/long/path/name/%lu", static_cast<unsigned long>(i));
+	strings.push_back(buf);
+    }
+    teardownTest(strings);
+    return 0;
+}
@@ -9,10 +9,12 @@
     test for deque
 */
 
-// TODO: add performance comparison to this test
 #include <iostream>
 #include <inttypes.h>
 #include <deque>
+#include <iterator>
+#include <string>
+#include <vector>
 
 #include <Lintel/Deque.hpp>
 #include <Lintel/MersenneTwisterRandom.hpp>
@@ -162,6 +164,191 @@ void testDestroy() {
     SINVARIANT(Thing::thing_count == 0);
 }
 
+void testPushFrontPopBack() {
+    Deque<int> deque(4);
+
+    for(int i = 0; i < 10; ++i) {
+	deque.push_front(i);
+	SINVARIANT(deque.front() == i && deque.size() == static_cast<size_t>(i + 1));
+    }
+    for(int i = 0; i < 10; ++i) {
+	SINVARIANT(deque.at(i) == 9 - i);
+    }
+    for(int i = 0; i < 10; ++i) {
+	SINVARIANT(deque.back() == i);
+	deque.pop_back();
+    }
+    SINVARIANT(deque.empty());
+
+    // capacity is all usable, and rounded up to a power of two
+    Deque<int> small(3);
+    SINVARIANT(small.capacity() == 4);
+    for(int i = 0; i < 4; ++i) {
+	small.push_back(i);
+    }
+    SINVARIANT(small.capacity() == 4 && small.size() == 4);
+    small.push_back(4);
+    SINVARIANT(small.capacity() == 8 && small.size() == 5);
+}
+
+// reserve() on a deque that has wrapped around has to keep the values in order.
+void testReserve() {
+    Deque<NoDefaultConstructor> deque(8);
+    for(int i = 0; i < 6; ++i) {
+	deque.push_back(NoDefaultConstructor(i));
+    }
+    for(int i = 0; i < 4; ++i) {
+	deque.pop_front();
+	deque.push_back(NoDefaultConstructor(6 + i));
+    }
+    deque.reserve(100);
+    SINVARIANT(deque.capacity() == 128 && deque.size() == 6);
+    SINVARIANT(NoDefaultConstructor::ndc_count == 6);
+    for(int i = 0; i < 6; ++i) {
+	SINVARIANT(deque.at(i).v == 4 + i);
+    }
+    deque.reserve(10);
+    SINVARIANT(deque.capacity() == 128);
+    deque.clear();
+    SINVARIANT(NoDefaultConstructor::ndc_count == 0);
+}
+
+void testBulk() {
+    Deque<int> deque(16);
+    vector<int> in, out;
+    for(int i = 0; i < 100; ++i) {
+	in.push_back(i);
+    }
+    // start near the end of the array so the bulk operations wrap
+    for(int i = 0; i < 12; ++i) {
+	deque.push_back(-1);
+	deque.pop_front();
+    }
+    deque.push_back(&in[0], 10);
+    SINVARIANT(deque.size() == 10 && deque.capacity() == 16);
+    out.resize(7);
+    SINVARIANT(deque.pop_front(7, out.begin()) == out.end());
+    for(int i = 0; i < 7; ++i) {
+	SINVARIANT(out[i] == i);
+    }
+    deque.push_back(&in[10], 90); // grows
+    SINVARIANT(deque.size() == 93);
+    out.clear();
+    deque.pop_front(93, back_inserter(out));
+    SINVARIANT(deque.empty() && out.size() == 93);
+    for(int i = 0; i < 93; ++i) {
+	SINVARIANT(out[i] == 7 + i);
+    }
+
+    // bulk operations on values with constructors
+    Deque<string> strings(4);
+    vector<string> sin(9, "abc"), sout(9);
+    strings.push_back("x");
+    strings.pop_front();
+    strings.push_back(sin);
+    strings.pop_front(9, sout.begin());
+    SINVARIANT(strings.empty() && sout == sin);
+}
+
+#if __cplusplus >= 201103L
+struct CopyCounter {
+    CopyCounter(int v) : v(v) { }
+    CopyCounter(const CopyCounter &from) : v(from.v) { ++copies; }
+    CopyCounter(CopyCounter &&from) : v(from.v) { from.v = -1; }
+    CopyCounter &operator=(const CopyCounter &from) { v = from.v; ++copies; return *this; }
+    CopyCounter &operator=(CopyCounter &&from) { v = from.v; from.v = -1; return *this; }
+
+    int v;
+    static int copies;
+};
+
+int CopyCounter::copies;
+
+// nothing should be copied by moving in, growing, emplacing, or bulk popping.
+void testMove() {
+    Deque<CopyCounter> deque(2);
+    for(int i = 0; i < 50; ++i) {
+	CopyCounter c(i);
+	deque.push_back(std::move(c));
+	deque.emplace_front(-i);
+    }
+    SINVARIANT(deque.size() == 100);
+    vector<CopyCounter> out(100, CopyCounter(0));
+    CopyCounter::copies = 0;
+    deque.pop_front(100, out.begin());
+    for(int i = 0; i < 50; ++i) {
+	SINVARIANT(out[i].v == i - 49 && out[50 + i].v == i);
+    }
+    SINVARIANT(CopyCounter::copies == 0);
+}
+#else
+void testMove() { }
+#endif
+
+// all of the operations mixed against std::deque
+void testRandomOps(int seed) {
+    MersenneTwisterRandom rng(seed);
+    deque<int> std_deq;
+    Deque<int> lintel_deq(2);
+    vector<int> buf;
+
+    for(int i = 0; i < 20000; ++i) {
+	switch(rng.randInt(8)) {
+	case 0: case 1: {
+	    int v = rng.randInt();
+	    std_deq.push_back(v);
+	    lintel_deq.push_back(v);
+	    break;
+	}
+	case 2: {
+	    int v = rng.randInt();
+	    std_deq.push_front(v);
+	    lintel_deq.push_front(v);
+	    break;
+	}
+	case 3: case 4:
+	    if (!std_deq.empty()) {
+		std_deq.pop_front();
+		lintel_deq.pop_front();
+	    }
+	    break;
+	case 5:
+	    if (!std_deq.empty()) {
+		std_deq.pop_back();
+		lintel_deq.pop_back();
+	    }
+	    break;
+	case 6: {
+	    buf.resize(rng.randInt(20) + 1);
+	    for(size_t j = 0; j < buf.size(); ++j) {
+		buf[j] = rng.randInt();
+	    }
+	    std_deq.insert(std_deq.end(), buf.begin(), buf.end());
+	    lintel_deq.push_back(buf);
+	    break;
+	}
+	case 7: {
+	    size_t n = min(std_deq.size(), static_cast<size_t>(rng.randInt(20)));
+	    buf.resize(n);
+	    lintel_deq.pop_front(n, buf.begin());
+	    for(size_t j = 0; j < n; ++j) {
+		SINVARIANT(buf[j] == std_deq.front());
+		std_deq.pop_front();
+	    }
+	    break;
+	}
+	}
+	SINVARIANT(std_deq.size() == lintel_deq.size());
+	if (!std_deq.empty()) {
+	    SINVARIANT(std_deq.front() == lintel_deq.front());
+	    SINVARIANT(std_deq.back() == lintel_deq.back());
+	    size_t pos = rng.randInt(std_deq.size());
+	    SINVARIANT(std_deq[pos] == lintel_deq.at(pos));
+	}
+    }
+    SINVARIANT(equal(std_deq.begin(), std_deq.end(), lintel_deq.begin()));
+}
+
 void performSortingTest(int seed = 0) {
     MersenneTwisterRandom rng(seed);
     deque<int> std_deq;
@@ -278,6 +465,13 @@ int main(int, char **) {
     testDestroy();
     testSorting();
     testIteratorOperations();
+    testPushFrontPopBack();
+    testReserve();
+    testBulk();
+    testMove();
+    for(int seed = 1; seed <= 5; ++seed) {
+	testRandomOps(seed);
+    }
     cout << "deque tests passed.\n";
 }
 
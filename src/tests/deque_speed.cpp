@@ -0,0 +1,131 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Time the basic operations of Deque and std::deque: a FIFO and a
+    stack at the back, each held at a fixed depth, a scan with at(),
+    and moving values in and out in blocks.  Reports ns per value.
+
+    Usage: deque_speed [nops [depth]]
+*/
+
+#include <stdlib.h>
+
+#include <deque>
+#include <iostream>
+#include <vector>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/Deque.hpp>
+
+using namespace std;
+using boost::format;
+
+static const size_t block_size = 64;
+
+template<class T> T &at(deque<T> &q, size_t pos) { return q[pos]; }
+template<class T> T &at(Deque<T> &q, size_t pos) { return q.at(pos); }
+
+template<class T> void pushBlock(deque<T> &q, const T *vals, size_t n) {
+    q.insert(q.end(), vals, vals + n);
+}
+template<class T> void pushBlock(Deque<T> &q, const T *vals, size_t n) {
+    q.push_back(vals, n);
+}
+
+template<class T> void popBlock(deque<T> &q, T *out, size_t n) {
+    copy(q.begin(), q.begin() + n, out);
+    q.erase(q.begin(), q.begin() + n);
+}
+template<class T> void popBlock(Deque<T> &q, T *out, size_t n) {
+    q.pop_front(n, out);
+}
+
+class Timer {
+public:
+    Timer(const string &what, size_t nops) : what(what), nops(nops), start(Clock::todTfrac()) { }
+    ~Timer() {
+	double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+	cout << format("  %-8s %6.2f ns/op\n") % what % (elapsed * 1.0e9 / nops);
+    }
+private:
+    string what;
+    size_t nops;
+    Clock::Tfrac start;
+};
+
+template<class Q> int64_t runTests(const string &name, size_t nops, size_t depth) {
+    int64_t sum = 0;
+    cout << name << ":\n";
+    {
+	Q q;
+	Timer t("fifo", nops);
+	for(size_t i = 0; i < nops; ++i) {
+	    q.push_back(i);
+	    if (q.size() > depth) {
+		sum += q.front();
+		q.pop_front();
+	    }
+	}
+    }
+    {
+	Q q;
+	Timer t("stack", nops);
+	for(size_t i = 0; i < nops; ++i) {
+	    q.push_back(i);
+	    if (q.size() > depth) {
+		sum += q.back();
+		q.pop_back();
+		q.pop_back();
+	    }
+	}
+    }
+    {
+	Q q;
+	for(size_t i = 0; i < depth; ++i) {
+	    q.push_back(i);
+	    q.pop_front(); // start part way around the array
+	}
+	for(size_t i = 0; i < depth; ++i) {
+	    q.push_back(i);
+	}
+	Timer t("at", nops);
+	for(size_t i = 0; i < nops; i += depth) {
+	    for(size_t j = 0; j < depth; ++j) {
+		sum += at(q, j);
+	    }
+	}
+    }
+    {
+	Q q;
+	vector<int64_t> in(block_size), out(block_size);
+	for(size_t i = 0; i < block_size; ++i) {
+	    in[i] = i;
+	}
+	Timer t("block", nops);
+	for(size_t i = 0; i < nops; i += block_size) {
+	    pushBlock(q, &in[0], block_size);
+	    if (q.size() > depth) {
+		popBlock(q, &out[0], block_size);
+		sum += out[i % block_size];
+	    }
+	}
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: deque_speed [nops [depth]]");
+    size_t nops = argc > 1 ? strtoul(argv[1], NULL, 10) : 100*1000*1000;
+    size_t depth = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+    SINVARIANT(nops > 0 && depth > 0);
+
+    cout << format("%d operations, depth %d\n") % nops % depth;
+    int64_t a = runTests<deque<int64_t> >("std::deque", nops, depth);
+    int64_t b = runTests<Deque<int64_t> >("Deque", nops, depth);
+    INVARIANT(a == b, format("%d != %d") % a % b);
+    return 0;
+}
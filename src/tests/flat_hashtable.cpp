@@ -0,0 +1,290 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    FlatHashTable test program
+*/
+
+#include <stdio.h>
+
+#include <map>
+#include <string>
+
+#include <Lintel/FlatHashTable.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/HashUnique.hpp>
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+class intHash {
+public:
+    unsigned int operator()(const int k) const {
+	return k;
+    }
+};
+
+class collisionHash {
+public:
+    unsigned int operator()(const int) const {
+	return 0;
+    }
+};
+
+class intEqual {
+public:
+    bool operator()(const int a, const int b) const {
+	return a == b;
+    }
+};
+
+typedef FlatHashTable<int,intHash,intEqual> inttable;
+
+void iterateTest(const inttable &table, int maxi) {
+    vector<bool> found;
+    found.resize(maxi);
+    for(inttable::const_iterator i = table.begin(); i != table.end(); ++i) {
+	SINVARIANT(*i < maxi);
+	SINVARIANT(found[*i] == false);
+	found[*i] = true;
+    }
+    for(int i=0; i<maxi; ++i) {
+	SINVARIANT(found[i]);
+    }
+}
+
+void collisionTest() {
+    printf("test collision add/remove\n");
+
+    FlatHashTable<int,collisionHash,intEqual> collisiontable;
+    for(int i=0;i<100;i++) {
+	collisiontable.add(i);
+    }
+    for(int i=0;i<100;i+=2) {
+	collisiontable.remove(i);
+	size_t count = 0;
+	for (FlatHashTable<int,collisionHash,intEqual>::iterator i = collisiontable.begin();
+	     i != collisiontable.end();i++) {
+	    count++;
+	}
+	INVARIANT(count == collisiontable.size(),
+		  boost::format("?! %d %d") % count % collisiontable.size());
+    }
+    for(int i=1;i<100;i+=2) {
+	SINVARIANT(collisiontable.lookup(i) != NULL);
+	SINVARIANT(collisiontable.lookup(i-1) == NULL);
+    }
+
+    // multiple adds of the same key are *supposed* to add multiple times.
+    collisiontable.clear();
+    SINVARIANT(collisiontable.size() == 0);
+    for(int i=0;i<100;i++) {
+	collisiontable.add(i);
+	collisiontable.add(i);
+    }
+    SINVARIANT(collisiontable.size() == 200);
+    for(int i=0;i<100;i++) {
+	collisiontable.remove(i, true);
+	collisiontable.remove(i, true);
+    }
+    SINVARIANT(collisiontable.size() == 0);
+
+    for(int i=0;i<100;i++) {
+	bool replaced;
+	collisiontable.addOrReplace(i, replaced);
+	SINVARIANT(replaced == false);
+	collisiontable.addOrReplace(i, replaced);
+	SINVARIANT(replaced == true);
+    }
+    SINVARIANT(collisiontable.size() == 100);
+
+    Stats probes;
+    collisiontable.chainLengthStats(probes);
+    SINVARIANT(probes.count() == 100 && probes.max() > 1);
+}
+
+void generalTest() {
+    int maxi = 20000;
+    inttable table;
+
+    printf("test adding...\n");
+    for(int i=0;i<maxi;i++) {
+	SINVARIANT(table.size() == static_cast<size_t>(i));
+	table.add(i);
+    }
+    SINVARIANT(table.capacity() >= table.size());
+    iterateTest(table, maxi);
+
+    for(int i=0;i<maxi;i++) {
+	SINVARIANT(table.lookup(i) != NULL && *table.lookup(i) == i);
+	SINVARIANT(table.find(i) != table.end() && *table.find(i) == i);
+    }
+    SINVARIANT(table.lookup(maxi) == NULL);
+    for(inttable::iterator i = table.begin();i != table.end();i++) {
+	SINVARIANT(table.find(*i) == i);
+    }
+
+    table.add(777777);
+    table.remove(777777); // have something removed when copying
+    printf("test copying...\n");
+    inttable table2;
+    table2 = table;
+    SINVARIANT(table2.size() == table.size());
+    iterateTest(table2, maxi);
+    inttable table3(table2);
+    iterateTest(table3, maxi);
+
+    printf("test removing...\n");
+    for(int i=0;i<maxi/2;i++) {
+	SINVARIANT(static_cast<int>(table.size()) == maxi-i);
+	table.remove(i);
+    }
+    for(int i=0;i<maxi;i++) {
+	SINVARIANT((table.lookup(i) != NULL) == (i >= maxi/2));
+    }
+    table.remove(5, false);
+    table.clear();
+    SINVARIANT(table.empty() && table.begin() == table.end());
+
+    printf("test reserve...\n");
+    table.add(1);
+    table.reserve(maxi);
+    size_t mem = table.memoryUsage();
+    for(int i=2;i<maxi;i++) {
+	table.add(i);
+    }
+    SINVARIANT(table.memoryUsage() == mem && *table.lookup(1) == 1);
+}
+
+// Random add/remove against std::map; keeps the table at about the
+// same size so that deleted slots accumulate and get cleaned up by
+// the same-size rehash.
+void churnTest() {
+    MersenneTwisterRandom rng;
+
+    cout << format("churn test using seed %d\n") % rng.seedUsed();
+    inttable table;
+    map<int, int> model;
+
+    for(uint32_t round = 0; round < 200000; ++round) {
+	int v = rng.randInt(5000);
+	if (model[v] > 0 && rng.randInt(2) == 0) {
+	    table.remove(v);
+	    --model[v];
+	} else if (model[v] < 2) {
+	    table.add(v);
+	    ++model[v];
+	}
+    }
+    size_t total = 0;
+    for(map<int, int>::iterator i = model.begin(); i != model.end(); ++i) {
+	total += i->second;
+	SINVARIANT((table.lookup(i->first) != NULL) == (i->second > 0));
+    }
+    SINVARIANT(table.size() == total);
+    size_t count = 0;
+    for(inttable::iterator i = table.begin(); i != table.end(); ++i) {
+	++count;
+    }
+    SINVARIANT(count == total);
+}
+
+void eraseTest() {
+    MersenneTwisterRandom rng;
+
+    cout << format("erase test using seed %d\n") % rng.seedUsed();
+    inttable table;
+    for (int i = 0; i < 1000; ++i) {
+	table.add(i);
+    }
+    // erase all the odd entries while walking the table
+    for(inttable::iterator i = table.begin(); i != table.end(); ) {
+	if (*i % 2 == 1) {
+	    table.erase(i);
+	    i.partialReset();
+	} else {
+	    ++i;
+	}
+    }
+    SINVARIANT(table.size() == 500);
+    for (int i = 0; i < 1000; ++i) {
+	SINVARIANT((table.lookup(i) != NULL) == (i % 2 == 0));
+    }
+}
+
+static int live_objects;
+
+struct Counted {
+    Counted(int _v = 0) : v(_v) { ++live_objects; }
+    Counted(const Counted &from) : v(from.v) { ++live_objects; }
+    ~Counted() { --live_objects; }
+    bool operator==(const Counted &rhs) const { return v == rhs.v; }
+    int v;
+};
+
+struct CountedHash {
+    uint32_t operator()(const Counted &c) const { return c.v; }
+};
+
+void destructionTest() {
+    printf("test destruction...\n");
+    {
+	FlatHashTable<Counted, CountedHash, std::equal_to<Counted> > table;
+	for(int i = 0; i < 1000; ++i) {
+	    table.add(Counted(i));
+	}
+	SINVARIANT(live_objects == 1000);
+	for(int i = 0; i < 500; ++i) {
+	    table.remove(Counted(i));
+	}
+	SINVARIANT(live_objects == 500);
+	FlatHashTable<Counted, CountedHash, std::equal_to<Counted> > table2(table);
+	SINVARIANT(live_objects == 1000);
+	table2.clear();
+	SINVARIANT(live_objects == 500);
+    }
+    SINVARIANT(live_objects == 0);
+}
+
+void backendTest() {
+    printf("test HashMap/HashUnique backend...\n");
+    HashMap<string, unsigned, HashMap_hash<const string>,
+	std::equal_to<const string>, FlatHashTableBackend> test;
+
+    for(unsigned i = 0; i < 1000; ++i) {
+	test[str(format("%d") % i)] = i;
+    }
+    SINVARIANT(test.size() == 1000);
+    for(unsigned i = 0; i < 1000; ++i) {
+	SINVARIANT(test[str(format("%d") % i)] == i);
+    }
+    SINVARIANT(!test.exists("abc"));
+    test.remove("17");
+    SINVARIANT(!test.exists("17") && test.size() == 999);
+
+    HashUnique<int, HashMap_hash<const int>, std::equal_to<const int>,
+	FlatHashTableBackend> unique;
+    for(int i = 0; i < 1000; ++i) {
+	SINVARIANT(unique.add(i));
+	SINVARIANT(!unique.add(i));
+    }
+    SINVARIANT(unique.size() == 1000 && unique.exists(999) && !unique.exists(1000));
+}
+
+int main(int argc, char **) {
+    SINVARIANT(argc == 1);
+
+    collisionTest();
+    generalTest();
+    churnTest();
+    eraseTest();
+    destructionTest();
+    backendTest();
+
+    printf("success.\n");
+}
@@ -0,0 +1,112 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare the speed and memory usage of the chained HashTable and
+    the FlatHashTable as HashMap backends.
+
+    Usage: flat_hashtable_speed [nkeys [lookup-rounds]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/FlatHashTable.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/HashUnique.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef Clock::Tfrac Tfrac;
+
+typedef HashMap<int64_t, int64_t> ChainedMap;
+typedef HashMap<int64_t, int64_t, HashMap_hash<const int64_t>,
+		std::equal_to<const int64_t>, FlatHashTableBackend> FlatMap;
+
+static double nsPerOp(Tfrac start, Tfrac stop, size_t nops) {
+    return Clock::TfracToDouble(stop - start) / nops * 1.0e9;
+}
+
+template<class M> void speedTest(const string &name, const vector<int64_t> &keys,
+				 const vector<int64_t> &misses, unsigned rounds) {
+    M map;
+    Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < keys.size(); ++i) {
+	map[keys[i]] = i;
+    }
+    Tfrac stop = Clock::todTfrac();
+    double insert_ns = nsPerOp(start, stop, keys.size());
+    double bytes_per_entry = static_cast<double>(map.memoryUsage()) / keys.size();
+
+    int64_t sum = 0;
+    start = Clock::todTfrac();
+    for(unsigned r = 0; r < rounds; ++r) {
+	for(size_t i = 0; i < keys.size(); ++i) {
+	    sum += *map.lookup(keys[i]);
+	}
+    }
+    stop = Clock::todTfrac();
+    double hit_ns = nsPerOp(start, stop, keys.size() * rounds);
+
+    size_t found = 0;
+    start = Clock::todTfrac();
+    for(unsigned r = 0; r < rounds; ++r) {
+	for(size_t i = 0; i < misses.size(); ++i) {
+	    if (map.lookup(misses[i]) != NULL) {
+		++found;
+	    }
+	}
+    }
+    stop = Clock::todTfrac();
+    double miss_ns = nsPerOp(start, stop, misses.size() * rounds);
+
+    start = Clock::todTfrac();
+    for(size_t i = 0; i < keys.size(); i += 2) {
+	map.remove(keys[i]);
+    }
+    stop = Clock::todTfrac();
+    double remove_ns = nsPerOp(start, stop, (keys.size() + 1) / 2);
+
+    int64_t n = keys.size();
+    SINVARIANT(found == 0 && sum == rounds * (n * (n - 1) / 2));
+    cout << format("%-8s: insert %7.2f ns, hit %7.2f ns, miss %7.2f ns, remove %7.2f ns, %6.2f bytes/entry\n")
+	% name % insert_ns % hit_ns % miss_ns % remove_ns
+	% bytes_per_entry;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: flat_hashtable_speed [nkeys [lookup-rounds]]");
+    size_t nkeys = argc > 1 ? strtoul(argv[1], NULL, 10) : 4*1000*1000;
+    unsigned rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 4;
+    SINVARIANT(nkeys > 0 && rounds > 0);
+
+    MersenneTwisterRandom rng;
+    cout << format("%d keys, %d lookup rounds, seed %d\n") % nkeys % rounds % rng.seedUsed();
+
+    // keys have a zero low bit, misses a one, so they never overlap
+    vector<int64_t> keys, misses;
+    keys.reserve(nkeys);
+    misses.reserve(nkeys);
+    HashUnique<int64_t> seen;
+    while(keys.size() < nkeys) {
+	int64_t v = rng.randLongLong() & ~1ULL;
+	if (seen.add(v)) {
+	    keys.push_back(v);
+	    misses.push_back(v | 1);
+	}
+    }
+    MT_random_shuffle(misses.begin(), misses.end(), rng);
+
+    speedTest<ChainedMap>("chained", keys, misses, rounds);
+    speedTest<FlatMap>("flat", keys, misses, rounds);
+    return 0;
+}
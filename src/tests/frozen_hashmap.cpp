@@ -0,0 +1,125 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    FrozenHashMap test program
+*/
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Lintel/FlatHashTable.hpp>
+#include <Lintel/FrozenHashMap.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/TestUtil.hpp>
+
+using namespace std;
+
+typedef FrozenHashMap<int32_t, int32_t> IntFrozen;
+
+template<class Map> void checkSquares(const Map &from, int32_t n) {
+    IntFrozen frozen(from);
+    SINVARIANT(frozen.size() == from.size() && !frozen.empty());
+    for(int32_t i = -n; i < 2 * n; ++i) {
+	const int32_t *v = frozen.lookup(i);
+	if (i >= 0 && i < n) {
+	    SINVARIANT(v != NULL && *v == i * i && frozen.exists(i));
+	} else {
+	    SINVARIANT(v == NULL && !frozen.exists(i));
+	}
+    }
+    size_t count = 0;
+    for(IntFrozen::const_iterator i = frozen.begin(); i != frozen.end(); ++i) {
+	SINVARIANT(i->second == i->first * i->first);
+	++count;
+    }
+    SINVARIANT(count == from.size());
+}
+
+template<class Backend> void testFromHashMap() {
+    HashMap<int32_t, int32_t, HashMap_hash<const int32_t>, std::equal_to<const int32_t>,
+	Backend> hm;
+    for(int32_t i = 0; i < 10000; ++i) {
+	hm[i] = i * i;
+    }
+    checkSquares(hm, 10000);
+}
+
+// Keys that only differ in their high bits all have the same low bits
+// under the identity hash of the integers; without mixing they would
+// share one probe run, taking minutes to build and look up.
+void testAlignedKeys() {
+    HashMap<int32_t, int32_t> hm;
+    static const int32_t n = 100000;
+    for(int32_t i = 0; i < n; ++i) {
+	hm[i << 14] = i;
+    }
+    IntFrozen frozen(hm);
+    SINVARIANT(frozen.size() == static_cast<size_t>(n));
+    for(int32_t i = 0; i < n; ++i) {
+	SINVARIANT(*frozen.lookup(i << 14) == i);
+	SINVARIANT(!frozen.exists((i << 14) + 1));
+    }
+}
+
+void testFromMap() {
+    map<int32_t, int32_t> m;
+    for(int32_t i = 0; i < 1000; ++i) {
+	m[i] = i * i;
+    }
+    checkSquares(m, 1000);
+    m.clear();
+    m[0] = 0;
+    checkSquares(m, 1);
+}
+
+void testEmpty() {
+    IntFrozen frozen;
+    SINVARIANT(frozen.empty() && frozen.size() == 0 && frozen.begin() == frozen.end());
+    SINVARIANT(frozen.lookup(0) == NULL && !frozen.exists(17));
+
+    IntFrozen copy(frozen);
+    SINVARIANT(copy.empty() && !copy.exists(0));
+}
+
+void testStringRef() {
+    HashMap<string, int, lintel::StringHash, lintel::StringEqual> hm;
+    hm["abc"] = 1;
+    hm["abcdef"] = 2;
+    hm[string("a\0b", 3)] = 3;
+    hm[""] = 4;
+
+    FrozenHashMap<string, int, lintel::StringHash, lintel::StringEqual> frozen(hm);
+    const char *buf = "abcdefa\0b";
+    SINVARIANT(*frozen.lookup(lintel::StringRef(buf, 3)) == 1);
+    SINVARIANT(*frozen.lookup(lintel::StringRef(buf, 6)) == 2);
+    SINVARIANT(*frozen.lookup(lintel::StringRef(buf + 6, 3)) == 3);
+    SINVARIANT(*frozen.lookup(lintel::StringRef(buf, 0)) == 4);
+    SINVARIANT(frozen.lookup(lintel::StringRef(buf, 4)) == NULL);
+    SINVARIANT(*frozen.lookup(string("abc")) == 1);
+}
+
+void testDuplicates() {
+    vector<pair<int32_t, int32_t> > dups;
+    dups.push_back(make_pair(1, 1));
+    dups.push_back(make_pair(2, 2));
+    dups.push_back(make_pair(1, 3));
+    TEST_INVARIANT_MSG1(IntFrozen tmp(dups), "FrozenHashMap built from duplicate keys");
+}
+
+int main() {
+    testFromHashMap<HashTableChainedBackend>();
+    testFromHashMap<FlatHashTableBackend>();
+    testFromMap();
+    testAlignedKeys();
+    testEmpty();
+    testStringRef();
+    testDuplicates();
+    cout << "FrozenHashMap tests passed.\n";
+    return 0;
+}
@@ -3,6 +3,8 @@
 
    See the file named COPYING for license details
 */
+#include <string.h>
+
 #include <iostream>
 
 #include <Lintel/AssertBoost.hpp>
@@ -58,6 +60,67 @@ ostream &operator <<(ostream &to, const TestHash &a) {
     return to;
 }
 
+struct TestHash64 {
+    int x;
+    uint64_t hash64() const {
+	return x * 3;
+    }
+};
+
+void check64() {
+    // standard check values for crc32c
+    const char *digits = "123456789";
+    SINVARIANT(lintel::crc32c(0, digits, 9) == 0xE3069283);
+    char zeros[32];
+    memset(zeros, 0, sizeof(zeros));
+    SINVARIANT(lintel::crc32c(0, zeros, 32) == 0x8A9136AA);
+    SINVARIANT(lintel::crc32c(lintel::crc32c(0, digits, 4), digits + 4, 5) == 0xE3069283);
+
+    string buf;
+    for(int i = 0; i < 300; ++i) {
+	buf.push_back(static_cast<char>(i * 37 + 11));
+    }
+    for(size_t len = 0; len < buf.size(); ++len) {
+	for(size_t offset = 0; offset < 8; ++offset) {
+	    SINVARIANT(lintel::crc32c(7, buf.data() + offset, len) 
+		       == lintel::detail::crc32cSoftware(7, buf.data() + offset, len));
+	}
+    }
+
+    // pin the 64 bit hash so it stays stable across releases, since
+    // it may be stored.
+    SINVARIANT(lintel::hashBytes64("", 0) == 0x0409638ee2bde459ULL);
+    SINVARIANT(lintel::hashBytes64("a", 1) == 0x28d2053309d28531ULL);
+    SINVARIANT(lintel::hashBytes64(digits, 9) == 0xc3901284d62a3e7bULL);
+    SINVARIANT(lintel::hashBytes64(buf.data(), 300, 42) == 0xc7a1ddc8d8e13e42ULL);
+
+    HashUnique<uint64_t> seen;
+    for(size_t len = 0; len < buf.size(); ++len) {
+	SINVARIANT(seen.add(lintel::hashBytes64(buf.data(), len)));
+	SINVARIANT(seen.add(lintel::hashBytes64(buf.data(), len, 1)));
+	SINVARIANT(lintel::hashBytes64(buf.data(), len) 
+		   == lintel::hashBytes64(string(buf.data(), len).data(), len));
+    }
+
+    SINVARIANT(lintel::hash64(5) == lintel::mix64(5) && lintel::mix64(0) == 0);
+    SINVARIANT(lintel::hash64(static_cast<uint8_t>(5)) == lintel::mix64(5));
+    SINVARIANT(lintel::hash64(string("abc")) == lintel::hashBytes64("abc", 3));
+    SINVARIANT(lintel::hash64(lintel::StringRef("abcd", 3)) == lintel::hashBytes64("abc", 3));
+    TestHash64 t64 = { 5 };
+    SINVARIANT(lintel::hash64(t64) == 15);
+    SINVARIANT(lintel::hash64(make_pair(1, string("x"))) 
+	       == lintel::mix64(lintel::mix64(1), lintel::hashBytes64("x", 1)));
+    SINVARIANT(lintel::mix64(1, 2) != lintel::mix64(2, 1));
+
+    HashMap<string, int, lintel::Hash64To32<string>, lintel::StringEqual> map;
+    map["abc"] = 1;
+    map["def"] = 2;
+    SINVARIANT(*map.lookup(lintel::StringRef("abcdef", 3)) == 1);
+    SINVARIANT(*map.lookup(lintel::StringRef("abcdef" + 3, 3)) == 2);
+    cout << format("passed hashfns 64 bit tests; crc32c %s\n") 
+	% (lintel::detail::crc32cHardware() ? "sse4.2" : "software");
+}
+
 int main() {
     bool a = true;
     char b = 'a';
@@ -102,6 +165,7 @@ int main() {
 
     BOOST_STATIC_ASSERT(sizeof(xhash(o)) != 4);
     cout << "passed hashfns tests\n";
+    check64();
 
     return 0;
 }
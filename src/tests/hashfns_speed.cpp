@@ -0,0 +1,132 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare the throughput of lintel::hashBytes, lintel::hashBytes64
+    and lintel::crc32c for key sizes from 4 bytes to 4KiB, and measure
+    how well each of them avalanches: for every input bit flipped, each
+    output bit should flip half of the time.
+
+    Usage: hashfns_speed [bytes-per-size [avalanche-trials]]
+*/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/HashFns.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+struct HashBytes32 {
+    static const int nbits = 32;
+    uint64_t operator()(const void *p, size_t len) const {
+	return lintel::hashBytes(p, len);
+    }
+};
+
+struct HashBytes64 {
+    static const int nbits = 64;
+    uint64_t operator()(const void *p, size_t len) const {
+	return lintel::hashBytes64(p, len);
+    }
+};
+
+struct Crc32c {
+    static const int nbits = 32;
+    uint64_t operator()(const void *p, size_t len) const {
+	return lintel::crc32c(0, p, len);
+    }
+};
+
+// returns ns/hash; prints GB/s
+template<class Fn> double throughput(const vector<uint8_t> &buf, size_t keysize, size_t nbytes) {
+    Fn fn;
+    size_t nkeys = max(nbytes / keysize, static_cast<size_t>(1));
+    size_t nslots = buf.size() - keysize;
+    uint64_t sum = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < nkeys; ++i) {
+	// vary the starting point so every alignment is measured
+	sum += fn(&buf[(i * 7) % nslots], keysize);
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    if (sum == 42) { // keep the loop from being optimized away
+	cout << "";
+    }
+    cout << format(" %6.2f GB/s") % (nkeys * keysize / elapsed / 1.0e9);
+    return elapsed * 1.0e9 / nkeys;
+}
+
+// returns the largest deviation from 0.5 of the probability that an
+// output bit flips when an input bit does, over all pairs of bits.
+template<class Fn> double worstBias(size_t keysize, size_t ntrials, MersenneTwisterRandom &rng) {
+    Fn fn;
+    vector<uint8_t> key(keysize);
+    size_t nin = keysize * 8;
+    vector<uint32_t> flips(nin * Fn::nbits, 0);
+    for(size_t trial = 0; trial < ntrials; ++trial) {
+	for(size_t i = 0; i < keysize; ++i) {
+	    key[i] = static_cast<uint8_t>(rng.randInt());
+	}
+	uint64_t base = fn(&key[0], keysize);
+	for(size_t in = 0; in < nin; ++in) {
+	    key[in / 8] ^= 1 << (in % 8);
+	    uint64_t diff = base ^ fn(&key[0], keysize);
+	    key[in / 8] ^= 1 << (in % 8);
+	    for(int out = 0; out < Fn::nbits; ++out) {
+		flips[in * Fn::nbits + out] += (diff >> out) & 1;
+	    }
+	}
+    }
+    double worst = 0;
+    for(size_t i = 0; i < flips.size(); ++i) {
+	worst = max(worst, fabs(static_cast<double>(flips[i]) / ntrials - 0.5));
+    }
+    return worst;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: hashfns_speed [bytes-per-size [avalanche-trials]]");
+    size_t nbytes = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000*1000*1000;
+    size_t ntrials = argc > 2 ? strtoul(argv[2], NULL, 10) : 100000;
+    SINVARIANT(nbytes > 0 && ntrials > 0);
+
+    MersenneTwisterRandom rng;
+    cout << format("%d bytes per size, crc32c %s, seed %d\n") % nbytes
+	% (lintel::detail::crc32cHardware() ? "sse4.2" : "software") % rng.seedUsed();
+
+    vector<uint8_t> buf(64 * 1024);
+    for(size_t i = 0; i < buf.size(); ++i) {
+	buf[i] = static_cast<uint8_t>(rng.randInt());
+    }
+    cout << "  size   hashBytes    ns/hash   hashBytes64    ns/hash   crc32c       ns/hash\n";
+    for(size_t keysize = 4; keysize <= 4096; keysize *= 2) {
+	cout << format("%6d") % keysize;
+	double ns32 = throughput<HashBytes32>(buf, keysize, nbytes);
+	cout << format(" %8.2f ") % ns32;
+	double ns64 = throughput<HashBytes64>(buf, keysize, nbytes);
+	cout << format(" %8.2f ") % ns64;
+	double nscrc = throughput<Crc32c>(buf, keysize, nbytes);
+	cout << format(" %8.2f\n") % nscrc;
+    }
+
+    cout << format("worst avalanche bias over %d trials (0 is ideal):\n") % ntrials;
+    size_t sizes[] = { 4, 8, 16 };
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+	cout << format("%6d  hashBytes %.4f  hashBytes64 %.4f  crc32c %.4f\n") % sizes[i]
+	    % worstBias<HashBytes32>(sizes[i], ntrials, rng)
+	    % worstBias<HashBytes64>(sizes[i], ntrials, rng)
+	    % worstBias<Crc32c>(sizes[i], ntrials, rng);
+    }
+    return 0;
+}
@@ -11,7 +11,12 @@
 
 #include <iostream>
 #include <map>
+#if __cplusplus >= 201103L
+#include <memory>
+#endif
+#include <vector>
 
+#include <Lintel/FlatHashTable.hpp>
 #include <Lintel/HashMap.hpp>
 #include <Lintel/HashUnique.hpp>
 
@@ -397,6 +402,211 @@ void testAddUnlessExist() {
     SINVARIANT(hm2.size() == 3 && hm2[0] == 1 && hm2[1] == 2 && hm2[2] == 0); // default value of int is 0
 }
 
+// Probe a string keyed map with a view into a buffer without making a
+// std::string.
+template<class Backend> void testStringRef() {
+    typedef HashMap<string, int, lintel::StringHash, lintel::StringEqual,
+	Backend> StrMap;
+    StrMap hm;
+    hm["abc"] = 1;
+    hm["abcdef"] = 2;
+    hm[string("a\0b", 3)] = 3;
+
+    const char *buf = "abcdefa\0b";
+    SINVARIANT(lintel::hash(lintel::StringRef(buf, 3)) == lintel::hash(string("abc")));
+    SINVARIANT(*hm.lookup(lintel::StringRef(buf, 3)) == 1);
+    SINVARIANT(*hm.lookup(lintel::StringRef(buf, 6)) == 2);
+    SINVARIANT(*hm.lookup(lintel::StringRef(buf + 6, 3)) == 3);
+    SINVARIANT(hm.lookup(lintel::StringRef(buf, 4)) == NULL);
+    SINVARIANT(hm.exists(lintel::StringRef(buf, 6)));
+    SINVARIANT(hm.find(lintel::StringRef(buf, 3))->second == 1);
+    SINVARIANT(hm.find(lintel::StringRef(buf, 2)) == hm.end());
+
+    const StrMap &chm(hm);
+    SINVARIANT(*chm.lookup(lintel::StringRef(buf, 3)) == 1);
+    SINVARIANT(chm.find(lintel::StringRef(buf, 6)) != chm.end());
+
+    SINVARIANT(hm.remove(lintel::StringRef(buf, 3)));
+    SINVARIANT(!hm.remove(lintel::StringRef(buf, 3), false));
+    SINVARIANT(hm.size() == 2 && !hm.exists("abc") && hm.exists("abcdef"));
+}
+
+template<class Backend> void testLookupBatch() {
+    typedef HashMap<int, int, HashMap_hash<const int>, std::equal_to<const int>,
+	Backend> IntMap;
+    IntMap hm;
+    HashUnique<int, HashMap_hash<const int>, std::equal_to<const int>, Backend> hu;
+    vector<int> keys;
+    for(int i = 0; i < 1000; ++i) {
+	keys.push_back(i * 7);
+    }
+    vector<int *> found(keys.size());
+    vector<const int *> cfound(keys.size());
+    bool exists[1000];
+    hm.lookupBatch(&keys[0], keys.size(), &found[0]);
+    hu.existsBatch(&keys[0], keys.size(), exists);
+    for(size_t i = 0; i < keys.size(); ++i) {
+	SINVARIANT(found[i] == NULL && !exists[i]);
+    }
+
+    for(int i = 0; i < 2000; i += 2) {
+	hm[i] = -i;
+	hu.add(i);
+    }
+    // odd length so the last group is partial
+    hm.lookupBatch(&keys[0], 999, &found[0]);
+    const IntMap &chm(hm);
+    chm.lookupBatch(&keys[0], 999, &cfound[0]);
+    hu.existsBatch(&keys[0], 999, exists);
+    for(size_t i = 0; i < 999; ++i) {
+	bool present = keys[i] < 2000 && keys[i] % 2 == 0;
+	SINVARIANT(found[i] == hm.lookup(keys[i]) && cfound[i] == found[i]);
+	SINVARIANT((found[i] != NULL) == present && exists[i] == present);
+    }
+    *found[2] = 5;
+    SINVARIANT(hm[14] == 5);
+
+    typedef HashMap<string, int, lintel::StringHash, lintel::StringEqual,
+	Backend> StrMap;
+    StrMap sm;
+    sm["abc"] = 1;
+    sm["def"] = 2;
+    lintel::StringRef refs[] = { lintel::StringRef("abcdef", 3), 
+				 lintel::StringRef("abcdef", 4),
+				 lintel::StringRef("abcdef" + 3, 3) };
+    int *sfound[3];
+    sm.lookupBatch(refs, 3, sfound);
+    SINVARIANT(*sfound[0] == 1 && sfound[1] == NULL && *sfound[2] == 2);
+}
+
+template<class Backend> void testCompact() {
+    typedef HashMap<int, string, HashMap_hash<const int>, std::equal_to<const int>,
+	Backend> StrMap;
+    StrMap hm;
+    HashUnique<int, HashMap_hash<const int>, std::equal_to<const int>, Backend> hu;
+    for(int i = 0; i < 10000; ++i) {
+	hm[i] = str(format("%d") % i);
+	hu.add(i);
+    }
+    size_t before = hm.memoryUsage();
+    for(int i = 0; i < 10000; ++i) {
+	if (i % 100 != 0) {
+	    hm.remove(i);
+	    hu.remove(i);
+	}
+    }
+    hm.compact();
+    hu.compact();
+    SINVARIANT(hm.size() == 100 && hu.size() == 100 && hm.memoryUsage() < before / 10);
+    vector<typename StrMap::value_type> sorted(hm.extractSorted());
+    vector<int> keys(hu.extractSorted());
+    SINVARIANT(sorted.size() == 100 && keys.size() == 100);
+    for(int i = 0; i < 100; ++i) {
+	SINVARIANT(sorted[i].first == i * 100 && sorted[i].second == str(format("%d") % (i * 100)));
+	SINVARIANT(keys[i] == i * 100 && hm[i * 100] == sorted[i].second && hu.exists(i * 100));
+    }
+    hm[1] = "1";
+    SINVARIANT(hm.size() == 101 && hm.extractSorted()[1].second == "1");
+}
+
+// Hash a key once and use it on several maps with the same KHash.
+template<class Backend> void testWithHash() {
+    typedef HashMap<string, int, lintel::StringHash, lintel::StringEqual,
+	Backend> StrMap;
+    StrMap a, b;
+    for(int i = 0; i < 1000; ++i) {
+	string k(str(format("key %d") % i));
+	uint32_t hash = a.hashOf(k);
+	SINVARIANT(hash == b.hashOf(lintel::StringRef(k)));
+	SINVARIANT(a.lookupWithHash(k, hash) == NULL);
+	*a.addWithHash(k, i, hash) += 1;
+	if (i % 2 == 0) {
+	    b.addWithHash(k, -i, hash);
+	}
+    }
+    SINVARIANT(a.size() == 1000 && b.size() == 500);
+    const StrMap &cb(b);
+    for(int i = 0; i < 1000; ++i) {
+	string k(str(format("key %d") % i));
+	uint32_t hash = a.hashOf(k);
+	SINVARIANT(*a.lookupWithHash(lintel::StringRef(k), hash) == i + 1);
+	const int *v = cb.lookupWithHash(k, hash);
+	SINVARIANT(i % 2 == 0 ? *v == -i : v == NULL);
+	SINVARIANT(b.removeWithHash(k, hash, false) == (i % 2 == 0));
+    }
+    SINVARIANT(b.empty() && !b.removeWithHash(string("x"), b.hashOf(string("x")), false));
+}
+
+#if __cplusplus >= 201103L
+// counts copies so we can check that the C++11 paths only ever move,
+// and assignments so we can check that reused entries are constructed
+// in place.
+struct Counted {
+    static int copies, assigns;
+    string s;
+    Counted() { }
+    explicit Counted(const string &s) : s(s) { }
+    Counted(const Counted &from) : s(from.s) { ++copies; }
+    Counted(Counted &&from) noexcept : s(std::move(from.s)) { }
+    Counted &operator=(const Counted &from) { s = from.s; ++copies; ++assigns; return *this; }
+    Counted &operator=(Counted &&from) noexcept { s = std::move(from.s); ++assigns; return *this; }
+};
+int Counted::copies, Counted::assigns;
+
+template<class Backend> void testMove() {
+    typedef HashMap<int, Counted, HashMap_hash<const int>, std::equal_to<const int>,
+	Backend> CountedMap;
+    Counted::copies = 0;
+    CountedMap hm;
+    for(int i = 0; i < 1000; ++i) {
+	switch (i % 4) {
+	case 0: hm[i] = Counted(str(format("%d") % i)); break;
+	case 1: SINVARIANT(hm.try_emplace(i, str(format("%d") % i)).second); break;
+	case 2: SINVARIANT(hm.emplace(i, Counted(str(format("%d") % i))).second); break;
+	case 3: SINVARIANT(hm.insert(make_pair(i, Counted(str(format("%d") % i)))).second); break;
+	}
+    }
+    pair<Counted *, bool> r = hm.try_emplace(5, "x");
+    SINVARIANT(!r.second && r.first->s == "5");
+    SINVARIANT(!hm.insert(make_pair(7, Counted("y"))).second && hm[7].s == "7");
+    for(int i = 0; i < 1000; i += 2) {
+	SINVARIANT(hm.remove(i));
+    }
+    Counted::assigns = 0;
+    for(int i = 0; i < 1000; i += 2) {
+	SINVARIANT(hm.try_emplace(i, "again").second);
+    }
+    SINVARIANT(hm.size() == 1000 && hm[4].s == "again" && hm[5].s == "5");
+    SINVARIANT(Counted::copies == 0 && Counted::assigns == 0);
+
+    // the copying add constructs in place too
+    for(int i = 1; i < 1000; i += 2) {
+	SINVARIANT(hm.remove(i));
+    }
+    Counted copied("copied");
+    for(int i = 1; i < 1000; i += 2) {
+	hm.addWithHash(i, copied, hm.hashOf(i));
+    }
+    SINVARIANT(hm.size() == 1000 && hm[5].s == "copied" && Counted::assigns == 0);
+
+    HashUnique<string, HashMap_hash<const string>, std::equal_to<const string>,
+	Backend> hu;
+    string big(100, 'x');
+    SINVARIANT(hu.add(std::move(big)) && big.empty());
+    big = string(100, 'x');
+    SINVARIANT(!hu.add(std::move(big)) && big.size() == 100);
+
+    // move only values work as long as the map isn't copied
+    HashMap<int, std::unique_ptr<int>, HashMap_hash<const int>, std::equal_to<const int>,
+	Backend> up;
+    for(int i = 0; i < 1000; ++i) {
+	up[i].reset(new int(i));
+    }
+    up.remove(3);
+    SINVARIANT(up.size() == 999 && *up[999] == 999 && up.lookup(3) == NULL);
+}
+#endif
+
 int main() {
     testTypes();
     testForeach();
@@ -407,4 +617,16 @@ int main() {
     testKeys();
     testErase();
     testAddUnlessExist();
+    testStringRef<HashTableChainedBackend>();
+    testStringRef<FlatHashTableBackend>();
+    testLookupBatch<HashTableChainedBackend>();
+    testLookupBatch<FlatHashTableBackend>();
+    testCompact<HashTableChainedBackend>();
+    testCompact<FlatHashTableBackend>();
+    testWithHash<HashTableChainedBackend>();
+    testWithHash<FlatHashTableBackend>();
+#if __cplusplus >= 201103L
+    testMove<HashTableChainedBackend>();
+    testMove<FlatHashTableBackend>();
+#endif
 }
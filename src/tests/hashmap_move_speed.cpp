@@ -0,0 +1,122 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Count the allocations and time of filling a HashMap with string
+    and vector values by copying them in and by moving them in with
+    try_emplace, for both backends.
+
+    Usage: hashmap_move_speed [nkeys]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/FlatHashTable.hpp>
+#include <Lintel/HashMap.hpp>
+
+using namespace std;
+using boost::format;
+
+#if __cplusplus >= 201103L
+
+static size_t nallocs;
+
+// Kept out of line so that gcc can't pair an inlined free() with a
+// new it treats as the builtin one, and warn about the mismatch.
+__attribute__((noinline)) void *operator new(size_t size) {
+    ++nallocs;
+    void *ret = malloc(size == 0 ? 1 : size);
+    if (ret == NULL) {
+	throw bad_alloc();
+    }
+    return ret;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+// long enough to not fit in the small string buffer
+string makeValue(int64_t i, const string *) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "value number %020lld padding the string",
+	     static_cast<long long>(i));
+    return string(buf);
+}
+
+vector<int64_t> makeValue(int64_t i, const vector<int64_t> *) {
+    return vector<int64_t>(16, i);
+}
+
+template<class V, class Backend> void fillTest(const string &name, size_t nkeys, bool move) {
+    typedef HashMap<int64_t, V, HashMap_hash<const int64_t>, std::equal_to<const int64_t>,
+	Backend> MapT;
+    MapT map;
+    size_t start_allocs = nallocs;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < nkeys; ++i) {
+	V v(makeValue(i, static_cast<const V *>(NULL)));
+	if (move) {
+	    map.try_emplace(i, std::move(v));
+	} else {
+	    map[i] = v;
+	}
+    }
+    // replace every value, as a cache would
+    for(size_t i = 0; i < nkeys; ++i) {
+	V v(makeValue(i + 1, static_cast<const V *>(NULL)));
+	if (move) {
+	    *map.lookup(i) = std::move(v);
+	} else {
+	    *map.lookup(i) = v;
+	}
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    SINVARIANT(map.size() == nkeys);
+    cout << format("%-22s %s: %5.2f allocations/op, %6.1f ns/op\n")
+	% name % (move ? "move" : "copy")
+	% (static_cast<double>(nallocs - start_allocs) / (2 * nkeys))
+	% (elapsed * 1.0e9 / (2 * nkeys));
+}
+
+template<class V> void valueTest(const string &name, size_t nkeys) {
+    fillTest<V, HashTableChainedBackend>(name + " chained", nkeys, false);
+    fillTest<V, HashTableChainedBackend>(name + " chained", nkeys, true);
+    fillTest<V, FlatHashTableBackend>(name + " flat", nkeys, false);
+    fillTest<V, FlatHashTableBackend>(name + " flat", nkeys, true);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 2, "Usage: hashmap_move_speed [nkeys]");
+    size_t nkeys = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000*1000;
+    SINVARIANT(nkeys > 0);
+
+    cout << format("%d keys\n") % nkeys;
+    valueTest<string>("string", nkeys);
+    valueTest<vector<int64_t> >("vector", nkeys);
+    return 0;
+}
+
+#else
+
+int main() {
+    cout << "hashmap_move_speed needs C++11, skipping.\n";
+    return 0;
+}
+
+#endif
@@ -292,6 +292,207 @@ void eraseTest() {
     cout << "erase test passed.\n";
 }
 
+// Run with one bucket moved per operation so that most of the checks
+// below happen while a resize is in progress.
+void incrementalResizeTest() {
+    MersenneTwisterRandom rng;
+
+    cout << format("incremental resize test using seed %d\n") % rng.seedUsed();
+    inttable table;
+    table.setIncrementalResize(1);
+    static const int maxi = 50000;
+    uint32_t in_progress = 0;
+    for(int i = 0; i < maxi; ++i) {
+	table.add(i);
+	if (table.resizeInProgress()) {
+	    ++in_progress;
+	    if (rng.randInt(100) == 0) {
+		const inttable &ctable(table);
+		constHTTest(ctable, i + 1);
+		inttable copy(table);
+		SINVARIANT(copy.resizeInProgress() && copy.size() == table.size());
+		for(int j = 0; j <= i; j += 97) {
+		    SINVARIANT(*ctable.lookup(j) == j && *copy.lookup(j) == j);
+		}
+		int keys[] = { 0, i / 2, i, i + 1, maxi + i };
+		const int *found[5];
+		ctable.lookupBatch(keys, 5, found);
+		for(int j = 0; j < 5; ++j) {
+		    SINVARIANT((found[j] != NULL) == (keys[j] <= i));
+		    SINVARIANT(found[j] == NULL || *found[j] == keys[j]);
+		}
+	    }
+	}
+	int j = rng.randInt(i + 1);
+	SINVARIANT(table.lookup(j) != NULL && *table.lookup(j) == j);
+	SINVARIANT(table.lookup(maxi + j) == NULL);
+    }
+    SINVARIANT(in_progress > 0);
+    nonconstHTTest(table, maxi);
+
+    vector<int> keys;
+    for(int i = 0; i < 2 * maxi; i += 3) {
+	keys.push_back(i);
+    }
+    vector<int *> found(keys.size());
+    table.lookupBatch(&keys[0], keys.size(), &found[0]);
+    for(size_t i = 0; i < keys.size(); ++i) {
+	SINVARIANT(found[i] == table.lookup(keys[i]));
+	SINVARIANT((found[i] != NULL) == (keys[i] < maxi));
+    }
+
+    Stats chain_lengths;
+    table.chainLengthStats(chain_lengths);
+    SINVARIANT(chain_lengths.mean() * chain_lengths.count() == maxi);
+
+    // force a resize and then remove and erase entries while it is
+    // in progress.
+    for(int i = maxi; ! table.resizeInProgress(); ++i) {
+	table.add(i);
+    }
+    table.setIncrementalResize(0);
+    SINVARIANT(!table.resizeInProgress());
+    table.setIncrementalResize(1);
+    table.clear();
+    for(int i = 0; i < maxi; ++i) {
+	table.add(i);
+    }
+    int extra = maxi;
+    for(; ! table.resizeInProgress(); ++extra) {
+	table.add(extra);
+    }
+    for(int i = maxi; i < extra; ++i) {
+	SINVARIANT(table.remove(i));
+    }
+    for(int i = 0; i < maxi; i += 2) {
+	if (i % 4 == 0) {
+	    SINVARIANT(table.remove(i));
+	} else {
+	    inttable::iterator e = table.find(i);
+	    SINVARIANT(e != table.end());
+	    table.erase(e);
+	}
+	SINVARIANT(!table.remove(i, false));
+    }
+    for(int i = 0; i < maxi; ++i) {
+	SINVARIANT((table.lookup(i) != NULL) == (i % 2 == 1));
+    }
+    SINVARIANT(table.size() == maxi/2 && !table.resizeInProgress());
+    cout << "incremental resize test passed.\n";
+}
+
+// reserve() on a table that already has entries, including removed
+// ones, with and without incremental resizing.
+void reserveTest() {
+    static const int maxi = 100000;
+    inttable table;
+    for(int i = 0; i < 1000; ++i) {
+	table.add(i);
+    }
+    for(int i = 0; i < 1000; i += 3) {
+	SINVARIANT(table.remove(i));
+    }
+    table.reserve(maxi);
+    SINVARIANT(table.capacity() >= maxi && !table.resizeInProgress());
+    for(int i = 0; i < 1000; ++i) {
+	SINVARIANT((table.lookup(i) != NULL) == (i % 3 != 0));
+    }
+    size_t usage = table.memoryUsage();
+    for(int i = 1000; table.size() < maxi; ++i) {
+	table.add(i);
+    }
+    SINVARIANT(table.memoryUsage() == usage);
+
+    inttable incremental;
+    incremental.setIncrementalResize(1);
+    for(int i = 0; i < 1000; ++i) {
+	incremental.add(i);
+    }
+    incremental.reserve(maxi);
+    SINVARIANT(incremental.resizeInProgress());
+    for(int i = 1000; incremental.resizeInProgress(); ++i) {
+	incremental.add(i);
+	SINVARIANT(*incremental.lookup(i / 2) == i / 2);
+    }
+    SINVARIANT(incremental.capacity() >= maxi);
+
+    // only the chains; the entry points still grow as it fills
+    inttable chains_only;
+    chains_only.setIncrementalResize(1);
+    chains_only.reserve(maxi, false);
+    size_t resizes = 0;
+    bool was_resizing = false;
+    for(int i = 0; i < maxi; ++i) {
+	chains_only.add(i);
+	if (chains_only.resizeInProgress() && !was_resizing) {
+	    ++resizes;
+	}
+	was_resizing = chains_only.resizeInProgress();
+    }
+    SINVARIANT(resizes > 1);
+    nonconstHTTest(chains_only, maxi);
+    cout << "reserve test passed.\n";
+}
+
+void compactTest() {
+    MersenneTwisterRandom rng;
+
+    cout << format("compact test using seed %d\n") % rng.seedUsed();
+    inttable table;
+    static const int maxi = 100000;
+    for(int i = 0; i < maxi; ++i) {
+	table.add(i);
+    }
+    // start an incremental resize so compact has to finish it.
+    table.setIncrementalResize(1);
+    int extra = maxi;
+    for(; !table.resizeInProgress(); ++extra) {
+	table.add(extra);
+    }
+    size_t before = table.memoryUsage();
+    vector<bool> present(extra, true);
+    size_t nremain = extra;
+    for(int i = 0; i < extra; ++i) {
+	if (rng.randInt(10) != 0) {
+	    SINVARIANT(table.remove(i));
+	    present[i] = false;
+	    --nremain;
+	}
+    }
+    SINVARIANT(!table.dense());
+    table.compact();
+    SINVARIANT(table.dense() && !table.resizeInProgress() && table.size() == nremain);
+    SINVARIANT(table.unsafeGetRawDataVector().size() == nremain);
+    SINVARIANT(table.memoryUsage() < before / 5);
+    for(int i = 0; i < extra; ++i) {
+	SINVARIANT((table.lookup(i) != NULL) == present[i]);
+    }
+
+    vector<int> sorted = table.extractSorted(greater<int>());
+    SINVARIANT(sorted.size() == nremain);
+    for(size_t i = 0, j = extra; i < sorted.size(); ++i) {
+	do {
+	    --j;
+	} while (!present[j]);
+	SINVARIANT(sorted[i] == static_cast<int>(j));
+    }
+
+    // and it still works as a table.
+    for(int i = 0; i < extra; ++i) {
+	if (!present[i]) {
+	    table.add(i);
+	}
+    }
+    SINVARIANT(table.size() == static_cast<size_t>(extra));
+    nonconstHTTest(table, extra);
+    table.clear();
+    table.compact();
+    SINVARIANT(table.empty() && table.extractSorted(less<int>()).empty());
+    table.add(5);
+    SINVARIANT(*table.lookup(5) == 5);
+    cout << "compact test passed.\n";
+}
+
 int main(int argc, char **) {
     SINVARIANT(argc == 1);
 
@@ -299,6 +500,9 @@ int main(int argc, char **) {
     generalTest();
     stringHTTests();
     eraseTest();
+    incrementalResizeTest();
+    reserveTest();
+    compactTest();
 
     printf("success.\n");
 }
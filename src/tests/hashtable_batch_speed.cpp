@@ -0,0 +1,92 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare HashMap::lookupBatch against a loop over lookup() for
+    tables from cache sized up to max-entries, for both backends.  Half
+    of the lookups are misses.
+
+    Usage: hashtable_batch_speed [max-entries [nlookups]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/FlatHashTable.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+static const size_t batch_size = 256;
+
+template<class Backend>
+void batchTest(const string &name, size_t nentries, size_t nlookups,
+	       MersenneTwisterRandom &rng) {
+    typedef HashMap<int64_t, int64_t, HashMap_hash<const int64_t>,
+	std::equal_to<const int64_t>, Backend> MapT;
+    MapT map;
+    map.reserve(nentries);
+    // even keys are present, odd keys are misses
+    for(size_t i = 0; i < nentries; ++i) {
+	map[2 * static_cast<int64_t>(i)] = i;
+    }
+    vector<int64_t> keys;
+    keys.reserve(nlookups);
+    for(size_t i = 0; i < nlookups; ++i) {
+	keys.push_back(rng.randLongLong() % (2 * nentries));
+    }
+
+    int64_t scalar_sum = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < nlookups; ++i) {
+	int64_t *v = map.lookup(keys[i]);
+	if (v != NULL) {
+	    scalar_sum += *v;
+	}
+    }
+    double scalar_elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+
+    int64_t batch_sum = 0;
+    int64_t *found[batch_size];
+    start = Clock::todTfrac();
+    for(size_t i = 0; i < nlookups; i += batch_size) {
+	size_t n = min(batch_size, nlookups - i);
+	map.lookupBatch(&keys[i], n, found);
+	for(size_t j = 0; j < n; ++j) {
+	    if (found[j] != NULL) {
+		batch_sum += *found[j];
+	    }
+	}
+    }
+    double batch_elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    SINVARIANT(scalar_sum == batch_sum);
+
+    cout << format("%-7s %9d entries: scalar %6.1f ns/lookup, batch %6.1f ns/lookup, %.2fx\n")
+	% name % nentries % (scalar_elapsed * 1.0e9 / nlookups)
+	% (batch_elapsed * 1.0e9 / nlookups) % (scalar_elapsed / batch_elapsed);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: hashtable_batch_speed [max-entries [nlookups]]");
+    size_t max_entries = argc > 1 ? strtoul(argv[1], NULL, 10) : 16*1024*1024;
+    size_t nlookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 10*1000*1000;
+    SINVARIANT(max_entries > 0 && nlookups > 0);
+
+    MersenneTwisterRandom rng;
+    cout << format("%d lookups, seed %d\n") % nlookups % rng.seedUsed();
+    for(size_t nentries = min(max_entries, static_cast<size_t>(1) << 16);
+	nentries <= max_entries; nentries *= 4) {
+	batchTest<HashTableChainedBackend>("chained", nentries, nlookups, rng);
+	batchTest<FlatHashTableBackend>("flat", nentries, nlookups, rng);
+    }
+    return 0;
+}
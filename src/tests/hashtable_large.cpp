@@ -0,0 +1,99 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Check HashTable operation up to the limits of its index type.
+
+    By default this runs at sizes that fit in a test run; the uint16_t
+    index check fills the table to its limit.  Run with "full" on a
+    64 bit machine with ~48GB of memory to check a table with more
+    than 2^31 entries, or with a number of entries to try that size.
+
+    Usage: hashtable_large [full | nentries]
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/HashTable.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef lintel::Hash<uint32_t> U32Hash;
+typedef std::equal_to<uint32_t> U32Equal;
+
+// a bijection on uint32_t, so all the keys are distinct without being
+// sequential.
+static uint32_t keyOf(size_t i) {
+    return static_cast<uint32_t>(i) * 2654435761U;
+}
+
+template<class IndexT> void largeTest(size_t nentries, const string &index_name) {
+    cout << format("testing %d entries with %s index\n") % nentries % index_name;
+    HashTable<uint32_t, U32Hash, U32Equal, IndexT> table;
+    table.reserve(nentries);
+
+    for(size_t i = 0; i < nentries; ++i) {
+	table.add(keyOf(i));
+    }
+    SINVARIANT(table.size() == nentries);
+    for(size_t i = 0; i < nentries; ++i) {
+	const uint32_t *v = table.lookup(keyOf(i));
+	INVARIANT(v != NULL && *v == keyOf(i), format("missing entry %d") % i);
+    }
+
+    // remove every third entry, and re-add half of those through the
+    // free list.
+    for(size_t i = 0; i < nentries; i += 3) {
+	table.remove(keyOf(i));
+    }
+    for(size_t i = 0; i < nentries; i += 6) {
+	table.add(keyOf(i));
+    }
+    size_t expected = 0;
+    for(size_t i = 0; i < nentries; ++i) {
+	bool present = i % 3 != 0 || i % 6 == 0;
+	SINVARIANT((table.lookup(keyOf(i)) != NULL) == present);
+	expected += present ? 1 : 0;
+    }
+    SINVARIANT(table.size() == expected);
+
+    size_t count = 0;
+    for(typename HashTable<uint32_t, U32Hash, U32Equal, IndexT>::iterator i = table.begin();
+	i != table.end(); ++i) {
+	++count;
+    }
+    SINVARIANT(count == expected);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 2, "Usage: hashtable_large [full | nentries]");
+
+    if (argc == 2) {
+	size_t nentries;
+	if (strcmp(argv[1], "full") == 0) {
+	    if (sizeof(size_t) < 8) {
+		cout << "full test requires a 64 bit machine, skipping.\n";
+		return 0;
+	    }
+	    nentries = (static_cast<size_t>(1) << 31) + (1 << 24);
+	} else {
+	    nentries = strtoull(argv[1], NULL, 10);
+	}
+	largeTest<uint32_t>(nentries, "uint32_t");
+    } else {
+	// 2^16 - 1 is the sentinel, so this is as full as it can get.
+	largeTest<uint16_t>(65535, "uint16_t");
+	largeTest<uint32_t>(1 << 20, "uint32_t");
+	largeTest<uint64_t>(1 << 20, "uint64_t");
+    }
+    cout << "success.\n";
+    return 0;
+}
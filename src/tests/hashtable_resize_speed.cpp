@@ -0,0 +1,83 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Measure the insert latency distribution of HashMap across resizes,
+    with and without incremental resizing, and with incremental
+    resizing after reserving the chains.  The last one has to keep
+    every insert under max-us, which does not depend on nkeys.
+
+    Usage: hashtable_resize_speed [nkeys [buckets-per-op [max-us]]]
+*/
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+// returns the maximum insert latency in us
+double latencyTest(const vector<int64_t> &keys, uint32_t buckets_per_op,
+		   bool reserve_chains) {
+    HashMap<int64_t, int64_t> map;
+    map.setIncrementalResize(buckets_per_op);
+    if (reserve_chains) {
+	map.reserve(keys.size(), false);
+    }
+
+    vector<uint64_t> cycles;
+    cycles.reserve(keys.size());
+    Clock::Tfrac start = Clock::todTfrac();
+    uint64_t start_cycles = Clock::cycleCounter();
+    for(size_t i = 0; i < keys.size(); ++i) {
+	uint64_t before = Clock::cycleCounter();
+	map[keys[i]] = i;
+	cycles.push_back(Clock::cycleCounter() - before);
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    double us_per_cycle = elapsed * 1.0e6 / (Clock::cycleCounter() - start_cycles);
+    SINVARIANT(map.size() == keys.size());
+
+    sort(cycles.begin(), cycles.end());
+    size_t n = cycles.size();
+    cout << format("buckets/op %4d%s: %6.3fs total; insert latency us: p50 %.3f, p99 %.3f, p999 %.3f, max %.1f\n")
+	% buckets_per_op % (reserve_chains ? ", chains reserved" : "") % elapsed
+	% (cycles[n / 2] * us_per_cycle) % (cycles[n * 99 / 100] * us_per_cycle)
+	% (cycles[n * 999 / 1000] * us_per_cycle) % (cycles[n - 1] * us_per_cycle);
+    return cycles[n - 1] * us_per_cycle;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 4, "Usage: hashtable_resize_speed [nkeys [buckets-per-op [max-us]]]");
+    size_t nkeys = argc > 1 ? strtoul(argv[1], NULL, 10) : 10*1000*1000;
+    uint32_t buckets_per_op = argc > 2 ? strtoul(argv[2], NULL, 10) : 8;
+    double max_us = argc > 3 ? strtod(argv[3], NULL) : 10000;
+    SINVARIANT(nkeys > 0 && buckets_per_op > 0 && max_us > 0);
+
+    MersenneTwisterRandom rng;
+    cout << format("%d keys, seed %d\n") % nkeys % rng.seedUsed();
+    vector<int64_t> keys;
+    keys.reserve(nkeys);
+    for(size_t i = 0; i < nkeys; ++i) {
+	keys.push_back(static_cast<int64_t>(i) << 20 | rng.randInt(1 << 20));
+    }
+    MT_random_shuffle(keys.begin(), keys.end(), rng);
+
+    latencyTest(keys, 0, false);
+    latencyTest(keys, buckets_per_op, false);
+    double max_latency = latencyTest(keys, buckets_per_op, true);
+    INVARIANT(max_latency < max_us,
+	      format("max insert latency %.1fus over the %.1fus bound") % max_latency % max_us);
+    return 0;
+}
@@ -90,6 +90,9 @@ int main() {
     }
 
     hts.prune(boost::bind(&pruneGreaterEqual5, _1));
+    SINVARIANT(hts.size() == 5);
+    hts.compact();
+    SINVARIANT(hts.size() == 5);
     
     hut.get<0>().clear();
     hut.get<1>().clear();
@@ -0,0 +1,104 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Measure HashUnique::exists with and without the Bloom filter in
+    front of the chained table, and with the flat table, sweeping the
+    fraction of the probed keys that are present.  The disabled row
+    is a chained table whose filter was turned off again, which should
+    run as fast as the plain chained one.
+
+    Usage: hashunique_filter_speed [nkeys [nprobes]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/FlatHashTable.hpp>
+#include <Lintel/HashUnique.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef HashUnique<int64_t> ChainedUnique;
+typedef HashUnique<int64_t, HashMap_hash<const int64_t>, std::equal_to<const int64_t>,
+		   FlatHashTableBackend> FlatUnique;
+
+template<class U> double probeTest(const U &unique, const vector<int64_t> &probes,
+				   size_t expected) {
+    size_t found = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < probes.size(); ++i) {
+	if (unique.exists(probes[i])) {
+	    ++found;
+	}
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    SINVARIANT(found == expected);
+    return elapsed * 1.0e9 / probes.size();
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: hashunique_filter_speed [nkeys [nprobes]]");
+    size_t nkeys = argc > 1 ? strtoul(argv[1], NULL, 10) : 4*1000*1000;
+    size_t nprobes = argc > 2 ? strtoul(argv[2], NULL, 10) : 4*1000*1000;
+    SINVARIANT(nkeys > 0 && nprobes > 0);
+
+    MersenneTwisterRandom rng(1776);
+    ChainedUnique chained, disabled, filtered;
+    FlatUnique flat;
+    disabled.enableFilter();
+    filtered.enableFilter(10, true);
+    vector<int64_t> keys;
+    keys.reserve(nkeys);
+    // even keys are present, odd ones absent
+    for(size_t i = 0; i < nkeys; ++i) {
+	int64_t k = static_cast<int64_t>(rng.randLongLong() & ~1ULL);
+	if (chained.add(k)) {
+	    disabled.add(k);
+	    filtered.add(k);
+	    flat.add(k);
+	    keys.push_back(k);
+	}
+    }
+
+    disabled.enableFilter(0);
+    BlockedBloomFilter::FilterStats before(filtered.filterStats());
+    cout << format("%d keys, %d probes; filter %.1f bits/key, %.2f MiB\n")
+	% keys.size() % nprobes % before.bits_per_key
+	% ((before.bits_per_key * before.keys) / (8 * 1024 * 1024));
+    double hit_ratios[] = { 0, 0.01, 0.1, 0.5, 0.9, 1 };
+    for(size_t r = 0; r < sizeof(hit_ratios) / sizeof(double); ++r) {
+	vector<int64_t> probes(nprobes);
+	size_t expected = 0;
+	for(size_t i = 0; i < nprobes; ++i) {
+	    if (rng.randDouble() < hit_ratios[r]) {
+		probes[i] = keys[rng.randInt(keys.size())];
+		++expected;
+	    } else {
+		probes[i] = static_cast<int64_t>(rng.randLongLong() | 1);
+	    }
+	}
+	BlockedBloomFilter::FilterStats start(filtered.filterStats());
+	double chained_ns = probeTest(chained, probes, expected);
+	double disabled_ns = probeTest(disabled, probes, expected);
+	double filtered_ns = probeTest(filtered, probes, expected);
+	double flat_ns = probeTest(flat, probes, expected);
+	BlockedBloomFilter::FilterStats end(filtered.filterStats());
+	uint64_t negatives = end.negatives - start.negatives;
+	uint64_t false_positives = end.false_positives - start.false_positives;
+	cout << format("hit ratio %4.2f: chained %6.1f ns, filter disabled %6.1f ns,"
+		       " chained+filter %6.1f ns, flat %6.1f ns; filter false positive rate %.4f\n")
+	    % hit_ratios[r] % chained_ns % disabled_ns % filtered_ns % flat_ns
+	    % (negatives + false_positives == 0 ? 0
+	       : static_cast<double>(false_positives) / (negatives + false_positives));
+    }
+    return 0;
+}
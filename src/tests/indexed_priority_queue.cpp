@@ -0,0 +1,127 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    test for IndexedPriorityQueue, against a std::multiset of the
+    values that should be queued
+*/
+
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include <Lintel/IndexedPriorityQueue.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+
+using namespace std;
+using boost::format;
+
+template<class PQ> void testRandom(uint32_t seed) {
+    typedef typename PQ::Handle Handle;
+    MersenneTwisterRandom mt(seed);
+    PQ pq;
+    multiset<int> expect;
+    vector<pair<Handle, int> > live; // handle and value
+    vector<Handle> dead;
+
+    for(unsigned i = 0; i < 50000; ++i) {
+	uint32_t op = mt.randInt(10);
+	if (op < 4 || live.empty()) {
+	    int v = mt.randInt(2000);
+	    Handle h = pq.push(v);
+	    SINVARIANT(pq.contains(h) && pq.get(h) == v);
+	    live.push_back(make_pair(h, v));
+	    expect.insert(v);
+	} else {
+	    size_t which = mt.randInt(live.size());
+	    Handle h = live[which].first;
+	    SINVARIANT(pq.contains(h) && pq.get(h) == live[which].second);
+	    expect.erase(expect.find(live[which].second));
+	    if (op < 6) {
+		int v = mt.randInt(2000);
+		pq.update(h, v);
+		live[which].second = v;
+		expect.insert(v);
+		SINVARIANT(pq.get(h) == v);
+	    } else {
+		if (op < 8) {
+		    pq.erase(h);
+		} else {
+		    // pop the top instead, whichever handle that is
+		    expect.insert(live[which].second);
+		    h = pq.topHandle();
+		    for(which = 0; live[which].first != h; ++which) { }
+		    expect.erase(expect.find(pq.top()));
+		    SINVARIANT(live[which].second == pq.top());
+		    pq.pop();
+		}
+		live[which] = live.back();
+		live.pop_back();
+		dead.push_back(h);
+		SINVARIANT(!pq.contains(h));
+	    }
+	}
+	SINVARIANT(pq.size() == expect.size());
+	if (!pq.empty()) {
+	    SINVARIANT(pq.top() == *expect.rbegin());
+	}
+	if ((i % 1000) == 0) {
+	    pq.selfVerify();
+	}
+    }
+
+    // slots get reused, but old handles stay dead
+    for(size_t i = 0; i < dead.size(); ++i) {
+	SINVARIANT(!pq.contains(dead[i]));
+    }
+
+    pq.clear();
+    SINVARIANT(pq.empty());
+    for(size_t i = 0; i < live.size(); ++i) {
+	SINVARIANT(!pq.contains(live[i].first));
+    }
+}
+
+struct IntGeq {
+    bool operator()(int a, int b) const {
+	return a >= b;
+    }
+};
+
+// reschedule events in a min queue, as a simulator would
+void testReschedule() {
+    IndexedPriorityQueue<int, IntGeq> pq;
+    vector<IndexedPriorityQueue<int, IntGeq>::Handle> handles;
+    for(int i = 0; i < 100; ++i) {
+	handles.push_back(pq.push(i));
+    }
+    for(int i = 0; i < 100; i += 2) {
+	pq.update(handles[i], 1000 + i); // push back the even ones
+    }
+    for(int i = 1; i < 100; i += 4) {
+	pq.erase(handles[i]);
+    }
+    int expect = 3;
+    while (!pq.empty() && pq.top() < 100) {
+	SINVARIANT(pq.top() == expect);
+	pq.pop();
+	expect += 4;
+    }
+    for(int i = 0; i < 100; i += 2) {
+	SINVARIANT(pq.top() == 1000 + i && pq.topHandle() == handles[i]);
+	pq.pop();
+    }
+    SINVARIANT(pq.empty());
+}
+
+int main() {
+    testRandom<IndexedPriorityQueue<int> >(1);
+    testRandom<IndexedPriorityQueue<int, less_equal<int>, 4> >(2);
+    testRandom<IndexedPriorityQueue<int, less_equal<int>, 3> >(3);
+    testReschedule();
+    cout << "indexed priority queue tests passed.\n";
+    return 0;
+}
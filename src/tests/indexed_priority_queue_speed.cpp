@@ -0,0 +1,170 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare cancelling events by leaving tombstones in a PriorityQueue
+    with changing them in an IndexedPriorityQueue.  Each flow has a
+    packet arrival pending, about one time unit away, and a timeout;
+    each arrival pushes the flow's timeout back, so nearly all timeouts
+    are cancelled.  With tombstones the stale timeouts stay in the
+    queue until they come to the top.  Reports ns per event and the
+    peak queue size and memory.
+
+    Usage: indexed_priority_queue_speed [nflows [nevents [timeout]]]
+*/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/IndexedPriorityQueue.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PriorityQueue.hpp>
+
+using namespace std;
+using boost::format;
+
+struct Event {
+    double time;
+    uint32_t flow;
+    uint32_t seq; // only used with tombstones
+    bool timeout;
+};
+
+struct EventGeq {
+    bool operator()(const Event &a, const Event &b) const {
+	return a.time >= b.time;
+    }
+};
+
+struct Result {
+    double sum;
+    size_t timeouts, max_size, max_memory;
+};
+
+static double interarrival(MersenneTwisterRandom &rng) {
+    return -log(1 - rng.randDouble());
+}
+
+static void report(const string &name, double elapsed, size_t nevents, const Result &r) {
+    cout << format("  %-28s %6.1f ns/event, peak %9d queued, %8.2f MiB\n")
+	% name % (elapsed * 1.0e9 / nevents) % r.max_size
+	% (r.max_memory / (1024.0 * 1024));
+}
+
+Result tombstoneTest(uint32_t nflows, size_t nevents, double timeout) {
+    MersenneTwisterRandom rng(1776);
+    PriorityQueue<Event, EventGeq> pq;
+    vector<uint32_t> timeout_seq(nflows, 0);
+    Result r = { 0, 0, 0, 0 };
+
+    for(uint32_t i = 0; i < nflows; ++i) {
+	Event a = { interarrival(rng), i, 0, false };
+	Event t = { timeout, i, 0, true };
+	pq.push(a);
+	pq.push(t);
+    }
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t n = 0; n < nevents; ) {
+	Event e = pq.top();
+	pq.pop();
+	if (e.timeout && e.seq != timeout_seq[e.flow]) {
+	    continue; // cancelled
+	}
+	++n;
+	r.sum += e.time;
+	Event t = { e.time + timeout, e.flow, ++timeout_seq[e.flow], true };
+	if (e.timeout) {
+	    ++r.timeouts;
+	    pq.push(t);
+	} else {
+	    pq.push(t);
+	    Event a = { e.time + interarrival(rng), e.flow, 0, false };
+	    pq.push(a);
+	}
+	if ((n & 1023) == 0) {
+	    r.max_size = max(r.max_size, static_cast<size_t>(pq.size()));
+	}
+    }
+    // PriorityQueue doubles its array as it fills
+    size_t capacity = 1;
+    while (capacity < r.max_size) {
+	capacity *= 2;
+    }
+    r.max_memory = capacity * sizeof(Event);
+    report("PriorityQueue + tombstones", Clock::TfracToDouble(Clock::todTfrac() - start),
+	   nevents, r);
+    return r;
+}
+
+template<class PQ> Result indexedTest(const string &name, uint32_t nflows, size_t nevents,
+				      double timeout, bool erase) {
+    MersenneTwisterRandom rng(1776);
+    PQ pq;
+    vector<typename PQ::Handle> timeouts(nflows);
+    Result r = { 0, 0, 0, 0 };
+
+    for(uint32_t i = 0; i < nflows; ++i) {
+	Event a = { interarrival(rng), i, 0, false };
+	Event t = { timeout, i, 0, true };
+	pq.push(a);
+	timeouts[i] = pq.push(t);
+    }
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t n = 0; n < nevents; ++n) {
+	Event e = pq.top();
+	pq.pop();
+	r.sum += e.time;
+	Event t = { e.time + timeout, e.flow, 0, true };
+	if (e.timeout) {
+	    ++r.timeouts;
+	    timeouts[e.flow] = pq.push(t);
+	} else {
+	    if (erase) {
+		pq.erase(timeouts[e.flow]);
+		timeouts[e.flow] = pq.push(t);
+	    } else {
+		pq.update(timeouts[e.flow], t);
+	    }
+	    Event a = { e.time + interarrival(rng), e.flow, 0, false };
+	    pq.push(a);
+	}
+	if ((n & 1023) == 0) {
+	    r.max_size = max(r.max_size, pq.size());
+	    r.max_memory = max(r.max_memory, pq.memoryUsage());
+	}
+    }
+    report(name, Clock::TfracToDouble(Clock::todTfrac() - start), nevents, r);
+    return r;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 4, "Usage: indexed_priority_queue_speed [nflows [nevents [timeout]]]");
+    uint32_t nflows = argc > 1 ? strtoul(argv[1], NULL, 10) : 100*1000;
+    size_t nevents = argc > 2 ? strtoul(argv[2], NULL, 10) : 10*1000*1000;
+    double timeout = argc > 3 ? strtod(argv[3], NULL) : 4;
+    SINVARIANT(nflows > 0 && nevents > 0 && timeout > 0);
+
+    cout << format("%d flows, %d events, timeout %.1f arrivals\n") % nflows % nevents % timeout;
+    Result expect = tombstoneTest(nflows, nevents, timeout);
+    Result results[] = {
+	indexedTest<IndexedPriorityQueue<Event, EventGeq> >
+	("IndexedPriorityQueue update", nflows, nevents, timeout, false),
+	indexedTest<IndexedPriorityQueue<Event, EventGeq> >
+	("IndexedPriorityQueue erase", nflows, nevents, timeout, true),
+	indexedTest<IndexedPriorityQueue<Event, EventGeq, 4> >
+	("IndexedPriorityQueue<4>", nflows, nevents, timeout, false),
+    };
+    for(size_t i = 0; i < sizeof(results) / sizeof(results[0]); ++i) {
+	INVARIANT(results[i].sum == expect.sum && results[i].timeouts == expect.timeouts,
+		  format("run %d disagrees") % i);
+    }
+    cout << format("%d timeouts fired\n") % expect.timeouts;
+    return 0;
+}
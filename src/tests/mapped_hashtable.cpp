@@ -0,0 +1,124 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Test saving HashTable and HashMap and serving lookups from the
+    mapped file.
+*/
+
+#include <stdio.h>
+
+#include <iostream>
+
+#include <Lintel/HashMap.hpp>
+#include <Lintel/MappedHashTable.hpp>
+#include <Lintel/TestUtil.hpp>
+
+using namespace std;
+using boost::format;
+
+struct Entry {
+    int32_t key;
+    double value;
+};
+
+struct EntryHash {
+    uint32_t operator()(const Entry &e) const {
+	return lintel::hash(e.key);
+    }
+    uint32_t operator()(int32_t k) const {
+	return lintel::hash(k);
+    }
+};
+
+struct EntryEqual {
+    bool operator()(const Entry &a, const Entry &b) const {
+	return a.key == b.key;
+    }
+    bool operator()(int32_t k, const Entry &b) const {
+	return k == b.key;
+    }
+};
+
+typedef HashTable<Entry, EntryHash, EntryEqual> EntryTable;
+typedef MappedHashTable<Entry, EntryHash, EntryEqual> MappedEntryTable;
+
+static const char *path = "mapped_hashtable.tmp";
+
+void testTable() {
+    EntryTable table;
+    for(int32_t i = 0; i < 10000; ++i) {
+	Entry e = { i * 3, i * 0.5 };
+	table.add(e);
+    }
+    // leave some holes on the free list.
+    for(int32_t i = 0; i < 10000; i += 10) {
+	Entry e = { i * 3, 0 };
+	SINVARIANT(table.remove(e));
+    }
+    table.save(path);
+
+    MappedEntryTable mapped(path);
+    SINVARIANT(mapped.size() == table.size() && mapped.size() == 9000);
+    for(int32_t k = 0; k < 30000; ++k) {
+	Entry probe = { k, 0 };
+	const Entry *e = mapped.lookup(probe);
+	bool present = k % 3 == 0 && (k / 3) % 10 != 0;
+	SINVARIANT((e != NULL) == present && (mapped.lookup(k) != NULL) == present);
+	if (present) {
+	    SINVARIANT(e->key == k && e->value == (k / 3) * 0.5);
+	}
+    }
+
+    // saving again replaces the file without disturbing the mapping
+    table.clear();
+    table.save(path);
+    SINVARIANT(mapped.lookup(3) != NULL);
+    MappedEntryTable empty(path);
+    SINVARIANT(empty.empty() && empty.lookup(3) == NULL);
+    cout << "table test passed.\n";
+}
+
+void testMap() {
+    HashMap<int64_t, int32_t> map;
+    map.setIncrementalResize(1);
+    for(int64_t i = 0; i < 50000; ++i) {
+	map[i << 32] = i;
+    }
+    map.save(path);
+    MappedHashMap<int64_t, int32_t> mapped(path);
+    SINVARIANT(mapped.size() == map.size());
+    for(int64_t i = 0; i < 50000; ++i) {
+	SINVARIANT(*mapped.lookup(i << 32) == i && !mapped.exists(i + 1));
+    }
+    cout << "map test passed.\n";
+}
+
+void testErrors() {
+    HashMap<int32_t, int32_t> map;
+    map[1] = 2;
+    map.save(path);
+    TEST_INVARIANT_MSG1(MappedEntryTable table(path),
+			(format("%s was saved with data size 8 and index size 4, expected 16 and 4")
+			 % path).str());
+    TEST_INVARIANT_MSG1(MappedEntryTable table("/nonexistent/mapped_hashtable"),
+			"error opening /nonexistent/mapped_hashtable: No such file or directory");
+    FILE *f = fopen(path, "w");
+    fputs("not a hash table", f);
+    fclose(f);
+    TEST_INVARIANT_MSG1(MappedEntryTable table(path),
+			(format("%s is not a saved HashTable") % path).str());
+    cout << "error test passed.\n";
+}
+
+int main() {
+    testTable();
+    testMap();
+    testErrors();
+    remove(path);
+    cout << "success.\n";
+    return 0;
+}
@@ -0,0 +1,109 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Time the hold operation of an event simulator -- take the next
+    event, and schedule one an exponentially distributed time after
+    it -- with 64 bit integer times, on PriorityQueue of arity 2 and 4,
+    RadixHeap and CalendarQueue, for queue sizes from 1000 up.
+    Reports ns per hold, and per push while filling the queue.
+
+    Usage: monotone_queue_speed [max-size [nholds]]
+*/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <utility>
+
+#include <Lintel/CalendarQueue.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PriorityQueue.hpp>
+#include <Lintel/RadixHeap.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef pair<uint64_t, uint32_t> Event;
+
+// mean time between events scheduled by one event, in ticks
+static const double mean_delay = 1.0e6;
+
+struct EventGeq {
+    bool operator()(const Event &a, const Event &b) const {
+	return a.first >= b.first;
+    }
+};
+
+// PriorityQueue in the push(key, value) form of the others
+template<unsigned Arity> class HeapQueue {
+public:
+    void push(uint64_t key, uint32_t val) {
+	pq.push(Event(key, val));
+    }
+    const Event &top() const {
+	return pq.top();
+    }
+    void pop() {
+	pq.pop();
+    }
+private:
+    PriorityQueue<Event, EventGeq, Arity> pq;
+};
+
+static uint64_t delay(MersenneTwisterRandom &rng) {
+    return static_cast<uint64_t>(-log(1 - rng.randDouble()) * mean_delay);
+}
+
+template<class Q> uint64_t holdTest(const string &name, size_t size, size_t nholds) {
+    MersenneTwisterRandom rng(size);
+    Q q;
+
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < size; ++i) {
+	q.push(delay(rng), i);
+    }
+    double fill = Clock::TfracToDouble(Clock::todTfrac() - start);
+
+    uint64_t sum = 0;
+    start = Clock::todTfrac();
+    for(size_t i = 0; i < nholds; ++i) {
+	Event e = q.top();
+	q.pop();
+	sum += e.first;
+	q.push(e.first + delay(rng), e.second);
+    }
+    double hold = Clock::TfracToDouble(Clock::todTfrac() - start);
+    cout << format("  %-18s push %6.1f ns, hold %6.1f ns\n")
+	% name % (fill * 1.0e9 / size) % (hold * 1.0e9 / nholds);
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: monotone_queue_speed [max-size [nholds]]");
+    size_t max_size = argc > 1 ? strtoul(argv[1], NULL, 10) : 10*1000*1000;
+    size_t nholds = argc > 2 ? strtoul(argv[2], NULL, 10) : 10*1000*1000;
+    SINVARIANT(nholds > 0);
+
+    cout << format("%d holds\n") % nholds;
+    for(size_t size = 1000; size <= max_size; size *= 10) {
+	cout << format("%d entries:\n") % size;
+	uint64_t expect = holdTest<HeapQueue<2> >("PriorityQueue", size, nholds);
+	uint64_t sums[] = {
+	    holdTest<HeapQueue<4> >("PriorityQueue<4>", size, nholds),
+	    holdTest<RadixHeap<uint64_t, uint32_t> >("RadixHeap", size, nholds),
+	    holdTest<CalendarQueue<uint64_t, uint32_t> >("CalendarQueue", size, nholds),
+	};
+	for(size_t i = 0; i < sizeof(sums) / sizeof(sums[0]); ++i) {
+	    // ties can come out in a different order, but the times
+	    // popped do not depend on that
+	    INVARIANT(sums[i] == expect, format("queue %d disagrees") % i);
+	}
+    }
+    return 0;
+}
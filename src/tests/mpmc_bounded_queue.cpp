@@ -0,0 +1,135 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    MPMCBoundedQueue test program
+*/
+
+#include <sched.h>
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/MPMCBoundedQueue.hpp>
+#include <Lintel/PThread.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef MPMCBoundedQueue<int64_t> Queue;
+
+static const int64_t nper_producer = 200*1000;
+
+void basicTest() {
+    Queue queue(3);
+    SINVARIANT(queue.capacity() == 4 && queue.empty());
+    int64_t v = -1;
+    SINVARIANT(!queue.tryPop(v) && v == -1);
+    for(int round = 0; round < 3; ++round) {
+	for(int64_t i = 0; i < 4; ++i) {
+	    SINVARIANT(queue.tryPush(i + round));
+	}
+	SINVARIANT(!queue.tryPush(4) && queue.size() == 4);
+	for(int64_t i = 0; i < 4; ++i) {
+	    SINVARIANT(queue.tryPop(v) && v == i + round);
+	}
+	SINVARIANT(!queue.tryPop(v) && queue.empty());
+    }
+}
+
+// values are producer << 32 | sequence, sequence from 1
+void *producer(Queue *queue, int64_t id, bool blocking) {
+    for(int64_t i = 1; i <= nper_producer; ++i) {
+	int64_t v = (id << 32) | i;
+	if (blocking) {
+	    queue->push(v);
+	} else {
+	    while (!queue->tryPush(v)) {
+		sched_yield();
+	    }
+	}
+    }
+    return NULL;
+}
+
+// stops at a value of -1; the values from each producer have to come
+// in order.
+void *consumer(Queue *queue, int nproducers, bool blocking, vector<int64_t> *counts) {
+    vector<int64_t> last(nproducers, 0);
+    while (true) {
+	int64_t v;
+	if (blocking) {
+	    queue->pop(v);
+	} else if (!queue->tryPop(v)) {
+	    sched_yield();
+	    continue;
+	}
+	if (v == -1) {
+	    break;
+	}
+	int64_t id = v >> 32, seq = v & 0xFFFFFFFF;
+	SINVARIANT(id >= 0 && id < nproducers);
+	INVARIANT(seq > last[id], format("producer %d: %d after %d") % id % seq % last[id]);
+	last[id] = seq;
+	++(*counts)[id];
+    }
+    return NULL;
+}
+
+void threadedTest(int nproducers, int nconsumers, size_t capacity, bool blocking) {
+    Queue queue(capacity, blocking);
+    vector<vector<int64_t> > counts(nconsumers, vector<int64_t>(nproducers, 0));
+    vector<PThreadFunction *> consumers, producers;
+    for(int i = 0; i < nconsumers; ++i) {
+	consumers.push_back(new PThreadFunction(boost::bind(consumer, &queue, nproducers,
+							    blocking, &counts[i])));
+	consumers.back()->start();
+    }
+    for(int i = 0; i < nproducers; ++i) {
+	producers.push_back(new PThreadFunction(boost::bind(producer, &queue, i, blocking)));
+	producers.back()->start();
+    }
+    for(int i = 0; i < nproducers; ++i) {
+	producers[i]->join();
+	delete producers[i];
+    }
+    for(int i = 0; i < nconsumers; ++i) {
+	if (blocking) {
+	    queue.push(-1);
+	} else {
+	    while (!queue.tryPush(-1)) {
+		sched_yield();
+	    }
+	}
+    }
+    for(int i = 0; i < nconsumers; ++i) {
+	consumers[i]->join();
+	delete consumers[i];
+    }
+    SINVARIANT(queue.empty());
+    for(int p = 0; p < nproducers; ++p) {
+	int64_t total = 0;
+	for(int c = 0; c < nconsumers; ++c) {
+	    total += counts[c][p];
+	}
+	SINVARIANT(total == nper_producer);
+    }
+    cout << format("%d producers, %d consumers, capacity %d, %s passed\n")
+	% nproducers % nconsumers % capacity % (blocking ? "blocking" : "polling");
+}
+
+int main() {
+    basicTest();
+    threadedTest(1, 1, 2, false);
+    threadedTest(4, 4, 64, false);
+    threadedTest(1, 1, 2, true);
+    threadedTest(4, 2, 16, true);
+    threadedTest(2, 4, 1024, true);
+    cout << "success.\n";
+    return 0;
+}
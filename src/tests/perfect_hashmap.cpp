@@ -0,0 +1,128 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    PerfectHashMap test program
+*/
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Lintel/HashMap.hpp>
+#include <Lintel/PerfectHashMap.hpp>
+#include <Lintel/TestUtil.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef PerfectHashMap<int64_t, int64_t> IntPerfect;
+
+void testInts(int64_t n) {
+    HashMap<int64_t, int64_t> hm;
+    for(int64_t i = 0; i < n; ++i) {
+	hm[i * 7] = i;
+    }
+    IntPerfect perfect(hm);
+    SINVARIANT(perfect.size() == static_cast<size_t>(n));
+    vector<bool> seen(n, false);
+    for(int64_t i = 0; i < n; ++i) {
+	size_t index = perfect.indexOf(i * 7);
+	SINVARIANT(index < perfect.size() && !seen[index]);
+	seen[index] = true;
+	SINVARIANT(perfect.begin()[index].first == i * 7 && *perfect.lookup(i * 7) == i);
+	SINVARIANT(!perfect.exists(i * 7 + 1) && perfect.indexOf(i * 7 + 3) == perfect.size());
+    }
+    for(IntPerfect::iterator i = perfect.begin(); i != perfect.end(); ++i) {
+	SINVARIANT(i->second * 7 == i->first);
+	i->second = -i->second;
+    }
+    SINVARIANT(*perfect.lookup(n * 7 - 7) == 1 - n);
+    cout << format("%d keys: %.2f bits per key overhead\n") % n % perfect.overheadBitsPerKey();
+    if (n >= 1000) {
+	SINVARIANT(perfect.overheadBitsPerKey() < 3.5);
+    }
+}
+
+// probes with a StringRef as well as a std::string
+struct StringHash64 {
+    uint64_t operator()(const string &s) const {
+	return lintel::hashType64(s);
+    }
+    uint64_t operator()(const lintel::StringRef &s) const {
+	return lintel::hashType64(s);
+    }
+};
+
+void testStrings() {
+    vector<string> keys;
+    for(int i = 0; i < 1000; ++i) {
+	keys.push_back((format("column-%d") % i).str());
+    }
+    keys.push_back("");
+    PerfectHashMap<string, int, StringHash64, lintel::StringEqual> perfect(keys);
+    SINVARIANT(perfect.size() == keys.size());
+    for(size_t i = 0; i < keys.size(); ++i) {
+	SINVARIANT(perfect.exists(keys[i]) && *perfect.lookup(lintel::StringRef(keys[i])) == 0);
+    }
+    const char *buf = "column-17x";
+    SINVARIANT(perfect.exists(lintel::StringRef(buf, 9)));
+    SINVARIANT(!perfect.exists(lintel::StringRef(buf, 10)));
+    SINVARIANT(perfect.exists(lintel::StringRef(buf, 0)));
+}
+
+// every key has the same hash, so none of them can be placed
+struct ConstantHash {
+    uint64_t operator()(int64_t) const {
+	return 42;
+    }
+};
+
+void testCollidingHashes() {
+    map<int64_t, int64_t> m;
+    for(int64_t i = 0; i < 100; ++i) {
+	m[i] = i * i;
+    }
+    PerfectHashMap<int64_t, int64_t, ConstantHash> perfect(m);
+    SINVARIANT(perfect.size() == 100);
+    for(int64_t i = 0; i < 100; ++i) {
+	SINVARIANT(*perfect.lookup(i) == i * i);
+    }
+    SINVARIANT(!perfect.exists(100) && !perfect.exists(-1));
+}
+
+void testEmpty() {
+    IntPerfect perfect;
+    SINVARIANT(perfect.empty() && perfect.begin() == perfect.end());
+    SINVARIANT(perfect.lookup(0) == NULL && perfect.indexOf(5) == 0);
+    SINVARIANT(perfect.overheadBitsPerKey() == 0);
+
+    vector<pair<int64_t, int64_t> > one(1, make_pair(5, 6));
+    IntPerfect single(one);
+    SINVARIANT(*single.lookup(5) == 6 && !single.exists(6));
+}
+
+void testDuplicates() {
+    vector<pair<int64_t, int64_t> > dups;
+    dups.push_back(make_pair(1, 1));
+    dups.push_back(make_pair(2, 2));
+    dups.push_back(make_pair(1, 3));
+    TEST_INVARIANT_MSG1(IntPerfect tmp(dups), "PerfectHashMap built from duplicate keys");
+}
+
+int main() {
+    testInts(1);
+    testInts(10);
+    testInts(1000);
+    testInts(300000);
+    testStrings();
+    testCollidingHashes();
+    testEmpty();
+    testDuplicates();
+    cout << "PerfectHashMap tests passed.\n";
+    return 0;
+}
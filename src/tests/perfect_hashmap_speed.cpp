@@ -0,0 +1,98 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare the memory use and lookup time of PerfectHashMap against
+    HashMap with both backends for min-keys to max-keys keys, growing
+    by a factor of ten.
+
+    Usage: perfect_hashmap_speed [max-keys [min-keys]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/FlatHashTable.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PerfectHashMap.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef HashMap<int64_t, int64_t> ChainedMap;
+typedef HashMap<int64_t, int64_t, HashMap_hash<const int64_t>, std::equal_to<const int64_t>,
+		FlatHashTableBackend> FlatMap;
+typedef PerfectHashMap<int64_t, int64_t> PerfectMap;
+
+static const size_t nprobes = 4*1000*1000;
+
+template<class M> void timeLookups(const string &name, const M &map, size_t memory,
+				   double build_seconds, const vector<int64_t> &probes) {
+    int64_t sum = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < probes.size(); ++i) {
+	const int64_t *v = map.lookup(probes[i]);
+	if (v != NULL) {
+	    sum += *v;
+	}
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    cout << format("  %-14s build %7.2f s, %8.1f MiB, %5.1f bytes/key, lookup %6.1f ns%s\n")
+	% name % build_seconds % (memory / (1024.0 * 1024)) % (static_cast<double>(memory) / map.size())
+	% (elapsed * 1.0e9 / probes.size()) % (sum == 0 ? " (no hits)" : "");
+}
+
+template<class M> void hashMapTest(const string &name, const vector<int64_t> &keys,
+				   const vector<int64_t> &probes) {
+    Clock::Tfrac start = Clock::todTfrac();
+    M map;
+    for(size_t i = 0; i < keys.size(); ++i) {
+	map[keys[i]] = i + 1;
+    }
+    double build = Clock::TfracToDouble(Clock::todTfrac() - start);
+    timeLookups(name, map, map.memoryUsage(), build, probes);
+}
+
+void perfectTest(const vector<int64_t> &keys, const vector<int64_t> &probes) {
+    vector<pair<int64_t, int64_t> > entries;
+    entries.reserve(keys.size());
+    for(size_t i = 0; i < keys.size(); ++i) {
+	entries.push_back(make_pair(keys[i], i + 1));
+    }
+    Clock::Tfrac start = Clock::todTfrac();
+    PerfectMap map(entries);
+    double build = Clock::TfracToDouble(Clock::todTfrac() - start);
+    timeLookups("PerfectHashMap", map, map.memoryUsage(), build, probes);
+    cout << format("  %.2f bits per key beyond the entries\n") % map.overheadBitsPerKey();
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: perfect_hashmap_speed [max-keys [min-keys]]");
+    size_t max_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : 10*1000*1000;
+    size_t min_keys = argc > 2 ? strtoull(argv[2], NULL, 10) : max_keys;
+    SINVARIANT(min_keys > 0 && min_keys <= max_keys);
+
+    MersenneTwisterRandom rng(1776);
+    for(size_t nkeys = min_keys; nkeys <= max_keys; nkeys *= 10) {
+	vector<int64_t> keys(nkeys);
+	for(size_t i = 0; i < nkeys; ++i) {
+	    keys[i] = rng.randLongLong();
+	}
+	vector<int64_t> probes(nprobes);
+	for(size_t i = 0; i < nprobes; ++i) {
+	    probes[i] = keys[rng.randLongLong() % nkeys];
+	}
+	cout << format("%d keys, %d random hits:\n") % nkeys % nprobes;
+	hashMapTest<ChainedMap>("HashMap", keys, probes);
+	hashMapTest<FlatMap>("flat HashMap", keys, probes);
+	perfectTest(keys, probes);
+    }
+    return 0;
+}
@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <queue>
+#include <string>
 
 #include <Lintel/MersenneTwisterRandom.hpp>
 #include <Lintel/PriorityQueue.hpp>
@@ -22,11 +23,11 @@ void check(const T &queue_1, const U &queue_2) {
     }
 }
 	   
-void test_basic() {
+template<class PQ> void test_basic() {
     MersenneTwisterRandom mt(1933);
 
     std::priority_queue<int> stl_queue;
-    PriorityQueue<int> lintel_queue;
+    PQ lintel_queue;
 
     for(unsigned i=0; i < 1000; ++i) {
 	uint32_t v = mt.randInt();
@@ -47,11 +48,11 @@ void test_basic() {
 }
 
 // interleave pushes and pops
-void test_random() {
+template<class PQ> void test_random() {
     MersenneTwisterRandom mt;
 
     std::priority_queue<int> stl_queue;
-    PriorityQueue<int> lintel_queue;
+    PQ lintel_queue;
 
     while (lintel_queue.size() < 10000) {
 	uint32_t v = mt.randInt();
@@ -76,11 +77,11 @@ void test_random() {
     check(stl_queue, lintel_queue);
 }
 
-void test_replaceTop() {
+template<class PQ> void test_replaceTop() {
     MersenneTwisterRandom mt;
 
-    PriorityQueue<int> lintel_queue;
-    PriorityQueue<int> replace_top_queue;
+    PQ lintel_queue;
+    PQ replace_top_queue;
 
     while (lintel_queue.size() < 1000) {
 	uint32_t v = mt.randInt();
@@ -118,6 +119,55 @@ void test_replaceTop() {
     check(lintel_queue, replace_top_queue);
 }
 
+template<class PQ> void test_bottomUp() {
+    MersenneTwisterRandom mt(1066);
+
+    std::priority_queue<int> stl_queue;
+    PQ lintel_queue;
+
+    for(unsigned i = 0; i < 20000; ++i) {
+	if (mt.randInt(3) == 0 && !lintel_queue.empty()) {
+	    stl_queue.pop();
+	    lintel_queue.pop_bottom_up_heuristic();
+	} else {
+	    int v = mt.randInt(5000);
+	    stl_queue.push(v);
+	    lintel_queue.push(v);
+	}
+	check(stl_queue, lintel_queue);
+    }
+    lintel_queue.selfVerify();
+}
+
+template<class PQ> void test_all() {
+    test_basic<PQ>();
+    test_random<PQ>();
+    test_replaceTop<PQ>();
+    test_bottomUp<PQ>();
+}
+
+// strings are not default constructed into the queue's slots the same
+// way ints are, and are big enough that the children do not line up
+// with cache lines.
+void test_strings() {
+    MersenneTwisterRandom mt(1848);
+    std::priority_queue<std::string> stl_queue;
+    PriorityQueue<std::string, std::less_equal<std::string>, 4> lintel_queue(1);
+
+    for(unsigned i = 0; i < 2000; ++i) {
+	std::string v(1 + mt.randInt(20), 'a' + mt.randInt(26));
+	stl_queue.push(v);
+	lintel_queue.push(v);
+	check(stl_queue, lintel_queue);
+    }
+    lintel_queue.selfVerify();
+    while(!lintel_queue.empty()) {
+	check(stl_queue, lintel_queue);
+	stl_queue.pop();
+	lintel_queue.pop();
+    }
+}
+
 void test_clear() {
     PriorityQueue<int> test;
     test.push(5);
@@ -126,9 +176,11 @@ void test_clear() {
 }
 
 int main() {
-    test_basic();
-    test_random();
-    test_replaceTop();
+    test_all<PriorityQueue<int> >();
+    test_all<PriorityQueue<int, std::less_equal<int>, 3> >();
+    test_all<PriorityQueue<int, std::less_equal<int>, 4> >();
+    test_all<PriorityQueue<int, std::less_equal<int>, 8> >();
+    test_strings();
     test_clear();
     std::cout << "Test passed\n";
     return 0;
@@ -0,0 +1,132 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Time the hold operation of an event simulator -- take the next
+    event, and schedule one a random time after it -- on queues of
+    sizes from 1000 up, with std::priority_queue, PriorityQueue of
+    arity 2, 4 and 8, and SequenceHeap.  The events are doubles, which
+    are cheap to compare and copy, and strings with a long common
+    prefix, which are not.  Reports ns per hold, and per push while
+    filling the queue.
+
+    Usage: priority_queue_speed [max-double-size [max-string-size [nholds]]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PriorityQueue.hpp>
+#include <Lintel/SequenceHeap.hpp>
+
+using namespace std;
+using boost::format;
+
+template<class T> struct Geq {
+    bool operator()(const T &a, const T &b) const {
+	return a >= b;
+    }
+};
+
+// Event times are kept in the strings as a fixed prefix and 16 hex
+// digits, so they sort in time order and most of a compare is spent
+// on the prefix.
+static const string prefix("simulator/event-queue/");
+
+struct DoubleEvents {
+    typedef double T;
+    static T make(double t) { return t; }
+    static double time(const T &v) { return v; }
+};
+
+struct StringEvents {
+    typedef string T;
+    static T make(double t) {
+	static const char hex[] = "0123456789abcdef";
+	uint64_t v = static_cast<uint64_t>(t * 1.0e9);
+	string ret(prefix);
+	ret.resize(prefix.size() + 16);
+	for(size_t i = ret.size(); i > prefix.size(); v >>= 4) {
+	    ret[--i] = hex[v & 0xF];
+	}
+	return ret;
+    }
+    static double time(const T &v) {
+	uint64_t ret = 0;
+	for(size_t i = prefix.size(); i < v.size(); ++i) {
+	    ret = (ret << 4) | (v[i] <= '9' ? v[i] - '0' : v[i] - 'a' + 10);
+	}
+	return ret * 1.0e-9;
+    }
+};
+
+template<class Q, class E> double holdTest(const string &name, size_t size, size_t nholds) {
+    MersenneTwisterRandom rng(size);
+    Q q;
+
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < size; ++i) {
+	q.push(E::make(rng.randDouble() * size));
+    }
+    double fill = Clock::TfracToDouble(Clock::todTfrac() - start);
+
+    double sum = 0;
+    start = Clock::todTfrac();
+    for(size_t i = 0; i < nholds; ++i) {
+	double now = E::time(q.top());
+	sum += now;
+	q.pop();
+	q.push(E::make(now + rng.randDouble() * size));
+    }
+    double hold = Clock::TfracToDouble(Clock::todTfrac() - start);
+    cout << format("  %-22s push %7.1f ns, hold %7.1f ns\n")
+	% name % (fill * 1.0e9 / size) % (hold * 1.0e9 / nholds);
+    return sum;
+}
+
+template<class E> void sizeTest(size_t size, size_t nholds) {
+    typedef typename E::T T;
+    typedef Geq<T> Cmp;
+    cout << format("%d entries:\n") % size;
+
+    double expect = holdTest<priority_queue<T, vector<T>, greater<T> >, E>
+	("std::priority_queue", size, nholds);
+    double sums[] = {
+	holdTest<PriorityQueue<T, Cmp>, E>("PriorityQueue", size, nholds),
+	holdTest<PriorityQueue<T, Cmp, 4>, E>("PriorityQueue<4>", size, nholds),
+	holdTest<PriorityQueue<T, Cmp, 8>, E>("PriorityQueue<8>", size, nholds),
+	holdTest<SequenceHeap<T, Cmp>, E>("SequenceHeap", size, nholds),
+    };
+    for(size_t i = 0; i < sizeof(sums) / sizeof(sums[0]); ++i) {
+	INVARIANT(sums[i] == expect, format("queue %d disagrees: %.6f != %.6f")
+		  % i % sums[i] % expect);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 4, "Usage: priority_queue_speed [max-double-size"
+	      " [max-string-size [nholds]]]");
+    size_t max_double = argc > 1 ? strtoul(argv[1], NULL, 10) : 100*1000*1000;
+    size_t max_string = argc > 2 ? strtoul(argv[2], NULL, 10) : 10*1000*1000;
+    size_t nholds = argc > 3 ? strtoul(argv[3], NULL, 10) : 1000*1000;
+    SINVARIANT(nholds > 0);
+
+    cout << format("double events, %d holds\n") % nholds;
+    for(size_t size = 1000; size <= max_double; size *= 10) {
+	sizeTest<DoubleEvents>(size, nholds);
+    }
+    cout << format("string events, %d holds\n") % nholds;
+    for(size_t size = 1000; size <= max_string; size *= 10) {
+	sizeTest<StringEvents>(size, nholds);
+    }
+    return 0;
+}
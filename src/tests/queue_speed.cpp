@@ -0,0 +1,146 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare the throughput and enqueue to dequeue latency of a Deque
+    behind a mutex and condition variables, MPMCBoundedQueue and, for
+    one producer, SPSCRing, with 1 to max-producers producer threads
+    feeding one consumer; the queues block when full or empty.
+
+    Usage: queue_speed [max-producers [items-per-producer [capacity]]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/Deque.hpp>
+#include <Lintel/MPMCBoundedQueue.hpp>
+#include <Lintel/PThread.hpp>
+#include <Lintel/SPSCRing.hpp>
+
+using namespace std;
+using boost::format;
+
+// the time the item was pushed, or 0 to stop the consumer
+typedef Clock::Tfrac Item;
+
+class LockedDeque {
+public:
+    explicit LockedDeque(size_t capacity) : capacity(capacity) { }
+
+    void push(const Item &v) {
+	PThreadScopedLock lock(mutex);
+	while (deque.size() >= capacity) {
+	    not_full.wait(mutex);
+	}
+	deque.push_back(v);
+	if (deque.size() == 1) {
+	    not_empty.signal();
+	}
+    }
+
+    void pop(Item &out) {
+	PThreadScopedLock lock(mutex);
+	while (deque.empty()) {
+	    not_empty.wait(mutex);
+	}
+	out = deque.front();
+	deque.pop_front();
+	not_full.broadcast();
+    }
+
+private:
+    size_t capacity;
+    PThreadMutex mutex;
+    PThreadCond not_empty, not_full;
+    Deque<Item> deque;
+};
+
+class MPMC : public MPMCBoundedQueue<Item> {
+public:
+    explicit MPMC(size_t capacity) : MPMCBoundedQueue<Item>(capacity, true) { }
+};
+
+class SPSC : public SPSCRing<Item> {
+public:
+    explicit SPSC(size_t capacity) : SPSCRing<Item>(capacity, true) { }
+};
+
+template<class Q> void *producer(Q *queue, size_t nitems) {
+    for(size_t i = 0; i < nitems; ++i) {
+	queue->push(Clock::todTfrac());
+    }
+    return NULL;
+}
+
+template<class Q> void *consumer(Q *queue, int nproducers, double *latency_sum) {
+    double sum = 0;
+    for(int stopped = 0; stopped < nproducers; ) {
+	Item v;
+	queue->pop(v);
+	if (v == 0) {
+	    ++stopped;
+	} else {
+	    sum += Clock::TfracToDouble(Clock::todTfrac() - v);
+	}
+    }
+    *latency_sum = sum;
+    return NULL;
+}
+
+template<class Q> void *stoppingProducer(Q *queue, size_t nitems) {
+    producer(queue, nitems);
+    queue->push(0);
+    return NULL;
+}
+
+template<class Q> void runTest(const string &name, int nproducers, size_t nitems,
+			       size_t capacity) {
+    Q queue(capacity);
+    double latency_sum = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    PThreadFunction consumer_thread(boost::bind(consumer<Q>, &queue, nproducers, &latency_sum));
+    consumer_thread.start();
+    vector<PThreadFunction *> threads;
+    for(int i = 0; i < nproducers; ++i) {
+	threads.push_back(new PThreadFunction(boost::bind(stoppingProducer<Q>, &queue, nitems)));
+	threads.back()->start();
+    }
+    for(int i = 0; i < nproducers; ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+    consumer_thread.join();
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    size_t total = nproducers * nitems;
+    cout << format("  %-16s %7.2f Mitems/s, latency %8.2f us\n") % name
+	% (total / elapsed / 1.0e6) % (latency_sum / total * 1.0e6);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 4, "Usage: queue_speed [max-producers [items-per-producer [capacity]]]");
+    int max_producers = argc > 1 ? atoi(argv[1]) : 16;
+    size_t nitems = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000*1000;
+    size_t capacity = argc > 3 ? strtoul(argv[3], NULL, 10) : 1024;
+    SINVARIANT(max_producers > 0 && nitems > 0 && capacity > 0);
+
+    cout << format("%d items/producer, capacity %d, %d cpus\n") % nitems % capacity
+	% PThreadMisc::getNCpus();
+    for(int nproducers = 1; nproducers <= max_producers; nproducers *= 2) {
+	cout << format("%d producers:\n") % nproducers;
+	runTest<LockedDeque>("mutex Deque", nproducers, nitems, capacity);
+	runTest<MPMC>("MPMCBoundedQueue", nproducers, nitems, capacity);
+	if (nproducers == 1) {
+	    runTest<SPSC>("SPSCRing", nproducers, nitems, capacity);
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    test for RadixHeap, against std::priority_queue
+*/
+
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <vector>
+
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/RadixHeap.hpp>
+
+using namespace std;
+using boost::format;
+
+template<class Key> void check(const priority_queue<Key, vector<Key>, greater<Key> > &expect,
+			       const RadixHeap<Key, int> &heap) {
+    SINVARIANT(expect.size() == heap.size());
+    if (!expect.empty()) {
+	SINVARIANT(expect.top() == heap.top().first);
+	SINVARIANT(static_cast<int>(heap.top().first % 1000) == heap.top().second);
+    }
+}
+
+// keys a random distance after the last one popped, with spreads from
+// a few ticks to most of the key range
+template<class Key> void testMonotone(uint32_t seed, unsigned spread_bits) {
+    MersenneTwisterRandom mt(seed);
+    priority_queue<Key, vector<Key>, greater<Key> > expect;
+    RadixHeap<Key, int> heap;
+    Key now = 0;
+
+    for(unsigned i = 0; i < 100000; ++i) {
+	if (mt.randInt(5) < 2 && !heap.empty()) {
+	    now = heap.top().first;
+	    expect.pop();
+	    heap.pop();
+	} else {
+	    Key delta = static_cast<Key>(mt.randLongLong() >> (64 - spread_bits));
+	    Key key = now + delta;
+	    if (key < now) {
+		key = numeric_limits<Key>::max(); // do not wrap around
+	    }
+	    expect.push(key);
+	    heap.push(key, static_cast<int>(key % 1000));
+	}
+	check(expect, heap);
+    }
+    while (!heap.empty()) {
+	SINVARIANT(heap.top().first >= now);
+	now = heap.top().first;
+	expect.pop();
+	heap.pop();
+	check(expect, heap);
+    }
+}
+
+void testDuplicates() {
+    RadixHeap<uint32_t, int> heap;
+    for(int i = 0; i < 10; ++i) {
+	heap.push(5, 5);
+	heap.push(7, 7);
+    }
+    for(int i = 0; i < 20; ++i) {
+	SINVARIANT(heap.top().first == (i < 11 ? 5U : 7U));
+	heap.pop();
+	if (i == 3) {
+	    heap.push(5, 5); // equal to the last popped is fine
+	}
+	if (i == 10) {
+	    heap.push(7, 7);
+	}
+    }
+    SINVARIANT(heap.size() == 2);
+    heap.clear();
+    SINVARIANT(heap.empty());
+    heap.push(1, 1); // anything goes after clear()
+    SINVARIANT(heap.top().first == 1);
+}
+
+int main() {
+    testMonotone<uint32_t>(1, 4);
+    testMonotone<uint32_t>(2, 16);
+    testMonotone<uint32_t>(3, 30);
+    testMonotone<uint64_t>(4, 8);
+    testMonotone<uint64_t>(5, 40);
+    testMonotone<uint64_t>(6, 62);
+    testDuplicates();
+    cout << "radix heap tests passed.\n";
+    return 0;
+}
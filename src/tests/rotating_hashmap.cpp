@@ -10,6 +10,9 @@
 
 */
 
+#include <string>
+#include <vector>
+
 #include <Lintel/RotatingHashMap.hpp>
 
 void test_odd(int k, int &v) 
@@ -18,8 +21,148 @@ void test_odd(int k, int &v)
     v = -1; // test mutability
 }
 
+void countDropped(int &dropped, int k, int &)
+{
+    SINVARIANT(k != 0);
+    ++dropped;
+}
+
+// With K generations, an entry is dropped by the K'th rotation after
+// its last use.
+void testGenerations()
+{
+    RotatingHashMap<int, int> hm(4);
+    SINVARIANT(hm.ngenerations() == 4);
+    for(int round = 0; round < 4; ++round) {
+	for(int i = 0; i < 10; ++i) {
+	    hm[round * 10 + i] = round;
+	}
+	hm.rotate();
+    }
+    // 0-9 were dropped by the 4th rotation
+    SINVARIANT(hm.size_recent() == 0 && hm.size_old() == 30 && hm.size() == 30);
+    SINVARIANT(!hm.existsNoPromote(5) && hm.existsNoPromote(15));
+    SINVARIANT(hm.exists_old(15) && !hm.exists_recent(15));
+    SINVARIANT(*hm.lookup(15) == 1 && hm.exists_recent(15) && !hm.exists_old(15));
+
+    int dropped = 0;
+    hm.rotate(boost::bind(countDropped, boost::ref(dropped), _1, _2));
+    SINVARIANT(dropped == 9 && hm.size() == 21);
+    SINVARIANT(hm.remove(15) && !hm.remove(15, false) && hm.remove(25));
+    hm.flushRotate(boost::bind(countDropped, boost::ref(dropped), _1, _2));
+    SINVARIANT(dropped == 9 + 19 && hm.empty());
+}
+
+void testMaybeRotate()
+{
+    RotatingHashMap<int, int> hm(3);
+    const Clock::Tfrac second = Clock::secondsToTfrac(1);
+    // keep entries for at least 10 seconds
+    hm.setRotateInterval(5 * second);
+    Clock::Tfrac start = 1000 * second;
+    SINVARIANT(!hm.maybeRotate(start));
+    hm[1] = 1;
+    SINVARIANT(!hm.maybeRotate(start + 4 * second));
+    hm[2] = 2;
+    SINVARIANT(hm.maybeRotate(start + 5 * second) && hm.size_old() == 2);
+    SINVARIANT(!hm.maybeRotate(start + 9 * second));
+    SINVARIANT(hm.maybeRotate(start + 10 * second) && hm.size() == 2);
+    // the interval ending at 15 drops both of them, 2 after 11 seconds
+    SINVARIANT(hm.maybeRotate(start + 15 * second) && hm.empty());
+
+    // a gap of more than one interval rotates once per interval,
+    // stopping once the map is empty.
+    hm[3] = 3;
+    SINVARIANT(hm.maybeRotate(start + 24 * second) && hm.size_old() == 1);
+    hm[4] = 4;
+    int dropped = 0;
+    SINVARIANT(hm.maybeRotate(start + 1000 * second,
+			      boost::bind(countDropped, boost::ref(dropped), _1, _2)));
+    SINVARIANT(hm.empty() && dropped == 2);
+    SINVARIANT(!hm.maybeRotate(start + 1004 * second));
+    SINVARIANT(hm.maybeRotate(start + 1005 * second));
+}
+
+// Runs the tasks when told to, as a background thread would later.
+struct DeferredRunner {
+    std::vector<boost::function<void ()> > tasks;
+    void add(const boost::function<void ()> &task) {
+	tasks.push_back(task);
+    }
+    void runAll() {
+	for(size_t i = 0; i < tasks.size(); ++i) {
+	    tasks[i]();
+	}
+	tasks.clear();
+    }
+};
+
+void testBackground()
+{
+    RotatingHashMap<int, int> hm(2);
+    DeferredRunner runner;
+    hm.setBackgroundRunner(boost::bind(&DeferredRunner::add, &runner, _1));
+    for(int i = 1; i <= 100; ++i) {
+	hm[i] = i;
+    }
+    int dropped = 0;
+    hm.rotate(boost::bind(countDropped, boost::ref(dropped), _1, _2));
+    // the dropped table was empty, so nothing was handed off
+    SINVARIANT(runner.tasks.empty() && dropped == 0);
+    hm.rotate(boost::bind(countDropped, boost::ref(dropped), _1, _2));
+    SINVARIANT(runner.tasks.size() == 1 && dropped == 0 && hm.empty());
+    hm[1] = 1;
+    runner.runAll();
+    SINVARIANT(dropped == 100 && hm.size() == 1);
+
+    RotatingHashMap<int, int>::HashMapT *detached = hm.rotateDetach();
+    SINVARIANT(detached->empty() && hm.size_old() == 1);
+    delete detached;
+    detached = hm.rotateDetach();
+    SINVARIANT(detached->size() == 1 && (*detached)[1] == 1 && hm.empty());
+    delete detached;
+}
+
+#if __cplusplus >= 201103L
+struct Counted {
+    static int copies;
+    std::string s;
+    Counted() { }
+    explicit Counted(const std::string &s) : s(s) { }
+    Counted(const Counted &from) : s(from.s) { ++copies; }
+    Counted(Counted &&from) noexcept : s(std::move(from.s)) { }
+    Counted &operator=(const Counted &from) { s = from.s; ++copies; return *this; }
+    Counted &operator=(Counted &&from) noexcept { s = std::move(from.s); return *this; }
+};
+int Counted::copies;
+
+// promoting from an old generation moves the value
+void testMovePromote()
+{
+    RotatingHashMap<int, Counted> hm(3);
+    for(int i = 0; i < 100; ++i) {
+	hm[i].s = "value";
+    }
+    hm.rotate();
+    hm.rotate();
+    Counted::copies = 0;
+    for(int i = 0; i < 100; ++i) {
+	SINVARIANT(hm.lookup(i)->s == "value" && hm.exists_recent(i) && !hm.exists_old(i));
+	hm[i + 1000].s = "new";
+    }
+    SINVARIANT(Counted::copies == 0 && hm.size_recent() == 200);
+}
+#endif
+
 int main()
 {
+    testGenerations();
+    testMaybeRotate();
+    testBackground();
+#if __cplusplus >= 201103L
+    testMovePromote();
+#endif
+
     RotatingHashMap<int, int> test_hm;
 
     SINVARIANT(test_hm.empty());
@@ -0,0 +1,96 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Count packets per flow in a stream of packets, expiring flows that
+    have been idle for a window, with RotatingHashMap and different
+    numbers of generations.  Reports the peak and average memory and
+    entries held, and the time per packet.
+
+    Usage: rotating_hashmap_speed [npackets [nactive]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/RotatingHashMap.hpp>
+
+using namespace std;
+using boost::format;
+
+// One packet per microsecond, flows have to be kept for 100ms after
+// their last packet.
+static const double packet_interval = 1.0e-6;
+static const double window = 0.1;
+
+struct Packet {
+    Clock::Tfrac time;
+    uint64_t flow;
+};
+
+// Each packet starts a new flow with probability 1/8, otherwise it
+// belongs to one of the last nactive flows started, so flows go idle
+// after about 8 * nactive packets and then wait to be expired.
+void makeStream(vector<Packet> &stream, size_t npackets, uint32_t nactive) {
+    MersenneTwisterRandom rng(1776);
+    uint64_t next_flow = nactive;
+    stream.resize(npackets);
+    for(size_t i = 0; i < npackets; ++i) {
+	stream[i].time = Clock::secondsToTfrac(1 + i * packet_interval);
+	if (rng.randInt(8) == 0) {
+	    stream[i].flow = next_flow++;
+	} else {
+	    stream[i].flow = next_flow - 1 - rng.randInt(nactive);
+	}
+    }
+}
+
+void flowTest(const vector<Packet> &stream, size_t ngenerations) {
+    RotatingHashMap<uint64_t, uint64_t> flows(ngenerations);
+    flows.setRotateInterval(Clock::secondsToTfrac(window / (ngenerations - 1)));
+
+    size_t max_memory = 0, max_entries = 0, nsamples = 0;
+    double sum_memory = 0, sum_entries = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < stream.size(); ++i) {
+	flows.maybeRotate(stream[i].time);
+	++flows[stream[i].flow];
+	if ((i & 1023) == 0) {
+	    size_t memory = flows.memoryUsage(), entries = flows.size();
+	    max_memory = max(max_memory, memory);
+	    max_entries = max(max_entries, entries);
+	    sum_memory += memory;
+	    sum_entries += entries;
+	    ++nsamples;
+	}
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    cout << format("%d generations: %6.1f ns/packet; memory peak %8.2f MiB, avg %8.2f MiB;"
+		   " entries peak %8d, avg %10.0f\n")
+	% ngenerations % (elapsed * 1.0e9 / stream.size())
+	% (max_memory / (1024.0 * 1024)) % (sum_memory / nsamples / (1024 * 1024))
+	% max_entries % (sum_entries / nsamples);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: rotating_hashmap_speed [npackets [nactive]]");
+    size_t npackets = argc > 1 ? strtoul(argv[1], NULL, 10) : 10*1000*1000;
+    uint32_t nactive = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+    SINVARIANT(npackets > 0 && nactive > 0);
+
+    vector<Packet> stream;
+    makeStream(stream, npackets, nactive);
+    cout << format("%d packets, %d active flows, %.0f ms window\n")
+	% npackets % nactive % (window * 1000);
+    for(size_t k = 2; k <= 5; ++k) {
+	flowTest(stream, k);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    test for SequenceHeap, against std::priority_queue
+*/
+
+#include <iostream>
+#include <queue>
+#include <string>
+
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/SequenceHeap.hpp>
+#include <Lintel/StringUtil.hpp>
+
+using namespace std;
+using boost::format;
+
+template<class T, class U>
+void check(const T &queue_1, const U &queue_2) {
+    if (queue_1.empty()) {
+	SINVARIANT(queue_2.empty());
+    } else {
+	SINVARIANT(queue_1.size() == queue_2.size());
+	SINVARIANT(queue_1.top() == queue_2.top());
+    }
+}
+
+// Tiny insertion heaps and merge widths, so that runs get merged
+// through several groups and the deletion buffer is refilled often.
+void testRandom(uint32_t insert_size, uint32_t merge_ways, uint32_t max_size) {
+    MersenneTwisterRandom mt(insert_size * 1000 + merge_ways);
+
+    std::priority_queue<int> stl_queue;
+    SequenceHeap<int> seq_heap(insert_size, merge_ways);
+
+    for(unsigned round = 0; round < 4; ++round) {
+	// grow, then shrink to empty
+	while (seq_heap.size() < max_size) {
+	    if (mt.randInt(4) == 0 && !seq_heap.empty()) {
+		stl_queue.pop();
+		seq_heap.pop();
+	    } else {
+		int v = mt.randInt(1000); // plenty of ties
+		stl_queue.push(v);
+		seq_heap.push(v);
+	    }
+	    check(stl_queue, seq_heap);
+	}
+	while (!seq_heap.empty()) {
+	    if (mt.randInt(4) == 0) {
+		int v = mt.randInt(1000);
+		stl_queue.push(v);
+		seq_heap.push(v);
+	    } else {
+		stl_queue.pop();
+		seq_heap.pop();
+	    }
+	    check(stl_queue, seq_heap);
+	}
+    }
+}
+
+struct DoubleGeq {
+    bool operator()(double a, double b) const {
+	return a >= b;
+    }
+};
+
+// the hold model of an event simulator: take the next event, and
+// schedule a new one a random time after it.
+void testHold() {
+    MersenneTwisterRandom mt(1776);
+    std::priority_queue<double, vector<double>, greater<double> > stl_queue;
+    SequenceHeap<double, DoubleGeq> seq_heap(16, 4);
+
+    for(unsigned i = 0; i < 10000; ++i) {
+	double v = mt.randDouble();
+	stl_queue.push(v);
+	seq_heap.push(v);
+    }
+    SINVARIANT(seq_heap.nruns() > 0);
+    for(unsigned i = 0; i < 100000; ++i) {
+	check(stl_queue, seq_heap);
+	double now = seq_heap.top();
+	stl_queue.pop();
+	seq_heap.pop();
+	double v = now + mt.randDouble();
+	stl_queue.push(v);
+	seq_heap.push(v);
+    }
+    for(double last = 0; !seq_heap.empty(); ) {
+	check(stl_queue, seq_heap);
+	SINVARIANT(seq_heap.top() >= last);
+	last = seq_heap.top();
+	stl_queue.pop();
+	seq_heap.pop();
+    }
+    check(stl_queue, seq_heap);
+}
+
+void testStrings() {
+    MersenneTwisterRandom mt(1492);
+    std::priority_queue<string> stl_queue;
+    SequenceHeap<string> seq_heap(8, 3);
+
+    for(unsigned i = 0; i < 5000; ++i) {
+	if (mt.randInt(3) == 0 && !seq_heap.empty()) {
+	    stl_queue.pop();
+	    seq_heap.pop();
+	} else {
+	    string v = str(format("%08x") % mt.randInt());
+	    stl_queue.push(v);
+	    seq_heap.push(v);
+	}
+	check(stl_queue, seq_heap);
+    }
+    seq_heap.clear();
+    SINVARIANT(seq_heap.empty() && seq_heap.size() == 0 && seq_heap.nruns() == 0);
+}
+
+int main() {
+    testRandom(1, 2, 100);
+    testRandom(4, 2, 1000);
+    testRandom(5, 3, 2000);
+    testRandom(64, 8, 10000);
+    testHold();
+    testStrings();
+    cout << "sequence heap tests passed.\n";
+    return 0;
+}
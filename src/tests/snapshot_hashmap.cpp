@@ -0,0 +1,137 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    SnapshotHashMap and EpochReclaimer test program
+*/
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/EpochReclaimer.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/PThread.hpp>
+#include <Lintel/SnapshotHashMap.hpp>
+#include <Lintel/TestUtil.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef SnapshotHashMap<int32_t, int64_t> VersionMap;
+
+static const int32_t nkeys = 1000;
+static const int64_t nversions = 500;
+
+static lintel::Atomic<int32_t> live_tracked(0);
+
+struct Tracked {
+    Tracked() { ++live_tracked; }
+    ~Tracked() { --live_tracked; }
+};
+
+void testReclaimer() {
+    EpochReclaimer::synchronize();
+    SINVARIANT(EpochReclaimer::pending() == 0);
+    {
+	EpochReclaimer::ReadGuard guard;
+	EpochReclaimer::ReadGuard nested;
+	EpochReclaimer::retire(new Tracked());
+	// retiring while reading keeps it, since this thread might
+	// still be using it.
+	EpochReclaimer::retire(new Tracked());
+	SINVARIANT(live_tracked.load() == 2 && EpochReclaimer::pending() == 2);
+	TEST_INVARIANT_MSG1(EpochReclaimer::synchronize(),
+			    "EpochReclaimer::synchronize() called inside a ReadGuard");
+    }
+    EpochReclaimer::retire(new Tracked());
+    SINVARIANT(live_tracked.load() == 0 && EpochReclaimer::pending() == 0);
+    cout << format("reclaimer test passed, %s barrier.\n")
+	% (EpochReclaimer::asymmetricBarrier() ? "membarrier" : "fence");
+}
+
+void testBasic() {
+    VersionMap map;
+    int64_t v = -1;
+    SINVARIANT(map.size() == 0 && !map.lookup(1, v) && v == -1 && !map.exists(1));
+
+    HashMap<int32_t, int64_t> hm;
+    hm[1] = 10;
+    hm[2] = 20;
+    map.publish(hm);
+    SINVARIANT(map.size() == 2 && map.lookup(1, v) && v == 10 && map.exists(2));
+
+    hm[3] = 30;
+    hm.remove(1);
+    {
+	VersionMap::Reader reader(map);
+	map.publish(hm);
+	// the reader still sees the version it started with
+	SINVARIANT(reader->size() == 2 && *reader->lookup(1) == 10 && !reader->exists(3));
+    }
+    SINVARIANT(!map.exists(1) && map.lookup(3, v) && v == 30);
+    EpochReclaimer::synchronize();
+    SINVARIANT(EpochReclaimer::pending() == 0);
+}
+
+// every snapshot has all of the keys with the same value, and
+// versions only go forward.
+void *readWorker(const VersionMap *map, lintel::Atomic<int64_t> *nreads) {
+    int64_t last_version = 0, reads = 0;
+    while (last_version < nversions) {
+	VersionMap::Reader reader(*map);
+	if (reader->empty()) {
+	    continue;
+	}
+	int64_t version = *reader->lookup(0);
+	INVARIANT(version >= last_version, format("version went back from %d to %d")
+		  % last_version % version);
+	for(int32_t k = 0; k < nkeys; k += 37) {
+	    const int64_t *v = reader->lookup(k);
+	    INVARIANT(v != NULL && *v == version,
+		      format("key %d missing or wrong in version %d") % k % version);
+	}
+	last_version = version;
+	++reads;
+    }
+    nreads->fetch_add(reads);
+    return NULL;
+}
+
+void testThreaded(int32_t nreaders) {
+    VersionMap map;
+    lintel::Atomic<int64_t> nreads(0);
+    vector<PThreadFunction *> threads;
+    for(int32_t i = 0; i < nreaders; ++i) {
+	threads.push_back(new PThreadFunction(boost::bind(readWorker, &map, &nreads)));
+	threads.back()->start();
+    }
+    HashMap<int32_t, int64_t> hm;
+    for(int64_t version = 1; version <= nversions; ++version) {
+	for(int32_t k = 0; k < nkeys; ++k) {
+	    hm[k] = version;
+	}
+	map.publish(hm);
+    }
+    for(int32_t i = 0; i < nreaders; ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+    EpochReclaimer::synchronize();
+    SINVARIANT(EpochReclaimer::pending() == 0);
+    cout << format("%d reader test passed, %d snapshot reads.\n") % nreaders % nreads.load();
+}
+
+int main() {
+    testReclaimer();
+    testBasic();
+    testThreaded(1);
+    testThreaded(4);
+    cout << "success.\n";
+    return 0;
+}
@@ -0,0 +1,161 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare lookup throughput of SnapshotHashMap against a HashMap
+    behind a single mutex and ConcurrentHashMap for 1 to max-threads
+    reader threads, while a writer changes one key and republishes
+    about every millisecond.
+
+    Usage: snapshot_hashmap_speed [max-threads [ops-per-thread [nkeys]]]
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/AtomicCounter.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/ConcurrentHashMap.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PThread.hpp>
+#include <Lintel/SnapshotHashMap.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef HashMap<int64_t, int64_t> SourceMap;
+
+class LockedMap {
+public:
+    bool lookup(int64_t k, int64_t &out) const {
+	PThreadScopedLock lock(mutex);
+	const int64_t *v = map.lookup(k);
+	if (v == NULL) {
+	    return false;
+	}
+	out = *v;
+	return true;
+    }
+    void fill(const SourceMap &from) {
+	PThreadScopedLock lock(mutex);
+	map = from;
+    }
+    void update(const SourceMap &from, int64_t k) {
+	PThreadScopedLock lock(mutex);
+	map[k] = from.find(k)->second;
+    }
+private:
+    mutable PThreadMutex mutex;
+    SourceMap map;
+};
+
+class Concurrent : public ConcurrentHashMap<int64_t, int64_t> {
+public:
+    void fill(const SourceMap &from) {
+	for(SourceMap::const_iterator i = from.begin(); i != from.end(); ++i) {
+	    set(i->first, i->second);
+	}
+    }
+    void update(const SourceMap &from, int64_t k) {
+	set(k, from.find(k)->second);
+    }
+};
+
+class Snapshot : public SnapshotHashMap<int64_t, int64_t> {
+public:
+    void fill(const SourceMap &from) {
+	publish(from);
+    }
+    void update(const SourceMap &from, int64_t) {
+	publish(from);
+    }
+};
+
+template<class M> void *reader(const M *map, uint32_t seed, size_t nops, uint32_t nkeys,
+			       int64_t *found) {
+    MersenneTwisterRandom rng(seed);
+    int64_t sum = 0;
+    for(size_t i = 0; i < nops; ++i) {
+	int64_t v;
+	if (map->lookup(rng.randInt(nkeys), v)) {
+	    sum += v;
+	}
+    }
+    *found = sum;
+    return NULL;
+}
+
+template<class M> void *writer(M *map, SourceMap *source, lintel::Atomic<int32_t> *stop,
+			       size_t *nupdates) {
+    MersenneTwisterRandom rng(1776);
+    while (stop->load() == 0) {
+	int64_t k = rng.randInt(source->size());
+	++(*source)[k];
+	map->update(*source, k);
+	++*nupdates;
+	usleep(1000);
+    }
+    return NULL;
+}
+
+template<class M> double runTest(int nthreads, size_t nops, uint32_t nkeys, size_t &nupdates) {
+    SourceMap source;
+    M map;
+    for(uint32_t k = 0; k < nkeys; ++k) {
+	source[k] = k;
+    }
+    map.fill(source);
+    lintel::Atomic<int32_t> stop(0);
+    nupdates = 0;
+    PThreadFunction update_thread(boost::bind(writer<M>, &map, &source, &stop, &nupdates));
+    update_thread.start();
+
+    vector<PThreadFunction *> threads;
+    vector<int64_t> found(nthreads);
+    Clock::Tfrac start = Clock::todTfrac();
+    for(int i = 0; i < nthreads; ++i) {
+	threads.push_back(new PThreadFunction(boost::bind(reader<M>, &map, i + 1, nops,
+							  nkeys, &found[i])));
+	threads.back()->start();
+    }
+    for(int i = 0; i < nthreads; ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+    double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    stop = 1;
+    update_thread.join();
+    EpochReclaimer::synchronize();
+    return nthreads * nops / elapsed / 1.0e6;
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 4, "Usage: snapshot_hashmap_speed [max-threads [ops-per-thread [nkeys]]]");
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    size_t nops = argc > 2 ? strtoul(argv[2], NULL, 10) : 10*1000*1000;
+    uint32_t nkeys = argc > 3 ? strtoul(argv[3], NULL, 10) : 10*1000;
+    SINVARIANT(max_threads > 0 && nops > 0 && nkeys > 0);
+
+    cout << format("%d lookups/thread, %d keys, %d cpus\n") % nops % nkeys
+	% PThreadMisc::getNCpus();
+    for(int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+	size_t locked_updates, concurrent_updates, snapshot_updates;
+	double locked_mops = runTest<LockedMap>(nthreads, nops, nkeys, locked_updates);
+	double concurrent_mops = runTest<Concurrent>(nthreads, nops, nkeys, concurrent_updates);
+	double snapshot_mops = runTest<Snapshot>(nthreads, nops, nkeys, snapshot_updates);
+	cout << format("%2d threads: mutex HashMap %7.2f, ConcurrentHashMap %7.2f,"
+		       " SnapshotHashMap %7.2f Mops/s; %d publishes\n")
+	    % nthreads % locked_mops % concurrent_mops % snapshot_mops % snapshot_updates;
+    }
+    cout << format("readers used %s\n")
+	% (EpochReclaimer::asymmetricBarrier() ? "membarrier" : "fences");
+    return 0;
+}
@@ -0,0 +1,112 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    SPSCRing test program
+*/
+
+#include <sched.h>
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/PThread.hpp>
+#include <Lintel/SPSCRing.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef SPSCRing<int64_t> Ring;
+
+static const int64_t nvalues = 200*1000;
+
+void basicTest() {
+    Ring ring(5);
+    SINVARIANT(ring.capacity() == 8 && ring.empty());
+    int64_t v = -1;
+    SINVARIANT(!ring.tryPop(v) && v == -1);
+    for(int64_t i = 0; i < 8; ++i) {
+	SINVARIANT(ring.tryPush(i));
+    }
+    SINVARIANT(!ring.tryPush(8) && ring.size() == 8);
+    SINVARIANT(ring.tryPop(v) && v == 0);
+
+    // wraps around
+    int64_t vals[] = { 8, 9, 10 };
+    SINVARIANT(ring.tryPush(vals, 3) == 1 && ring.size() == 8);
+    int64_t out[16];
+    SINVARIANT(ring.tryPop(out, 16) == 8);
+    for(int64_t i = 0; i < 8; ++i) {
+	SINVARIANT(out[i] == i + 1);
+    }
+    SINVARIANT(ring.empty() && ring.tryPop(out, 16) == 0);
+    SINVARIANT(ring.tryPush(vals, 3) == 3 && ring.tryPop(out, 2) == 2 && out[1] == 9);
+    SINVARIANT(ring.tryPop(v) && v == 10 && ring.empty());
+}
+
+// pushes 1..nvalues, in batches of 1 to batch
+void *producer(Ring *ring, size_t batch, bool blocking) {
+    vector<int64_t> vals(batch);
+    int64_t next = 1;
+    while (next <= nvalues) {
+	size_t n = min<int64_t>(1 + next % batch, nvalues - next + 1);
+	for(size_t i = 0; i < n; ++i) {
+	    vals[i] = next + i;
+	}
+	if (blocking && n == 1) {
+	    ring->push(vals[0]);
+	    ++next;
+	} else {
+	    size_t pushed = ring->tryPush(&vals[0], n);
+	    next += pushed;
+	    if (pushed == 0) {
+		sched_yield();
+	    }
+	}
+    }
+    return NULL;
+}
+
+void threadedTest(size_t capacity, size_t batch, bool blocking) {
+    Ring ring(capacity, blocking);
+    PThreadFunction thread(boost::bind(producer, &ring, batch, blocking));
+    thread.start();
+    vector<int64_t> out(batch);
+    int64_t expect = 1;
+    while (expect <= nvalues) {
+	size_t n;
+	if (blocking && expect % 2 == 0) {
+	    ring.pop(out[0]);
+	    n = 1;
+	} else {
+	    n = ring.tryPop(&out[0], batch);
+	    if (n == 0) {
+		sched_yield();
+	    }
+	}
+	for(size_t i = 0; i < n; ++i) {
+	    INVARIANT(out[i] == expect, format("got %d, expected %d") % out[i] % expect);
+	    ++expect;
+	}
+    }
+    thread.join();
+    SINVARIANT(ring.empty());
+    cout << format("capacity %d, batch %d, %s passed\n") % capacity % batch
+	% (blocking ? "blocking" : "polling");
+}
+
+int main() {
+    basicTest();
+    threadedTest(1, 1, false);
+    threadedTest(1024, 1, false);
+    threadedTest(1024, 32, false);
+    threadedTest(2, 1, true);
+    threadedTest(64, 8, true);
+    cout << "success.\n";
+    return 0;
+}
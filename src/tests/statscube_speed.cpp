@@ -0,0 +1,120 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Time StatsCube::cube() on a 6 dimensional tuple against cubing the
+    same base data by looking up each partial tuple with
+    getCubeEntry(), which hashes every partial tuple from scratch, and
+    time hashing the partial tuples alone.
+
+    Usage: statscube_speed [nbase [cardinality]]
+*/
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/Clock.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/StatsCube.hpp>
+
+using namespace std;
+using boost::format;
+
+typedef boost::tuple<int32_t, int32_t, string, int64_t, int32_t, string> Tuple;
+typedef lintel::StatsCube<Tuple> Cube;
+typedef Cube::MyAny MyAny;
+
+static const uint32_t nmasks = 1U << MyAny::length;
+
+// every partial tuple looked up through the hash of the whole key
+void cubeByEntry(Cube *cube, const Tuple &key, Stats &value) {
+    MyAny partial(key);
+    for(uint32_t mask = 0; mask < nmasks; ++mask) {
+	for(uint32_t i = 0; i < MyAny::length; ++i) {
+	    partial.any[i] = ((mask >> i) & 1) != 0;
+	}
+	if (mask != 0) {
+	    cube->getCubeEntry(partial).add(value);
+	}
+    }
+}
+
+void hashTest(const vector<Tuple> &tuples) {
+    uint32_t sum = 0;
+    Clock::Tfrac start = Clock::todTfrac();
+    for(size_t i = 0; i < tuples.size(); ++i) {
+	MyAny partial(tuples[i]);
+	for(uint32_t mask = 0; mask < nmasks; ++mask) {
+	    for(uint32_t j = 0; j < MyAny::length; ++j) {
+		partial.any[j] = ((mask >> j) & 1) != 0;
+	    }
+	    sum += lintel::hash(partial);
+	}
+    }
+    double each = Clock::TfracToDouble(Clock::todTfrac() - start);
+
+    uint32_t sum_cached = 0;
+    lintel::tuples::BitsetAnyTupleHashes<Tuple> hashes;
+    start = Clock::todTfrac();
+    for(size_t i = 0; i < tuples.size(); ++i) {
+	hashes.reset(tuples[i]);
+	for(uint32_t mask = 0; mask < nmasks; ++mask) {
+	    sum_cached += hashes[mask];
+	}
+    }
+    double cached = Clock::TfracToDouble(Clock::todTfrac() - start);
+    SINVARIANT(sum == sum_cached);
+    double per = 1.0e9 / (tuples.size() * nmasks);
+    cout << format("hash %d partial tuples: each %.1f ns, BitsetAnyTupleHashes %.1f ns"
+		   " per partial tuple, %.1fx\n")
+	% nmasks % (each * per) % (cached * per) % (each / cached);
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: statscube_speed [nbase [cardinality]]");
+    size_t nbase = argc > 1 ? strtoul(argv[1], NULL, 10) : 200*1000;
+    uint32_t cardinality = argc > 2 ? strtoul(argv[2], NULL, 10) : 10;
+    SINVARIANT(nbase > 0 && cardinality > 0);
+
+    MersenneTwisterRandom rng(1776);
+    vector<Tuple> tuples;
+    Cube by_entry, cube;
+    for(size_t i = 0; i < nbase; ++i) {
+	Tuple t(rng.randInt(cardinality), rng.randInt(cardinality),
+		(format("host-%d") % rng.randInt(cardinality)).str(),
+		rng.randInt(cardinality) * 1000000007LL, rng.randInt(cardinality),
+		(format("/dir/file-%d") % rng.randInt(cardinality)).str());
+	tuples.push_back(t);
+	double v = rng.randDouble();
+	by_entry.add(t, v);
+	cube.add(t, v);
+    }
+
+    Clock::Tfrac start = Clock::todTfrac();
+    by_entry.base_data.walk(boost::bind(cubeByEntry, &by_entry, _1, _2));
+    double entry_seconds = Clock::TfracToDouble(Clock::todTfrac() - start);
+
+    start = Clock::todTfrac();
+    cube.cube();
+    double cube_seconds = Clock::TfracToDouble(Clock::todTfrac() - start);
+    SINVARIANT(cube.size() == by_entry.size());
+
+    size_t nbase_distinct = cube.base_data.size();
+    double per = 1.0e9 / (nbase_distinct * (nmasks - 1));
+    cout << format("%d base tuples, %d distinct, %d cube entries\n")
+	% nbase % nbase_distinct % cube.size();
+    cout << format("cube via getCubeEntry %.3f s (%.1f ns/partial), cube() %.3f s"
+		   " (%.1f ns/partial), %.2fx\n")
+	% entry_seconds % (entry_seconds * per) % cube_seconds % (cube_seconds * per)
+	% (entry_seconds / cube_seconds);
+    hashTest(tuples);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Test StringId, including assigning ids from many threads at once.
+*/
+
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Lintel/HashMap.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/PThread.hpp>
+#include <Lintel/StringId.hpp>
+#include <Lintel/TestUtil.hpp>
+
+using namespace std;
+using boost::format;
+
+void testBasic() {
+    StringId sid;
+    SINVARIANT(sid.maxId() == 1 && sid.size() == 0);
+    SINVARIANT(sid.getId("hello") == 1 && sid.getId("") == 2 && sid.getId("world") == 3);
+    SINVARIANT(sid.getId(string("hello")) == 1 && sid.getId(lintel::StringRef("", 0)) == 2);
+    SINVARIANT(sid.getId(string("a\0b", 3)) == 4 && sid.getId(string("a\0c", 3)) == 5);
+    SINVARIANT(sid.getString(1) == "hello" && sid.getString(2) == "");
+    SINVARIANT(sid.getString(4) == string("a\0b", 3) && sid.maxId() == 6);
+    TEST_INVARIANT_MSG1(sid.getString(6), "invalid id 6, max id is 6");
+    TEST_INVARIANT_MSG1(sid.getString(0), "invalid id 0, max id is 6");
+
+    // an empty string first, with nothing in the arena
+    StringId sid2;
+    SINVARIANT(sid2.getId("") == 1 && sid2.getString(1) == "" && sid2.getId("") == 1);
+
+    MersenneTwisterRandom rng;
+    cout << format("seed %d\n") % rng.seedUsed();
+    StringId sid3;
+    vector<string> strings;
+    for(int i = 0; i < 100000; ++i) {
+	strings.push_back((format("/path/%d/%d") % rng.randInt(100) % rng.randInt(1000)).str());
+    }
+    // batches that repeat strings, including within a batch
+    vector<unsigned int> ids;
+    sid3.getIds(strings, ids);
+    SINVARIANT(ids.size() == strings.size());
+    HashMap<string, unsigned int> expected;
+    for(size_t i = 0; i < strings.size(); ++i) {
+	unsigned int &id = expected[strings[i]];
+	if (id == 0) {
+	    id = expected.size();
+	}
+	SINVARIANT(ids[i] == id && sid3.getId(strings[i]) == id);
+	SINVARIANT(sid3.getString(id) == strings[i]);
+    }
+    SINVARIANT(sid3.size() == expected.size());
+    cout << format("basic test passed; %d strings use %d bytes.\n")
+	% sid3.size() % sid3.memoryUsage();
+}
+
+void *idWorker(StringId *sid, const vector<string> *strings, uint32_t seed,
+	       vector<unsigned int> *out) {
+    MersenneTwisterRandom rng(seed);
+    out->resize(strings->size());
+    for(size_t i = 0; i < strings->size(); i += 100) {
+	// alternate between single and batched assignment
+	if (rng.randInt(2) == 0) {
+	    for(size_t j = i; j < i + 100; ++j) {
+		(*out)[j] = sid->getId((*strings)[j]);
+	    }
+	} else {
+	    vector<string> batch(strings->begin() + i, strings->begin() + i + 100);
+	    vector<unsigned int> ids;
+	    sid->getIds(batch, ids);
+	    copy(ids.begin(), ids.end(), out->begin() + i);
+	}
+    }
+    return NULL;
+}
+
+void testThreads(int nthreads) {
+    StringId sid(true);
+    vector<string> strings;
+    for(int i = 0; i < 100000; ++i) {
+	strings.push_back((format("/threaded/%d") % (i % 30000)).str());
+    }
+    vector<vector<unsigned int> > results(nthreads);
+    vector<PThreadFunction *> threads;
+    for(int i = 0; i < nthreads; ++i) {
+	threads.push_back(new PThreadFunction
+			  (boost::bind(idWorker, &sid, &strings, i + 1, &results[i])));
+	threads.back()->start();
+    }
+    for(int i = 0; i < nthreads; ++i) {
+	threads[i]->join();
+	delete threads[i];
+    }
+    SINVARIANT(sid.size() == 30000);
+    for(size_t i = 0; i < strings.size(); ++i) {
+	for(int j = 0; j < nthreads; ++j) {
+	    SINVARIANT(results[j][i] == results[0][i]);
+	}
+	SINVARIANT(sid.getString(results[0][i]) == strings[i]);
+    }
+    cout << format("thread test with %d threads passed.\n") % nthreads;
+}
+
+int main() {
+    testBasic();
+    testThreads(8);
+    return 0;
+}
@@ -0,0 +1,137 @@
+/* -*-C++-*-
+   (c) Copyright 2008, Hewlett-Packard Development Company, LP
+
+   See the file named COPYING for license details
+*/
+
+/** @file
+    Compare the time and memory used by StringId to dictionary encode
+    path names against a HashMap from std::string to id plus a vector
+    of std::string for the reverse mapping, for one at a time and
+    batched assignment.
+
+    Usage: string_id_speed [nstrings [ndistinct]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Lintel/AssertBoost.hpp>
+#include <Lintel/Clock.hpp>
+#include <Lintel/HashMap.hpp>
+#include <Lintel/MersenneTwisterRandom.hpp>
+#include <Lintel/StringId.hpp>
+
+using namespace std;
+using boost::format;
+
+class HashMapDictionary {
+public:
+    unsigned int getId(const string &str) {
+	unsigned int &id = ids[str];
+	if (id == 0) {
+	    strings.push_back(str);
+	    id = strings.size();
+	}
+	return id;
+    }
+    void getString(unsigned int id, string &out) const {
+	out = strings[id - 1];
+    }
+    size_t size() const {
+	return strings.size();
+    }
+    // Does not count malloc's overhead, so is an underestimate.
+    size_t memoryUsage() const {
+	size_t ret = ids.memoryUsage() + sizeof(string) * strings.capacity();
+	for(size_t i = 0; i < strings.size(); ++i) {
+	    // a copy in each of the map and the vector, unless short
+	    // enough for the string to hold it
+	    if (strings[i].size() >= sizeof(string)) {
+		ret += 2 * (strings[i].capacity() + 1);
+	    }
+	}
+	return ret;
+    }
+private:
+    HashMap<string, unsigned int> ids;
+    vector<string> strings;
+};
+
+template<class Dict> void report(const string &name, Dict &dict, const vector<string> &paths,
+				 double elapsed) {
+    Clock::Tfrac start = Clock::todTfrac();
+    size_t total = 0;
+    string out;
+    for(size_t i = 0; i < paths.size(); ++i) {
+	dict.getString(i % 1000 + 1, out);
+	total += out.size();
+    }
+    double lookup_elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+    SINVARIANT(total > 0);
+    cout << format("%-22s %6.1f ns/getId %6.1f ns/getString %6.1f bytes/string\n")
+	% name % (elapsed * 1.0e9 / paths.size()) % (lookup_elapsed * 1.0e9 / paths.size())
+	% (static_cast<double>(dict.memoryUsage()) / dict.size());
+}
+
+int main(int argc, char *argv[]) {
+    INVARIANT(argc <= 3, "Usage: string_id_speed [nstrings [ndistinct]]");
+    size_t nstrings = argc > 1 ? strtoul(argv[1], NULL, 10) : 10*1000*1000;
+    size_t ndistinct = argc > 2 ? strtoul(argv[2], NULL, 10) : 2*1000*1000;
+    SINVARIANT(ndistinct >= 1000 && nstrings >= ndistinct);
+
+    MersenneTwisterRandom rng;
+    vector<string> paths;
+    for(size_t i = 0; i < nstrings; ++i) {
+	char buf[128];
+	// the first ndistinct are all different, so every dictionary
+	// has at least 1000 strings for the getString loop.
+	uint32_t n = i < ndistinct ? i : rng.randInt(ndistinct);
+	snprintf(buf, sizeof(buf), "/nfs/home/user%u/data/2008/%02u/trace-%u.ds",
+		 n % 113, n % 12, n);
+	paths.push_back(buf);
+    }
+    size_t path_bytes = 0;
+    for(size_t i = 0; i < ndistinct; ++i) {
+	path_bytes += paths[i].size();
+    }
+    cout << format("%d strings, %d distinct, %.1f bytes each, seed %d\n")
+	% nstrings % ndistinct % (static_cast<double>(path_bytes) / ndistinct) % rng.seedUsed();
+
+    {
+	HashMapDictionary *dict = new HashMapDictionary();
+	Clock::Tfrac start = Clock::todTfrac();
+	for(size_t i = 0; i < paths.size(); ++i) {
+	    dict->getId(paths[i]);
+	}
+	double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+	report("HashMap + vector", *dict, paths, elapsed);
+	delete dict;
+    }
+
+    static const char *names[] = { "StringId getIds", "StringId thread safe", "StringId getId" };
+    for(int mode = 0; mode < 3; ++mode) {
+	StringId *sid = new StringId(mode == 1);
+	Clock::Tfrac start = Clock::todTfrac();
+	if (mode == 2) {
+	    for(size_t i = 0; i < paths.size(); ++i) {
+		sid->getId(paths[i]);
+	    }
+	} else {
+	    vector<lintel::StringRef> batch;
+	    vector<unsigned int> ids;
+	    for(size_t i = 0; i < paths.size(); i += 1024) {
+		batch.assign(paths.begin() + i, paths.begin() + min(i + 1024, paths.size()));
+		sid->getIds(batch, ids);
+	    }
+	}
+	double elapsed = Clock::TfracToDouble(Clock::todTfrac() - start);
+	SINVARIANT(sid->size() == ndistinct);
+	report(names[mode], *sid, paths, elapsed);
+	delete sid;
+    }
+    return 0;
+}
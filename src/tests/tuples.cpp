@@ -18,6 +18,33 @@ template<typename T> string toStr(const T &t) {
     return out.str();
 }
 
+// every partial tuple hashes the same through BitsetAnyTupleHashes
+template<class T> void checkPartialHashes(const T &tuple) {
+    typedef lintel::tuples::BitsetAnyTuple<T> Any;
+    lintel::tuples::BitsetAnyTupleHashes<T> hashes(tuple);
+    Any partial(tuple);
+    for(uint32_t mask = 0; mask < (1U << Any::length); ++mask) {
+        for(uint32_t i = 0; i < Any::length; ++i) {
+            partial.any[i] = ((mask >> i) & 1) != 0;
+        }
+        INVARIANT(hashes[mask] == lintel::hash(partial) && hashes.hash(partial.any) == hashes[mask],
+                  format("mask %d: %d != %d") % mask % hashes[mask] % lintel::hash(partial));
+    }
+}
+
+void testPartialHashes(const Tuple &tuple1, const Tuple &tuple2) {
+    checkPartialHashes(tuple1);
+    checkPartialHashes(tuple2);
+    checkPartialHashes(boost::tuple<int32_t>(5));
+    checkPartialHashes(boost::tuple<int32_t, string>(5, "x"));
+    checkPartialHashes(boost::tuple<int32_t, int32_t, int64_t, string, char, bool>
+                       (1, 2, 3, "four", '5', true));
+
+    lintel::tuples::BitsetAnyTupleHashes<Tuple> hashes(tuple1);
+    hashes.reset(tuple2);
+    SINVARIANT(hashes[0] == boost::tuples::hash(tuple2));
+}
+
 int main() {
     Tuple tuple1(true, 'a', 7, 123456789023LL, "Hello, World");
     // alternate so attributes are <, >, <, >, <
@@ -107,5 +134,6 @@ int main() {
     INVARIANT(toStr(bitsetanytuple2) == "(* * 6 * Iello, World)",
               format("got '%s'") % toStr(bitsetanytuple2));
 
+    testPartialHashes(tuple1, tuple2);
     return 0;
 }